@@ -7,6 +7,8 @@
 #extension GL_EXT_shader_explicit_arithmetic_types : require
 #include "utility.glsl"
 
+#define MESH_MAX_LODS 4
+
 struct NormalUV
 {
     uint32_t normal;
@@ -49,6 +51,15 @@ layout(scalar, buffer_reference, buffer_reference_align = 8) readonly buffer Nor
     NormalUV normalUVs[];
 };
 
+struct MeshLod
+{
+    uint32_t indexOffset;
+    uint32_t indexCount;
+    uint32_t meshletOffset;
+    uint32_t meshletCount;
+    float error;
+};
+
 struct Mesh
 {
     uint32_t indexCount;
@@ -57,6 +68,11 @@ struct Mesh
     uint32_t positionBufferOffset;
     uint32_t normalUVBufferOffset;
     uint32_t baseColorIndex;
+    uint32_t meshletBufferOffset;
+    uint32_t meshletCount;
+    uint32_t meshIndex;
+    uint32_t lodCount;
+    MeshLod lods[MESH_MAX_LODS];
 };
 
 layout(scalar, buffer_reference, buffer_reference_align = 4) readonly buffer MeshBuffer
@@ -64,12 +80,19 @@ layout(scalar, buffer_reference, buffer_reference_align = 4) readonly buffer Mes
     Mesh meshes[];
 };
 
+//scene slot of every drawn instance, indexed by gl_InstanceIndex
+layout(scalar, buffer_reference, buffer_reference_align = 4) readonly buffer InstanceBuffer
+{
+    uint32_t slots[];
+};
+
 layout(scalar, push_constant) uniform PC
 {
     CameraBuffer pCamera;
     MeshBuffer pMeshes;
     TransformBuffer pTransform;
     uint64_t pVertexBuffer;
+    InstanceBuffer pInstances;
 };
 
 layout(location = 0) out vec3 vs_position;
@@ -79,9 +102,11 @@ layout(location = 3) out uint32_t texIndex;
 
 void main()
 {
-    Mesh mesh = pMeshes.meshes[gl_BaseInstance];
+    uint32_t slot = pInstances.slots[gl_InstanceIndex];
+
+    Mesh mesh = pMeshes.meshes[slot];
 
-    Transform transform = pTransform.transforms[gl_BaseInstance];
+    Transform transform = pTransform.transforms[slot];
     transform.rotation = transform.rotation.yzwx;
 
     vec3 vertexPos = PositionBuffer(pVertexBuffer + uint64_t(mesh.positionBufferOffset)).positions[gl_VertexIndex];
@@ -27,4 +27,77 @@ vec3 quatRotateVec(vec4 q, vec3 v)
 uint64_t padSize2Alignment(uint64_t size, uint64_t alignment)
 {
     return (size + alignment - 1) & ~(alignment - 1);
-}
\ No newline at end of file
+}
+//2D Polyhedral Bounds of a Clipped, Perspective-Projected 3D Sphere. Michael Mara, Morgan McGuire. 2013
+//https://github.com/zeux/niagara/blob/master/src/shaders/math.h
+//center is in view space, returns false when the sphere intersects the near plane
+bool projectSphere(vec3 center, float radius, float near, float P00, float P11, out vec4 aabb)
+{
+    if(center.z < radius + near)
+    {
+        return false;
+    }
+
+    vec3 cr = center * radius;
+    float czr2 = center.z * center.z - radius * radius;
+
+    float vx = sqrt(center.x * center.x + czr2);
+    float minx = (vx * center.x - cr.z) / (vx * center.z + cr.x);
+    float maxx = (vx * center.x + cr.z) / (vx * center.z - cr.x);
+
+    float vy = sqrt(center.y * center.y + czr2);
+    float miny = (vy * center.y - cr.z) / (vy * center.z + cr.y);
+    float maxy = (vy * center.y + cr.z) / (vy * center.z - cr.y);
+
+    aabb = vec4(minx * P00, miny * P11, maxx * P00, maxy * P11) * 0.5 + vec4(0.5); //clip space -> uv space
+    return true;
+}
+
+//the storage view of an srgb image is unorm, so the encode has to happen in the shader
+vec3 linearToSrgb(vec3 color)
+{
+    vec3 low = color * 12.92;
+    vec3 high = 1.055 * pow(color, vec3(1.0 / 2.4)) - 0.055;
+    return mix(low, high, greaterThan(color, vec3(0.0031308)));
+}
+
+//perspective correct barycentrics of a pixel and their screen space derivatives, the points are in clip space
+//http://filmicworlds.com/blog/visibility-buffer-rendering-with-material-graphs/
+void computeBarycentrics(vec4 p0, vec4 p1, vec4 p2, vec2 pixelNdc, vec2 imageSize, out vec3 lambda, out vec3 ddx, out vec3 ddy)
+{
+    vec3 invW = 1.0 / vec3(p0.w, p1.w, p2.w);
+
+    vec2 ndc0 = p0.xy * invW.x;
+    vec2 ndc1 = p1.xy * invW.y;
+    vec2 ndc2 = p2.xy * invW.z;
+
+    vec2 edge0 = ndc2 - ndc1;
+    vec2 edge1 = ndc0 - ndc1;
+    float invDet = 1.0 / (edge0.x * edge1.y - edge1.x * edge0.y);
+
+    ddx = vec3(ndc1.y - ndc2.y, ndc2.y - ndc0.y, ndc0.y - ndc1.y) * invDet * invW;
+    ddy = vec3(ndc2.x - ndc1.x, ndc0.x - ndc2.x, ndc1.x - ndc0.x) * invDet * invW;
+
+    float ddxSum = ddx.x + ddx.y + ddx.z;
+    float ddySum = ddy.x + ddy.y + ddy.z;
+
+    vec2 delta = pixelNdc - ndc0;
+    float interpInvW = invW.x + delta.x * ddxSum + delta.y * ddySum;
+    float interpW = 1.0 / interpInvW;
+
+    lambda.x = interpW * (invW.x + delta.x * ddx.x + delta.y * ddy.x);
+    lambda.y = interpW * (delta.x * ddx.y + delta.y * ddy.y);
+    lambda.z = interpW * (delta.x * ddx.z + delta.y * ddy.z);
+
+    //one pixel step in ndc, vulkan ndc y already points down the image
+    ddx *= 2.0 / imageSize.x;
+    ddy *= 2.0 / imageSize.y;
+    ddxSum *= 2.0 / imageSize.x;
+    ddySum *= 2.0 / imageSize.y;
+
+    float interpWdx = 1.0 / (interpInvW + ddxSum);
+    float interpWdy = 1.0 / (interpInvW + ddySum);
+
+    ddx = interpWdx * (lambda * interpInvW + ddx) - lambda;
+    ddy = interpWdy * (lambda * interpInvW + ddy) - lambda;
+}
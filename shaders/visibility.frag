@@ -0,0 +1,28 @@
+#version 460
+#extension GL_EXT_scalar_block_layout : require
+#extension GL_EXT_buffer_reference : require
+#extension GL_EXT_nonuniform_qualifier : require
+#extension GL_EXT_shader_16bit_storage : require
+#extension GL_EXT_shader_explicit_arithmetic_types : require
+#include "utility.glsl"
+
+layout(set = 0, binding = 0) uniform sampler2D Textures[];
+
+layout(location = 0) in vec2 uv;
+layout(location = 1) flat in uint32_t texIndex;
+layout(location = 2) flat in uint32_t slot;
+layout(location = 3) flat in uint32_t firstTriangle;
+
+//scene slot and triangle, everything else is reconstructed by material.comp
+layout(location = 0) out uvec2 out_visibility;
+
+void main()
+{
+    //same alpha test as geometry.frag, only the alpha is fetched
+    if(texIndex != 0 && texture(Textures[texIndex], uv).a == 0)
+    {
+        discard;
+    }
+
+    out_visibility = uvec2(slot, firstTriangle + uint32_t(gl_PrimitiveID));
+}
@@ -0,0 +1,140 @@
+#version 460
+#extension GL_EXT_scalar_block_layout : require
+#extension GL_EXT_buffer_reference : require
+#extension GL_EXT_buffer_reference2 : require
+#extension GL_EXT_nonuniform_qualifier : require
+#extension GL_EXT_shader_16bit_storage : require
+#extension GL_EXT_shader_explicit_arithmetic_types : require
+#include "utility.glsl"
+
+#define MESH_MAX_LODS 4
+
+struct NormalUV
+{
+    uint32_t normal;
+    uint32_t uv;
+};
+
+struct Transform
+{
+    vec3 translation;
+    vec3 translation_err;
+    vec4 rotation;
+    vec3 scale;
+};
+
+layout(std430, buffer_reference, buffer_reference_align = 256) readonly buffer CameraBuffer
+{
+    mat4x4 view;
+    mat4x4 projection;
+    mat4x4 viewProjection;
+    vec3 location;
+    vec3 location_err;
+    vec4 frustum;
+    float near;
+    float far;
+    float pad3[2];
+};
+
+layout(scalar, buffer_reference, buffer_reference_align = 4) readonly buffer TransformBuffer
+{
+    Transform transforms[];
+};
+
+layout(scalar, buffer_reference, buffer_reference_align = 4) readonly buffer PositionBuffer
+{
+    vec3 positions[];
+};
+
+layout(scalar, buffer_reference, buffer_reference_align = 8) readonly buffer NormalUVBuffer
+{
+    NormalUV normalUVs[];
+};
+
+struct MeshLod
+{
+    uint32_t indexOffset;
+    uint32_t indexCount;
+    uint32_t meshletOffset;
+    uint32_t meshletCount;
+    float error;
+};
+
+struct Mesh
+{
+    uint32_t indexCount;
+    uint32_t vertexCount;
+    uint32_t indexBufferOffset;
+    uint32_t positionBufferOffset;
+    uint32_t normalUVBufferOffset;
+    uint32_t baseColorIndex;
+    uint32_t meshletBufferOffset;
+    uint32_t meshletCount;
+    uint32_t meshIndex;
+    uint32_t lodCount;
+    MeshLod lods[MESH_MAX_LODS];
+};
+
+layout(scalar, buffer_reference, buffer_reference_align = 4) readonly buffer MeshBuffer
+{
+    Mesh meshes[];
+};
+
+struct VkDrawIndexedIndirectCommand
+{
+    uint32_t    indexCount;
+    uint32_t    instanceCount;
+    uint32_t    firstIndex;
+    int32_t     vertexOffset;
+    uint32_t    firstInstance;
+};
+
+layout(scalar, buffer_reference, buffer_reference_align = 4) readonly buffer DrawIndirectCommands
+{
+    VkDrawIndexedIndirectCommand commands[];
+};
+
+//scene slot of every drawn instance, indexed by gl_InstanceIndex
+layout(scalar, buffer_reference, buffer_reference_align = 4) readonly buffer InstanceBuffer
+{
+    uint32_t slots[];
+};
+
+layout(scalar, push_constant) uniform PC
+{
+    CameraBuffer pCamera;
+    MeshBuffer pMeshes;
+    TransformBuffer pTransform;
+    uint64_t pVertexBuffer;
+    InstanceBuffer pInstances;
+    DrawIndirectCommands pDrawCommands;
+};
+
+layout(location = 0) out vec2 uv;
+layout(location = 1) out uint32_t texIndex;
+layout(location = 2) out uint32_t slot;
+layout(location = 3) out uint32_t firstTriangle;
+
+void main()
+{
+    slot = pInstances.slots[gl_InstanceIndex];
+
+    Mesh mesh = pMeshes.meshes[slot];
+
+    Transform transform = pTransform.transforms[slot];
+    transform.rotation = transform.rotation.yzwx;
+
+    vec3 vertexPos = PositionBuffer(pVertexBuffer + uint64_t(mesh.positionBufferOffset)).positions[gl_VertexIndex];
+    uint32_t vertexUV = NormalUVBuffer(pVertexBuffer + uint64_t(mesh.normalUVBufferOffset)).normalUVs[gl_VertexIndex].uv;
+
+    vec3 delta_pos = (transform.translation - pCamera.location) - (transform.translation_err - pCamera.location_err);
+    vec3 position = quatRotateVec(transform.rotation, vertexPos) * transform.scale + delta_pos;
+
+    uv = unpackUnorm2x16(vertexUV);
+    texIndex = uint32_t(mesh.baseColorIndex);
+
+    //gl_PrimitiveID restarts at every draw, this turns it into an index into the global index buffer
+    firstTriangle = pDrawCommands.commands[gl_DrawID].firstIndex / 3;
+
+    gl_Position = pCamera.viewProjection * vec4(position, 1.0);
+}
\ No newline at end of file
@@ -5,20 +5,23 @@
 #include "steamaudio/include/phonon.h"
 #include "core/resource.hpp"
 #include "core/math.hpp"
-#include "taskflow/taskflow.hpp"
-#include "tbb/concurrent_unordered_map.h"
+#include "core/job_scheduler.hpp"
+#include "core/asset_registry.hpp"
+#include "core/epoch.hpp"
 #include "core/filesystem.hpp"
 #include <string>
 #include <unordered_map>
 #include <unordered_set>
 #include <memory>
 #include <atomic>
+#include <mutex>
 #include <filesystem>
 
 class AAudioBuffer : public SharedAsset
 {
 public:
-    static AAudioBuffer* LoadAsset(const std::fpath& Path);
+    static AAudioBuffer* LoadAsset(AssetId Id);
+    static void RetireAsset(AssetId Id);
 public:
 
     std::vector<std::vector<float>> pcmChannels{};
@@ -62,8 +65,11 @@ private:
     IPLHRTFSettings HrtfSettings{};
     IPLAudioSettings AudioSettings{};
 
-    tbb::concurrent_unordered_map<std::filesystem::path, AAudioBuffer> AudioBuffers{};
-    tf::Executor TaskExecutor{};
+    TAssetTable<AAudioBuffer> AudioBuffers{};
+    JobGroup LoadJobs{JobPriority::Streaming};
+
+    std::mutex ReferenceMx{}; //held while references on the buffers are taken, and while retired buffers are checked and freed
+    RetireList Retired{false}; //nothing on the device reads the buffers
 
 public:
 
@@ -72,9 +78,11 @@ public:
 
     IPLBinauralEffect CreateBinauralEffect();
 
-    AAudioBuffer* LoadAudioFile(const std::fpath& Path);
+    //the buffer with a reference taken for the caller
+    AAudioBuffer* LoadAudioFile(AssetId Id);
+    void RetireAudioBuffer(AssetId Id);
 
-    void GarbageCollect();
+    void Reclaim();
 
 private:
 
@@ -60,9 +60,14 @@ static void SteamAudioLogCallback(IPLLogLevel level, const char* message)
     }
 }
 
-AAudioBuffer* AAudioBuffer::LoadAsset(const std::fpath& Path)
+AAudioBuffer* AAudioBuffer::LoadAsset(AssetId Id)
 {
-    return alContext->LoadAudioFile(Path);
+    return alContext->LoadAudioFile(Id);
+}
+
+void AAudioBuffer::RetireAsset(AssetId Id)
+{
+    alContext->RetireAudioBuffer(Id);
 }
 
 AContext::AContext()
@@ -85,9 +90,9 @@ AContext::AContext()
 
 AContext::~AContext()
 {
-    TaskExecutor.wait_for_all();
+    global::Scheduler.Wait(LoadJobs, JobPriority::FrameCritical); //the loads are left to the workers
     LOG_INFO("destroying audio context");
-    GarbageCollect();
+    Retired.Drain();
     VERIFY(AudioBuffers.size() == 0, ASSERTION::NONFATAL);
 
     iplHRTFRelease(&hrtf);
@@ -97,25 +102,33 @@ AContext::~AContext()
     Context = nullptr;
 }
 
-AAudioBuffer* AContext::LoadAudioFile(const std::fpath& Path)
+AAudioBuffer* AContext::LoadAudioFile(AssetId Id)
 {
-    auto[it, inserted] = AudioBuffers.emplace(Path, AAudioBuffer{});
-    if(inserted)
+    std::unique_lock Guard{ReferenceMx};
+
+    auto[BufferId, Buffer, bInserted] = AudioBuffers.Emplace(Id);
+    Buffer->AddReference();
+
+    Guard.unlock();
+
+    //the loader holds a reference, so the buffer is not retired before it is loaded
+    if(bInserted)
     {
-        TaskExecutor.silent_async([=]()
+        global::Scheduler.Submit(JobPriority::Streaming, [Asset = TAssetPtr{BufferId, Buffer}]()
         {
-            if(it->first.extension() == ".ogg")
+            std::fpath Path = Asset.GetPath();
+            if(Path.extension() == ".ogg")
             {
-                LoadOggVorbisFile_Impl(TAssetPtr{it->first, &it->second});
+                LoadOggVorbisFile_Impl(Asset);
             }
             else
             {
-                VERIFY(false, "unsupported audio file format", it->first.extension());
+                VERIFY(false, "unsupported audio file format", Path.extension());
             }
-        });
+        }, &LoadJobs);
     }
 
-    return &it->second;
+    return Buffer;
 }
 
 void AContext::LoadOggVorbisFile_Impl(TAssetPtr<AAudioBuffer> AudioBuffer)
@@ -235,26 +248,33 @@ void AContext::LoadOggVorbisFile_Impl(TAssetPtr<AAudioBuffer> AudioBuffer)
 }
  */
 
-void AContext::GarbageCollect()
+void AContext::RetireAudioBuffer(AssetId Id)
 {
-    if(TaskExecutor.num_topologies() != 0)
+    std::lock_guard Guard{ReferenceMx};
+
+    AAudioBuffer* Buffer = AudioBuffers.Find(Id);
+    if(Buffer == nullptr || Buffer->GetRefCount() != 0)
     {
         return;
     }
 
-    auto it = AudioBuffers.begin();
-    while(it != AudioBuffers.end())
+    Buffer->SetRetiredIn(Retired.Retire([this, Id](uint64_t Epoch)
     {
-        if(it->second.IsLoaded() && it->second.GetRefCount() == 0)
-        {
-            LOG_DEBUG("freeing audio file {}", it->first);
-            it = AudioBuffers.unsafe_erase(it);
-        }
-        else
+        std::lock_guard Guard{ReferenceMx};
+
+        if(FindRetired(AudioBuffers, Id, Epoch))
         {
-            ++it;
+            LOG_DEBUG("freeing audio file {}", global::Assets.GetName(Id));
+            AudioBuffers.Erase(Id);
         }
-    }
+
+        return true;
+    }));
+}
+
+void AContext::Reclaim()
+{
+    Retired.Reclaim();
 }
 
 IPLBinauralEffect AContext::CreateBinauralEffect()
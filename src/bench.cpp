@@ -0,0 +1,574 @@
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <fstream>
+#include <numeric>
+#include <optional>
+#include <pthread.h>
+#include <random>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <vector>
+#include "core/log.hpp"
+#include "core/time.hpp"
+#include "core/filesystem.hpp"
+#include "core/cpu_profiler.hpp"
+#include "core/range_allocator.hpp"
+#include "audio/audio_context.hpp"
+#include "core/utility_functions.hpp"
+#include "render/vk_context.hpp"
+#include "render/vk_model.hpp"
+#include "render/vk_render_target.hpp"
+#include "world/world.hpp"
+#include "world/transform_component.hpp"
+#include "world/render_module.hpp"
+#include "world/audio_module.hpp"
+#include "world/input_module.hpp"
+
+//starsight_bench [--entities <n>] [--frames <n>] [--warmup <n>] [--seed <n>] [--spline <file>] [--output <file>] [--trace <file>]
+//renders a seeded scene headless while the camera flies along a closed spline and writes a json report
+//the world always advances by BENCH_DELTA_TIME so two runs with the same arguments render the same frames
+
+//starsight_bench --range-allocator <operations> [--seed <n>] [--output <file>]
+//times alloc/free pairs against a live set of BENCH_RANGE_ALLOCATIONS ranges instead, without creating a renderer
+
+#ifndef BENCH_DELTA_TIME
+#define BENCH_DELTA_TIME (1.0 / 60.0) //seconds the world advances each frame, independent of how long the frame took
+#endif
+
+#ifndef BENCH_FIELD_SPACING
+#define BENCH_FIELD_SPACING 25.0 //the field is a cube of BENCH_FIELD_SPACING * cbrt(entities) to a side
+#endif
+
+#ifndef BENCH_SPLINE_POINTS
+#define BENCH_SPLINE_POINTS 8 //control points of a generated spline
+#endif
+
+#ifndef BENCH_MAX_LOAD_FRAMES
+#define BENCH_MAX_LOAD_FRAMES 100000 //frames to wait for every model to be built before measuring anyway
+#endif
+
+#ifndef BENCH_RANGE_CAPACITY
+#define BENCH_RANGE_CAPACITY (256ull << 20) //about half used by the live set
+#endif
+
+#ifndef BENCH_RANGE_ALLOCATIONS
+#define BENCH_RANGE_ALLOCATIONS 4096 //live ranges, every operation replaces a random one of them
+#endif
+
+#ifndef BENCH_RANGE_MAX_SIZE
+#define BENCH_RANGE_MAX_SIZE 65536 //sizes are uniform in [256, BENCH_RANGE_MAX_SIZE], like mesh buffers
+#endif
+
+struct BenchOptions
+{
+    uint64_t Entities = 10000;
+    uint64_t Frames = 2000;
+    uint64_t Warmup = 200;
+    uint64_t Seed = 1;
+    std::fpath Spline{};
+    std::fpath Output = ProjectAbsolutePath("saved/bench/report.json");
+    std::fpath Trace{}; //cpu zones of the end of the run when set
+    uint64_t RangeAllocatorOperations = 0; //runs the range allocator benchmark instead of the scene when set
+};
+
+static BenchOptions ParseOptions(int argc, char** argv)
+{
+    BenchOptions Options{};
+
+    for(int arg = 1; arg + 1 < argc; arg += 2)
+    {
+        std::string_view Option{argv[arg]};
+        const char* Value = argv[arg + 1];
+
+        if(Option == "--entities")
+        {
+            Options.Entities = std::stoull(Value);
+        }
+        else if(Option == "--frames")
+        {
+            Options.Frames = std::max<uint64_t>(1, std::stoull(Value));
+        }
+        else if(Option == "--warmup")
+        {
+            Options.Warmup = std::stoull(Value);
+        }
+        else if(Option == "--seed")
+        {
+            Options.Seed = std::stoull(Value);
+        }
+        else if(Option == "--spline")
+        {
+            Options.Spline = Value;
+        }
+        else if(Option == "--output")
+        {
+            Options.Output = Value;
+        }
+        else if(Option == "--trace")
+        {
+            Options.Trace = Value;
+        }
+        else if(Option == "--range-allocator")
+        {
+            Options.RangeAllocatorOperations = std::stoull(Value);
+        }
+        else
+        {
+            LOG_WARNING("unknown option {}", Option);
+        }
+    }
+
+    return Options;
+}
+
+//closed uniform catmull-rom spline through the control points
+class CameraSpline
+{
+public:
+    std::vector<glm::dvec3> Points{};
+
+    glm::dvec3 Location(double Time) const
+    {
+        auto [P0, P1, P2, P3, t] = Segment(Time);
+
+        return 0.5 * ((2.0 * P1)
+            + (P2 - P0) * t
+            + (2.0 * P0 - 5.0 * P1 + 4.0 * P2 - P3) * t * t
+            + (3.0 * P1 - P0 - 3.0 * P2 + P3) * t * t * t);
+    }
+
+    glm::dvec3 Tangent(double Time) const
+    {
+        auto [P0, P1, P2, P3, t] = Segment(Time);
+
+        return 0.5 * ((P2 - P0)
+            + (2.0 * P0 - 5.0 * P1 + 4.0 * P2 - P3) * 2.0 * t
+            + (3.0 * P1 - P0 - 3.0 * P2 + P3) * 3.0 * t * t);
+    }
+
+    //looks along the spline with the world up on top, forward is +Y like everywhere else
+    glm::dquat Rotation(double Time) const
+    {
+        glm::dvec3 Forward = glm::normalize(Tangent(Time));
+        glm::dvec3 Up = std::abs(glm::dot(Forward, axis::up)) > 0.999 ? axis::forward : axis::up;
+        glm::dvec3 Right = glm::normalize(glm::cross(Forward, Up));
+        Up = glm::cross(Right, Forward);
+
+        return glm::normalize(glm::quat_cast(glm::dmat3x3{Right, Forward, Up}));
+    }
+
+private:
+
+    //Time in [0, 1) covers the whole loop
+    std::tuple<glm::dvec3, glm::dvec3, glm::dvec3, glm::dvec3, double> Segment(double Time) const
+    {
+        const int64_t Count = static_cast<int64_t>(Points.size());
+        double Scaled = math::frac(Time) * static_cast<double>(Count);
+        int64_t Index = std::min(static_cast<int64_t>(Scaled), Count - 1);
+
+        auto Point = [&](int64_t Offset){ return Points[(Index + Offset + Count) % Count]; };
+
+        return {Point(-1), Point(0), Point(1), Point(2), Scaled - static_cast<double>(Index)};
+    }
+};
+
+//one "x y z" per line
+static CameraSpline LoadSpline(const std::fpath& Path)
+{
+    CameraSpline Spline{};
+
+    std::ifstream File{Path};
+    VERIFY(File.is_open(), "failed to open spline", Path.string());
+
+    glm::dvec3 Point{};
+    while(File >> Point.x >> Point.y >> Point.z)
+    {
+        Spline.Points.emplace_back(Point);
+    }
+
+    VERIFY(Spline.Points.size() >= 4, "a spline needs at least 4 points", Path.string());
+    return Spline;
+}
+
+static CameraSpline MakeSpline(std::mt19937_64& Random, double Extent)
+{
+    CameraSpline Spline{};
+
+    //around the field at varying radius and height so the view alternates between looking into and across it
+    std::uniform_real_distribution<double> Radius{0.3 * Extent, 0.8 * Extent};
+    std::uniform_real_distribution<double> Height{-0.3 * Extent, 0.3 * Extent};
+
+    for(uint64_t point = 0; point < BENCH_SPLINE_POINTS; ++point)
+    {
+        double Angle = (2.0 * M_PI * static_cast<double>(point)) / BENCH_SPLINE_POINTS;
+        double PointRadius = Radius(Random);
+
+        Spline.Points.emplace_back(std::cos(Angle) * PointRadius, std::sin(Angle) * PointRadius, Height(Random));
+    }
+
+    return Spline;
+}
+
+static void SpawnScene(flecs::world& World, std::mt19937_64& Random, uint64_t Entities, double Extent)
+{
+    //interned once, every entity only copies the id
+    const std::array<TAssetPtr<VModel>, 2> Models{
+        TAssetPtr<VModel>{ProjectAbsolutePath("assets/models/cube.gltf")},
+        TAssetPtr<VModel>{ProjectAbsolutePath("assets/models/space_rock.gltf")}
+    };
+
+    std::uniform_real_distribution<double> Location{-Extent, Extent};
+    std::uniform_real_distribution<double> Scale{0.1, 2.0};
+    std::uniform_real_distribution<double> Angle{0.0, 2.0 * M_PI};
+    std::uniform_int_distribution<uint32_t> Model{0, 15};
+
+    for(uint64_t i = 0; i < Entities; i++)
+    {
+        glm::dvec3 Axis = glm::normalize(glm::dvec3{Location(Random), Location(Random), Location(Random)} + glm::dvec3{1e-6});
+
+        World.entity()
+        .set<ModelComponent>({
+            .Asset = Models[Model(Random) == 0 ? 1 : 0], //one in sixteen is a rock
+            .isBuilt = false
+        })
+        .set<TransformComponent>({
+            .location = {Location(Random), Location(Random), Location(Random)},
+            .rotation = glm::angleAxis(Angle(Random), Axis),
+            .scale = glm::dvec3{Scale(Random)}
+        });
+    }
+}
+
+struct Percentiles
+{
+    double Mean = 0.0;
+    double P50 = 0.0;
+    double P95 = 0.0;
+    double P99 = 0.0;
+    double Max = 0.0;
+};
+
+//nearest rank
+static Percentiles MakePercentiles(std::vector<double> Samples)
+{
+    Percentiles Result{};
+    if(Samples.empty())
+    {
+        return Result;
+    }
+
+    std::sort(Samples.begin(), Samples.end());
+
+    auto Rank = [&](double Percentile)
+    {
+        size_t Index = static_cast<size_t>(std::ceil(Percentile * static_cast<double>(Samples.size())));
+        return Samples[std::clamp<size_t>(Index, 1, Samples.size()) - 1];
+    };
+
+    Result.Mean = std::accumulate(Samples.begin(), Samples.end(), 0.0) / static_cast<double>(Samples.size());
+    Result.P50 = Rank(0.50);
+    Result.P95 = Rank(0.95);
+    Result.P99 = Rank(0.99);
+    Result.Max = Samples.back();
+    return Result;
+}
+
+static std::string FormatPercentiles(const Percentiles& Value)
+{
+    return fmt::format(R"({{"mean": {:.4f}, "p50": {:.4f}, "p95": {:.4f}, "p99": {:.4f}, "max": {:.4f}}})",
+                       Value.Mean, Value.P50, Value.P95, Value.P99, Value.Max);
+}
+
+//times every pipeline phase from the end of the one before it
+//the markers are declared after every module, so they run after the other systems of their phase
+class PhaseTimer
+{
+public:
+    static constexpr std::array<std::string_view, 8> Names{
+        "OnLoad", "PostLoad", "PreUpdate", "OnUpdate", "OnValidate", "PostUpdate", "PreStore", "OnStore"
+    };
+
+    std::array<std::vector<double>, Names.size()> Milliseconds{};
+    bool bRecording = false;
+
+    explicit PhaseTimer(flecs::world& World)
+    {
+        const std::array<flecs::entity_t, Names.size()> Phases{
+            flecs::OnLoad, flecs::PostLoad, flecs::PreUpdate, flecs::OnUpdate,
+            flecs::OnValidate, flecs::PostUpdate, flecs::PreStore, flecs::OnStore
+        };
+
+        for(size_t phase = 0; phase < Phases.size(); ++phase)
+        {
+            World.system(fmt::format("Bench {} Marker", Names[phase]).c_str())
+                    .kind(Phases[phase])
+                    .iter([this, phase](flecs::iter&){ Mark(phase); });
+        }
+    }
+
+    void BeginFrame()
+    {
+        Last = double_time_now();
+    }
+
+private:
+
+    void Mark(size_t Phase)
+    {
+        double Now = double_time_now();
+        if(bRecording)
+        {
+            Milliseconds[Phase].emplace_back((Now - Last) * 1000.0);
+        }
+
+        Last = Now;
+    }
+
+    double Last = 0.0;
+};
+
+static void WriteReport(const std::fpath& Output, const std::string& Report)
+{
+    std::error_code Error{};
+    std::filesystem::create_directories(Output.parent_path(), Error);
+
+    std::ofstream File{Output, std::ios::trunc};
+    if(File.is_open())
+    {
+        File << Report;
+        LOG_INFO("bench report written to {}", Output.string());
+    }
+    else
+    {
+        LOG_WARNING("failed to write bench report to {}", Output.string());
+    }
+}
+
+static std::string RangeAllocatorBench(const BenchOptions& Options)
+{
+    struct Operation
+    {
+        uint64_t Slot = 0;
+        uint64_t Size = 0;
+        uint64_t Alignment = 1;
+    };
+
+    std::mt19937_64 Random{Options.Seed};
+    std::uniform_int_distribution<uint64_t> Slot{0, BENCH_RANGE_ALLOCATIONS - 1};
+    std::uniform_int_distribution<uint64_t> Size{256, BENCH_RANGE_MAX_SIZE};
+    std::uniform_int_distribution<uint32_t> AlignmentShift{2, 8};
+
+    //drawn up front so the generator is not part of the measurement
+    std::vector<Operation> Operations(Options.RangeAllocatorOperations);
+    for(Operation& Op : Operations)
+    {
+        Op = {.Slot = Slot(Random), .Size = Size(Random), .Alignment = 1ull << AlignmentShift(Random)};
+    }
+
+    RangeAllocator Allocator{BENCH_RANGE_CAPACITY};
+    std::vector<RangeAllocation> Live(BENCH_RANGE_ALLOCATIONS);
+
+    for(uint64_t slot = 0; slot < Live.size(); ++slot)
+    {
+        Live[slot] = Allocator.Allocate(Size(Random), 16, slot);
+    }
+
+    uint64_t Failed = 0;
+
+    double ChurnStart = double_time_now();
+    for(const Operation& Op : Operations)
+    {
+        RangeAllocation& Allocation = Live[Op.Slot];
+        if(Allocation.IsValid())
+        {
+            Allocator.Free(Allocation);
+        }
+
+        Allocation = Allocator.Allocate(Op.Size, Op.Alignment, Op.Slot);
+        Failed += Allocation.IsValid() ? 0 : 1;
+    }
+    double ChurnSeconds = double_time_now() - ChurnStart;
+
+    RangeAllocatorStats Stats = Allocator.GetStats();
+
+    std::vector<RangeMove> Moves{};
+    double PlanStart = double_time_now();
+    uint64_t PlannedBytes = Allocator.PlanDefragmentation(UINT64_MAX, Moves);
+    double PlanSeconds = double_time_now() - PlanStart;
+
+    const double Nanoseconds = Operations.empty() ? 0.0 : ChurnSeconds * 1e9 / static_cast<double>(Operations.size());
+    LOG_INFO("range allocator bench {:.1f}ns per alloc/free pair, fragmentation {:.3f}", Nanoseconds, Stats.Fragmentation());
+
+    std::string Report = "{\n";
+    Report += fmt::format(R"(  "seed": {},)" "\n", Options.Seed);
+    Report += fmt::format(R"(  "capacity": {},)" "\n", Stats.Capacity);
+    Report += fmt::format(R"(  "live_allocations": {},)" "\n", Stats.AllocationCount);
+    Report += fmt::format(R"(  "operations": {},)" "\n", Operations.size());
+    Report += fmt::format(R"(  "failed_allocations": {},)" "\n", Failed);
+    Report += fmt::format(R"(  "alloc_free_ns": {:.2f},)" "\n", Nanoseconds);
+    Report += fmt::format(R"(  "used_bytes": {},)" "\n", Stats.UsedBytes);
+    Report += fmt::format(R"(  "free_ranges": {},)" "\n", Stats.FreeRangeCount);
+    Report += fmt::format(R"(  "fragmentation": {:.4f},)" "\n", Stats.Fragmentation());
+    Report += fmt::format(R"(  "defragmentation_moves": {},)" "\n", Moves.size());
+    Report += fmt::format(R"(  "defragmentation_bytes": {},)" "\n", PlannedBytes);
+    Report += fmt::format(R"(  "defragmentation_plan_ms": {:.4f})" "\n", PlanSeconds * 1000.0);
+    Report += "}\n";
+
+    return Report;
+}
+
+int main(int argc, char** argv)
+{
+    global::MainThreadID = pthread_self();
+    pthread_setname_np(pthread_self(), "main");
+
+    BenchOptions Options = ParseOptions(argc, argv);
+
+    if(Options.RangeAllocatorOperations != 0)
+    {
+        WriteReport(Options.Output, RangeAllocatorBench(Options));
+        return 0;
+    }
+
+    VStarSightRenderer* Renderer = new VStarSightRenderer{VHeadlessOptions{}};
+    vkContext = Renderer;
+
+    alContext = new AContext{};
+    std::optional<flecs::world> World = CreateWorld();
+
+    PhaseTimer Phases{*World};
+
+    std::mt19937_64 Random{Options.Seed};
+    const double Extent = BENCH_FIELD_SPACING * std::cbrt(static_cast<double>(std::max<uint64_t>(Options.Entities, 1)));
+
+    CameraSpline Spline = Options.Spline.empty() ? MakeSpline(Random, Extent) : LoadSpline(Options.Spline);
+    SpawnScene(*World, Random, Options.Entities, Extent);
+
+    CameraComponent Camera{};
+    Camera.Mode = CameraComponent::fly;
+    Camera.Location = Spline.Location(0.0);
+    Camera.Rotation = Spline.Rotation(0.0);
+
+    auto CameraEntity = World->entity()
+    .set<CameraComponent>(Camera);
+
+    vkContext->Camera = CameraEntity.get<CameraComponent>();
+
+    auto Progress = [&]()
+    {
+        global::ProgramTime.StartFrame();
+        Phases.BeginFrame();
+        World->progress(BENCH_DELTA_TIME);
+        global::ProgramTime.EndFrame();
+    };
+
+    //loading is not what is measured, the camera waits at the start of the spline until every model is built
+    flecs::query<const ModelComponent> ModelQuery = World->query<const ModelComponent>();
+    auto AllBuilt = [&]()
+    {
+        bool bAllBuilt = true;
+        ModelQuery.each([&](const ModelComponent& Model){ bAllBuilt = bAllBuilt && Model.isBuilt; });
+        return bAllBuilt;
+    };
+
+    double LoadStart = double_time_now();
+    uint64_t LoadFrames = 0;
+    while(!AllBuilt() && LoadFrames < BENCH_MAX_LOAD_FRAMES)
+    {
+        Progress();
+        LoadFrames += 1;
+    }
+
+    LOG_INFO("bench scene of {} entities built in {} frames, {:.2f}s", Options.Entities, LoadFrames, double_time_now() - LoadStart);
+
+    std::vector<double> FrameMilliseconds{};
+    std::vector<double> VisibleMeshes{};
+    std::vector<std::pair<std::string_view, double>> GpuPasses{}; //summed over the measured frames
+
+    FrameMilliseconds.reserve(Options.Frames);
+    VisibleMeshes.reserve(Options.Frames);
+
+    const uint64_t TotalFrames = Options.Warmup + Options.Frames;
+    for(uint64_t frame = 0; frame < TotalFrames; ++frame)
+    {
+        const bool bMeasured = frame >= Options.Warmup;
+        const double Time = static_cast<double>(frame) / static_cast<double>(TotalFrames);
+
+        CameraComponent* FlyingCamera = CameraEntity.get_mut<CameraComponent>();
+        FlyingCamera->Location = Spline.Location(Time);
+        FlyingCamera->Rotation = Spline.Rotation(Time);
+
+        Phases.bRecording = bMeasured;
+
+        double FrameStart = double_time_now();
+        Progress();
+        double FrameEnd = double_time_now();
+
+        if(!bMeasured)
+        {
+            continue;
+        }
+
+        FrameMilliseconds.emplace_back((FrameEnd - FrameStart) * 1000.0);
+        VisibleMeshes.emplace_back(static_cast<double>(Renderer->VisibleMeshCount)); //lags FRAMES_IN_FLIGHT behind
+
+        for(const VGpuPassTiming& Pass : Renderer->GpuProfiler.GetPassTimings())
+        {
+            auto it = std::ranges::find(GpuPasses, Pass.Name, &std::pair<std::string_view, double>::first);
+            if(it == GpuPasses.end())
+            {
+                GpuPasses.emplace_back(Pass.Name, Pass.Milliseconds);
+            }
+            else
+            {
+                it->second += Pass.Milliseconds;
+            }
+        }
+    }
+
+    std::string Report = "{\n";
+    Report += fmt::format(R"(  "device": "{}",)" "\n", std::string_view{Renderer->PhysicalDeviceProperties.properties.deviceName});
+    Report += fmt::format(R"(  "resolution": [{}, {}],)" "\n", Renderer->ImageExtent.width, Renderer->ImageExtent.height);
+    Report += fmt::format(R"(  "seed": {},)" "\n", Options.Seed);
+    Report += fmt::format(R"(  "entities": {},)" "\n", Options.Entities);
+    Report += fmt::format(R"(  "warmup_frames": {},)" "\n", Options.Warmup);
+    Report += fmt::format(R"(  "frames": {},)" "\n", Options.Frames);
+    Report += fmt::format(R"(  "frame_ms": {},)" "\n", FormatPercentiles(MakePercentiles(FrameMilliseconds)));
+
+    Report += "  \"phase_ms\": {\n";
+    for(size_t phase = 0; phase < PhaseTimer::Names.size(); ++phase)
+    {
+        const char* Separator = phase + 1 < PhaseTimer::Names.size() ? "," : "";
+        Report += fmt::format(R"(    "{}": {}{})" "\n", PhaseTimer::Names[phase], FormatPercentiles(MakePercentiles(Phases.Milliseconds[phase])), Separator);
+    }
+    Report += "  },\n";
+
+    Report += "  \"gpu_pass_mean_ms\": {\n";
+    for(size_t pass = 0; pass < GpuPasses.size(); ++pass)
+    {
+        const char* Separator = pass + 1 < GpuPasses.size() ? "," : "";
+        Report += fmt::format(R"(    "{}": {:.4f}{})" "\n", GpuPasses[pass].first, GpuPasses[pass].second / static_cast<double>(Options.Frames), Separator);
+    }
+    Report += "  },\n";
+
+    Report += fmt::format(R"(  "visible_meshes": {})" "\n", FormatPercentiles(MakePercentiles(VisibleMeshes)));
+    Report += "}\n";
+
+    WriteReport(Options.Output, Report);
+
+    if(!Options.Trace.empty())
+    {
+        global::Profiler.ExportChromeTrace(Options.Trace);
+    }
+
+    Percentiles FrameTime = MakePercentiles(FrameMilliseconds);
+    LOG_INFO("bench frame time p50 {:.3f}ms p95 {:.3f}ms p99 {:.3f}ms", FrameTime.P50, FrameTime.P95, FrameTime.P99);
+
+    World.reset();
+    SafeDelete(alContext)
+    SafeDelete(vkContext)
+
+    return 0;
+}
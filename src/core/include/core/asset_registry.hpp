@@ -0,0 +1,277 @@
+#ifndef STARSIGHT_ASSET_REGISTRY_HPP
+#define STARSIGHT_ASSET_REGISTRY_HPP
+
+#include "assertion.hpp"
+#include "filesystem.hpp"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#ifndef ASSET_PAGE_SIZE
+#define ASSET_PAGE_SIZE 1024 //ids per page, pages are only allocated once an id in them is used
+#endif
+
+//the low bits index the registry, the high bits tell apart the names that used the same index over time
+//0 is never handed out, so a zeroed id is no asset
+struct AssetId
+{
+    static constexpr uint32_t IndexBits = 24;
+    static constexpr uint32_t IndexMask = (1u << IndexBits) - 1;
+    static constexpr uint32_t MaxIndex = IndexMask;
+
+    uint32_t Value = 0;
+
+    static constexpr AssetId Make(uint32_t Index, uint32_t Generation) { return AssetId{(Generation << IndexBits) | Index}; }
+
+    constexpr uint32_t Index() const { return Value & IndexMask; }
+    constexpr uint32_t Generation() const { return Value >> IndexBits; }
+
+    constexpr explicit operator bool() const { return Value != 0; }
+    constexpr bool operator==(const AssetId&) const = default;
+};
+
+//lazily allocated pages that never move, lookups are two loads and no lock
+template<typename T>
+class TAssetPages
+{
+public:
+    static constexpr uint32_t PageCount = (AssetId::MaxIndex + ASSET_PAGE_SIZE) / ASSET_PAGE_SIZE;
+
+    ~TAssetPages()
+    {
+        for(uint32_t Page = 0; Page < PageCount; ++Page)
+        {
+            delete[] Pages[Page].load(std::memory_order_relaxed);
+        }
+    }
+
+    T* Find(uint32_t Index) const
+    {
+        T* Page = Pages[Index / ASSET_PAGE_SIZE].load(std::memory_order_acquire);
+        return Page ? &Page[Index % ASSET_PAGE_SIZE] : nullptr;
+    }
+
+    T& Get(uint32_t Index)
+    {
+        std::atomic<T*>& Slot = Pages[Index / ASSET_PAGE_SIZE];
+
+        T* Page = Slot.load(std::memory_order_acquire);
+        if(Page == nullptr) [[unlikely]]
+        {
+            T* NewPage = new T[ASSET_PAGE_SIZE]{};
+            if(Slot.compare_exchange_strong(Page, NewPage, std::memory_order_acq_rel))
+            {
+                Page = NewPage;
+            }
+            else
+            {
+                delete[] NewPage; //another thread was first
+            }
+        }
+
+        return Page[Index % ASSET_PAGE_SIZE];
+    }
+
+private:
+    std::unique_ptr<std::atomic<T*>[]> Pages = std::make_unique<std::atomic<T*>[]>(PageCount);
+};
+
+//interns asset paths and names, the same string maps to the same id for as long as anything uses it
+//the managers, asset pointers and anything else that has to keep an id alive count as users
+class AssetRegistry
+{
+public:
+
+    //interns the name and adds a user
+    AssetId Acquire(std::string_view Name);
+    //the id has to have a user already
+    void AddUser(AssetId Id);
+    //the index is reused for another name once the last user is gone
+    void Release(AssetId Id);
+
+    //no user is added, an empty id if the name is not interned
+    AssetId Find(std::string_view Name) const;
+    bool IsValid(AssetId Id) const;
+
+    //valid while the id has users
+    std::string_view GetName(AssetId Id) const;
+    std::fpath GetPath(AssetId Id) const;
+
+    //one past the highest index handed out so far
+    uint32_t GetIndexLimit() const { return NextIndex.load(std::memory_order_acquire); }
+
+private:
+
+    struct Slot
+    {
+        std::string Name{};
+        std::atomic<uint32_t> Generation = 1;
+        std::atomic<uint32_t> Users = 0;
+    };
+
+    Slot& GetSlot(AssetId Id) const;
+
+    TAssetPages<Slot> Slots{};
+    std::atomic<uint32_t> NextIndex = 0;
+
+    mutable std::mutex Mx{};
+    std::unordered_map<std::string_view, uint32_t> Lookup{}; //views into the slot names
+    std::vector<uint32_t> FreeIndices{};
+};
+
+namespace global
+{
+    inline AssetRegistry Assets{};
+}
+
+//objects of one asset type indexed by their id, pointers stay valid until the object is erased
+//emplacing and finding are safe from any thread, erasing is not safe against either for the same id
+template<typename T>
+class TAssetTable
+{
+public:
+    struct EmplaceResult
+    {
+        AssetId Id{};
+        T* Object = nullptr;
+        bool bInserted = false;
+    };
+
+    TAssetTable() = default;
+    TAssetTable(const TAssetTable&) = delete;
+    TAssetTable& operator=(const TAssetTable&) = delete;
+
+    ~TAssetTable()
+    {
+        ForEach([](AssetId, T& Object)
+        {
+            std::destroy_at(&Object);
+        });
+    }
+
+    //the object of the id, default constructed by the first call, the table holds a user of the id while the object exists
+    EmplaceResult Emplace(AssetId Id)
+    {
+        ASSERT(Id);
+        Record& Entry = Records.Get(Id.Index());
+
+        uint32_t Expected = Empty;
+        if(Entry.State.compare_exchange_strong(Expected, Constructing, std::memory_order_acquire))
+        {
+            global::Assets.AddUser(Id);
+
+            std::construct_at(Entry.Get());
+            Entry.Id = Id;
+            Count.fetch_add(1, std::memory_order_relaxed);
+
+            Entry.State.store(Live, std::memory_order_release);
+            Entry.State.notify_all();
+
+            return EmplaceResult{Id, Entry.Get(), true};
+        }
+
+        while(Expected == Constructing)
+        {
+            Entry.State.wait(Constructing, std::memory_order_acquire);
+            Expected = Entry.State.load(std::memory_order_acquire);
+        }
+
+        //the index only changes hands once every user is gone, the table among them
+        ASSERT(Entry.Id == Id);
+        return EmplaceResult{Id, Entry.Get(), false};
+    }
+
+    EmplaceResult Emplace(std::string_view Name)
+    {
+        AssetId Id = global::Assets.Acquire(Name);
+        EmplaceResult Result = Emplace(Id);
+        global::Assets.Release(Id); //the table holds its own user now
+
+        return Result;
+    }
+
+    //nullptr when the id has no object in this table
+    T* Find(AssetId Id) const
+    {
+        Record* Entry = Records.Find(Id.Index());
+        if(Entry == nullptr || Entry->State.load(std::memory_order_acquire) != Live || Entry->Id != Id)
+        {
+            return nullptr;
+        }
+
+        return Entry->Get();
+    }
+
+    T& At(AssetId Id) const
+    {
+        T* Object = Find(Id);
+        VERIFY(Object, "no asset with this id", Id.Value);
+        return *Object;
+    }
+
+    void Erase(AssetId Id)
+    {
+        Record* Entry = Records.Find(Id.Index());
+        ASSERT(Entry && Entry->State.load(std::memory_order_relaxed) == Live && Entry->Id == Id);
+
+        std::destroy_at(Entry->Get());
+        Entry->Id = AssetId{};
+        Entry->State.store(Empty, std::memory_order_release);
+        Count.fetch_sub(1, std::memory_order_relaxed);
+
+        global::Assets.Release(Id);
+    }
+
+    //Function(AssetId, T&) for every object, objects may be erased from within
+    template<typename F>
+    void ForEach(F&& Function)
+    {
+        const uint32_t Limit = global::Assets.GetIndexLimit();
+        for(uint32_t Index = 0; Index < Limit; ++Index)
+        {
+            Record* Entry = Records.Find(Index);
+            if(Entry == nullptr)
+            {
+                Index += ASSET_PAGE_SIZE - 1 - Index % ASSET_PAGE_SIZE; //skip the whole page
+                continue;
+            }
+
+            if(Entry->State.load(std::memory_order_acquire) == Live)
+            {
+                Function(Entry->Id, *Entry->Get());
+            }
+        }
+    }
+
+    uint64_t size() const { return Count.load(std::memory_order_relaxed); }
+
+private:
+
+    enum : uint32_t
+    {
+        Empty,
+        Constructing,
+        Live
+    };
+
+    struct Record
+    {
+        std::atomic<uint32_t> State = Empty;
+        AssetId Id{};
+        alignas(T) std::byte Storage[sizeof(T)];
+
+        T* Get() { return std::launder(reinterpret_cast<T*>(Storage)); }
+    };
+
+    TAssetPages<Record> Records{};
+    std::atomic<uint64_t> Count = 0;
+};
+
+#endif //STARSIGHT_ASSET_REGISTRY_HPP
@@ -0,0 +1,111 @@
+#ifndef STARSIGHT_CPU_PROFILER_HPP
+#define STARSIGHT_CPU_PROFILER_HPP
+
+#include "filesystem.hpp"
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+#include <vector>
+#include <x86intrin.h>
+
+#ifndef CPU_PROFILER
+#define CPU_PROFILER 1 //0 compiles every zone out
+#endif
+
+#ifndef CPU_PROFILER_RING_SIZE
+#define CPU_PROFILER_RING_SIZE 65536 //zones kept per thread before the oldest are overwritten, a power of two
+#endif
+
+struct CpuZone
+{
+    const char* Name = nullptr;
+    uint64_t Begin = 0; //tsc
+    uint64_t End = 0;
+    uint64_t Frame = UINT64_MAX; //only set on the zones covering a whole frame
+};
+
+//zones are written at their end into a ring of the thread that ran them, nothing is shared until a trace is exported
+//nesting is not stored, the trace viewers rebuild it from the times
+class CpuProfiler
+{
+public:
+    CpuProfiler();
+
+    static uint64_t Now() { return __rdtsc(); }
+
+    //the name has to outlive the profiler, literals or interned names
+    void Record(const char* Name, uint64_t Begin, uint64_t End, uint64_t Frame = UINT64_MAX);
+    const char* InternName(std::string_view Name);
+
+    //from program_time_t, on the main thread
+    void BeginFrame();
+    void EndFrame(uint64_t Frame);
+
+    //everything still in the rings as a chrome trace, opens in chrome://tracing and perfetto
+    bool ExportChromeTrace(const std::fpath& Path);
+
+private:
+
+    struct ThreadRing
+    {
+        std::unique_ptr<CpuZone[]> Zones = std::make_unique<CpuZone[]>(CPU_PROFILER_RING_SIZE);
+        std::atomic<uint64_t> Head = 0;
+        std::string ThreadName{};
+        uint32_t ThreadIndex = 0;
+    };
+
+    ThreadRing* RegisterThread();
+
+    //the tsc against the monotonic clock at startup, the export measures the tick rate from here to its own pair
+    uint64_t BaseTicks = 0;
+    uint64_t BaseNanoseconds = 0;
+    uint64_t FrameBegin = 0;
+
+    std::mutex Mx{};
+    std::vector<std::unique_ptr<ThreadRing>> Rings{}; //kept after their thread has exited
+    std::unordered_set<std::string_view> Names{};
+    std::deque<std::string> NameStorage{};
+};
+
+namespace global
+{
+    inline CpuProfiler Profiler{};
+}
+
+class CpuProfileScope
+{
+public:
+    explicit CpuProfileScope(const char* Name_)
+        : Name(Name_)
+        , Begin(CpuProfiler::Now())
+    {
+    }
+
+    ~CpuProfileScope()
+    {
+        global::Profiler.Record(Name, Begin, CpuProfiler::Now());
+    }
+
+    CpuProfileScope(const CpuProfileScope&) = delete;
+    CpuProfileScope& operator=(const CpuProfileScope&) = delete;
+
+private:
+    const char* Name;
+    uint64_t Begin;
+};
+
+#define PROFILE_SCOPE_CONCAT_IMPL(a, b) a##b
+#define PROFILE_SCOPE_CONCAT(a, b) PROFILE_SCOPE_CONCAT_IMPL(a, b)
+
+#if CPU_PROFILER
+#define PROFILE_SCOPE(Name) CpuProfileScope PROFILE_SCOPE_CONCAT(ProfileScope, __LINE__){Name}
+#else
+#define PROFILE_SCOPE(Name)
+#endif
+
+#endif //STARSIGHT_CPU_PROFILER_HPP
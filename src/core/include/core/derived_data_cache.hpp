@@ -0,0 +1,107 @@
+#ifndef STARSIGHT_DERIVED_DATA_CACHE_HPP
+#define STARSIGHT_DERIVED_DATA_CACHE_HPP
+
+#include "filesystem.hpp"
+#include "tbb/concurrent_unordered_map.h"
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string_view>
+#include <type_traits>
+
+#ifndef DDC_DIRECTORY
+#define DDC_DIRECTORY "saved/ddc"
+#endif
+
+#ifndef DDC_MAX_BYTES
+#define DDC_MAX_BYTES (4ull << 30) //least recently used entries are evicted past this
+#endif
+
+#ifndef DDC_TRIM_RATIO
+#define DDC_TRIM_RATIO 0.9 //a trim evicts down to this fraction of the cap so it does not run on every store
+#endif
+
+#define DDC_MAGIC 0x43444453u //"SDDC"
+#define DDC_VERSION 1u
+
+//identifies derived data by everything it was derived from, the source bytes, its dependencies and the processing options
+//bump the version of a kind whenever its processing changes in a way the inputs do not show
+class DerivedDataKey
+{
+public:
+    DerivedDataKey(std::string_view Kind, uint32_t Version);
+
+    DerivedDataKey& Append(const void* Data, uint64_t Size);
+    DerivedDataKey& Append(std::span<const uint8_t> Data);
+    DerivedDataKey& Append(std::string_view String);
+
+    template<typename T> requires std::is_arithmetic_v<T> || std::is_enum_v<T>
+    DerivedDataKey& Append(T Value)
+    {
+        return Append(&Value, sizeof(T));
+    }
+
+    uint64_t Value() const { return Hash; }
+
+private:
+    uint64_t Hash;
+};
+
+//a verified read only mapping of one cache entry, it stays valid after the entry is evicted
+class DerivedData
+{
+public:
+    DerivedData(void* Mapping_, uint64_t MappingSize_, uint64_t PayloadOffset);
+    DerivedData(const DerivedData&) = delete;
+    DerivedData& operator=(const DerivedData&) = delete;
+    ~DerivedData();
+
+    std::span<const uint8_t> Payload() const { return PayloadBytes; }
+
+private:
+    void* Mapping;
+    uint64_t MappingSize;
+    std::span<const uint8_t> PayloadBytes;
+};
+
+//content addressed cache of expensive derivation results, one file per entry under DDC_DIRECTORY
+//lookups only touch the in memory index, which is built once from the directory and never locked
+class DerivedDataCache
+{
+public:
+    DerivedDataCache();
+
+    //returns nullptr when the entry is missing or fails its checksum, damaged entries are removed
+    std::shared_ptr<const DerivedData> Find(const DerivedDataKey& Key);
+
+    //writes the entry and evicts the least recently used ones once the cache is over its cap
+    void Store(const DerivedDataKey& Key, std::span<const uint8_t> Payload);
+
+private:
+
+    struct Entry
+    {
+        std::atomic_uint64_t Size{0}; //0 while the entry is not on disk
+        std::atomic_uint64_t LastAccess{0};
+        std::atomic_bool bTouched{false}; //the file time is refreshed on the first hit of a run so the order survives restarts
+        std::mutex FileMx{}; //keeps the file and its size in step between a store renaming it in and an eviction unlinking it
+    };
+
+    std::fpath EntryPath(uint64_t Key) const;
+    Entry& FindOrAddEntry(uint64_t Key);
+    void Evict(uint64_t Key, Entry& Slot);
+    void Trim();
+
+    tbb::concurrent_unordered_map<uint64_t, Entry> Entries{};
+    std::atomic_uint64_t TotalBytes{0};
+    std::atomic_uint64_t AccessClock{0};
+    std::atomic_flag bTrimming = ATOMIC_FLAG_INIT;
+    std::fpath Directory;
+};
+
+DerivedDataCache* GetDerivedDataCache();
+
+#endif //STARSIGHT_DERIVED_DATA_CACHE_HPP
@@ -0,0 +1,81 @@
+#ifndef STARSIGHT_EPOCH_HPP
+#define STARSIGHT_EPOCH_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <mutex>
+
+//a counter the main thread advances once per frame, retired objects are reclaimed once nothing from their epoch is left
+//two things hold an epoch back: pins taken by work that may touch retired objects, and frames the device has not finished
+class EpochManager
+{
+public:
+
+    uint64_t GetEpoch() const { return Epoch.load(std::memory_order_acquire); }
+
+    //from program_time_t, on the main thread
+    void Advance();
+
+    //every frame recorded in an epoch before this one has finished on the device
+    void SetDeviceEpoch(uint64_t DeviceEpoch_);
+    uint64_t GetDeviceEpoch() const { return DeviceEpoch.load(std::memory_order_acquire); }
+
+    //nothing retired in or after the returned epoch is reclaimed before it is unpinned
+    uint64_t Pin();
+    void Unpin(uint64_t PinnedEpoch);
+
+    //objects retired before this epoch can not be reached by any pinned work anymore
+    uint64_t GetOldestPin() const;
+
+private:
+    std::atomic<uint64_t> Epoch = 1;
+    std::atomic<uint64_t> DeviceEpoch = 0;
+
+    mutable std::mutex PinMx{};
+    std::map<uint64_t, uint64_t> Pins{}; //epoch to the number of pins in it
+};
+
+namespace global
+{
+    inline EpochManager Epochs{};
+}
+
+//objects waiting to be reclaimed, in the order they were retired
+//Free gets the epoch of its retirement and returns false while the object is still busy, it is tried again on the next reclaim
+class RetireList
+{
+public:
+    explicit RetireList(bool bWaitForDevice_)
+        : bWaitForDevice(bWaitForDevice_)
+    {
+    }
+
+    //returns the epoch the entry was recorded in
+    uint64_t Retire(std::function<bool(uint64_t)> Free);
+
+    //frees everything that nothing can reach anymore
+    void Reclaim();
+
+    //frees everything regardless of epochs, once the device and every loader are idle
+    void Drain();
+
+    bool IsEmpty() const;
+
+private:
+
+    struct Entry
+    {
+        uint64_t Epoch = 0;
+        std::function<bool(uint64_t)> Free{};
+    };
+
+    bool bWaitForDevice;
+
+    mutable std::mutex Mx{};
+    std::deque<Entry> Entries{};
+};
+
+#endif //STARSIGHT_EPOCH_HPP
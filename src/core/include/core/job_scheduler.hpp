@@ -0,0 +1,199 @@
+#ifndef STARSIGHT_JOB_SCHEDULER_HPP
+#define STARSIGHT_JOB_SCHEDULER_HPP
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#ifndef JOB_SCHEDULER_WORKERS
+#define JOB_SCHEDULER_WORKERS 0 //0 takes one less than the hardware threads, the thread that waits on jobs runs them too
+#endif
+
+#ifndef JOB_SCHEDULER_RESERVED_WORKERS
+#define JOB_SCHEDULER_RESERVED_WORKERS 1 //workers kept free of streaming and background jobs, so frame critical jobs always find one
+#endif
+
+//lower values are taken first, a job only ever waits behind jobs of its own class or a more urgent one
+enum class JobPriority : uint8_t
+{
+    FrameCritical, //ecs systems and everything the current frame waits on
+    Streaming, //asset loads
+    Background, //shader compiles, pipeline builds and file writes
+};
+
+inline constexpr uint32_t JobPriorityCount = 3;
+
+//counts the jobs submitted with it that have not finished, jobs may submit more to the group they run in
+//the priority is the class of its jobs, which is all a thread waiting on the group helps with by default
+class JobGroup
+{
+public:
+    explicit JobGroup(JobPriority Priority_)
+        : Priority(Priority_)
+    {
+    }
+
+    bool IsBusy() const { return Pending.load(std::memory_order_acquire) != 0; }
+    JobPriority GetPriority() const { return Priority; }
+
+private:
+    friend class JobScheduler;
+
+    JobPriority Priority;
+    std::atomic<uint64_t> Pending = 0;
+};
+
+//one pool of workers for every subsystem, each with a deque per priority
+//workers take from the back of their own deques and steal from the front of the others
+//threads that are not workers submit into shared deques, and run jobs themselves while they wait instead of blocking
+class JobScheduler
+{
+public:
+    explicit JobScheduler(uint32_t WorkerCount = JOB_SCHEDULER_WORKERS);
+    ~JobScheduler();
+
+    JobScheduler(const JobScheduler&) = delete;
+    JobScheduler& operator=(const JobScheduler&) = delete;
+
+    void Submit(JobPriority Priority, std::function<void()> Function, JobGroup* Group = nullptr);
+
+    template<typename F>
+    std::future<std::invoke_result_t<std::decay_t<F>>> Async(JobPriority Priority, F&& Function)
+    {
+        using ResultType = std::invoke_result_t<std::decay_t<F>>;
+
+        auto Task = std::make_shared<std::packaged_task<ResultType()>>(std::forward<F>(Function));
+        std::future<ResultType> Future = Task->get_future();
+
+        Submit(Priority, [Task](){ (*Task)(); });
+        return Future;
+    }
+
+    //Body(Index) for every index in [First, Last), the caller takes part and returns once every index is done
+    template<typename F>
+    void ParallelFor(JobPriority Priority, uint64_t First, uint64_t Last, F&& Body)
+    {
+        if(First >= Last)
+        {
+            return;
+        }
+
+        const uint64_t Count = Last - First;
+        const uint64_t Grain = std::max<uint64_t>(1, Count / ((GetWorkerCount() + 1) * 4));
+        const uint64_t Helpers = std::min<uint64_t>(GetWorkerCount(), (Count + Grain - 1) / Grain - 1);
+
+        std::atomic<uint64_t> Next = First;
+        auto Loop = [&]()
+        {
+            for(uint64_t Begin = Next.fetch_add(Grain, std::memory_order_relaxed); Begin < Last; Begin = Next.fetch_add(Grain, std::memory_order_relaxed))
+            {
+                for(uint64_t Index = Begin; Index < std::min(Begin + Grain, Last); ++Index)
+                {
+                    Body(Index);
+                }
+            }
+        };
+
+        JobGroup Group{Priority};
+        for(uint64_t Helper = 0; Helper < Helpers; ++Helper)
+        {
+            Submit(Priority, Loop, &Group);
+        }
+
+        Loop();
+        Wait(Group, Priority);
+    }
+
+    //runs pending jobs at least as urgent as Help until the group is done
+    void Wait(JobGroup& Group, JobPriority Help);
+    //helps with jobs at least as urgent as the group's own
+    void Wait(JobGroup& Group) { Wait(Group, Group.GetPriority()); }
+
+    //the same for a future, for jobs that wait on each other through futures
+    template<typename Future>
+    decltype(auto) Await(Future& Result, JobPriority Help = JobPriority::Background)
+    {
+        Backoff Delay{};
+        while(Result.wait_for(std::chrono::seconds{0}) != std::future_status::ready)
+        {
+            if(!RunPending(Help))
+            {
+                Delay.Pause();
+            }
+            else
+            {
+                Delay = Backoff{};
+            }
+        }
+
+        return Result.get();
+    }
+
+    //runs one pending job at least as urgent as Help on the calling thread, false when there was none
+    bool RunPending(JobPriority Help = JobPriority::Background);
+
+    uint32_t GetWorkerCount() const { return static_cast<uint32_t>(Workers.size()); }
+    bool InWorker() const;
+
+private:
+
+    struct Job
+    {
+        std::function<void()> Function{};
+        JobGroup* Group = nullptr;
+    };
+
+    struct alignas(64) JobQueue
+    {
+        std::mutex Mx{};
+        std::deque<Job> Jobs{};
+    };
+
+    struct Worker
+    {
+        std::array<JobQueue, JobPriorityCount> Queues{};
+        std::thread Thread{};
+    };
+
+    //yields first, then sleeps for longer and longer up to a tenth of a millisecond
+    struct Backoff
+    {
+        uint32_t Rounds = 0;
+        void Pause();
+    };
+
+    void WorkerMain(uint32_t Index);
+
+    //the caller's own deque first, then the shared one, then the other workers
+    bool TryPop(uint32_t Priority, Job& Out);
+    bool FindJob(JobPriority Help, bool bTopLevel, Job& Out, bool& bLowPriority);
+    void Execute(Job& Entry);
+    void Wake();
+
+    std::vector<std::unique_ptr<Worker>> Workers{};
+    std::array<JobQueue, JobPriorityCount> Shared{};
+    std::array<std::atomic<uint64_t>, JobPriorityCount> Queued{}; //lets every search skip the empty classes
+
+    uint32_t LowPriorityLimit = 1;
+    std::atomic<uint32_t> LowPriorityRunning = 0;
+
+    std::atomic<uint64_t> WakeEpoch = 0;
+    std::atomic<bool> bStop = false;
+};
+
+namespace global
+{
+    inline JobScheduler Scheduler{};
+}
+
+#endif //STARSIGHT_JOB_SCHEDULER_HPP
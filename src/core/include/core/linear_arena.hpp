@@ -0,0 +1,155 @@
+#ifndef STARSIGHT_LINEAR_ARENA_HPP
+#define STARSIGHT_LINEAR_ARENA_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+#ifndef FRAME_ARENA_SIZE
+#define FRAME_ARENA_SIZE (8ull * 1024 * 1024) //per frame in flight, grows to the largest frame seen
+#endif
+
+#ifndef SCRATCH_ARENA_SIZE
+#define SCRATCH_ARENA_SIZE (1ull * 1024 * 1024) //per thread, only reserved by the threads that use one
+#endif
+
+//bump allocator, nothing is freed on its own, everything goes at once on Reset or back to a marker on Rewind
+//allocating is lock free and safe from any thread, Reset and Rewind are not
+//requests that do not fit go to the heap, the next Reset grows the block so the same load fits next time
+//destructors are never run, only trivially destructible data or containers that clean up after themselves belong here
+class LinearArena
+{
+public:
+    struct Marker
+    {
+        uint64_t Offset = 0;
+        uint64_t Overflow = 0;
+    };
+
+    explicit LinearArena(uint64_t Capacity_ = FRAME_ARENA_SIZE);
+    ~LinearArena();
+
+    LinearArena(const LinearArena&) = delete;
+    LinearArena& operator=(const LinearArena&) = delete;
+
+    void* Allocate(uint64_t Size, uint64_t Alignment = alignof(std::max_align_t));
+
+    template<typename T>
+    T* Allocate(uint64_t Count = 1)
+    {
+        return static_cast<T*>(Allocate(sizeof(T) * Count, alignof(T)));
+    }
+
+    void Reset();
+
+    Marker GetMarker() const;
+    void Rewind(Marker To);
+
+    uint64_t GetCapacity() const { return Capacity; }
+    uint64_t GetUsed() const { return Offset.load(std::memory_order_relaxed) + OverflowBytes.load(std::memory_order_relaxed); }
+
+private:
+
+    struct OverflowBlock
+    {
+        void* Memory = nullptr;
+        uint64_t Size = 0;
+        uint64_t Alignment = 0;
+    };
+
+    void* AllocateOverflow(uint64_t Size, uint64_t Alignment);
+    void FreeOverflow(uint64_t From);
+
+    std::byte* Memory = nullptr;
+    uint64_t Capacity = 0;
+    std::atomic<uint64_t> Offset = 0;
+
+    std::atomic<uint64_t> OverflowBytes = 0;
+    uint64_t HighWater = 0; //bytes in use at the most, seen by Reset
+    mutable std::mutex OverflowMx{};
+    std::vector<OverflowBlock> Overflow{};
+};
+
+//the arena of the calling thread, every worker of the job scheduler gets its own
+LinearArena& ScratchArena();
+
+//gives back everything taken from the scratch arena of this thread while it was alive
+//jobs that run while a thread waits nest inside the scope of the job that waits, so scopes always end in reverse order
+class ScratchScope
+{
+public:
+    ScratchScope()
+        : Arena(ScratchArena())
+        , Begin(Arena.GetMarker())
+    {
+    }
+
+    ~ScratchScope()
+    {
+        Arena.Rewind(Begin);
+    }
+
+    ScratchScope(const ScratchScope&) = delete;
+    ScratchScope& operator=(const ScratchScope&) = delete;
+
+    LinearArena& Get() { return Arena; }
+
+private:
+    LinearArena& Arena;
+    LinearArena::Marker Begin;
+};
+
+//std allocator over an arena, without one it falls back to the heap
+//freeing arena memory does nothing, it goes back with the arena
+template<typename T>
+class TArenaAllocator
+{
+public:
+    using value_type = T;
+    using propagate_on_container_copy_assignment = std::true_type;
+    using propagate_on_container_move_assignment = std::true_type;
+    using propagate_on_container_swap = std::true_type;
+
+    TArenaAllocator() = default;
+    TArenaAllocator(LinearArena* Arena_) : Arena(Arena_) {}
+    TArenaAllocator(LinearArena& Arena_) : Arena(&Arena_) {}
+
+    template<typename U>
+    TArenaAllocator(const TArenaAllocator<U>& Other) : Arena(Other.GetArena()) {}
+
+    T* allocate(std::size_t Count)
+    {
+        if(Arena != nullptr)
+        {
+            return Arena->Allocate<T>(Count);
+        }
+
+        return static_cast<T*>(::operator new(sizeof(T) * Count, std::align_val_t{alignof(T)}));
+    }
+
+    void deallocate(T* Pointer, std::size_t Count)
+    {
+        if(Arena == nullptr)
+        {
+            ::operator delete(Pointer, sizeof(T) * Count, std::align_val_t{alignof(T)});
+        }
+    }
+
+    LinearArena* GetArena() const { return Arena; }
+
+    template<typename U>
+    bool operator==(const TArenaAllocator<U>& Other) const { return Arena == Other.GetArena(); }
+
+private:
+    LinearArena* Arena = nullptr;
+};
+
+template<typename T>
+using TArenaVector = std::vector<T, TArenaAllocator<T>>;
+
+#endif //STARSIGHT_LINEAR_ARENA_HPP
@@ -0,0 +1,122 @@
+#ifndef STARSIGHT_RANGE_ALLOCATOR_HPP
+#define STARSIGHT_RANGE_ALLOCATOR_HPP
+
+#include <cstdint>
+#include <array>
+#include <functional>
+#include <vector>
+
+//http://www.gii.upv.es/tlsf/files/papers/ecrts04_tlsf.pdf
+//two level segregated fit allocator over an abstract range, it never touches the memory it manages
+
+struct RangeAllocation
+{
+    static constexpr uint32_t InvalidNode = UINT32_MAX;
+
+    uint64_t Offset = 0;
+    uint64_t Size = 0;
+    uint32_t Node = InvalidNode;
+
+    bool IsValid() const
+    {
+        return Node != InvalidNode;
+    }
+};
+
+struct RangeAllocatorStats
+{
+    uint64_t Capacity = 0;
+    uint64_t UsedBytes = 0;
+    uint64_t FreeBytes = 0;
+    uint64_t LargestFreeRange = 0;
+    uint32_t AllocationCount = 0;
+    uint32_t FreeRangeCount = 0;
+
+    //0 when all free space is one contiguous range, approaches 1 as it gets scattered
+    double Fragmentation() const
+    {
+        return FreeBytes == 0 ? 0.0 : 1.0 - double(LargestFreeRange) / double(FreeBytes);
+    }
+};
+
+//Dst is already allocated, Src stays allocated until the caller has copied the contents and frees it
+struct RangeMove
+{
+    RangeAllocation Src{};
+    RangeAllocation Dst{};
+    uint64_t UserData = 0;
+};
+
+class RangeAllocator
+{
+private:
+    static constexpr uint32_t SecondLevelBits = 5;
+    static constexpr uint32_t SecondLevelCount = 1u << SecondLevelBits;
+    static constexpr uint32_t FirstLevelCount = 64 - SecondLevelBits + 1;
+    static constexpr uint64_t SmallRangeSize = 1ull << SecondLevelBits;
+
+    struct Node
+    {
+        uint64_t Offset = 0;
+        uint64_t Size = 0;
+        uint64_t Alignment = 1;
+        uint64_t UserData = 0;
+        uint32_t BinPrev = RangeAllocation::InvalidNode;
+        uint32_t BinNext = RangeAllocation::InvalidNode;
+        uint32_t NeighborPrev = RangeAllocation::InvalidNode; //physically adjacent ranges
+        uint32_t NeighborNext = RangeAllocation::InvalidNode;
+        bool bUsed = false;
+        bool bRelocating = false; //source of a planned move, skipped by later defragmentation passes
+    };
+
+    std::vector<Node> Nodes{};
+    std::vector<uint32_t> FreeNodes{};
+
+    uint64_t FirstLevelBitmap = 0;
+    std::array<uint32_t, FirstLevelCount> SecondLevelBitmaps{};
+    std::array<std::array<uint32_t, SecondLevelCount>, FirstLevelCount> BinHeads{};
+
+    uint32_t HeadNode = RangeAllocation::InvalidNode;
+    uint32_t TailNode = RangeAllocation::InvalidNode;
+
+    uint64_t Capacity = 0;
+    uint64_t UsedBytes = 0;
+    uint32_t AllocationCount = 0;
+    uint32_t FreeRangeCount = 0;
+
+public:
+
+    explicit RangeAllocator(uint64_t Capacity_);
+
+    //returns an invalid allocation when no free range is large enough, alignment has to be a power of 2
+    RangeAllocation Allocate(uint64_t Size, uint64_t Alignment = 1, uint64_t UserData = 0);
+    void Free(const RangeAllocation& Allocation);
+
+    //extends the managed range at the end, existing allocations keep their offsets
+    void Grow(uint64_t NewCapacity);
+
+    uint64_t GetUserData(const RangeAllocation& Allocation) const;
+    void SetUserData(const RangeAllocation& Allocation, uint64_t UserData);
+    uint64_t GetCapacity() const { return Capacity; }
+    RangeAllocatorStats GetStats() const;
+
+    //plans moves for the highest allocations into the lowest free range that fits them, until at least MaxBytes are scheduled
+    //CanMove lets the caller pin allocations whose contents are not ready to be copied yet
+    uint64_t PlanDefragmentation(uint64_t MaxBytes, std::vector<RangeMove>& OutMoves, const std::function<bool(uint64_t UserData)>& CanMove = nullptr);
+
+private:
+
+    static void MapSize(uint64_t Size, uint32_t& FirstLevel, uint32_t& SecondLevel);
+
+    uint32_t GrabNode();
+    void ReleaseNode(uint32_t Index);
+
+    void InsertFreeNode(uint32_t Index);
+    void RemoveFreeNode(uint32_t Index);
+    uint32_t FindFreeNode(uint64_t Size) const;
+
+    //Index has to be a free range that still holds Size once its offset is aligned
+    RangeAllocation AllocateFrom(uint32_t Index, uint64_t Size, uint64_t Alignment, uint64_t UserData);
+};
+
+#endif //STARSIGHT_RANGE_ALLOCATOR_HPP
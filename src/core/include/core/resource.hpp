@@ -5,21 +5,25 @@
 #include <atomic>
 #include <filesystem>
 #include "assertion.hpp"
+#include "asset_registry.hpp"
 
 class SharedAsset
 {
 private:
     std::atomic_uint32_t RefCount;
+    std::atomic_uint64_t RetiredIn; //the epoch the references last ran out in, 0 while they never did
 
 public:
 
     SharedAsset()
         : RefCount(0)
+        , RetiredIn(0)
     {
     }
 
     SharedAsset(const SharedAsset& Other)
         : RefCount(Other.GetRefCount())
+        , RetiredIn(Other.GetRetiredIn())
     {
     }
 
@@ -37,24 +41,53 @@ public:
     {
         return RefCount.fetch_sub(1, std::memory_order_relaxed);
     }
+
+    uint64_t GetRetiredIn() const
+    {
+        return RetiredIn.load(std::memory_order_relaxed);
+    }
+
+    void SetRetiredIn(uint64_t Epoch)
+    {
+        RetiredIn.store(Epoch, std::memory_order_relaxed);
+    }
 };
 
+//the object when nothing referenced it again since it was retired in the epoch, nullptr when there is nothing left to free
+//an asset retired twice has an entry per retirement, only the newest one frees it
+template<typename T>
+T* FindRetired(const TAssetTable<T>& Table, AssetId Id, uint64_t Epoch)
+{
+    T* Object = Table.Find(Id);
+    if(Object == nullptr || Object->GetRefCount() != 0 || Object->GetRetiredIn() != Epoch)
+    {
+        return nullptr;
+    }
+
+    return Object;
+}
+
 template<typename T>
 concept IsSharedAsset = requires(T obj)
 {
     std::is_base_of_v<SharedAsset, T>;
 
-    { T::LoadAsset(std::filesystem::path{}) } -> std::same_as<T*>;
+    //returns the object with a reference already taken for the caller
+    { T::LoadAsset(AssetId{}) } -> std::same_as<T*>;
+    //the last reference is gone, called before the id is released
+    { T::RetireAsset(AssetId{}) } -> std::same_as<void>;
 
     { obj.IsLoaded() } -> std::same_as<bool>;
 };
 
+//the interned id of the asset and, once loaded, the object it holds a reference on
+//the id stays a user of the registry for as long as the pointer has it
 template<IsSharedAsset T>
 class TAssetPtr
 {
 private:
 
-    std::filesystem::path AssetPath;
+    AssetId Id;
     T* Object;
 
 public:
@@ -64,55 +97,61 @@ public:
         Reset();
     }
 
-    TAssetPtr(std::filesystem::path Path = "", T* Object_ = nullptr)
-        : AssetPath(std::move(Path))
+    TAssetPtr()
+        : Id()
+        , Object(nullptr)
+    {
+    }
+
+    TAssetPtr(const std::filesystem::path& Path)
+        : Id(Path.empty() ? AssetId{} : global::Assets.Acquire(Path.native()))
+        , Object(nullptr)
+    {
+    }
+
+    TAssetPtr(AssetId Id_, T* Object_ = nullptr)
+        : Id(Id_)
         , Object(Object_)
     {
+        if(Id)
+        {
+            global::Assets.AddUser(Id);
+        }
+
         if(Object)
         {
-            ASSERT(!AssetPath.empty());
+            ASSERT(Id);
             Object->AddReference();
         }
     }
 
     TAssetPtr(const TAssetPtr& Other)
-        : AssetPath(Other.AssetPath)
-        , Object(Other.Object)
+        : TAssetPtr(Other.Id, Other.Object)
     {
-        if(Object)
-        {
-            ASSERT(!AssetPath.empty());
-            Object->AddReference();
-        }
     }
 
     TAssetPtr(TAssetPtr&& Other)
-        : AssetPath(std::move(Other.AssetPath))
+        : Id(Other.Id)
         , Object(Other.Object)
     {
-        Other.AssetPath.clear();
+        Other.Id = AssetId{};
         Other.Object = nullptr;
     }
 
-    TAssetPtr& operator=(std::filesystem::path Path)
+    TAssetPtr& operator=(const std::filesystem::path& Path)
     {
         Reset();
-        AssetPath = std::move(Path);
+        Id = Path.empty() ? AssetId{} : global::Assets.Acquire(Path.native());
 
         return *this;
     }
 
     TAssetPtr& operator=(const TAssetPtr& Other)
     {
-        Reset();
-
-        AssetPath = Other.AssetPath;
-        Object = Other.Object;
-
-        if(Object)
+        if(this != &Other)
         {
-            ASSERT(!AssetPath.empty());
-            Object->AddReference();
+            Reset();
+            *this = TAssetPtr{Other};
         }
 
         return *this;
@@ -120,35 +159,43 @@ public:
 
     TAssetPtr& operator=(TAssetPtr&& Other)
     {
-        AssetPath = std::move(Other.AssetPath);
-        Object = Other.Object;
+        if(this != &Other)
+        {
+            Reset();
 
-        Other.AssetPath.clear();
-        Other.Object = nullptr;
+            Id = Other.Id;
+            Object = Other.Object;
+
+            Other.Id = AssetId{};
+            Other.Object = nullptr;
+        }
 
         return *this;
     }
 
     void Reset()
     {
-        if(!AssetPath.empty() && Object && Object->RemoveReference() == 1)
+        if(Object && Object->RemoveReference() == 1)
+        {
+            T::RetireAsset(Id);
+        }
+
+        if(Id)
         {
-            //should be handled by the garbage collector
-            void();
+            global::Assets.Release(Id);
         }
 
-        AssetPath.clear();
+        Id = AssetId{};
         Object = nullptr;
     }
 
     void Load()
     {
-        ASSERT(!AssetPath.empty());
+        ASSERT(Id);
 
         if(Object == nullptr)
         {
-            Object = T::LoadAsset(AssetPath);
-            Object->AddReference();
+            Object = T::LoadAsset(Id);
         }
     }
 
@@ -157,9 +204,14 @@ public:
         return Object && Object->IsLoaded();
     }
 
-    const std::filesystem::path& GetPath() const
+    AssetId GetId() const
+    {
+        return Id;
+    }
+
+    std::filesystem::path GetPath() const
     {
-        return AssetPath;
+        return global::Assets.GetPath(Id);
     }
 
     T* GetPtr()
@@ -6,6 +6,7 @@
 #include <cstring>
 #include <exception>
 #include <limits>
+#include <memory>
 #include <stdexcept>
 #include <string>
 #include <type_traits>
@@ -56,12 +57,13 @@ using required_uint_t =
                                  std::numeric_limits<std::uint32_t>::max()),
                                 std::uint32_t, std::uint64_t>::type>::type>::type;
 
-template<class T, std::size_t MinStackCapacity = 0, std::size_t MaxCapacity = std::numeric_limits<std::size_t>::max()>
+template<class T, std::size_t MinStackCapacity = 0, std::size_t MaxCapacity = std::numeric_limits<std::size_t>::max(), class Allocator = std::allocator<T>>
 class ssovector {
     static_assert(MaxCapacity >= MinStackCapacity, "Max Capacity has to be greater than minimum stack capacity");
 
 public:
     using value_type = T;
+    using allocator_type = Allocator;
     using size_type = std::size_t;
     using difference_type = typename std::make_signed<size_type>::type;
     using reference = value_type &;
@@ -77,6 +79,7 @@ public:
 private:
     using stack_size_type = required_uint_t<MinStackCapacity>;
     using heap_size_type = required_uint_t<MaxCapacity>;
+    using allocator_traits = std::allocator_traits<Allocator>;
 
 public:
     constexpr static std::size_t stack_capacity() {
@@ -125,6 +128,8 @@ private:
         CXX20_CONSTEXPR ~data_union_t() {} // destruction is handled in normal destructor
     } m_data{};
 
+    NO_UNIQUE_ADDRESS Allocator m_allocator{};
+
     constexpr void _set_size(size_type size) {
         if (is_small()) {
             m_data.stack.m_size = size;
@@ -150,9 +155,11 @@ public:
 
     constexpr ssovector() = default;
 
-    constexpr ssovector(size_type size) : ssovector(size, value_type{}) {}
+    constexpr explicit ssovector(const Allocator &allocator) : m_allocator(allocator) {}
+
+    constexpr ssovector(size_type size, const Allocator &allocator = Allocator{}) : ssovector(size, value_type{}, allocator) {}
 
-    constexpr ssovector(size_type size, const_reference default_value) {
+    constexpr ssovector(size_type size, const_reference default_value, const Allocator &allocator = Allocator{}) : m_allocator(allocator) {
         if (size <= stack_capacity()) {
             for (size_type i = 0; i < size; ++i) {
                 m_data.stack.m_array[i] = default_value;
@@ -166,7 +173,7 @@ public:
 #endif
             _allocate_heap(size);
             for (size_type i = 0; i < size; ++i) {
-                new (&m_data.heap.m_array[i]) value_type{default_value};
+                m_data.heap.m_array[i] = default_value;
             }
             m_data.heap.m_size = size;
             m_capacity = size;
@@ -196,38 +203,43 @@ public:
             push_back(*first);
     }
 
-    constexpr ssovector(ssovector const &other) {
+    constexpr ssovector(ssovector const &other) : m_allocator(allocator_traits::select_on_container_copy_construction(other.m_allocator)) {
         *this = other;
     }
 
-    constexpr ssovector(ssovector &&other) noexcept {
+    constexpr ssovector(ssovector &&other) noexcept : m_allocator(other.m_allocator) {
         *this = std::move(other);
     }
 
     constexpr ssovector &operator=(ssovector const &other) {
+        if (this == &other)
+            return *this;
         if (other.is_small()) {
-            this->~ssovector();
+            _release();
             m_data.stack.m_size = other.m_data.stack.m_size;
             for (size_type i = 0; i < other.size(); ++i)
                 m_data.stack.m_array[i] = other.m_data.stack.m_array[i];
-            m_capacity = other.m_data.stack.m_size;
+            m_capacity = stack_capacity();
         } else {
-            if (capacity() < other.capacity())
-                *this = ssovector(other.size()); // not infinite recursion since rhs is an rvalue reference
+            if (capacity() < other.size())
+                *this = ssovector(other.size(), m_allocator); // not infinite recursion since rhs is an rvalue reference
             for (size_type i = 0; i < other.size(); ++i)
-                m_data.heap.m_array[i] = other.m_data.heap.m_array[i];
+                data()[i] = other.m_data.heap.m_array[i];
+            _set_size(other.size());
         }
         return *this;
     }
 
     constexpr ssovector &operator=(ssovector &&other) noexcept {
+        if (this == &other)
+            return *this;
+        _release();
+        m_allocator = other.m_allocator; // the heap block belongs to the allocator it came from
         if (other.is_small()) {
-            this->~ssovector();
             m_data.stack.m_array = std::move(other.m_data.stack.m_array);
             m_data.stack.m_size = other.m_data.stack.m_size;
-            m_capacity = other.m_data.stack.m_size;
+            m_capacity = stack_capacity();
         } else {
-            this->~ssovector();
             m_data.heap.m_array = other.m_data.heap.m_array;
             m_data.heap.m_size = other.m_data.heap.m_size;
             m_capacity = other.m_capacity;
@@ -239,16 +251,19 @@ public:
     }
 
     CXX20_CONSTEXPR ~ssovector() {
-        for (auto &&i: *this) {
-            i.~value_type();
-        }
-        if (!is_small()) {
+        if (is_small()) {
+            for (auto &&i: *this) {
+                i.~value_type();
+            }
+        } else {
             _deallocate_heap();
-            m_data.heap.m_array = nullptr;
-            m_data.heap.m_size = 0;
         }
     }
 
+    NODISCARD constexpr allocator_type get_allocator() const {
+        return m_allocator;
+    }
+
     NODISCARD constexpr size_type size() const {
         if (is_small()) {
             return m_data.stack.m_size;
@@ -304,8 +319,8 @@ public:
         return data()[idx];
     }
 
-    template<std::size_t StackCap, std::size_t MaxCap>
-    NODISCARD constexpr bool operator==(ssovector<value_type, StackCap, MaxCap> const &other) const {
+    template<std::size_t StackCap, std::size_t MaxCap, class OtherAllocator>
+    NODISCARD constexpr bool operator==(ssovector<value_type, StackCap, MaxCap, OtherAllocator> const &other) const {
         if (size() != other.size())
             return false;
         const_pointer p1 = data(), p2 = other.data();
@@ -315,13 +330,13 @@ public:
         return true;
     }
 
-    template<std::size_t StackCap, std::size_t MaxCap>
-    NODISCARD constexpr bool operator!=(ssovector<value_type, StackCap, MaxCap> const &other) const {
+    template<std::size_t StackCap, std::size_t MaxCap, class OtherAllocator>
+    NODISCARD constexpr bool operator!=(ssovector<value_type, StackCap, MaxCap, OtherAllocator> const &other) const {
         return !(*this == other);
     }
 
-    template<std::size_t StackCap, std::size_t MaxCap>
-    NODISCARD constexpr bool operator<(ssovector<value_type, StackCap, MaxCap> const &other) const {
+    template<std::size_t StackCap, std::size_t MaxCap, class OtherAllocator>
+    NODISCARD constexpr bool operator<(ssovector<value_type, StackCap, MaxCap, OtherAllocator> const &other) const {
         for (size_type i = 0; i < std::min(size(), other.size()); ++i) {
             const auto lhs = (*this)[i], rhs = other[i];
             if (lhs < rhs)
@@ -332,18 +347,18 @@ public:
         return size() < other.size();
     }
 
-    template<std::size_t StackCap, std::size_t MaxCap>
-    NODISCARD constexpr bool operator>(ssovector<value_type, StackCap, MaxCap> const &other) const {
+    template<std::size_t StackCap, std::size_t MaxCap, class OtherAllocator>
+    NODISCARD constexpr bool operator>(ssovector<value_type, StackCap, MaxCap, OtherAllocator> const &other) const {
         return other < *this;
     }
 
-    template<std::size_t StackCap, std::size_t MaxCap>
-    NODISCARD constexpr bool operator<=(ssovector<value_type, StackCap, MaxCap> const &other) const {
+    template<std::size_t StackCap, std::size_t MaxCap, class OtherAllocator>
+    NODISCARD constexpr bool operator<=(ssovector<value_type, StackCap, MaxCap, OtherAllocator> const &other) const {
         return !(other > *this);
     }
 
-    template<std::size_t StackCap, std::size_t MaxCap>
-    NODISCARD constexpr bool operator>=(ssovector<value_type, StackCap, MaxCap> const &other) const {
+    template<std::size_t StackCap, std::size_t MaxCap, class OtherAllocator>
+    NODISCARD constexpr bool operator>=(ssovector<value_type, StackCap, MaxCap, OtherAllocator> const &other) const {
         return other <= *this;
     }
 
@@ -362,7 +377,7 @@ public:
             m_data.stack.m_array[m_data.stack.m_size] = value_type{std::forward<Args>(args)...};
             return m_data.stack.m_array[m_data.stack.m_size++];
         } else {
-            new (&m_data.heap.m_array[m_data.heap.m_size]) value_type{std::forward<Args>(args)...};
+            m_data.heap.m_array[m_data.heap.m_size] = value_type{std::forward<Args>(args)...};
             return m_data.heap.m_array[m_data.heap.m_size++];
         }
     }
@@ -482,7 +497,7 @@ private:
     }
 
     constexpr void _reallocate(size_type new_capacity) {
-        ssovector other;
+        ssovector other{m_allocator};
         if (new_capacity > stack_capacity()) {
             other._allocate_heap(new_capacity);
         }
@@ -506,12 +521,27 @@ private:
         if (size > MaxCapacity)
             throw std::bad_alloc();
 #endif
-        m_data.heap.m_array = ::new T[size]{};
+        // every slot up to the capacity holds a live value, elements past the size are assigned over
+        m_data.heap.m_array = allocator_traits::allocate(m_allocator, size);
+        std::uninitialized_value_construct_n(m_data.heap.m_array, size);
         m_capacity = size;
     }
 
     void _deallocate_heap() {
-        ::delete[] m_data.heap.m_array;
+        std::destroy_n(m_data.heap.m_array, capacity());
+        allocator_traits::deallocate(m_allocator, m_data.heap.m_array, capacity());
+    }
+
+    // empties the vector before it is assigned to, stack elements stay alive and are assigned over
+    constexpr void _release() {
+        if (is_small()) {
+            m_data.stack.m_size = 0;
+        } else {
+            _deallocate_heap();
+            m_data.heap.m_array = nullptr;
+            m_data.heap.m_size = 0;
+            m_capacity = stack_capacity();
+        }
     }
 };
 
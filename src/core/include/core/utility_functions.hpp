@@ -2,7 +2,7 @@
 #define STARSIGHT_UTILITY_FUNCTIONS_HPP
 
 #include <pthread.h>
-#include "taskflow/taskflow.hpp"
+#include "job_scheduler.hpp"
 #include "assertion.hpp"
 
 #define SafeFree(ptr)       \
@@ -23,7 +23,6 @@
 
 namespace global
 {
-    inline tf::Executor TaskExecutor{};
     inline pthread_t MainThreadID = 0;
 }
 
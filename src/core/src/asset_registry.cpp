@@ -0,0 +1,112 @@
+#include "asset_registry.hpp"
+
+AssetId AssetRegistry::Acquire(std::string_view Name)
+{
+    ASSERT(!Name.empty());
+    std::lock_guard Guard{Mx};
+
+    if(auto It = Lookup.find(Name); It != Lookup.end())
+    {
+        Slot& Entry = *Slots.Find(It->second);
+        Entry.Users.fetch_add(1, std::memory_order_relaxed);
+
+        return AssetId::Make(It->second, Entry.Generation.load(std::memory_order_relaxed));
+    }
+
+    uint32_t Index;
+    if(!FreeIndices.empty())
+    {
+        Index = FreeIndices.back();
+        FreeIndices.pop_back();
+    }
+    else
+    {
+        Index = NextIndex.load(std::memory_order_relaxed);
+        VERIFY(Index <= AssetId::MaxIndex, "out of asset ids");
+    }
+
+    Slot& Entry = Slots.Get(Index);
+    Entry.Name = Name;
+    Entry.Users.store(1, std::memory_order_relaxed);
+    Lookup.emplace(Entry.Name, Index);
+
+    //published after the slot is written, so anything iterating up to the limit finds it complete
+    if(Index == NextIndex.load(std::memory_order_relaxed))
+    {
+        NextIndex.store(Index + 1, std::memory_order_release);
+    }
+
+    return AssetId::Make(Index, Entry.Generation.load(std::memory_order_relaxed));
+}
+
+void AssetRegistry::AddUser(AssetId Id)
+{
+    Slot& Entry = GetSlot(Id);
+    [[maybe_unused]] uint32_t Users = Entry.Users.fetch_add(1, std::memory_order_relaxed);
+    ASSERT(Users != 0, "the id has no users left", Entry.Name);
+}
+
+void AssetRegistry::Release(AssetId Id)
+{
+    Slot& Entry = GetSlot(Id);
+    if(Entry.Users.fetch_sub(1, std::memory_order_acq_rel) != 1)
+    {
+        return;
+    }
+
+    std::lock_guard Guard{Mx};
+
+    //someone may have acquired the name again in between, or another release got here first
+    if(Entry.Users.load(std::memory_order_relaxed) != 0 || Entry.Generation.load(std::memory_order_relaxed) != Id.Generation())
+    {
+        return;
+    }
+
+    Lookup.erase(Entry.Name);
+    Entry.Name.clear();
+
+    //0 is left out so no id ever ends up as 0
+    uint32_t Generation = Id.Generation() + 1;
+    Entry.Generation.store(Generation > (UINT32_MAX >> AssetId::IndexBits) ? 1 : Generation, std::memory_order_release);
+
+    FreeIndices.emplace_back(Id.Index());
+}
+
+AssetId AssetRegistry::Find(std::string_view Name) const
+{
+    std::lock_guard Guard{Mx};
+
+    if(auto It = Lookup.find(Name); It != Lookup.end())
+    {
+        return AssetId::Make(It->second, Slots.Find(It->second)->Generation.load(std::memory_order_relaxed));
+    }
+
+    return AssetId{};
+}
+
+bool AssetRegistry::IsValid(AssetId Id) const
+{
+    if(!Id || Id.Index() >= GetIndexLimit())
+    {
+        return false;
+    }
+
+    const Slot* Entry = Slots.Find(Id.Index());
+    return Entry && Entry->Generation.load(std::memory_order_acquire) == Id.Generation() && Entry->Users.load(std::memory_order_relaxed) != 0;
+}
+
+std::string_view AssetRegistry::GetName(AssetId Id) const
+{
+    return GetSlot(Id).Name;
+}
+
+std::fpath AssetRegistry::GetPath(AssetId Id) const
+{
+    return std::fpath{GetSlot(Id).Name};
+}
+
+AssetRegistry::Slot& AssetRegistry::GetSlot(AssetId Id) const
+{
+    ASSERT(IsValid(Id), "stale or invalid asset id", Id.Value);
+    return *Slots.Find(Id.Index());
+}
@@ -0,0 +1,171 @@
+#include "cpu_profiler.hpp"
+#include "log.hpp"
+#include "time.hpp"
+#include "fmt/format.h"
+#include <algorithm>
+#include <fstream>
+#include <pthread.h>
+
+namespace
+{
+    thread_local void* CurrentRing = nullptr;
+
+    uint64_t MonotonicNanoseconds()
+    {
+        timespec Time = timespec_time_now();
+        return static_cast<uint64_t>(Time.tv_sec) * 1000000000ull + static_cast<uint64_t>(Time.tv_nsec);
+    }
+
+    //names come from flecs and asset paths, anything but quotes and backslashes passes through
+    std::string EscapeJson(std::string_view String)
+    {
+        std::string Result{};
+        Result.reserve(String.size());
+
+        for(char Character : String)
+        {
+            if(Character == '"' || Character == '\\')
+            {
+                Result.push_back('\\');
+            }
+
+            Result.push_back(static_cast<unsigned char>(Character) < 0x20 ? ' ' : Character);
+        }
+
+        return Result;
+    }
+}
+
+CpuProfiler::CpuProfiler()
+{
+    BaseTicks = Now();
+    BaseNanoseconds = MonotonicNanoseconds();
+}
+
+void CpuProfiler::Record(const char* Name, uint64_t Begin, uint64_t End, uint64_t Frame)
+{
+    ThreadRing* Ring = static_cast<ThreadRing*>(CurrentRing);
+    if(Ring == nullptr) [[unlikely]]
+    {
+        Ring = RegisterThread();
+        CurrentRing = Ring;
+    }
+
+    //only this thread writes the ring, the head tells the exporter how far the zones are complete
+    uint64_t Head = Ring->Head.load(std::memory_order_relaxed);
+    Ring->Zones[Head & (CPU_PROFILER_RING_SIZE - 1)] = CpuZone{Name, Begin, End, Frame};
+    Ring->Head.store(Head + 1, std::memory_order_release);
+}
+
+const char* CpuProfiler::InternName(std::string_view Name)
+{
+    std::lock_guard Lock{Mx};
+
+    auto Found = Names.find(Name);
+    if(Found != Names.end())
+    {
+        return Found->data();
+    }
+
+    const std::string& Stored = NameStorage.emplace_back(Name);
+    Names.emplace(Stored);
+    return Stored.c_str();
+}
+
+void CpuProfiler::BeginFrame()
+{
+    FrameBegin = Now();
+}
+
+void CpuProfiler::EndFrame(uint64_t Frame)
+{
+    Record("Frame", FrameBegin, Now(), Frame);
+}
+
+CpuProfiler::ThreadRing* CpuProfiler::RegisterThread()
+{
+    static_assert((CPU_PROFILER_RING_SIZE & (CPU_PROFILER_RING_SIZE - 1)) == 0, "CPU_PROFILER_RING_SIZE must be a power of two");
+
+    auto Ring = std::make_unique<ThreadRing>();
+
+    char ThreadName[16]{};
+    pthread_getname_np(pthread_self(), ThreadName, sizeof(ThreadName));
+    Ring->ThreadName = ThreadName;
+
+    std::lock_guard Lock{Mx};
+    Ring->ThreadIndex = static_cast<uint32_t>(Rings.size());
+
+    return Rings.emplace_back(std::move(Ring)).get();
+}
+
+bool CpuProfiler::ExportChromeTrace(const std::fpath& Path)
+{
+    const uint64_t Ticks = Now();
+    const uint64_t Nanoseconds = MonotonicNanoseconds();
+    const double MicrosecondsPerTick = (static_cast<double>(Nanoseconds - BaseNanoseconds) / 1000.0) / static_cast<double>(std::max<uint64_t>(Ticks - BaseTicks, 1));
+
+    std::error_code Error{};
+    std::filesystem::create_directories(Path.parent_path(), Error);
+
+    std::ofstream File{Path, std::ios::out | std::ios::trunc};
+    if(!File.is_open())
+    {
+        LOG_WARNING("failed to open {} for the cpu trace", Path.string());
+        return false;
+    }
+
+    std::lock_guard Lock{Mx};
+
+    File << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+    File << R"({"name": "process_name", "ph": "M", "pid": 1, "args": {"name": "starsight"}})";
+
+    uint64_t ZoneCount = 0;
+    std::vector<CpuZone> Zones(CPU_PROFILER_RING_SIZE);
+
+    for(const std::unique_ptr<ThreadRing>& Ring : Rings)
+    {
+        File << fmt::format(",\n{{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": {}, \"args\": {{\"name\": \"{}\"}}}}",
+                            Ring->ThreadIndex, EscapeJson(Ring->ThreadName.empty() ? fmt::format("thread {}", Ring->ThreadIndex) : Ring->ThreadName));
+
+        //the thread keeps writing while the ring is copied, whatever it may have overwritten in the meantime is dropped
+        const uint64_t Head = Ring->Head.load(std::memory_order_acquire);
+        const uint64_t First = Head > CPU_PROFILER_RING_SIZE ? Head - CPU_PROFILER_RING_SIZE : 0;
+
+        for(uint64_t Index = First; Index < Head; ++Index)
+        {
+            Zones[Index - First] = Ring->Zones[Index & (CPU_PROFILER_RING_SIZE - 1)];
+        }
+
+        //the writer fills the slot of zone HeadAfter before publishing it, which is where zone HeadAfter - RING_SIZE was
+        const uint64_t HeadAfter = Ring->Head.load(std::memory_order_acquire);
+        const uint64_t Valid = HeadAfter + 1 > CPU_PROFILER_RING_SIZE ? HeadAfter + 1 - CPU_PROFILER_RING_SIZE : 0;
+
+        for(uint64_t Index = std::max(First, Valid); Index < Head; ++Index)
+        {
+            const CpuZone& Zone = Zones[Index - First];
+            if(Zone.Begin < BaseTicks || Zone.End < Zone.Begin)
+            {
+                continue;
+            }
+
+            double Timestamp = static_cast<double>(Zone.Begin - BaseTicks) * MicrosecondsPerTick;
+            double Duration = static_cast<double>(Zone.End - Zone.Begin) * MicrosecondsPerTick;
+
+            File << fmt::format(",\n{{\"name\": \"{}\", \"ph\": \"X\", \"pid\": 1, \"tid\": {}, \"ts\": {:.3f}, \"dur\": {:.3f}",
+                                EscapeJson(Zone.Name), Ring->ThreadIndex, Timestamp, Duration);
+
+            if(Zone.Frame != UINT64_MAX)
+            {
+                File << fmt::format(", \"args\": {{\"frame\": {}}}", Zone.Frame);
+            }
+
+            File << "}";
+            ZoneCount += 1;
+        }
+    }
+
+    File << "\n]}\n";
+
+    LOG_INFO("wrote {} cpu zones of {} threads to {}", ZoneCount, Rings.size(), Path.string());
+    return true;
+}
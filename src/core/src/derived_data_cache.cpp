@@ -0,0 +1,342 @@
+#include "derived_data_cache.hpp"
+#include "assertion.hpp"
+#include "log.hpp"
+#include "math.hpp"
+#include "fmt/format.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <cstring>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+struct DerivedDataHeader
+{
+    uint32_t Magic;
+    uint32_t Version;
+    uint64_t Key;
+    uint64_t PayloadSize;
+    uint64_t PayloadHash;
+};
+
+static_assert(sizeof(DerivedDataHeader) % 16 == 0, "payloads keep the alignment of the mapping");
+
+DerivedDataKey::DerivedDataKey(std::string_view Kind, uint32_t Version)
+    : Hash(DDC_VERSION)
+{
+    Append(Kind);
+    Append(Version);
+}
+
+DerivedDataKey& DerivedDataKey::Append(const void* Data, uint64_t Size)
+{
+    //chained so the same bytes split differently between appends give a different key
+    uint64_t Chunk[3] = {Hash, Size, hash_crc64(Data, Size)};
+    Hash = hash_crc64(Chunk, sizeof(Chunk));
+    return *this;
+}
+
+DerivedDataKey& DerivedDataKey::Append(std::span<const uint8_t> Data)
+{
+    return Append(Data.data(), Data.size());
+}
+
+DerivedDataKey& DerivedDataKey::Append(std::string_view String)
+{
+    return Append(String.data(), String.size());
+}
+
+DerivedData::DerivedData(void* Mapping_, uint64_t MappingSize_, uint64_t PayloadOffset)
+    : Mapping(Mapping_)
+    , MappingSize(MappingSize_)
+    , PayloadBytes(static_cast<const uint8_t*>(Mapping_) + PayloadOffset, MappingSize_ - PayloadOffset)
+{
+}
+
+DerivedData::~DerivedData()
+{
+    VERIFY(munmap(Mapping, MappingSize) != -1, strerror(errno), ASSERTION::NONFATAL);
+}
+
+DerivedDataCache::DerivedDataCache()
+    : Directory(ProjectAbsolutePath(DDC_DIRECTORY))
+{
+    std::error_code Error{};
+    std::filesystem::create_directories(Directory, Error);
+    VERIFY(!Error, Directory, Error.message());
+
+    struct FoundEntry
+    {
+        uint64_t Key;
+        uint64_t Size;
+        std::filesystem::file_time_type WriteTime;
+    };
+
+    std::vector<FoundEntry> Found{};
+
+    for(const auto& File : std::filesystem::directory_iterator{Directory, Error})
+    {
+        const std::fpath& Path = File.path();
+
+        //left behind by a store that was interrupted
+        if(Path.extension() == ".tmp")
+        {
+            std::filesystem::remove(Path, Error);
+            continue;
+        }
+
+        std::string Stem = Path.stem().string();
+
+        uint64_t Key;
+        auto[End, Result] = std::from_chars(Stem.data(), Stem.data() + Stem.size(), Key, 16);
+
+        if(Path.extension() != ".ddc" || Result != std::errc{} || End != Stem.data() + Stem.size())
+        {
+            continue;
+        }
+
+        Found.emplace_back(Key, File.file_size(Error), File.last_write_time(Error));
+    }
+
+    //the file times carry the access order over from the last run
+    std::sort(Found.begin(), Found.end(), [](const FoundEntry& Lhs, const FoundEntry& Rhs)
+    {
+        return Lhs.WriteTime < Rhs.WriteTime;
+    });
+
+    for(const FoundEntry& Item : Found)
+    {
+        Entry& Slot = FindOrAddEntry(Item.Key);
+        Slot.Size.store(Item.Size, std::memory_order_relaxed);
+        Slot.LastAccess.store(AccessClock.fetch_add(1, std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        TotalBytes.fetch_add(Item.Size, std::memory_order_relaxed);
+    }
+
+    LOG_INFO("derived data cache has {} entries, {} MiB", Found.size(), TotalBytes.load(std::memory_order_relaxed) >> 20);
+
+    if(TotalBytes.load(std::memory_order_relaxed) > DDC_MAX_BYTES)
+    {
+        Trim();
+    }
+}
+
+std::fpath DerivedDataCache::EntryPath(uint64_t Key) const
+{
+    return Directory / fmt::format("{:016x}.ddc", Key);
+}
+
+DerivedDataCache::Entry& DerivedDataCache::FindOrAddEntry(uint64_t Key)
+{
+    auto Found = Entries.find(Key);
+    if(Found != Entries.end())
+    {
+        return Found->second;
+    }
+
+    return Entries.emplace(std::piecewise_construct, std::forward_as_tuple(Key), std::forward_as_tuple()).first->second;
+}
+
+std::shared_ptr<const DerivedData> DerivedDataCache::Find(const DerivedDataKey& Key)
+{
+    auto Found = Entries.find(Key.Value());
+    if(Found == Entries.end() || Found->second.Size.load(std::memory_order_acquire) == 0)
+    {
+        return nullptr;
+    }
+
+    Entry& Slot = Found->second;
+    std::fpath Path = EntryPath(Key.Value());
+
+    int fd = open(Path.c_str(), O_RDONLY);
+    if(fd == -1)
+    {
+        Evict(Key.Value(), Slot);
+        return nullptr;
+    }
+
+    struct stat64 statbuf;
+    if(fstat64(fd, &statbuf) == -1 || statbuf.st_size < static_cast<int64_t>(sizeof(DerivedDataHeader)))
+    {
+        close(fd);
+        LOG_WARNING("derived data {} is truncated", Path);
+        Evict(Key.Value(), Slot);
+        return nullptr;
+    }
+
+    //the mapping stays valid after the descriptor is closed
+    void* Mapping = mmap(nullptr, statbuf.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if(Mapping == MAP_FAILED)
+    {
+        LOG_WARNING("could not map derived data {} - {}", Path, strerror(errno));
+        return nullptr;
+    }
+
+    auto Data = std::make_shared<const DerivedData>(Mapping, statbuf.st_size, sizeof(DerivedDataHeader));
+    const auto* Header = static_cast<const DerivedDataHeader*>(Mapping);
+
+    bool bValid = Header->Magic == DDC_MAGIC
+                  && Header->Version == DDC_VERSION
+                  && Header->Key == Key.Value()
+                  && Header->PayloadSize == Data->Payload().size()
+                  && Header->PayloadHash == hash_crc64(Data->Payload().data(), Data->Payload().size());
+
+    if(!bValid)
+    {
+        LOG_WARNING("derived data {} is damaged, removing it", Path);
+        Evict(Key.Value(), Slot);
+        return nullptr;
+    }
+
+    Slot.LastAccess.store(AccessClock.fetch_add(1, std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+
+    if(!Slot.bTouched.exchange(true, std::memory_order_relaxed))
+    {
+        utimensat(AT_FDCWD, Path.c_str(), nullptr, 0);
+    }
+
+    return Data;
+}
+
+void DerivedDataCache::Store(const DerivedDataKey& Key, std::span<const uint8_t> Payload)
+{
+    static std::atomic_uint64_t TempCounter{0};
+
+    DerivedDataHeader Header{};
+    Header.Magic = DDC_MAGIC;
+    Header.Version = DDC_VERSION;
+    Header.Key = Key.Value();
+    Header.PayloadSize = Payload.size();
+    Header.PayloadHash = hash_crc64(Payload.data(), Payload.size());
+
+    std::fpath Path = EntryPath(Key.Value());
+
+    //written under a unique name and renamed over the entry, so readers never see a partial file
+    std::fpath TempPath = Directory / fmt::format("{:016x}.{}.tmp", Key.Value(), TempCounter.fetch_add(1, std::memory_order_relaxed));
+
+    int fd = open(TempPath.c_str(), O_WRONLY | O_TRUNC | O_CREAT, S_IWUSR | S_IRUSR);
+    if(fd == -1)
+    {
+        LOG_WARNING("could not write derived data {} - {}", Path, strerror(errno));
+        return;
+    }
+
+    auto WriteAll = [fd](const uint8_t* Data, uint64_t Size)
+    {
+        while(Size > 0)
+        {
+            ssize_t nwrite = write(fd, Data, Size);
+            if(nwrite <= 0)
+            {
+                return false;
+            }
+
+            Data += nwrite;
+            Size -= nwrite;
+        }
+
+        return true;
+    };
+
+    bool bWritten = WriteAll(reinterpret_cast<const uint8_t*>(&Header), sizeof(Header)) && WriteAll(Payload.data(), Payload.size());
+    VERIFY(close(fd) != -1, TempPath, strerror(errno));
+
+    uint64_t Size = sizeof(Header) + Payload.size();
+    Entry& Slot = FindOrAddEntry(Key.Value());
+
+    {
+        std::lock_guard Guard{Slot.FileMx};
+
+        if(!bWritten || rename(TempPath.c_str(), Path.c_str()) == -1)
+        {
+            LOG_WARNING("could not write derived data {} - {}", Path, strerror(errno));
+            unlink(TempPath.c_str());
+            return;
+        }
+
+        Slot.bTouched.store(true, std::memory_order_relaxed);
+        Slot.LastAccess.store(AccessClock.fetch_add(1, std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+
+        uint64_t OldSize = Slot.Size.exchange(Size, std::memory_order_release);
+        TotalBytes.fetch_add(Size, std::memory_order_relaxed);
+        TotalBytes.fetch_sub(OldSize, std::memory_order_relaxed);
+    }
+
+    if(TotalBytes.load(std::memory_order_relaxed) > DDC_MAX_BYTES)
+    {
+        Trim();
+    }
+}
+
+void DerivedDataCache::Evict(uint64_t Key, Entry& Slot)
+{
+    //entries are never erased from the index, a later store of the same key brings them back
+    std::lock_guard Guard{Slot.FileMx};
+
+    uint64_t Size = Slot.Size.exchange(0, std::memory_order_acq_rel);
+    if(Size != 0)
+    {
+        TotalBytes.fetch_sub(Size, std::memory_order_relaxed);
+        unlink(EntryPath(Key).c_str());
+    }
+}
+
+void DerivedDataCache::Trim()
+{
+    //one thread trims at a time, the others carry on since the cap is soft
+    if(bTrimming.test_and_set(std::memory_order_acquire))
+    {
+        return;
+    }
+
+    struct Candidate
+    {
+        uint64_t LastAccess;
+        uint64_t Key;
+        Entry* Slot;
+    };
+
+    std::vector<Candidate> Candidates{};
+
+    for(auto& [Key, Slot] : Entries)
+    {
+        if(Slot.Size.load(std::memory_order_relaxed) != 0)
+        {
+            Candidates.emplace_back(Slot.LastAccess.load(std::memory_order_relaxed), Key, &Slot);
+        }
+    }
+
+    std::sort(Candidates.begin(), Candidates.end(), [](const Candidate& Lhs, const Candidate& Rhs)
+    {
+        return Lhs.LastAccess < Rhs.LastAccess;
+    });
+
+    const uint64_t TargetBytes = static_cast<uint64_t>(DDC_MAX_BYTES * DDC_TRIM_RATIO);
+    uint64_t Evicted = 0;
+
+    for(const Candidate& Victim : Candidates)
+    {
+        if(TotalBytes.load(std::memory_order_relaxed) <= TargetBytes)
+        {
+            break;
+        }
+
+        Evict(Victim.Key, *Victim.Slot);
+        Evicted += 1;
+    }
+
+    LOG_INFO("evicted {} derived data entries, {} MiB left", Evicted, TotalBytes.load(std::memory_order_relaxed) >> 20);
+
+    bTrimming.clear(std::memory_order_release);
+}
+
+DerivedDataCache* GetDerivedDataCache()
+{
+    static DerivedDataCache Cache{};
+    return &Cache;
+}
@@ -0,0 +1,131 @@
+#include "epoch.hpp"
+#include "assertion.hpp"
+#include "log.hpp"
+#include <algorithm>
+#include <vector>
+
+void EpochManager::Advance()
+{
+    Epoch.fetch_add(1, std::memory_order_acq_rel);
+}
+
+void EpochManager::SetDeviceEpoch(uint64_t DeviceEpoch_)
+{
+    uint64_t Current = DeviceEpoch.load(std::memory_order_relaxed);
+    while(Current < DeviceEpoch_ && !DeviceEpoch.compare_exchange_weak(Current, DeviceEpoch_, std::memory_order_acq_rel))
+    {
+    }
+}
+
+uint64_t EpochManager::Pin()
+{
+    std::lock_guard Guard{PinMx};
+
+    uint64_t Pinned = GetEpoch();
+    Pins[Pinned] += 1;
+
+    return Pinned;
+}
+
+void EpochManager::Unpin(uint64_t PinnedEpoch)
+{
+    std::lock_guard Guard{PinMx};
+
+    auto It = Pins.find(PinnedEpoch);
+    ASSERT(It != Pins.end());
+
+    if(--It->second == 0)
+    {
+        Pins.erase(It);
+    }
+}
+
+uint64_t EpochManager::GetOldestPin() const
+{
+    std::lock_guard Guard{PinMx};
+    return Pins.empty() ? UINT64_MAX : Pins.begin()->first;
+}
+
+uint64_t RetireList::Retire(std::function<bool(uint64_t)> Free)
+{
+    std::lock_guard Guard{Mx};
+
+    uint64_t Epoch = global::Epochs.GetEpoch();
+    Entries.emplace_back(Entry{Epoch, std::move(Free)});
+
+    return Epoch;
+}
+
+void RetireList::Reclaim()
+{
+    uint64_t SafeEpoch = global::Epochs.GetOldestPin();
+    if(bWaitForDevice)
+    {
+        SafeEpoch = std::min(SafeEpoch, global::Epochs.GetDeviceEpoch());
+    }
+
+    //taken out first, freeing may retire more objects into this list
+    std::vector<Entry> Ready{};
+    {
+        std::lock_guard Guard{Mx};
+        while(!Entries.empty() && Entries.front().Epoch < SafeEpoch)
+        {
+            Ready.emplace_back(std::move(Entries.front()));
+            Entries.pop_front();
+        }
+    }
+
+    std::vector<Entry> Busy{};
+    for(Entry& Retired : Ready)
+    {
+        if(!Retired.Free(Retired.Epoch))
+        {
+            Busy.emplace_back(std::move(Retired));
+        }
+    }
+
+    //still in epoch order, and older than anything retired since
+    std::lock_guard Guard{Mx};
+    Entries.insert(Entries.begin(), std::make_move_iterator(Busy.begin()), std::make_move_iterator(Busy.end()));
+}
+
+void RetireList::Drain()
+{
+    while(true)
+    {
+        std::deque<Entry> Pending{};
+        {
+            std::lock_guard Guard{Mx};
+            Pending.swap(Entries);
+        }
+
+        if(Pending.empty())
+        {
+            return;
+        }
+
+        std::vector<Entry> Busy{};
+        for(Entry& Retired : Pending)
+        {
+            if(!Retired.Free(Retired.Epoch))
+            {
+                Busy.emplace_back(std::move(Retired));
+            }
+        }
+
+        std::lock_guard Guard{Mx};
+        Entries.insert(Entries.begin(), std::make_move_iterator(Busy.begin()), std::make_move_iterator(Busy.end()));
+
+        if(Busy.size() == Pending.size())
+        {
+            LOG_WARNING("{} retired objects are still busy", Busy.size());
+            return;
+        }
+    }
+}
+
+bool RetireList::IsEmpty() const
+{
+    std::lock_guard Guard{Mx};
+    return Entries.empty();
+}
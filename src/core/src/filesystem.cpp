@@ -64,7 +64,7 @@ std::vector<uint8_t> ReadFileBinary(std::fpath filepath, bool create)
 
 void WriteFileBinary(std::fpath filepath, std::vector<uint8_t>&& data, bool create)
 {
-    global::TaskExecutor.silent_async([filepath = std::move(filepath), data = std::move(data), create]()
+    global::Scheduler.Submit(JobPriority::Background, [filepath = std::move(filepath), data = std::move(data), create]()
     {
         int fd = create ? open(filepath.c_str(), O_WRONLY | O_TRUNC | O_CREAT, S_IWUSR | S_IRUSR) : open(filepath.c_str(), O_WRONLY | O_TRUNC);
         VERIFY(fd != -1, filepath, strerror(errno));
@@ -78,7 +78,7 @@ void WriteFileBinary(std::fpath filepath, std::vector<uint8_t>&& data, bool crea
 
 std::future<std::vector<uint8_t>> ReadFileBinaryAsync(std::fpath filepath, bool create)
 {
-    return global::TaskExecutor.async([filepath = std::move(filepath), create]() mutable
+    return global::Scheduler.Async(JobPriority::Streaming, [filepath = std::move(filepath), create]() mutable
     {
         return ReadFileBinary(std::move(filepath), create);
     });
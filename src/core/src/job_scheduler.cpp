@@ -0,0 +1,255 @@
+#include "job_scheduler.hpp"
+#include "fmt/format.h"
+#include <pthread.h>
+
+namespace
+{
+    thread_local const JobScheduler* CurrentScheduler = nullptr;
+    thread_local uint32_t CurrentWorker = UINT32_MAX;
+}
+
+JobScheduler::JobScheduler(uint32_t WorkerCount)
+{
+    if(WorkerCount == 0)
+    {
+        WorkerCount = std::max(1u, std::thread::hardware_concurrency() - 1);
+    }
+
+    LowPriorityLimit = std::max(1u, WorkerCount - std::min<uint32_t>(JOB_SCHEDULER_RESERVED_WORKERS, WorkerCount));
+
+    Workers.reserve(WorkerCount);
+    for(uint32_t Index = 0; Index < WorkerCount; ++Index)
+    {
+        Workers.emplace_back(std::make_unique<Worker>());
+    }
+
+    //every worker exists before the first one can try to steal
+    for(uint32_t Index = 0; Index < WorkerCount; ++Index)
+    {
+        Workers[Index]->Thread = std::thread{&JobScheduler::WorkerMain, this, Index};
+
+        std::string Name = fmt::format("worker {}", Index);
+        pthread_setname_np(Workers[Index]->Thread.native_handle(), Name.c_str());
+    }
+}
+
+JobScheduler::~JobScheduler()
+{
+    bStop.store(true, std::memory_order_release);
+    WakeEpoch.fetch_add(1, std::memory_order_release);
+    WakeEpoch.notify_all();
+
+    for(std::unique_ptr<Worker>& Worker : Workers)
+    {
+        Worker->Thread.join();
+    }
+}
+
+void JobScheduler::Submit(JobPriority Priority, std::function<void()> Function, JobGroup* Group)
+{
+    const uint32_t Level = static_cast<uint32_t>(Priority);
+
+    if(Group != nullptr)
+    {
+        Group->Pending.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    JobQueue& Queue = InWorker() ? Workers[CurrentWorker]->Queues[Level] : Shared[Level];
+    {
+        std::lock_guard Lock{Queue.Mx};
+        Queue.Jobs.emplace_back(Job{std::move(Function), Group});
+    }
+
+    Queued[Level].fetch_add(1, std::memory_order_release);
+    Wake();
+}
+
+void JobScheduler::Wait(JobGroup& Group, JobPriority Help)
+{
+    Backoff Delay{};
+    while(Group.IsBusy())
+    {
+        if(!RunPending(Help))
+        {
+            Delay.Pause();
+        }
+        else
+        {
+            Delay = Backoff{};
+        }
+    }
+}
+
+bool JobScheduler::RunPending(JobPriority Help)
+{
+    Job Entry{};
+    bool bLowPriority = false;
+
+    if(!FindJob(Help, false, Entry, bLowPriority))
+    {
+        return false;
+    }
+
+    Execute(Entry);
+    return true;
+}
+
+bool JobScheduler::InWorker() const
+{
+    return CurrentScheduler == this;
+}
+
+void JobScheduler::Backoff::Pause()
+{
+    if(Rounds < 64)
+    {
+        std::this_thread::yield();
+    }
+    else
+    {
+        std::this_thread::sleep_for(std::chrono::microseconds{std::min(1u << std::min(Rounds - 64, 7u), 100u)});
+    }
+
+    Rounds += 1;
+}
+
+void JobScheduler::WorkerMain(uint32_t Index)
+{
+    CurrentScheduler = this;
+    CurrentWorker = Index;
+
+    while(true)
+    {
+        uint64_t Epoch = WakeEpoch.load(std::memory_order_acquire);
+
+        Job Entry{};
+        bool bLowPriority = false;
+
+        if(FindJob(JobPriority::Background, true, Entry, bLowPriority))
+        {
+            Execute(Entry);
+
+            if(bLowPriority)
+            {
+                LowPriorityRunning.fetch_sub(1, std::memory_order_release);
+                Wake(); //a worker may have gone to sleep on the limit with low priority jobs left
+            }
+
+            continue;
+        }
+
+        if(bStop.load(std::memory_order_acquire))
+        {
+            break;
+        }
+
+        WakeEpoch.wait(Epoch, std::memory_order_acquire);
+    }
+}
+
+bool JobScheduler::TryPop(uint32_t Priority, Job& Out)
+{
+    auto PopBack = [&](JobQueue& Queue)
+    {
+        std::lock_guard Lock{Queue.Mx};
+        if(Queue.Jobs.empty())
+        {
+            return false;
+        }
+
+        Out = std::move(Queue.Jobs.back());
+        Queue.Jobs.pop_back();
+        return true;
+    };
+
+    auto PopFront = [&](JobQueue& Queue)
+    {
+        std::lock_guard Lock{Queue.Mx};
+        if(Queue.Jobs.empty())
+        {
+            return false;
+        }
+
+        Out = std::move(Queue.Jobs.front());
+        Queue.Jobs.pop_front();
+        return true;
+    };
+
+    const uint32_t Self = InWorker() ? CurrentWorker : UINT32_MAX;
+    bool bFound = (Self != UINT32_MAX && PopBack(Workers[Self]->Queues[Priority])) || PopFront(Shared[Priority]);
+
+    //the newest job of a worker is the most likely to be in its cache, so others take the oldest
+    const uint32_t Start = Self == UINT32_MAX ? 0 : Self + 1;
+    for(uint32_t Victim = 0; !bFound && Victim < Workers.size(); ++Victim)
+    {
+        uint32_t Index = (Start + Victim) % Workers.size();
+        bFound = Index != Self && PopFront(Workers[Index]->Queues[Priority]);
+    }
+
+    if(bFound)
+    {
+        Queued[Priority].fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    return bFound;
+}
+
+bool JobScheduler::FindJob(JobPriority Help, bool bTopLevel, Job& Out, bool& bLowPriority)
+{
+    for(uint32_t Priority = 0; Priority <= static_cast<uint32_t>(Help); ++Priority)
+    {
+        if(Queued[Priority].load(std::memory_order_acquire) == 0)
+        {
+            continue;
+        }
+
+        //only workers looking for their next job count against the limit, a thread helping while it waits already holds its place
+        const bool bLimited = bTopLevel && Priority != static_cast<uint32_t>(JobPriority::FrameCritical);
+        if(bLimited)
+        {
+            uint32_t Running = LowPriorityRunning.load(std::memory_order_relaxed);
+            do
+            {
+                if(Running >= LowPriorityLimit)
+                {
+                    break;
+                }
+            }
+            while(!LowPriorityRunning.compare_exchange_weak(Running, Running + 1, std::memory_order_acquire));
+
+            if(Running >= LowPriorityLimit)
+            {
+                continue;
+            }
+        }
+
+        if(TryPop(Priority, Out))
+        {
+            bLowPriority = bLimited;
+            return true;
+        }
+
+        if(bLimited)
+        {
+            LowPriorityRunning.fetch_sub(1, std::memory_order_release);
+        }
+    }
+
+    return false;
+}
+
+void JobScheduler::Execute(Job& Entry)
+{
+    Entry.Function();
+
+    if(Entry.Group != nullptr)
+    {
+        Entry.Group->Pending.fetch_sub(1, std::memory_order_acq_rel);
+    }
+}
+
+void JobScheduler::Wake()
+{
+    WakeEpoch.fetch_add(1, std::memory_order_release);
+    WakeEpoch.notify_one();
+}
@@ -0,0 +1,111 @@
+#include "linear_arena.hpp"
+#include "log.hpp"
+#include <algorithm>
+#include <bit>
+
+namespace
+{
+    constexpr uint64_t ArenaBlockAlignment = 64;
+}
+
+LinearArena::LinearArena(uint64_t Capacity_)
+    : Capacity(Capacity_)
+{
+    Memory = static_cast<std::byte*>(::operator new(Capacity, std::align_val_t{ArenaBlockAlignment}));
+}
+
+LinearArena::~LinearArena()
+{
+    FreeOverflow(0);
+    ::operator delete(Memory, Capacity, std::align_val_t{ArenaBlockAlignment});
+}
+
+void* LinearArena::Allocate(uint64_t Size, uint64_t Alignment)
+{
+    const uintptr_t Base = reinterpret_cast<uintptr_t>(Memory);
+
+    uint64_t Current = Offset.load(std::memory_order_relaxed);
+    uint64_t Aligned;
+    do
+    {
+        Aligned = ((Base + Current + Alignment - 1) & ~(Alignment - 1)) - Base;
+        if(Aligned + Size > Capacity) [[unlikely]]
+        {
+            return AllocateOverflow(Size, Alignment);
+        }
+    }
+    while(!Offset.compare_exchange_weak(Current, Aligned + Size, std::memory_order_relaxed));
+
+    return Memory + Aligned;
+}
+
+void* LinearArena::AllocateOverflow(uint64_t Size, uint64_t Alignment)
+{
+    Alignment = std::max<uint64_t>(Alignment, __STDCPP_DEFAULT_NEW_ALIGNMENT__);
+    void* Block = ::operator new(Size, std::align_val_t{Alignment});
+
+    std::lock_guard Guard{OverflowMx};
+    Overflow.emplace_back(OverflowBlock{Block, Size, Alignment});
+    OverflowBytes.fetch_add(Size, std::memory_order_relaxed);
+
+    return Block;
+}
+
+void LinearArena::FreeOverflow(uint64_t From)
+{
+    std::lock_guard Guard{OverflowMx};
+    for(uint64_t Index = From; Index < Overflow.size(); ++Index)
+    {
+        const OverflowBlock& Block = Overflow[Index];
+        ::operator delete(Block.Memory, Block.Size, std::align_val_t{Block.Alignment});
+        OverflowBytes.fetch_sub(Block.Size, std::memory_order_relaxed);
+    }
+
+    Overflow.resize(std::min<uint64_t>(From, Overflow.size()));
+}
+
+void LinearArena::Reset()
+{
+    HighWater = std::max(HighWater, GetUsed());
+
+    FreeOverflow(0);
+    Offset.store(0, std::memory_order_relaxed);
+
+    //one larger block instead of overflowing every time from now on
+    if(HighWater > Capacity) [[unlikely]]
+    {
+        uint64_t NewCapacity = std::bit_ceil(HighWater);
+        LOG_INFO("growing linear arena from {} to {} bytes", Capacity, NewCapacity);
+
+        ::operator delete(Memory, Capacity, std::align_val_t{ArenaBlockAlignment});
+        Capacity = NewCapacity;
+        Memory = static_cast<std::byte*>(::operator new(Capacity, std::align_val_t{ArenaBlockAlignment}));
+    }
+}
+
+LinearArena::Marker LinearArena::GetMarker() const
+{
+    std::lock_guard Guard{OverflowMx};
+    return Marker{Offset.load(std::memory_order_relaxed), Overflow.size()};
+}
+
+void LinearArena::Rewind(Marker To)
+{
+    //the outermost scope gives back everything, which is also the point where the block can grow
+    if(To.Offset == 0 && To.Overflow == 0)
+    {
+        Reset();
+        return;
+    }
+
+    HighWater = std::max(HighWater, GetUsed());
+
+    FreeOverflow(To.Overflow);
+    Offset.store(To.Offset, std::memory_order_relaxed);
+}
+
+LinearArena& ScratchArena()
+{
+    thread_local LinearArena Arena{SCRATCH_ARENA_SIZE};
+    return Arena;
+}
@@ -0,0 +1,457 @@
+#include "range_allocator.hpp"
+#include "assertion.hpp"
+#include "math.hpp"
+#include <algorithm>
+#include <bit>
+
+RangeAllocator::RangeAllocator(uint64_t Capacity_)
+    : Capacity(Capacity_)
+{
+    for(auto& SecondLevel : BinHeads)
+    {
+        SecondLevel.fill(RangeAllocation::InvalidNode);
+    }
+
+    if(Capacity != 0)
+    {
+        uint32_t Index = GrabNode();
+        Nodes[Index].Offset = 0;
+        Nodes[Index].Size = Capacity;
+
+        HeadNode = Index;
+        TailNode = Index;
+        InsertFreeNode(Index);
+    }
+}
+
+RangeAllocation RangeAllocator::Allocate(uint64_t Size, uint64_t Alignment, uint64_t UserData)
+{
+    ASSERT(std::has_single_bit(Alignment), Alignment);
+
+    Size = std::max<uint64_t>(Size, 1);
+
+    //worst case padding is included so any range found can be aligned without searching again
+    uint32_t Index = FindFreeNode(Size + Alignment - 1);
+    if(Index == RangeAllocation::InvalidNode)
+    {
+        return {};
+    }
+
+    return AllocateFrom(Index, Size, Alignment, UserData);
+}
+
+RangeAllocation RangeAllocator::AllocateFrom(uint32_t Index, uint64_t Size, uint64_t Alignment, uint64_t UserData)
+{
+    RemoveFreeNode(Index);
+
+    uint64_t LeadSize = math::PadSize2Alignment(Nodes[Index].Offset, Alignment) - Nodes[Index].Offset;
+    if(LeadSize != 0)
+    {
+        uint32_t LeadIndex = GrabNode(); //may reallocate the node storage
+
+        Node& Lead = Nodes[LeadIndex];
+        Node& Current = Nodes[Index];
+
+        Lead.Offset = Current.Offset;
+        Lead.Size = LeadSize;
+        Lead.NeighborPrev = Current.NeighborPrev;
+        Lead.NeighborNext = Index;
+
+        if(Current.NeighborPrev != RangeAllocation::InvalidNode)
+        {
+            Nodes[Current.NeighborPrev].NeighborNext = LeadIndex;
+        }
+
+        if(HeadNode == Index)
+        {
+            HeadNode = LeadIndex;
+        }
+
+        Current.NeighborPrev = LeadIndex;
+        Current.Offset += LeadSize;
+        Current.Size -= LeadSize;
+
+        InsertFreeNode(LeadIndex);
+    }
+
+    uint64_t RemainderSize = Nodes[Index].Size - Size;
+    if(RemainderSize != 0)
+    {
+        uint32_t RemainderIndex = GrabNode();
+
+        Node& Remainder = Nodes[RemainderIndex];
+        Node& Current = Nodes[Index];
+
+        Remainder.Offset = Current.Offset + Size;
+        Remainder.Size = RemainderSize;
+        Remainder.NeighborPrev = Index;
+        Remainder.NeighborNext = Current.NeighborNext;
+
+        if(Current.NeighborNext != RangeAllocation::InvalidNode)
+        {
+            Nodes[Current.NeighborNext].NeighborPrev = RemainderIndex;
+        }
+
+        if(TailNode == Index)
+        {
+            TailNode = RemainderIndex;
+        }
+
+        Current.NeighborNext = RemainderIndex;
+        Current.Size = Size;
+
+        InsertFreeNode(RemainderIndex);
+    }
+
+    Node& Current = Nodes[Index];
+    Current.bUsed = true;
+    Current.bRelocating = false;
+    Current.Alignment = Alignment;
+    Current.UserData = UserData;
+
+    UsedBytes += Size;
+    AllocationCount += 1;
+
+    return RangeAllocation{.Offset = Current.Offset, .Size = Size, .Node = Index};
+}
+
+void RangeAllocator::Free(const RangeAllocation& Allocation)
+{
+    ASSERT(Allocation.IsValid());
+    ASSERT(Allocation.Node < Nodes.size());
+
+    uint32_t Index = Allocation.Node;
+    ASSERT(Nodes[Index].bUsed && Nodes[Index].Offset == Allocation.Offset, "double free or stale allocation", Allocation.Offset, Allocation.Size);
+
+    Nodes[Index].bUsed = false;
+    Nodes[Index].bRelocating = false;
+
+    UsedBytes -= Nodes[Index].Size;
+    AllocationCount -= 1;
+
+    //free ranges are never adjacent to each other, so at most one merge per side is needed
+    uint32_t PrevIndex = Nodes[Index].NeighborPrev;
+    if(PrevIndex != RangeAllocation::InvalidNode && !Nodes[PrevIndex].bUsed)
+    {
+        RemoveFreeNode(PrevIndex);
+
+        Node& Prev = Nodes[PrevIndex];
+        Node& Current = Nodes[Index];
+
+        Current.Offset = Prev.Offset;
+        Current.Size += Prev.Size;
+        Current.NeighborPrev = Prev.NeighborPrev;
+
+        if(Prev.NeighborPrev != RangeAllocation::InvalidNode)
+        {
+            Nodes[Prev.NeighborPrev].NeighborNext = Index;
+        }
+
+        if(HeadNode == PrevIndex)
+        {
+            HeadNode = Index;
+        }
+
+        ReleaseNode(PrevIndex);
+    }
+
+    uint32_t NextIndex = Nodes[Index].NeighborNext;
+    if(NextIndex != RangeAllocation::InvalidNode && !Nodes[NextIndex].bUsed)
+    {
+        RemoveFreeNode(NextIndex);
+
+        Node& Next = Nodes[NextIndex];
+        Node& Current = Nodes[Index];
+
+        Current.Size += Next.Size;
+        Current.NeighborNext = Next.NeighborNext;
+
+        if(Next.NeighborNext != RangeAllocation::InvalidNode)
+        {
+            Nodes[Next.NeighborNext].NeighborPrev = Index;
+        }
+
+        if(TailNode == NextIndex)
+        {
+            TailNode = Index;
+        }
+
+        ReleaseNode(NextIndex);
+    }
+
+    InsertFreeNode(Index);
+}
+
+void RangeAllocator::Grow(uint64_t NewCapacity)
+{
+    ASSERT(NewCapacity >= Capacity, NewCapacity, Capacity);
+
+    uint64_t Extension = NewCapacity - Capacity;
+    if(Extension == 0)
+    {
+        return;
+    }
+
+    if(TailNode != RangeAllocation::InvalidNode && !Nodes[TailNode].bUsed)
+    {
+        RemoveFreeNode(TailNode);
+        Nodes[TailNode].Size += Extension;
+        InsertFreeNode(TailNode);
+    }
+    else
+    {
+        uint32_t Index = GrabNode();
+        Nodes[Index].Offset = Capacity;
+        Nodes[Index].Size = Extension;
+        Nodes[Index].NeighborPrev = TailNode;
+
+        if(TailNode != RangeAllocation::InvalidNode)
+        {
+            Nodes[TailNode].NeighborNext = Index;
+        }
+        else
+        {
+            HeadNode = Index;
+        }
+
+        TailNode = Index;
+        InsertFreeNode(Index);
+    }
+
+    Capacity = NewCapacity;
+}
+
+uint64_t RangeAllocator::GetUserData(const RangeAllocation& Allocation) const
+{
+    ASSERT(Allocation.IsValid() && Nodes[Allocation.Node].bUsed);
+    return Nodes[Allocation.Node].UserData;
+}
+
+void RangeAllocator::SetUserData(const RangeAllocation& Allocation, uint64_t UserData)
+{
+    ASSERT(Allocation.IsValid() && Nodes[Allocation.Node].bUsed);
+    Nodes[Allocation.Node].UserData = UserData;
+}
+
+RangeAllocatorStats RangeAllocator::GetStats() const
+{
+    RangeAllocatorStats Stats{};
+    Stats.Capacity = Capacity;
+    Stats.UsedBytes = UsedBytes;
+    Stats.FreeBytes = Capacity - UsedBytes;
+    Stats.AllocationCount = AllocationCount;
+    Stats.FreeRangeCount = FreeRangeCount;
+
+    if(FirstLevelBitmap != 0)
+    {
+        //only the highest non empty bin can hold the largest range
+        uint32_t FirstLevel = 63 - std::countl_zero(FirstLevelBitmap);
+        uint32_t SecondLevel = 31 - std::countl_zero(SecondLevelBitmaps[FirstLevel]);
+
+        for(uint32_t Index = BinHeads[FirstLevel][SecondLevel]; Index != RangeAllocation::InvalidNode; Index = Nodes[Index].BinNext)
+        {
+            Stats.LargestFreeRange = std::max(Stats.LargestFreeRange, Nodes[Index].Size);
+        }
+    }
+
+    return Stats;
+}
+
+uint64_t RangeAllocator::PlanDefragmentation(uint64_t MaxBytes, std::vector<RangeMove>& OutMoves, const std::function<bool(uint64_t UserData)>& CanMove)
+{
+    uint64_t PlannedBytes = 0;
+
+    //first fit from the bottom instead of the bins, so the moved ranges pack down instead of landing anywhere below
+    uint32_t LowestFree = HeadNode;
+    auto SkipUsed = [&]()
+    {
+        while(LowestFree != RangeAllocation::InvalidNode && Nodes[LowestFree].bUsed)
+        {
+            LowestFree = Nodes[LowestFree].NeighborNext;
+        }
+    };
+
+    SkipUsed();
+
+    uint32_t Index = TailNode;
+    while(Index != RangeAllocation::InvalidNode && LowestFree != RangeAllocation::InvalidNode && PlannedBytes < MaxBytes)
+    {
+        if(Nodes[Index].Offset <= Nodes[LowestFree].Offset)
+        {
+            break; //everything below is used
+        }
+
+        uint32_t PrevIndex = Nodes[Index].NeighborPrev;
+
+        const Node& Src = Nodes[Index];
+        if(Src.bUsed && !Src.bRelocating && (!CanMove || CanMove(Src.UserData)))
+        {
+            uint32_t DstIndex = LowestFree;
+            while(DstIndex != Index && (Nodes[DstIndex].bUsed
+                || math::PadSize2Alignment(Nodes[DstIndex].Offset, Src.Alignment) + Src.Size > Nodes[DstIndex].Offset + Nodes[DstIndex].Size))
+            {
+                DstIndex = Nodes[DstIndex].NeighborNext;
+            }
+
+            if(DstIndex != Index)
+            {
+                uint64_t Size = Src.Size;
+                uint64_t UserData = Src.UserData;
+                RangeAllocation Dst = AllocateFrom(DstIndex, Size, Src.Alignment, UserData); //may reallocate the node storage
+
+                Nodes[Index].bRelocating = true;
+
+                OutMoves.emplace_back(RangeMove{
+                    .Src = RangeAllocation{.Offset = Nodes[Index].Offset, .Size = Size, .Node = Index},
+                    .Dst = Dst,
+                    .UserData = UserData
+                });
+
+                PlannedBytes += Size;
+
+                //alignment may have left a free lead below the destination
+                if(DstIndex == LowestFree)
+                {
+                    uint32_t LeadIndex = Nodes[DstIndex].NeighborPrev;
+                    bool bFreeLead = LeadIndex != RangeAllocation::InvalidNode && !Nodes[LeadIndex].bUsed;
+                    LowestFree = bFreeLead ? LeadIndex : DstIndex;
+
+                    SkipUsed();
+                }
+
+                PrevIndex = Nodes[Index].NeighborPrev; //the destination may have split the range right below
+            }
+        }
+
+        Index = PrevIndex;
+    }
+
+    return PlannedBytes;
+}
+
+void RangeAllocator::MapSize(uint64_t Size, uint32_t& FirstLevel, uint32_t& SecondLevel)
+{
+    if(Size < SmallRangeSize)
+    {
+        FirstLevel = 0;
+        SecondLevel = static_cast<uint32_t>(Size);
+    }
+    else
+    {
+        uint32_t HighestBit = 63 - std::countl_zero(Size);
+        FirstLevel = HighestBit - SecondLevelBits + 1;
+        SecondLevel = static_cast<uint32_t>(Size >> (HighestBit - SecondLevelBits)) & (SecondLevelCount - 1);
+    }
+}
+
+uint32_t RangeAllocator::GrabNode()
+{
+    uint32_t Index;
+    if(!FreeNodes.empty())
+    {
+        Index = FreeNodes.back();
+        FreeNodes.pop_back();
+        Nodes[Index] = Node{};
+    }
+    else
+    {
+        Index = static_cast<uint32_t>(Nodes.size());
+        Nodes.emplace_back();
+    }
+
+    return Index;
+}
+
+void RangeAllocator::ReleaseNode(uint32_t Index)
+{
+    FreeNodes.emplace_back(Index);
+}
+
+void RangeAllocator::InsertFreeNode(uint32_t Index)
+{
+    uint32_t FirstLevel, SecondLevel;
+    MapSize(Nodes[Index].Size, FirstLevel, SecondLevel);
+
+    uint32_t& Head = BinHeads[FirstLevel][SecondLevel];
+
+    Nodes[Index].BinPrev = RangeAllocation::InvalidNode;
+    Nodes[Index].BinNext = Head;
+
+    if(Head != RangeAllocation::InvalidNode)
+    {
+        Nodes[Head].BinPrev = Index;
+    }
+
+    Head = Index;
+
+    FirstLevelBitmap |= 1ull << FirstLevel;
+    SecondLevelBitmaps[FirstLevel] |= 1u << SecondLevel;
+
+    FreeRangeCount += 1;
+}
+
+void RangeAllocator::RemoveFreeNode(uint32_t Index)
+{
+    uint32_t FirstLevel, SecondLevel;
+    MapSize(Nodes[Index].Size, FirstLevel, SecondLevel);
+
+    Node& Current = Nodes[Index];
+
+    if(Current.BinPrev != RangeAllocation::InvalidNode)
+    {
+        Nodes[Current.BinPrev].BinNext = Current.BinNext;
+    }
+    else
+    {
+        BinHeads[FirstLevel][SecondLevel] = Current.BinNext;
+    }
+
+    if(Current.BinNext != RangeAllocation::InvalidNode)
+    {
+        Nodes[Current.BinNext].BinPrev = Current.BinPrev;
+    }
+
+    Current.BinPrev = RangeAllocation::InvalidNode;
+    Current.BinNext = RangeAllocation::InvalidNode;
+
+    if(BinHeads[FirstLevel][SecondLevel] == RangeAllocation::InvalidNode)
+    {
+        SecondLevelBitmaps[FirstLevel] &= ~(1u << SecondLevel);
+
+        if(SecondLevelBitmaps[FirstLevel] == 0)
+        {
+            FirstLevelBitmap &= ~(1ull << FirstLevel);
+        }
+    }
+
+    FreeRangeCount -= 1;
+}
+
+uint32_t RangeAllocator::FindFreeNode(uint64_t Size) const
+{
+    //round up to the next bin so every range in the bin found is large enough
+    if(Size >= SmallRangeSize)
+    {
+        uint32_t HighestBit = 63 - std::countl_zero(Size);
+        Size += (1ull << (HighestBit - SecondLevelBits)) - 1;
+    }
+
+    uint32_t FirstLevel, SecondLevel;
+    MapSize(Size, FirstLevel, SecondLevel);
+
+    uint32_t SecondLevelMap = SecondLevelBitmaps[FirstLevel] & (~0u << SecondLevel);
+    if(SecondLevelMap == 0)
+    {
+        uint64_t FirstLevelMap = FirstLevel + 1 < 64 ? FirstLevelBitmap & (~0ull << (FirstLevel + 1)) : 0;
+        if(FirstLevelMap == 0)
+        {
+            return RangeAllocation::InvalidNode;
+        }
+
+        FirstLevel = std::countr_zero(FirstLevelMap);
+        SecondLevelMap = SecondLevelBitmaps[FirstLevel];
+    }
+
+    SecondLevel = std::countr_zero(SecondLevelMap);
+    return BinHeads[FirstLevel][SecondLevel];
+}
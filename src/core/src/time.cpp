@@ -1,6 +1,8 @@
 #include "time.hpp"
 #include "assertion.hpp"
 #include "math.hpp"
+#include "cpu_profiler.hpp"
+#include "epoch.hpp"
 #include <cerrno>
 #include <ratio>
 
@@ -55,11 +57,20 @@ void program_time_t::StartFrame()
 {
     WorkStart = timespec_time_now();
     FrameStart = WorkStart;
+
+#if CPU_PROFILER
+    global::Profiler.BeginFrame();
+#endif
 }
 
 void program_time_t::EndFrame()
 {
+#if CPU_PROFILER
+    global::Profiler.EndFrame(FrameCount); //the sleep below is not part of the frame's work
+#endif
+
     FrameCount += 1;
+    global::Epochs.Advance();
 
     WorkEnd = timespec_time_now();
     timespec work_delta = WorkEnd - WorkStart;
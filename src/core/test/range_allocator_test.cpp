@@ -0,0 +1,295 @@
+#include <algorithm>
+#include <cstdint>
+#include <random>
+#include <vector>
+#include "core/assertion.hpp"
+#include "core/log.hpp"
+#include "core/range_allocator.hpp"
+
+//starsight_core_test, aborts on the first failed check
+
+static bool Overlaps(const RangeAllocation& A, const RangeAllocation& B)
+{
+    return A.Offset < B.Offset + B.Size && B.Offset < A.Offset + A.Size;
+}
+
+static void VerifyDisjoint(const std::vector<RangeAllocation>& Allocations, uint64_t Capacity)
+{
+    std::vector<RangeAllocation> Sorted = Allocations;
+    std::ranges::sort(Sorted, {}, &RangeAllocation::Offset);
+
+    for(size_t i = 0; i < Sorted.size(); ++i)
+    {
+        VERIFY(Sorted[i].Offset + Sorted[i].Size <= Capacity, Sorted[i].Offset, Sorted[i].Size, Capacity);
+        if(i + 1 < Sorted.size())
+        {
+            VERIFY(!Overlaps(Sorted[i], Sorted[i + 1]), Sorted[i].Offset, Sorted[i + 1].Offset);
+        }
+    }
+}
+
+//everything freed has to merge back into the one range the allocator started with
+static void VerifyEmpty(const RangeAllocator& Allocator)
+{
+    RangeAllocatorStats Stats = Allocator.GetStats();
+    VERIFY(Stats.UsedBytes == 0, Stats.UsedBytes);
+    VERIFY(Stats.AllocationCount == 0, Stats.AllocationCount);
+    VERIFY(Stats.FreeRangeCount == 1, Stats.FreeRangeCount);
+    VERIFY(Stats.LargestFreeRange == Stats.Capacity, Stats.LargestFreeRange, Stats.Capacity);
+}
+
+static void TestMerge()
+{
+    RangeAllocator Allocator{768};
+
+    RangeAllocation A = Allocator.Allocate(256);
+    RangeAllocation B = Allocator.Allocate(256);
+    RangeAllocation C = Allocator.Allocate(256);
+
+    VERIFY(A.IsValid() && B.IsValid() && C.IsValid());
+    VerifyDisjoint({A, B, C}, 768);
+    VERIFY(Allocator.GetStats().FreeRangeCount == 0);
+
+    //two holes with B between them, then B joins them into one
+    Allocator.Free(A);
+    Allocator.Free(C);
+    VERIFY(Allocator.GetStats().FreeRangeCount == 2);
+    VERIFY(Allocator.GetStats().LargestFreeRange == 256);
+
+    Allocator.Free(B);
+    VerifyEmpty(Allocator);
+}
+
+static void TestRoundTrip()
+{
+    constexpr uint64_t Capacity = 1ull << 20;
+    RangeAllocator Allocator{Capacity};
+
+    std::mt19937_64 Random{1};
+    std::uniform_int_distribution<uint64_t> Size{1, 4096};
+    std::uniform_int_distribution<uint32_t> AlignmentShift{0, 8};
+
+    for(uint32_t round = 0; round < 4; ++round)
+    {
+        std::vector<RangeAllocation> Allocations{};
+        uint64_t UsedBytes = 0;
+
+        for(uint64_t i = 0; i < 128; ++i)
+        {
+            uint64_t Alignment = 1ull << AlignmentShift(Random);
+            RangeAllocation Allocation = Allocator.Allocate(Size(Random), Alignment, i);
+
+            VERIFY(Allocation.IsValid(), i);
+            VERIFY(Allocation.Offset % Alignment == 0, Allocation.Offset, Alignment);
+            VERIFY(Allocator.GetUserData(Allocation) == i);
+
+            UsedBytes += Allocation.Size;
+            Allocations.emplace_back(Allocation);
+        }
+
+        VerifyDisjoint(Allocations, Capacity);
+        VERIFY(Allocator.GetStats().UsedBytes == UsedBytes, Allocator.GetStats().UsedBytes, UsedBytes);
+        VERIFY(Allocator.GetStats().AllocationCount == Allocations.size());
+
+        std::ranges::shuffle(Allocations, Random);
+        for(const RangeAllocation& Allocation : Allocations)
+        {
+            Allocator.Free(Allocation);
+        }
+
+        VerifyEmpty(Allocator);
+    }
+}
+
+static void TestExhaustion()
+{
+    RangeAllocator Allocator{1024};
+
+    VERIFY(!Allocator.Allocate(1025).IsValid());
+
+    std::vector<RangeAllocation> Allocations{};
+    for(uint32_t i = 0; i < 4; ++i)
+    {
+        Allocations.emplace_back(Allocator.Allocate(256));
+        VERIFY(Allocations.back().IsValid(), i);
+    }
+
+    VERIFY(Allocator.GetStats().FreeBytes == 0);
+    VERIFY(!Allocator.Allocate(1).IsValid());
+
+    //a freed range is handed out again
+    uint64_t Offset = Allocations[2].Offset;
+    Allocator.Free(Allocations[2]);
+
+    VERIFY(!Allocator.Allocate(257).IsValid());
+    Allocations[2] = Allocator.Allocate(256);
+    VERIFY(Allocations[2].IsValid() && Allocations[2].Offset == Offset, Allocations[2].Offset, Offset);
+
+    for(const RangeAllocation& Allocation : Allocations)
+    {
+        Allocator.Free(Allocation);
+    }
+
+    VerifyEmpty(Allocator);
+}
+
+static void TestGrowth()
+{
+    RangeAllocator Allocator{1024};
+
+    RangeAllocation Full = Allocator.Allocate(1024);
+    VERIFY(Full.IsValid() && Full.Offset == 0);
+    VERIFY(!Allocator.Allocate(512).IsValid());
+
+    //grown behind a used tail
+    Allocator.Grow(2048);
+    VERIFY(Allocator.GetCapacity() == 2048);
+
+    RangeAllocation Extension = Allocator.Allocate(512);
+    VERIFY(Extension.IsValid() && Extension.Offset == 1024, Extension.Offset);
+    VERIFY(Allocator.GetUserData(Full) == 0);
+
+    //grown behind a free tail, the tail has to be extended instead of getting a neighbor
+    Allocator.Grow(4096);
+    VERIFY(Allocator.GetStats().FreeRangeCount == 1);
+    VERIFY(Allocator.GetStats().LargestFreeRange == 4096 - 1536, Allocator.GetStats().LargestFreeRange);
+
+    Allocator.Free(Full);
+    Allocator.Free(Extension);
+    VerifyEmpty(Allocator);
+    VERIFY(Allocator.GetStats().Capacity == 4096);
+}
+
+static void TestDefragmentation()
+{
+    constexpr uint64_t BlockSize = 256;
+    constexpr uint64_t BlockCount = 64;
+    constexpr uint64_t Capacity = BlockSize * BlockCount;
+
+    RangeAllocator Allocator{Capacity};
+
+    std::vector<RangeAllocation> Blocks{};
+    for(uint64_t i = 0; i < BlockCount; ++i)
+    {
+        Blocks.emplace_back(Allocator.Allocate(BlockSize, 1, i));
+        VERIFY(Blocks.back().IsValid(), i);
+    }
+
+    //every other block freed, the free space is scattered over as many holes as there are blocks left
+    std::vector<RangeAllocation> Live{};
+    for(uint64_t i = 0; i < BlockCount; ++i)
+    {
+        if(i % 2 == 0)
+        {
+            Allocator.Free(Blocks[i]);
+        }
+        else
+        {
+            Live.emplace_back(Blocks[i]);
+        }
+    }
+
+    RangeAllocatorStats Before = Allocator.GetStats();
+    VERIFY(Before.FreeRangeCount == BlockCount / 2, Before.FreeRangeCount);
+    VERIFY(Before.Fragmentation() > 0.9, Before.Fragmentation());
+
+    std::vector<RangeMove> Moves{};
+    uint64_t PlannedBytes = Allocator.PlanDefragmentation(UINT64_MAX, Moves);
+    VERIFY(!Moves.empty());
+
+    uint64_t MovedBytes = 0;
+    std::vector<RangeAllocation> Destinations{};
+    for(const RangeMove& Move : Moves)
+    {
+        VERIFY(Move.Dst.IsValid());
+        VERIFY(Move.Dst.Size == Move.Src.Size, Move.Dst.Size, Move.Src.Size);
+        VERIFY(Move.Dst.Offset < Move.Src.Offset, Move.Dst.Offset, Move.Src.Offset);
+        VERIFY(Allocator.GetUserData(Move.Dst) == Move.UserData);
+        VERIFY(Allocator.GetUserData(Move.Src) == Move.UserData);
+
+        MovedBytes += Move.Src.Size;
+        Destinations.emplace_back(Move.Dst);
+    }
+
+    VERIFY(PlannedBytes == MovedBytes, PlannedBytes, MovedBytes);
+
+    //until the sources are freed, sources and destinations are all allocated at once
+    std::vector<RangeAllocation> Planned = Live;
+    Planned.insert(Planned.end(), Destinations.begin(), Destinations.end());
+    VerifyDisjoint(Planned, Capacity);
+
+    //a second pass leaves ranges that are already being moved alone
+    std::vector<RangeMove> Repeated{};
+    Allocator.PlanDefragmentation(UINT64_MAX, Repeated);
+    for(const RangeMove& Move : Repeated)
+    {
+        VERIFY(std::ranges::none_of(Moves, [&](const RangeMove& Planned){ return Planned.Src.Offset == Move.Src.Offset; }), Move.Src.Offset);
+    }
+
+    for(const RangeMove& Move : Repeated)
+    {
+        Allocator.Free(Move.Dst);
+    }
+
+    for(const RangeMove& Move : Moves)
+    {
+        Allocator.Free(Move.Src);
+        std::ranges::replace_if(Live, [&](const RangeAllocation& Allocation){ return Allocation.Offset == Move.Src.Offset; }, Move.Dst);
+    }
+
+    VerifyDisjoint(Live, Capacity);
+
+    //the live blocks are packed at the bottom with all free space in one range above them
+    RangeAllocatorStats After = Allocator.GetStats();
+    VERIFY(After.UsedBytes == Before.UsedBytes, After.UsedBytes, Before.UsedBytes);
+    VERIFY(After.FreeRangeCount == 1, After.FreeRangeCount);
+    VERIFY(After.Fragmentation() == 0.0, After.Fragmentation());
+
+    for(const RangeAllocation& Allocation : Live)
+    {
+        VERIFY(Allocation.Offset + Allocation.Size <= After.UsedBytes, Allocation.Offset, After.UsedBytes);
+    }
+
+    for(const RangeAllocation& Allocation : Live)
+    {
+        Allocator.Free(Allocation);
+    }
+
+    VerifyEmpty(Allocator);
+}
+
+static void TestPinnedDefragmentation()
+{
+    RangeAllocator Allocator{1024};
+
+    RangeAllocation Low = Allocator.Allocate(256, 1, 0);
+    RangeAllocation Pinned = Allocator.Allocate(256, 1, 1);
+    Allocator.Allocate(256, 1, 2);
+    Allocator.Free(Low);
+
+    //the pinned range stays where it is, the one above it still moves into the hole below both
+    std::vector<RangeMove> Moves{};
+    Allocator.PlanDefragmentation(UINT64_MAX, Moves, [](uint64_t UserData){ return UserData != 1; });
+
+    VERIFY(Moves.size() == 1, Moves.size());
+    VERIFY(Moves[0].UserData == 2 && Moves[0].Dst.Offset == 0, Moves[0].UserData, Moves[0].Dst.Offset);
+    VERIFY(!Overlaps(Moves[0].Dst, Pinned));
+
+    Allocator.Free(Moves[0].Src);
+    Allocator.Free(Moves[0].Dst);
+    Allocator.Free(Pinned);
+    VerifyEmpty(Allocator);
+}
+
+int main()
+{
+    TestMerge();
+    TestRoundTrip();
+    TestExhaustion();
+    TestGrowth();
+    TestDefragmentation();
+    TestPinnedDefragmentation();
+
+    LOG_INFO("range allocator tests passed");
+    return 0;
+}
@@ -1,5 +1,7 @@
 #include <iostream>
 #include <pthread.h>
+#include <optional>
+#include <string_view>
 #include "core/log.hpp"
 #include "core/time.hpp"
 #include "core/filesystem.hpp"
@@ -15,16 +17,54 @@
 #include "world/audio_module.hpp"
 #include "world/input_module.hpp"
 
-int main()
+//starsight --headless <frames> [--dump <frame>]...
+//renders the given number of frames without a window, the dumped frames go to saved/headless
+static std::optional<std::pair<uint64_t, VHeadlessOptions>> ParseHeadless(int argc, char** argv)
+{
+    std::optional<std::pair<uint64_t, VHeadlessOptions>> Result{};
+
+    for(int arg = 1; arg + 1 < argc; arg += 2)
+    {
+        std::string_view Option{argv[arg]};
+        uint64_t Value = std::stoull(argv[arg + 1]);
+
+        if(Option == "--headless")
+        {
+            Result.emplace(Value, VHeadlessOptions{.DumpDirectory = ProjectAbsolutePath("saved/headless")});
+        }
+        else if(Option == "--dump" && Result)
+        {
+            Result->second.DumpFrames.emplace_back(Value);
+        }
+        else
+        {
+            LOG_WARNING("unknown option {}", Option);
+        }
+    }
+
+    return Result;
+}
+
+int main(int argc, char** argv)
 {
     global::MainThreadID = pthread_self();
     pthread_setname_np(pthread_self(), "main");
 
-    GlfwInitialize();
-    global::Window = GlfwCreateWindow("starsight");
-    glfwPollEvents();
+    std::optional<std::pair<uint64_t, VHeadlessOptions>> Headless = ParseHeadless(argc, argv);
+
+    if(Headless)
+    {
+        vkContext = new VStarSightRenderer{Headless->second};
+    }
+    else
+    {
+        GlfwInitialize();
+        global::Window = GlfwCreateWindow("starsight");
+        glfwPollEvents();
+
+        vkContext = new VStarSightRenderer{global::Window};
+    }
 
-    vkContext = new VStarSightRenderer{global::Window};
     alContext = new AContext{};
     std::optional<flecs::world> World = CreateWorld();
 
@@ -61,19 +101,25 @@ int main()
         });
     }
 
-    while(!glfwWindowShouldClose(global::Window))
+    uint64_t Frame = 0;
+    while(Headless ? Frame < Headless->first : !glfwWindowShouldClose(global::Window))
     {
         global::ProgramTime.StartFrame();
         World->progress(global::ProgramTime.FloatDelta);
         global::ProgramTime.EndFrame();
+
+        Frame += 1;
     }
 
     World.reset();
     SafeDelete(alContext)
     SafeDelete(vkContext)
 
-    GlfwCloseWindow(global::Window);
-    GlfwTerminate();
+    if(!Headless)
+    {
+        GlfwCloseWindow(global::Window);
+        GlfwTerminate();
+    }
 
     return 0;
 }
\ No newline at end of file
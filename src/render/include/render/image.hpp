@@ -6,5 +6,6 @@
 #define STBI_ASSERT(x) ASSERT(x)
 #include "stb_image.h"
 #include "stb_image_resize2.h"
+#include "stb_image_write.h"
 
 #endif //STARSIGHT_IMAGE_HPP
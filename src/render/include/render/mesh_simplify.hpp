@@ -0,0 +1,20 @@
+#ifndef STARSIGHT_MESH_SIMPLIFY_HPP
+#define STARSIGHT_MESH_SIMPLIFY_HPP
+
+#include "core/math.hpp"
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#ifndef MESH_SIMPLIFY_BOUNDARY_WEIGHT
+#define MESH_SIMPLIFY_BOUNDARY_WEIGHT 10.0 //keeps open borders in place, relative to the area weight of the faces
+#endif
+
+//quadric error metric edge collapse, https://www.cs.cmu.edu/~garland/Papers/quadrics.pdf
+//vertices that share a position are collapsed together so uv and normal seams do not tear open
+//returns a subset of the original vertices as a new index list with at most TargetIndexCount indices when reachable
+//OutError receives the largest distance in mesh units a collapsed vertex moved away from its surface
+std::vector<uint32_t> SimplifyMesh(std::span<const uint32_t> Indices, std::span<const glm::fvec3> Positions, uint32_t TargetIndexCount, float* OutError = nullptr);
+
+#endif //STARSIGHT_MESH_SIMPLIFY_HPP
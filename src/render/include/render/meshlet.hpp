@@ -0,0 +1,36 @@
+#ifndef STARSIGHT_MESHLET_HPP
+#define STARSIGHT_MESHLET_HPP
+
+#include "core/math.hpp"
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#ifndef MESHLET_MAX_VERTICES
+#define MESHLET_MAX_VERTICES 64
+#endif
+
+#ifndef MESHLET_MAX_TRIANGLES
+#define MESHLET_MAX_TRIANGLES 124
+#endif
+
+//a cluster of triangles that is culled and drawn on its own, stored in the global vertex buffer
+struct VShaderMeshlet
+{
+    glm::fvec4 SphereBounds; //mesh space, w = radius
+    glm::fvec3 ConeAxis; //average facing of the triangles, zero when the cone is too wide to ever cull
+    float ConeCutoff;
+    uint32_t TriangleOffset; //first triangle in the mesh index range
+    uint32_t TriangleCount;
+    uint32_t VertexCount;
+    uint32_t Pad;
+};
+
+static_assert(sizeof(VShaderMeshlet) == 48);
+
+//groups triangles that share vertices into meshlets and reorders Indices in place so each meshlet covers a contiguous index range
+//the index values themselves are left untouched, so the vertex buffers do not change
+std::vector<VShaderMeshlet> BuildMeshlets(std::span<uint32_t> Indices, std::span<const glm::fvec3> Positions, uint32_t MaxVertices = MESHLET_MAX_VERTICES, uint32_t MaxTriangles = MESHLET_MAX_TRIANGLES);
+
+#endif //STARSIGHT_MESHLET_HPP
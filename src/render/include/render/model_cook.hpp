@@ -0,0 +1,119 @@
+#ifndef STARSIGHT_MODEL_COOK_HPP
+#define STARSIGHT_MODEL_COOK_HPP
+
+#include "vk_model.hpp"
+#include "core/filesystem.hpp"
+#include "core/derived_data_cache.hpp"
+
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+#define COOKED_MODEL_MAGIC 0x4C444D53u //"SMDL"
+#define COOKED_MODEL_VERSION 2u
+
+//engine native model, cooked the first time a source model is imported and kept in the derived data cache so later loads never touch assimp
+//a header is followed by fixed size tables, strings and blobs, every offset is in bytes from the start of the cook
+//the cook is only ever read through a mapping, so every struct is trivially copyable and naturally aligned
+
+struct CookedModelHeader
+{
+    uint32_t Magic;
+    uint32_t Version;
+    uint64_t FileSize;
+    uint32_t MaxLods; //geometry settings the cook was made with, they are part of the cache key as well
+    uint32_t MeshletMaxVertices;
+    uint32_t MeshletMaxTriangles;
+    uint32_t NodeCount;
+    uint32_t MeshCount;
+    uint32_t TextureCount;
+    uint32_t RefCount;
+    uint32_t Pad;
+    uint64_t NodeTableOffset;
+    uint64_t MeshTableOffset;
+    uint64_t TextureTableOffset;
+    uint64_t RefTableOffset; //uint32_t indices, nodes list their meshes and meshes their textures through it
+};
+
+//the hierarchy in depth first order, so a parent always comes before its children
+struct CookedNode
+{
+    uint32_t Parent; //UINT32_MAX for the root
+    uint32_t FirstMeshRef;
+    uint32_t MeshRefCount;
+    scene::NodeTransform Transform;
+};
+
+struct CookedMesh
+{
+    uint64_t NameOffset;
+    uint64_t BlobOffset; //index | position | normal uv | meshlet data, exactly as it is staged
+    uint32_t NameSize;
+    uint32_t IndexBufferSize;
+    uint32_t PositionBufferSize;
+    uint32_t NormalUVBufferSize;
+    uint32_t MeshletBufferSize;
+    uint32_t IndexCount; //of the full detail level
+    uint32_t VertexCount;
+    uint32_t MeshletCount;
+    uint32_t LodCount;
+    uint32_t FirstTextureRef;
+    uint32_t TextureRefCount;
+    uint32_t Pad;
+    glm::fvec4 SphereBounds;
+    std::array<VShaderMeshLod, MESH_MAX_LODS> Lods;
+};
+
+struct CookedTexture
+{
+    uint64_t NameOffset; //embedded textures carry their full name, file textures the path relative to the model
+    uint64_t DataOffset;
+    uint64_t DataSize; //0 for textures that are loaded from their own file
+    uint32_t NameSize;
+    uint32_t Type; //aiTextureType
+    uint32_t Width;
+    uint32_t Height; //0 when the data is a compressed image of DataSize bytes
+};
+
+static_assert(std::is_trivially_copyable_v<CookedNode> && std::is_trivially_copyable_v<CookedMesh>);
+
+class VCookedModel
+{
+public:
+    //looks the source up in the derived data cache, returns nullptr when it or one of its dependencies changed since the last cook
+    static std::shared_ptr<const VCookedModel> Find(const std::fpath& SourcePath);
+
+    //wraps a cook that is still in memory
+    static std::shared_ptr<const VCookedModel> FromMemory(std::vector<uint8_t>&& Data);
+
+    VCookedModel() = default;
+    VCookedModel(const VCookedModel&) = delete;
+    VCookedModel& operator=(const VCookedModel&) = delete;
+    ~VCookedModel() = default;
+
+    const CookedModelHeader& Header() const;
+    std::span<const CookedNode> Nodes() const;
+    std::span<const CookedMesh> Meshes() const;
+    std::span<const CookedTexture> Textures() const;
+    std::span<const uint32_t> Refs() const;
+
+    std::string_view String(uint64_t Offset, uint32_t Size) const;
+    const uint8_t* Data(uint64_t Offset) const;
+
+private:
+
+    bool Validate() const;
+
+    std::vector<uint8_t> Storage{};
+    std::shared_ptr<const DerivedData> Mapping{};
+    std::span<const uint8_t> Bytes{};
+};
+
+//imports the source with assimp, builds the levels of detail and meshlets and encodes the vertex streams
+//the result is stored in the derived data cache for the next load and returned so the current load does not have to read it back
+std::vector<uint8_t> CookModel(const std::fpath& SourcePath);
+
+#endif //STARSIGHT_MODEL_COOK_HPP
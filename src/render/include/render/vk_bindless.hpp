@@ -0,0 +1,76 @@
+#ifndef STARSIGHT_VK_BINDLESS_HPP
+#define STARSIGHT_VK_BINDLESS_HPP
+
+#include "vk_utility.hpp"
+#include "concurrentqueue.h"
+#include <vulkan/vulkan.hpp>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+#ifndef BINDLESS_INDEX_BITS
+#define BINDLESS_INDEX_BITS 18 //the rest of a handle is the generation of its slot
+#endif
+
+#define BINDLESS_INDEX_MASK ((1u << BINDLESS_INDEX_BITS) - 1)
+
+//a slot in one of the bindless arrays together with the generation it was handed out at
+//the shaders only ever see the index, the generation catches handles that outlived their slot
+struct VBindlessHandle
+{
+    uint32_t Value = 0; //slot 0 is never handed out, so a zero handle is empty
+
+    uint32_t Index() const { return Value & BINDLESS_INDEX_MASK; }
+    uint32_t Generation() const { return Value >> BINDLESS_INDEX_BITS; }
+
+    explicit operator bool() const { return Value != 0; }
+    friend bool operator==(VBindlessHandle, VBindlessHandle) = default;
+};
+
+//hands out the slots of one binding of the shader resource set
+//grabbing and freeing are lock free, freed slots are recycled once the frames that could still sample them have finished
+class VBindlessTable
+{
+public:
+    vk::DescriptorPoolSize PoolSize{};
+    uint32_t Binding = 0;
+
+    void Reset(vk::DescriptorPoolSize PoolSize_, uint32_t Binding_);
+
+    VBindlessHandle Grab();
+
+    //the handle is stale from here on, the slot itself is only reused FRAMES_IN_FLIGHT frames later
+    void Free(VBindlessHandle Handle);
+
+    bool IsCurrent(VBindlessHandle Handle) const;
+
+    //called once per frame after the fence of the frame slot being reused has passed
+    void BeginFrame();
+
+private:
+
+    static constexpr uint32_t NoSlot = UINT32_MAX;
+
+    void Push(uint32_t Index);
+    uint32_t Pop();
+
+    std::unique_ptr<std::atomic_uint32_t[]> Next{}; //free list links
+    std::unique_ptr<std::atomic_uint32_t[]> Generations{};
+    std::atomic_uint64_t FreeHead{NoSlot}; //slot index in the low half, a counter against aba in the high half
+    std::atomic_uint32_t HighWater{1};
+
+    //frees of frame N wait in bucket N % (FRAMES_IN_FLIGHT + 1) until frame N + FRAMES_IN_FLIGHT begins
+    std::atomic_uint64_t Frame{0};
+    std::array<moodycamel::ConcurrentQueue<uint32_t>, FRAMES_IN_FLIGHT + 1> Retired{};
+};
+
+//descriptor writes into the shader resource set are queued from any thread and applied in one update per frame
+struct VBindlessWrite
+{
+    VBindlessHandle Handle{};
+    vk::DescriptorType Type{};
+    vk::DescriptorImageInfo ImageInfo{};
+};
+
+#endif //STARSIGHT_VK_BINDLESS_HPP
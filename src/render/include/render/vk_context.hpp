@@ -7,7 +7,11 @@
 #include "vk_descriptor.hpp"
 #include "vk_pipeline.hpp"
 #include "vk_shader.hpp"
+#include "vk_upload.hpp"
+#include "vk_bindless.hpp"
 #include "concurrentqueue.h"
+#include "core/range_allocator.hpp"
+#include "fmt/format.h"
 
 #include <vulkan/vulkan.hpp>
 #include <bit>
@@ -21,6 +25,26 @@
 #define UNIFORM_BUFFER_ALIGNMENT 256
 #endif
 
+#ifndef GEOMETRY_BUFFER_INITIAL_SIZE
+#define GEOMETRY_BUFFER_INITIAL_SIZE (16ull * 1024ull * 1024ull)
+#endif
+
+#ifndef GEOMETRY_BUFFER_MAX_SIZE
+#define GEOMETRY_BUFFER_MAX_SIZE uint64_t(UINT32_MAX) //slot offsets are 32 bit
+#endif
+
+#ifndef GEOMETRY_DEFRAG_BYTES_PER_TICK
+#define GEOMETRY_DEFRAG_BYTES_PER_TICK (4ull * 1024ull * 1024ull)
+#endif
+
+#ifndef GEOMETRY_DEFRAG_THRESHOLD
+#define GEOMETRY_DEFRAG_THRESHOLD 0.25
+#endif
+
+#ifndef ASYNC_COMPUTE
+#define ASYNC_COMPUTE 1 //early culling runs on a compute queue of its own family when the device has one
+#endif
+
 struct VPhysicalDeviceFeatures
 {
     VPhysicalDeviceFeatures()
@@ -53,18 +77,20 @@ struct VQueueHandles
     vk::Queue Compute = nullptr;
 };
 
-struct DescriptorSetFreeList
+//a live range in one of the global geometry buffers that is being copied to a lower offset
+struct VGeometryRelocation
 {
-    std::list<uint32_t> FreeList{};
-    std::mutex ListMX{};
-    vk::DescriptorPoolSize PoolSize{};
-    uint32_t LastSlot = 0;
+    const VAllocatedBuffer* Buffer = nullptr; //GlobalIndexBuffer or GlobalVertexBuffer
+    BufferAllocationSlot Src{};
+    BufferAllocationSlot Dst{};
+    uint64_t Owner = 0;
 };
 
 class VContext
 {
 public:
     std::vector<std::function<void()>> DestructionQueue{};
+    std::mutex DestructionMx{}; //only needed while the pipelines are built in parallel
     moodycamel::ConcurrentQueue<std::function<void()>> DeferredDestructionQueue{};
 
     std::vector<const char*> ValidationLayers{};
@@ -82,25 +108,37 @@ public:
     vma::Allocator Allocator = nullptr;
     vk::DescriptorPool ShaderResourcePool = nullptr;
     vk::DescriptorSetLayout ShaderResourceLayout = nullptr;
+    static constexpr vk::ShaderStageFlags ShaderResourceStages = vk::ShaderStageFlagBits::eFragment | vk::ShaderStageFlagBits::eCompute; //material.comp samples the same textures as the raster
     vk::DescriptorSet ShaderResourceSet = nullptr;
-    std::array<DescriptorSetFreeList, 1> DescriptorSetFreeLists{};
+    std::array<VBindlessTable, 1> BindlessTables{};
+    moodycamel::ConcurrentQueue<VBindlessWrite> PendingBindlessWrites{};
     vk::CommandPool GraphicsCommandPool = nullptr;
-    vk::CommandPool TransferCommandPool = nullptr;
-    std::mutex TransferMutex{};
+    vk::CommandPool ComputeCommandPool = nullptr; //only with async compute
+    bool bAsyncCompute = false;
+    std::vector<uint32_t> SharedQueueFamilies{}; //buffers are shared concurrently between these, empty when everything runs on one family
     vk::DescriptorPool TransientDescriptorPool = nullptr;
 
     VAllocatedBuffer GlobalIndexBuffer{};
-    std::vector<BufferAllocationSlot> IndexBufferAllocationList{};
+    std::optional<RangeAllocator> IndexBufferAllocator;
     std::mutex IndexBufferMx{};
 
     VAllocatedBuffer GlobalVertexBuffer{};
-    std::vector<BufferAllocationSlot> VertexBufferAllocationList{};
+    std::optional<RangeAllocator> VertexBufferAllocator;
     std::mutex VertexBufferMx{};
 
+    std::vector<VGeometryRelocation> PendingGeometryCopies{};
+    std::mutex GeometryCopyMx{};
+
+    //dense ids of the loaded meshes, the gpu buckets instances of the same mesh by them
+    std::vector<uint32_t> FreeMeshIndices{};
+    uint32_t MeshIndexCount = 0;
+    std::mutex MeshIndexMx{};
+
     std::optional<VDescriptorAllocator> DescriptorAllocator;
     std::optional<VDescriptorLayoutCache> DescriptorLayoutCache;
     std::optional<VPipelineLayoutCache> PipelineLayoutCache;
     std::optional<VShaderCache> ShaderModuleCache;
+    std::optional<VUploadManager> Uploader;
     std::optional<VModelManager> ModelManager;
 
     const class CameraComponent* Camera = nullptr;
@@ -118,12 +156,25 @@ public:
     VContext(const BaseInitializer& Initializer);
     virtual ~VContext();
 
-    void NameObject(uint64_t Handle, vk::ObjectType Type, const std::string& Name);
+    void NameObject(uint64_t Handle, vk::ObjectType Type, const char* Name);
 
     template<typename T>
-    void NameObject(T Object, std::string Name)
+    void NameObject(T Object, const std::string& Name)
     {
-        NameObject(std::bit_cast<uint64_t>(Object), T::objectType, std::move(Name));
+        NameObject(std::bit_cast<uint64_t>(Object), T::objectType, Name.c_str());
+    }
+
+    //formats into a buffer on the stack, and only in builds that keep the names at all
+    template<typename T, typename First, typename... Rest>
+    void NameObject(T Object, fmt::format_string<First, Rest...> Format, First&& Argument, Rest&&... Arguments)
+    {
+#ifndef NDEBUG
+        fmt::memory_buffer Name{};
+        fmt::format_to(std::back_inserter(Name), Format, std::forward<First>(Argument), std::forward<Rest>(Arguments)...);
+        Name.push_back('\0');
+
+        NameObject(std::bit_cast<uint64_t>(Object), T::objectType, Name.data());
+#endif
     }
 
     uint64_t PadUniformSize(uint64_t Size) const;
@@ -132,10 +183,6 @@ public:
     vk::Format PickImageFormat(vk::FormatFeatureFlags feature_flags, std::span<vk::Format> candidates) const;
     vk::Format PickBufferFormat(vk::FormatFeatureFlags feature_flags, std::span<vk::Format> candidates) const;
 
-    vk::CommandBuffer RequestTransferCommandBuffer(std::string Description = "");
-    void SubmitTransferCommands(vk::CommandBuffer Commands, vk::SubmitInfo2 Submits);
-    void FreeTransferCommandBuffer(vk::CommandBuffer Commands);
-
     VGraphicsPipelineBuilder MakeGraphicsPipelineBuilder();
     VComputePipelineBuilder MakeComputePipelineBuilder();
     VDescriptorBuilder MakeDescriptorBuilder();
@@ -144,16 +191,36 @@ public:
     void ReallocateBuffer(VAllocatedBuffer* Buffer, uint64_t NewSize);
     void FreeBuffer(VAllocatedBuffer* Buffer);
 
-    DescriptorSetFreeList* FindFreeList(vk::DescriptorType Type);
-    uint32_t GrabDescriptorSlot(vk::DescriptorType Type);
-    void FreeDescriptorSlot(vk::DescriptorType Type, uint32_t Slot);
+    VBindlessTable* FindBindlessTable(vk::DescriptorType Type);
+    VBindlessHandle GrabDescriptorSlot(vk::DescriptorType Type);
+    void FreeDescriptorSlot(vk::DescriptorType Type, VBindlessHandle Handle);
+    void WriteDescriptorSlot(vk::DescriptorType Type, VBindlessHandle Handle, const vk::DescriptorImageInfo& ImageInfo);
 
-    BufferAllocationSlot GrabIndexBufferMemory(uint32_t Size, uint32_t Alignment);
+    //recycles the slots freed FRAMES_IN_FLIGHT frames ago and applies the queued writes, call after waiting on the frame fence
+    void BeginBindlessFrame();
+
+    //owner is handed back in relocations, slots with no owner are never moved by defragmentation
+    BufferAllocationSlot GrabIndexBufferMemory(uint32_t Size, uint32_t Alignment, uint64_t Owner = 0);
     void FreeIndexBufferMemory(BufferAllocationSlot Slot);
 
-    BufferAllocationSlot GrabVertexBufferMemory(uint32_t Size, uint32_t Alignment);
+    BufferAllocationSlot GrabVertexBufferMemory(uint32_t Size, uint32_t Alignment, uint64_t Owner = 0);
     void FreeVertexBufferMemory(BufferAllocationSlot Slot);
 
+    uint32_t GrabMeshIndex();
+    void FreeMeshIndex(uint32_t MeshIndex);
+    uint32_t GetMeshIndexCount();
+
+    RangeAllocatorStats GetIndexBufferStats();
+    RangeAllocatorStats GetVertexBufferStats();
+
+    //allocates lower destinations for up to MaxBytes of geometry in each buffer, the copies are recorded by RecordGeometryCopies
+    std::vector<VGeometryRelocation> DefragmentGeometryBuffers(uint64_t MaxBytes, const std::function<bool(uint64_t Owner)>& CanMove);
+    //ReadStages are the stages of the recording queue that read the geometry afterwards
+    void RecordGeometryCopies(vk::CommandBuffer CommandBuffer, vk::PipelineStageFlags2 ReadStages);
+
+    //replaces the global geometry buffers with larger ones once their allocators have outgrown them, main thread only
+    bool GrowGeometryBuffers(vk::CommandBuffer TransferCommandBuffer);
+
 private:
 
     void CreateInstance();
@@ -62,6 +62,7 @@ public:
 
     VContext* Context = nullptr;
     std::unordered_map<layout_info_t, vk::DescriptorSetLayout, layout_info_hasher> layouts{};
+    std::mutex layouts_mx{};
 };
 
 // When you make the VkDescriptorSetLayoutBinding for your variable length array, the `descriptorCount` member is the maximum number of descriptors in that array.
@@ -0,0 +1,91 @@
+#ifndef STARSIGHT_VK_GPU_PROFILER_HPP
+#define STARSIGHT_VK_GPU_PROFILER_HPP
+
+#include "core/filesystem.hpp"
+#include <vulkan/vulkan.hpp>
+#include <array>
+#include <cstdint>
+#include <fstream>
+#include <initializer_list>
+#include <span>
+#include <string_view>
+#include <vector>
+
+#ifndef GPU_PROFILER_MAX_SCOPES
+#define GPU_PROFILER_MAX_SCOPES 32 //per frame, a pass entered several times takes one scope each time
+#endif
+
+#ifndef GPU_PROFILER_LOG_INTERVAL
+#define GPU_PROFILER_LOG_INTERVAL 600 //frames averaged into each log line, 0 turns the log off
+#endif
+
+#ifndef GPU_PROFILER_CSV
+#define GPU_PROFILER_CSV "" //relative to the project, every collected frame is appended when set
+#endif
+
+class VContext;
+
+//the query pools of one frame in flight, read back once its fence has passed so nothing ever waits on them
+struct VGpuFrameQueries
+{
+    vk::QueryPool Timestamps = nullptr; //null when the queue family has no timestamps
+    vk::QueryPool Statistics = nullptr; //null when the device has no pipeline statistics or the queue family no graphics
+    uint64_t TimestampMask = UINT64_MAX;
+    std::array<std::string_view, GPU_PROFILER_MAX_SCOPES> Scopes{};
+    uint32_t ScopeCount = 0;
+    bool bScopeOpen = false;
+};
+
+struct VGpuPassTiming
+{
+    std::string_view Name{};
+    double Milliseconds = 0.0;
+    uint64_t InputAssemblyVertices = 0;
+    uint64_t InputAssemblyPrimitives = 0;
+    uint64_t VertexShaderInvocations = 0;
+    uint64_t ClippingPrimitives = 0;
+    uint64_t FragmentShaderInvocations = 0;
+    uint64_t ComputeShaderInvocations = 0;
+};
+
+class VGpuProfiler
+{
+public:
+    void Init(VContext* Context_);
+
+    //the queries may only be used on queues of QueueFamily
+    void CreateQueries(VGpuFrameQueries& Queries, std::string_view DebugName, uint32_t QueueFamily);
+    void DestroyQueries(VGpuFrameQueries& Queries);
+
+    //reads what the frame recorded the last time it was used, call after waiting on its fence
+    //a frame recorded on several queues passes the queries of each, their scopes make up one frame
+    void Collect(std::initializer_list<VGpuFrameQueries*> FrameQueries);
+
+    //at the start of the command buffer, outside of any rendering
+    void Reset(vk::CommandBuffer CommandBuffer, VGpuFrameQueries& Queries);
+
+    //scopes do not nest and must not cross a begin or end of rendering, scopes with the same name are summed
+    void BeginScope(vk::CommandBuffer CommandBuffer, VGpuFrameQueries& Queries, std::string_view Name);
+    void EndScope(vk::CommandBuffer CommandBuffer, VGpuFrameQueries& Queries);
+
+    //of the latest collected frame, in the order the passes were first entered
+    std::span<const VGpuPassTiming> GetPassTimings() const { return Latest; }
+
+    void SetCsvOutput(const std::fpath& Path);
+
+private:
+
+    void WriteSinks();
+
+    VContext* Context = nullptr;
+    double NanosecondsPerTick = 1.0;
+    bool bStatistics = false;
+
+    uint64_t CollectedFrames = 0;
+    std::vector<VGpuPassTiming> Latest{};
+    std::vector<VGpuPassTiming> Accumulated{}; //summed since the last log line
+    uint64_t AccumulatedFrames = 0;
+    std::ofstream Csv{};
+};
+
+#endif //STARSIGHT_VK_GPU_PROFILER_HPP
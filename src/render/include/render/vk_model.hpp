@@ -3,30 +3,43 @@
 
 #include "vk_memory_allocator.hpp"
 #include "vk_utility.hpp"
+#include "vk_bindless.hpp"
 #include "core/ssovector.hpp"
 #include "core/math.hpp"
 #include "core/filesystem.hpp"
 #include "core/resource.hpp"
+#include "core/asset_registry.hpp"
 #include "assimp/material.h"
-#include "taskflow/taskflow.hpp"
-#include "tbb/concurrent_unordered_map.h"
+#include "core/job_scheduler.hpp"
+#include "core/epoch.hpp"
 
+#include <array>
+#include <span>
 #include <vector>
 #include <unordered_map>
 #include <memory>
 #include <functional>
+#include <mutex>
 
 class VContext;
+class VCookedModel;
+struct VGeometryRelocation;
 
-namespace Assimp
-{
-    class Importer;
-}
+#ifndef TEXTURE_DDC_VERSION
+#define TEXTURE_DDC_VERSION 1 //bump when the mip generation changes
+#endif
+
+#ifndef MESH_MAX_LODS
+#define MESH_MAX_LODS 4
+#endif
 
-class aiScene;
-class aiMesh;
-struct aiTexture;
-struct aiNode;
+#ifndef MESH_LOD_MIN_TRIANGLES
+#define MESH_LOD_MIN_TRIANGLES 256 //meshes this small are not simplified any further
+#endif
+
+#ifndef MESH_LOD_MIN_REDUCTION
+#define MESH_LOD_MIN_REDUCTION 0.8f //a level has to drop at least this fraction of the previous triangles to be kept
+#endif
 
 struct NormalUV
 {
@@ -34,27 +47,27 @@ struct NormalUV
     uint32_t UV;
 };
 
-struct VStagingData
+//one level of detail, every level is a separate index range with its own meshlets inside the mesh slots
+struct VShaderMeshLod
 {
-    vk::Buffer StagingBuffer = nullptr;
-    vma::Allocation Allocation = nullptr;
-    vk::CommandBuffer CommandBuffer = nullptr;
+    uint32_t indexOffset; //indices from the start of the mesh index slot
+    uint32_t indexCount;
+    uint32_t meshletOffset; //meshlets from the start of the mesh meshlet slot
+    uint32_t meshletCount;
+    float error; //mesh space distance the simplified surface may be off by
 };
 
 struct VTransferData
 {
-    std::atomic<vk::Semaphore> TransferFinish;
-    std::optional<VStagingData> Staging;
+    std::atomic_uint64_t TransferTicket; //upload timeline value, 0 until the upload has been committed
 
     VTransferData()
-        : TransferFinish(nullptr)
-        , Staging()
+        : TransferTicket(0)
     {
     }
 
     VTransferData(const VTransferData& Other)
-        : TransferFinish(Other.TransferFinish.load(std::memory_order_relaxed))
-        , Staging(Other.Staging)
+        : TransferTicket(Other.TransferTicket.load(std::memory_order_relaxed))
     {
     }
 
@@ -70,6 +83,11 @@ struct VMesh : public VTransferData, public SharedAsset
     BufferAllocationSlot IndexSlot{};
     BufferAllocationSlot PositionSlot{};
     BufferAllocationSlot NormalUVSlot{};
+    uint32_t MeshletCount = 0; //largest meshlet count of any level
+    BufferAllocationSlot MeshletSlot{};
+    uint32_t LodCount = 0;
+    std::array<VShaderMeshLod, MESH_MAX_LODS> Lods{};
+    uint32_t MeshIndex = UINT32_MAX; //shared by every instance of the mesh
 };
 
 struct VTexture : public VTransferData, public SharedAsset
@@ -77,7 +95,7 @@ struct VTexture : public VTransferData, public SharedAsset
     vk::Extent2D Extent{};
     uint64_t MipMaps = 0;
     aiTextureType Type{};
-    uint32_t DescriptorSlot = 0;
+    VBindlessHandle DescriptorHandle{};
     vk::Image Image = nullptr;
     vk::ImageView ImageView = nullptr;
     vma::Allocation Allocation = nullptr;
@@ -95,13 +113,13 @@ namespace scene
 
     struct TextureData
     {
-        std::string Name;
+        AssetId Texture; //into VModelManager::Textures
         aiTextureType Type;
     };
 
     struct MeshData
     {
-        std::string MeshName;
+        AssetId Mesh; //into VModelManager::Meshes
         std::vector<TextureData> Textures;
     };
 
@@ -123,7 +141,8 @@ namespace scene
 class VModel : public SharedAsset
 {
 public:
-    static VModel* LoadAsset(const std::fpath& Path);
+    static VModel* LoadAsset(AssetId Id);
+    static void RetireAsset(AssetId Id);
 
 public:
 
@@ -158,33 +177,60 @@ public:
 class VModelManager
 {
 public:
-    tbb::concurrent_unordered_map<std::string, VTexture> Textures;
-    tbb::concurrent_unordered_map<std::string, VMesh> Meshes;
-    tbb::concurrent_unordered_map<std::fpath, VModel> Models;
+    //file textures by path, embedded textures and meshes by their name in the model
+    TAssetTable<VTexture> Textures;
+    TAssetTable<VMesh> Meshes;
+    TAssetTable<VModel> Models;
 
     vk::Sampler TextureSampler = nullptr;
 
-    tf::Executor TaskExecutor;
+    JobGroup LoadJobs{JobPriority::Streaming}; //models, meshes and textures
     VContext* Context;
+
+private:
+    std::mutex ReferenceMx{}; //held while references on the assets are taken, and while retired assets are checked and freed
+    RetireList Retired{true};
+
 public:
 
     VModelManager(VContext* Context_);
     ~VModelManager();
 
-    VModel* LoadModel(const std::fpath& Path);
-    void GarbageCollect(bool InDestruction = false);
+    //the model with a reference taken for the caller
+    VModel* LoadModel(AssetId Id);
+    //queues the model to be freed once nothing references it and the frames that could still draw it are done
+    void RetireModel(AssetId Id);
+    //frees the retired assets that are safe to free, every frame
+    void Reclaim();
+
+    //moves loaded meshes towards the start of the geometry buffers once they get fragmented enough
+    std::vector<VGeometryRelocation> DefragmentGeometry(uint64_t MaxBytes);
 
 private:
 
+    //emplaces the asset and takes a reference on it, so a retired asset can not be freed in between
+    template<typename T, typename KeyT>
+    typename TAssetTable<T>::EmplaceResult EmplaceReference(TAssetTable<T>& Table, KeyT Key);
+
+    //the epoch stays pinned while the job runs
+    template<typename F>
+    void SubmitLoad(F&& Job);
+
+    //ReferenceMx has to be held
+    void RetireMesh(AssetId Id, VMesh& Mesh);
+    void RetireTexture(AssetId Id, VTexture& Texture);
+
+    //loads the cooked model, cooking it from the source first when there is no up to date cook
     void LoadModel_Impl(TAssetPtr<VModel> Asset);
-    void RecurseNodes(std::unique_ptr<scene::SceneNode>& SceneNode, scene::SceneNode* ParentNode, aiNode* ImportNode, std::shared_ptr<Assimp::Importer> Importer, TAssetPtr<VModel> Asset);
-    void ProcessMeshNode(scene::MeshNode* MeshNode, aiMesh* ImportMesh, uint64_t MeshIndex, std::shared_ptr<Assimp::Importer> Importer, TAssetPtr<VModel> Asset);
+    void ProcessMeshNode(scene::MeshNode* MeshNode, std::shared_ptr<const VCookedModel> Cooked, uint32_t MeshIndex, TAssetPtr<VModel> Asset);
 
-    void LoadMesh(VMesh* OutMesh, aiMesh* ImportMesh, std::shared_ptr<Assimp::Importer> Importer, TAssetPtr<VModel> Asset, std::string_view MeshName);
+    void LoadMesh(VMesh* OutMesh, std::shared_ptr<const VCookedModel> Cooked, uint32_t MeshIndex, AssetId Id);
 
-    void LoadFileTexture(VTexture* OutTexture, std::fpath Path, std::shared_ptr<Assimp::Importer> Importer, TAssetPtr<VModel> Asset);
-    void LoadEmbeddedTexture(VTexture* OutTexture, const aiTexture* EmbeddedTexture, std::shared_ptr<Assimp::Importer> Importer, TAssetPtr<VModel> Asset);
-    void LoadTexture(uint8_t* Pixels, uint64_t Width, uint64_t Height, VTexture* OutTexture, std::string Name);
+    void LoadFileTexture(VTexture* OutTexture, AssetId Id);
+    void LoadEmbeddedTexture(VTexture* OutTexture, std::shared_ptr<const VCookedModel> Cooked, uint32_t TextureIndex, AssetId Id);
+    //decodes and mip maps the source unless the derived data cache has the chain already, RawHeight is 0 for encoded images
+    void LoadDerivedTexture(VTexture* OutTexture, std::span<const uint8_t> Source, uint32_t RawWidth, uint32_t RawHeight, std::string Name);
+    void LoadTexture(const uint8_t* MipChain, uint64_t Width, uint64_t Height, VTexture* OutTexture, std::string Name);
 };
 
 #endif //STARSIGHT_VK_MODEL_HPP
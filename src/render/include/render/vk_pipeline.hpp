@@ -6,6 +6,7 @@
 #include <vulkan/vulkan.hpp>
 #include <unordered_map>
 #include <future>
+#include <mutex>
 
 class VContext;
 struct VShader;
@@ -51,6 +52,7 @@ private:
     std::shared_future<vk::PipelineCache> PipelineCache{};
 
     std::unordered_map<layout_info_t, vk::PipelineLayout, layout_info_hasher> layouts{};
+    std::mutex layouts_mx{};
 };
 
 struct PipelineBuilder
@@ -59,7 +61,7 @@ protected:
     struct VDeferredShader
     {
         vk::SpecializationInfo* Specialization;
-        std::future<VShader*> Shader;
+        std::shared_future<VShader*> Shader;
     };
 
     ssovector<VDeferredShader, 5> Shaders{};
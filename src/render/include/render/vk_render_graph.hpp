@@ -0,0 +1,148 @@
+#ifndef STARSIGHT_VK_RENDER_GRAPH_HPP
+#define STARSIGHT_VK_RENDER_GRAPH_HPP
+
+#include "vk_memory_allocator.hpp"
+#include <vulkan/vulkan.hpp>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+class VContext;
+class VGpuProfiler;
+struct VGpuFrameQueries;
+
+struct VRenderGraphImage
+{
+    uint32_t Index = UINT32_MAX;
+
+    explicit operator bool() const { return Index != UINT32_MAX; }
+};
+
+//one use of an image by a pass, write access makes it a write, read access on top of that also keeps the previous contents
+struct VImageUse
+{
+    vk::PipelineStageFlags2 Stages{};
+    vk::AccessFlags2 Access{};
+    vk::ImageLayout Layout = vk::ImageLayout::eUndefined;
+};
+
+class VRenderGraphPass
+{
+public:
+    VRenderGraphPass& Use(VRenderGraphImage Image, const VImageUse& ImageUse);
+
+    //kept even when nothing in the graph reads what it writes, for passes that only write buffers
+    VRenderGraphPass& SetSideEffects();
+
+private:
+    friend class VRenderGraph;
+
+    struct ImageAccess
+    {
+        uint32_t Image;
+        VImageUse Use;
+    };
+
+    std::string_view Name{};
+    uint32_t Segment = 0;
+    bool bSideEffects = false;
+    bool bCulled = false;
+    std::vector<ImageAccess> Accesses{};
+    std::function<void(vk::CommandBuffer)> Record{};
+
+    std::vector<vk::ImageMemoryBarrier2> Barriers{}; //images are filled in at execution, imported ones change every frame
+    std::vector<uint32_t> BarrierImages{};
+};
+
+//the passes of a frame in order, declared once and executed every frame
+//compiling culls passes nothing depends on, works out one batch of barriers in front of each pass
+//and places the transient images with disjoint lifetimes on the same memory
+//segments are recorded into separate command buffers on the same queue
+class VRenderGraph
+{
+public:
+    void Init(VContext* Context_, VGpuProfiler* Profiler_);
+
+    //contents are discarded at its first use, Initial is where the frame finds it, the end of the previous frame when not given
+    VRenderGraphImage ImportImage(std::string Name, vk::ImageAspectFlags Aspect, std::optional<VImageUse> Initial = {});
+
+    //created and bound by Compile, ViewUsage restricts the default view of an image with extended usage
+    VRenderGraphImage CreateImage(std::string Name, const vk::ImageCreateInfo& CreateInfo, vk::ImageAspectFlags Aspect, vk::ImageUsageFlags ViewUsage = {});
+
+    //the image is left in Final after its last use and the passes writing it are never culled
+    void ExportImage(VRenderGraphImage Image, const VImageUse& Final);
+
+    //the name is also the profiler scope, which outlives the graph, so it has to be a literal
+    VRenderGraphPass& AddPass(std::string_view Name, uint32_t Segment, std::function<void(vk::CommandBuffer)> Record);
+
+    void Compile();
+
+    //records the barriers and passes of one segment, each pass in a profiler scope of its name when Queries is given
+    void Execute(uint32_t Segment, vk::CommandBuffer CommandBuffer, VGpuFrameQueries* Queries = nullptr);
+
+    void SetImage(VRenderGraphImage Image, vk::Image Handle);
+    vk::Image GetImage(VRenderGraphImage Image) const;
+    vk::ImageView GetImageView(VRenderGraphImage Image) const;
+
+    //bytes of the transient memory and what they would take unaliased
+    vk::DeviceSize GetTransientBytes() const { return TransientBytes; }
+    vk::DeviceSize GetUnaliasedBytes() const { return UnaliasedBytes; }
+
+    //destroys the transient images right away, the frames using them must have finished
+    void Reset();
+
+private:
+
+    struct ImageEntry
+    {
+        std::string Name{};
+        vk::ImageAspectFlags Aspect{};
+        bool bTransient = false;
+        std::optional<VImageUse> Initial{};
+        std::optional<VImageUse> Final{};
+
+        vk::ImageCreateInfo CreateInfo{};
+        vk::ImageUsageFlags ViewUsage{};
+        vk::Image Image = nullptr;
+        vk::ImageView ImageView = nullptr;
+
+        uint32_t FirstPass = UINT32_MAX;
+        uint32_t LastPass = 0;
+        uint32_t Block = UINT32_MAX;
+        vk::DeviceSize Offset = 0;
+        vk::MemoryRequirements Requirements{};
+    };
+
+    //transient images are placed in blocks by compatible memory types
+    struct MemoryBlock
+    {
+        uint32_t MemoryTypeBits = 0;
+        vk::DeviceSize Size = 0;
+        vk::DeviceSize Alignment = 1;
+        vma::Allocation Allocation = nullptr;
+    };
+
+    void CullPasses();
+    void PlaceTransientImages();
+    void BuildBarriers();
+    bool SharesMemory(const ImageEntry& A, const ImageEntry& B) const;
+
+    VContext* Context = nullptr;
+    VGpuProfiler* Profiler = nullptr;
+
+    std::vector<ImageEntry> Images{};
+    std::vector<VRenderGraphPass> Passes{};
+    std::vector<MemoryBlock> Blocks{};
+    std::vector<std::vector<vk::ImageMemoryBarrier2>> FinalBarriers{}; //per segment, after its last pass
+    std::vector<std::vector<uint32_t>> FinalBarrierImages{};
+    std::vector<vk::ImageMemoryBarrier2> ScratchBarriers{};
+
+    vk::DeviceSize TransientBytes = 0;
+    vk::DeviceSize UnaliasedBytes = 0;
+    bool bCompiled = false;
+};
+
+#endif //STARSIGHT_VK_RENDER_GRAPH_HPP
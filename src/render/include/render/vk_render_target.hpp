@@ -2,23 +2,66 @@
 #define STARSIGHT_VK_RENDER_TARGET_HPP
 
 #include "core/math.hpp"
+#include "core/filesystem.hpp"
+#include "core/linear_arena.hpp"
 #include "vk_utility.hpp"
 #include "concurrentqueue.h"
 #include "vk_context.hpp"
+#include "vk_gpu_profiler.hpp"
+#include "vk_render_graph.hpp"
 #include <vulkan/vulkan.hpp>
 #include <span>
 #include <functional>
-
-#ifndef FRAMES_IN_FLIGHT
-#define FRAMES_IN_FLIGHT 2
-#endif
+#include <mutex>
+#include <vector>
 
 #ifndef DEVICE_MESH_ALLOCATION_STEP
 #define DEVICE_MESH_ALLOCATION_STEP 1024
 #endif
 
+#ifndef MESH_LOD_PIXEL_ERROR
+#define MESH_LOD_PIXEL_ERROR 1.f //how far on screen a lower level of detail may deviate from the full mesh
+#endif
+
+#ifndef INSTANCING_MAX_MESHLETS
+#define INSTANCING_MAX_MESHLETS 4 //levels with at most this many meshlets skip meshlet culling and are drawn instanced, 0 disables
+#endif
+
+#ifndef MESHLET_TASK_SIZE
+#define MESHLET_TASK_SIZE 64 //meshlets culled by one workgroup of build_draw_commands.comp
+#endif
+
+#ifndef CLUSTER_GRID_X
+#define CLUSTER_GRID_X 16 //screen tiles of the light cluster grid
+#endif
+
+#ifndef CLUSTER_GRID_Y
+#define CLUSTER_GRID_Y 9
+#endif
+
+#ifndef CLUSTER_GRID_Z
+#define CLUSTER_GRID_Z 24 //depth slices, exponentially spaced between the near and far plane
+#endif
+
+#ifndef CLUSTER_MAX_LIGHTS
+#define CLUSTER_MAX_LIGHTS 128 //lights past this in one cluster are dropped
+#endif
+
+#ifndef VISIBILITY_BUFFER
+#define VISIBILITY_BUFFER 1 //the geometry pass writes only slot and triangle ids, material.comp shades every pixel once
+#endif
+
 struct GLFWwindow;
 
+//renders into offscreen images instead of a swapchain, for machines without a display, software vulkan included
+struct VHeadlessOptions
+{
+    uint32_t Width = 1920;
+    uint32_t Height = 1080;
+    std::vector<uint64_t> DumpFrames{}; //frames written to DumpDirectory as png, counted from 0
+    std::fpath DumpDirectory{};
+};
+
 struct VShaderTransform
 {
     glm::fvec3 Translation;
@@ -35,16 +78,117 @@ struct VShaderMeshInfo
     uint32_t positionBufferOffset;
     uint32_t normalUVBufferOffset;
     uint32_t baseColorIndex;
+    uint32_t meshletBufferOffset;
+    uint32_t meshletCount; //largest meshlet count of any level, bounds the draws of the slot
+    uint32_t meshIndex;
+    uint32_t lodCount;
+    std::array<VShaderMeshLod, MESH_MAX_LODS> lods;
+};
+
+//one sparse write into the persistent scene buffers, applied on the gpu by scene_scatter.comp
+struct VShaderSceneUpdate
+{
+    VShaderTransform Transform;
+    VShaderMeshInfo MeshInfo;
+    glm::fvec4 Bounds;
+    uint32_t Slot;
+};
+
+struct VShaderSceneScatterPC
+{
+    vk::DeviceAddress pUpdates;
+    vk::DeviceAddress pMeshBounds;
+    vk::DeviceAddress pMeshes;
+    vk::DeviceAddress pTransforms;
+    uint32_t updateCount;
+};
+
+//a group of MESHLET_TASK_SIZE meshlets of one visible mesh, written by cull_meshes.comp
+struct VShaderMeshletTask
+{
+    uint32_t Slot;
+    uint32_t MeshletOffset;
+};
+
+struct VShaderMeshletTasksHeader
+{
+    vk::DispatchIndirectCommand Dispatch;
+    uint32_t TaskCount;
+    uint32_t VisibleMeshes;
+};
+
+//all visible instances of one mesh level, the instanced draw covers [offset, offset + count) of the instance slots
+struct VShaderInstanceBucket
+{
+    uint32_t Count;
+    uint32_t Offset;
+    uint32_t Slot;
+};
+
+struct VShaderInstanceEntry
+{
+    uint32_t Bucket;
+    uint32_t Index;
+};
+
+struct VShaderCullMeshesPC
+{
+    vk::DeviceAddress pCamera;
+    vk::DeviceAddress pTasks;
+    vk::DeviceAddress pMeshBounds;
+    vk::DeviceAddress pMeshes;
+    vk::DeviceAddress pTransforms;
+    vk::DeviceAddress pVisibility;
+    vk::DeviceAddress pBuckets;
+    vk::DeviceAddress pInstanceEntries;
+    glm::fvec2 pyramidSize;
+    uint32_t meshCount;
+    uint32_t maxTaskCount;
+    uint32_t occlusionCulling;
+    uint32_t latePass;
+    float lodErrorScale;
+    uint32_t bucketCount;
+    uint32_t maxInstancedMeshlets;
 };
 
 struct VShaderBuildDrawCommandsPC
 {
     vk::DeviceAddress pCamera;
     vk::DeviceAddress pDrawIndirectCount;
-    vk::DeviceAddress pMeshBounds;
+    vk::DeviceAddress pTasks;
     vk::DeviceAddress pMeshes;
     vk::DeviceAddress pTransforms;
+    vk::DeviceAddress pVertexBuffer;
+    vk::DeviceAddress pInstances;
+    glm::fvec2 pyramidSize;
+    uint32_t maxDrawCount;
+    uint32_t occlusionCulling;
+    uint32_t earlyOcclusionCulling;
+    uint32_t latePass;
+};
+
+struct VShaderInstanceBucketsPC
+{
+    vk::DeviceAddress pDrawIndirectCount;
+    vk::DeviceAddress pBuckets;
+    vk::DeviceAddress pMeshes;
+    uint32_t bucketCount;
+    uint32_t instanceBase;
+    uint32_t maxDrawCount;
+};
+
+struct VShaderInstanceScatterPC
+{
+    vk::DeviceAddress pBuckets;
+    vk::DeviceAddress pInstanceEntries;
+    vk::DeviceAddress pInstances;
     uint32_t meshCount;
+    uint32_t instanceBase;
+};
+
+struct VShaderDepthReducePC
+{
+    glm::fvec2 outImageSize;
 };
 
 struct VShaderForwardDrawPC
@@ -53,6 +197,26 @@ struct VShaderForwardDrawPC
     vk::DeviceAddress pMesh;
     vk::DeviceAddress pTransform;
     vk::DeviceAddress pVertexBuffer;
+    vk::DeviceAddress pInstances;
+};
+
+struct VShaderVisibilityDrawPC
+{
+    vk::DeviceAddress pCamera;
+    vk::DeviceAddress pMesh;
+    vk::DeviceAddress pTransform;
+    vk::DeviceAddress pVertexBuffer;
+    vk::DeviceAddress pInstances;
+    vk::DeviceAddress pDrawCommands;
+};
+
+struct VShaderMaterialPC
+{
+    vk::DeviceAddress pCamera;
+    vk::DeviceAddress pMesh;
+    vk::DeviceAddress pTransform;
+    vk::DeviceAddress pVertexBuffer;
+    vk::DeviceAddress pIndexBuffer;
 };
 
 struct VShaderDrawIndirectCount
@@ -60,11 +224,39 @@ struct VShaderDrawIndirectCount
     uint32_t Count;
 };
 
+//point and spot lights, point lights use cones of -1 and -2 which never cut anything off
+struct VShaderLight
+{
+    glm::fvec3 Translation;
+    glm::fvec3 Translation_Err;
+    glm::fvec3 Direction;
+    float Range;
+    glm::fvec3 Color; //premultiplied by the intensity
+    float CosInnerCone;
+    float CosOuterCone;
+};
+
+struct VShaderClusterLightsPC
+{
+    vk::DeviceAddress pCamera;
+    vk::DeviceAddress pLights;
+    vk::DeviceAddress pClusters;
+    uint32_t lightCount;
+    glm::uvec3 clusterGrid;
+    uint32_t maxClusterLights;
+};
+
 struct VGlobalLightPC
 {
+    vk::DeviceAddress pCamera;
+    vk::DeviceAddress pLights;
+    vk::DeviceAddress pClusters;
     glm::fvec3 lightDirection;
     glm::fvec3 lightColor;
     float lightStrength;
+    uint32_t lightCount;
+    glm::uvec3 clusterGrid;
+    uint32_t maxClusterLights;
 };
 
 struct alignas(UNIFORM_BUFFER_ALIGNMENT) VShaderCameraData
@@ -86,14 +278,26 @@ struct VFrame
 {
     std::vector<std::function<void()>> OnFrameBegin{};
 
+    //cpu side scratch of the frame, cleared when the frame becomes active again, FRAMES_IN_FLIGHT frames later
+    LinearArena Arena{FRAME_ARENA_SIZE};
+
+    uint64_t Epoch = 0; //the epoch the frame was last recorded in, retired assets it may use wait for it to finish
+
     vk::CommandBuffer CommandBuffer = nullptr;
+    vk::CommandBuffer ComputeCommandBuffer = nullptr; //async compute only, scene updates and the early culling pass
+    vk::CommandBuffer LightingCommandBuffer = nullptr; //async compute only, submitted after the point the next frame's culling waits on
     vk::Fence InFlight = nullptr;
     vk::Semaphore ImageAvailable = nullptr;
     vk::Semaphore DrawFinished = nullptr;
 
-    VAllocatedBuffer MeshBounds{};
-    VAllocatedBuffer MeshInfos{};
-    VAllocatedBuffer MeshTransforms{};
+    VAllocatedBuffer SceneUpdates{};
+    VAllocatedBuffer Lights{};
+    uint32_t LightCount = 0;
+
+    VGpuFrameQueries Queries{};
+    VGpuFrameQueries ComputeQueries{};
+
+    VAllocatedBuffer CullStatistics{}; //visible meshes of the early and late culling pass, read back with the queries
 };
 
 class VStarSightRenderer : public VContext
@@ -113,40 +317,154 @@ public:
     std::vector<vk::Image> Images{};
     std::vector<vk::ImageView> ImageViews{};
 
+    //headless there is no window, surface or swapchain, every frame in flight renders into its own offscreen image
+    const bool bHeadless = false;
+    VHeadlessOptions Headless{};
+    std::vector<VAllocatedImage> OffscreenImages{};
+    vk::ImageLayout PresentLayout = vk::ImageLayout::ePresentSrcKHR; //finished frames are left in this, transfer source when headless
+    uint64_t PresentedFrames = 0;
+
+    uint32_t VisibleMeshCount = 0; //of the latest frame whose fence has passed
+
     std::array<VFrame, FRAMES_IN_FLIGHT> Frames{};
     VFrame* ActiveFrame = nullptr;
+    VGpuProfiler GpuProfiler{};
+
+    //with async compute the early culling of a frame only waits for the previous frame's geometry, not its lighting
+    vk::Semaphore CullTimeline = nullptr; //reached once a frame's early culling pass is done
+    vk::Semaphore GeometryTimeline = nullptr; //reached once the graphics queue is done with a frame's scene and culling buffers
+    uint64_t CullTimelineValue = 0;
+    uint64_t GeometryTimelineValue = 0;
 
     VAllocatedBuffer CameraBuffer{};
     VAllocatedBuffer DrawIndirectCommandsBuffer{};
+    VAllocatedBuffer MeshletTasksBuffer{};
+    VAllocatedBuffer InstanceBuckets{};
+    VAllocatedBuffer InstanceSlots{}; //meshlet draws use the first DrawCommandsCapacity, instanced draws the rest
+    uint32_t DrawCommandsCapacity = 0;
+    uint32_t MeshletTasksCapacity = 0;
+    uint32_t InstanceBucketCapacity = 0;
+    uint32_t InstanceSlotCapacity = 0;
+
+    //persistent device local scene, every mesh entity owns a stable slot
+    VAllocatedBuffer SceneMeshBounds{};
+    VAllocatedBuffer SceneMeshInfos{};
+    VAllocatedBuffer SceneTransforms{};
+    VAllocatedBuffer SceneVisibility{}; //written by the early culling pass, the late pass uses it to skip meshlets that are already drawn
+    VAllocatedBuffer SceneInstanceEntries{}; //bucket of every instanced slot, rewritten by every culling pass
+    uint32_t SceneCapacity = 0;
+    uint32_t SceneSlotCount = 0;
+    std::vector<uint32_t> SceneSlotMeshlets{}; //meshlet count of every slot, bounds the draws a frame can emit
+    uint64_t SceneMeshletCount = 0;
+    std::vector<uint32_t> FreeSceneSlots{};
+    std::vector<uint32_t> PendingFreeSceneSlots{}; //can be reused once the frame clearing them has been recorded
+    std::vector<VShaderSceneUpdate> PendingSceneUpdates{};
+    std::vector<uint32_t> PendingSceneUpdateOfSlot{}; //index into PendingSceneUpdates, a slot has at most one update per batch since the scatter does not order them
+    std::mutex SceneMx{};
+
+    vk::PipelineLayout SceneScatterLayout = nullptr;
+    vk::Pipeline SceneScatterPipeline = nullptr;
+
+    vk::PipelineLayout CullMeshesLayout = nullptr;
+    vk::Pipeline CullMeshesPipeline = nullptr;
 
     vk::PipelineLayout BuildDrawCommandsLayout = nullptr;
     vk::Pipeline BuildDrawCommandsPipeline = nullptr;
 
+    vk::PipelineLayout InstanceBucketsLayout = nullptr;
+    vk::Pipeline InstanceBucketsPipeline = nullptr;
+
+    vk::PipelineLayout InstanceScatterLayout = nullptr;
+    vk::Pipeline InstanceScatterPipeline = nullptr;
+
+    vk::PipelineLayout DepthReduceLayout = nullptr;
+    vk::Pipeline DepthReducePipeline = nullptr;
+
     vk::PipelineLayout ForwardPipelineLayout = nullptr;
     vk::Pipeline ForwardPipeline = nullptr;
 
     vk::PipelineLayout GeometryPipelineLayout = nullptr;
     vk::Pipeline GeometryPipeline = nullptr;
 
+    vk::PipelineLayout VisibilityPipelineLayout = nullptr;
+    vk::Pipeline VisibilityPipeline = nullptr;
+
+    vk::PipelineLayout MaterialPipelineLayout = nullptr;
+    vk::Pipeline MaterialPipeline = nullptr;
+
     vk::PipelineLayout GlobalLightPipelineLayout = nullptr;
     vk::Pipeline GlobalLightPipeline = nullptr;
 
+    //with the visibility buffer Position is not created and Normal and Color are written by material.comp instead of the raster
+    //all but depth are transient images of the frame graph and have no allocation of their own
     struct
     {
         vk::Format PositionFormat{};
         vk::Format NormalFormat{};
         vk::Format ColorFormat{};
+        vk::Format VisibilityFormat{};
         vk::Format DepthFormat{};
 
         VAllocatedImage Position{};
         VAllocatedImage Normal{};
         VAllocatedImage Color{};
+        VAllocatedImage Visibility{}; //scene slot and global triangle index, UINT32_MAX where nothing was drawn
         VAllocatedImage Depth{};
+        vk::ImageView ColorStorageView = nullptr; //unorm alias of Color, srgb can not be a storage image
     } GBuffer;
 
+    const bool bVisibilityBuffer = VISIBILITY_BUFFER;
+
+    //the deferred frame, declared with the GBuffer and rebuilt with it
+    //segment 0 is the geometry work, segment 1 lighting, which async compute records into its own command buffer
+    VRenderGraph FrameGraph{};
+
+    struct
+    {
+        VRenderGraphImage Position{};
+        VRenderGraphImage Normal{};
+        VRenderGraphImage Color{};
+        VRenderGraphImage Visibility{};
+        VRenderGraphImage Depth{};
+        VRenderGraphImage SwapChain{};
+    } FrameImages;
+
+    uint32_t FrameMeshCount = 0; //of the frame being recorded, read by the passes
+    uint32_t FrameSwapChainImage = 0;
+
+    //hierarchical farthest depth, kept across frames so the next early culling pass can test against it
+    //there are two so the late pass can still repeat the early pass meshlet tests after the new one is built
+    struct
+    {
+        uint32_t Width = 0;
+        uint32_t Height = 0;
+        uint32_t MipLevels = 0;
+
+        std::array<VAllocatedImage, 2> Images{};
+        std::array<std::vector<vk::ImageView>, 2> MipViews{};
+        std::array<std::vector<vk::DescriptorSet>, 2> ReduceSets{};
+        std::array<vk::DescriptorSet, 2> MeshCullSets{}; //tests against Images[i]
+        std::array<vk::DescriptorSet, 2> MeshletCullSets{}; //tests against Images[i], early pass decisions against Images[1 - i]
+        vk::Sampler Sampler = nullptr;
+
+        uint32_t Current = 0; //the most recently built one
+        bool bValid = false;
+    } DepthPyramid;
+
+    bool bEarlyOcclusionCulling = false; //whether this frame's early pass tested against the pyramid
+
+    //light count of every cluster followed by CLUSTER_MAX_LIGHTS light indices per cluster, rebuilt every frame
+    VAllocatedBuffer ClusterLights{};
+    std::vector<VShaderLight> SceneLights{}; //latest set handed over by UpdateLights
+    std::mutex LightMx{};
+
+    vk::PipelineLayout ClusterLightsLayout = nullptr;
+    vk::Pipeline ClusterLightsPipeline = nullptr;
+
 public:
 
     VStarSightRenderer(GLFWwindow* Window_);
+    explicit VStarSightRenderer(const VHeadlessOptions& Options);
     virtual ~VStarSightRenderer();
 
     void WaitForFrames();
@@ -158,6 +476,16 @@ public:
     std::pair<uint32_t, uint32_t> GetWindowExtent();
 
     uint64_t ActiveFrameIndex() const;
+    LinearArena& GetFrameArena();
+
+    uint32_t GrabSceneSlot();
+    void FreeSceneSlot(uint32_t Slot);
+    //loaders grab slots concurrently, read before the frame is recorded so the scene buffers grow to cover it
+    uint32_t GetSceneSlotCount();
+    void UpdateSceneSlot(const VShaderSceneUpdate& Update);
+
+    //replaces the lights drawn from the next recorded frame on
+    void UpdateLights(std::vector<VShaderLight>&& Lights);
 
 private:
     friend class VContext;
@@ -165,18 +493,32 @@ private:
     /*
      * initialization
      */
+    void Initialize();
     void CreateSurface();
     void CreateSwapChain(vk::SwapchainKHR OldSwapChain = nullptr);
     void CreateSwapChainViews();
     void CreateFrames();
+    void CreateCullMeshesPipeline();
     void CreateDrawCommandsPipeline();
+    void CreateInstancingPipelines();
     void CreateForwardPipeline();
     void CreateGeometryPipeline();
+    void CreateVisibilityPipeline();
+    void CreateMaterialPipeline();
     void CreateGlobalLightPipeline();
+    void CreateClusterLightsPipeline();
+    void CreateClusterBuffers();
     void CreateCameraBuffer();
     void CreateIndirectCommandsBuffer();
+    void CreateMeshletTasksBuffer();
+    void CreateInstanceBuffers();
+    void CreateSceneBuffers();
+    void CreateSceneScatterPipeline();
     void CreateGBuffer();
     void DestroyGBuffer();
+    void CreateDepthReducePipeline();
+    void CreateDepthPyramid();
+    void DestroyDepthPyramid();
 
     /*
      * forward rendering
@@ -189,6 +531,11 @@ private:
     bool PresentImage(uint32_t SwapChainImage);
     void RecreateSwapChain();
     void AdvanceActiveFrame();
+    void PendingSceneUpdate_Locked(const VShaderSceneUpdate& Update);
+    void RecordSceneUpdates(vk::CommandBuffer CommandBuffer);
+    void RecordBuildDrawCommands(vk::CommandBuffer CommandBuffer, uint32_t MeshCount, bool bOcclusionCulling, bool bLatePass);
+    void RecordDepthPyramid(vk::CommandBuffer CommandBuffer);
+    std::vector<vk::SemaphoreSubmitInfo> MakeWaitSemaphoreInfos(vk::PipelineStageFlags2 ImageAvailableStage);
 
     /*
      * deferred rendering
@@ -197,6 +544,24 @@ private:
     //void RenderGBuffer(std::span<ecs::RenderSystem::RenderInfo> RenderInfos);
     void EndGeometryPass(uint32_t SwapChainImage);
     void SubmitGBufferCommands();
+    void BuildFrameGraph();
+    void RecordGeometryPass(vk::CommandBuffer CommandBuffer, bool bLatePass);
+    void RecordMaterialPass(vk::CommandBuffer CommandBuffer);
+    void RecordLightingPass(vk::CommandBuffer CommandBuffer);
+    void RecordClusterLights(vk::CommandBuffer CommandBuffer);
+
+    /*
+     * headless
+     */
+    void CreateOffscreenImages();
+    void DumpImage(uint32_t Image, const std::fpath& Path);
+
+    /*
+     * async compute
+     */
+    void SubmitAsyncCulling(uint32_t MeshCount);
+    void RecordPyramidOwnership(vk::CommandBuffer CommandBuffer, uint32_t SrcFamily, uint32_t DstFamily, bool bAcquire);
+    vk::PipelineStageFlags2 VertexStages(vk::CommandBuffer CommandBuffer) const;
 };
 
 #endif //STARSIGHT_VK_RENDER_TARGET_HPP
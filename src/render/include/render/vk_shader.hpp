@@ -4,17 +4,22 @@
 #include "core/ssovector.hpp"
 #include "spirv_reflect.hpp"
 #include "shaderc/shaderc.hpp"
-#include "taskflow/taskflow.hpp"
+#include "core/job_scheduler.hpp"
 #include "tbb/concurrent_unordered_map.h"
 #include "core/filesystem.hpp"
 #include <vulkan/vulkan.hpp>
 #include <string_view>
 #include <span>
 #include <unordered_map>
+#include <vector>
 #include <future>
 
 class VContext;
 
+#ifndef SHADER_DDC_VERSION
+#define SHADER_DDC_VERSION 2 //bump when the compiler is updated, its output is not part of the key
+#endif
+
 struct SpvResultCheck
 {
     SpvResultCheck& operator=(SpvReflectResult Result_);
@@ -23,10 +28,30 @@ struct SpvResultCheck
 };
 inline constinit thread_local SpvResultCheck spvResultCheck{};
 
+//the parts of the reflection the pipeline builders use, flat so they are cached next to the spirv
+struct VShaderPushConstant
+{
+    uint32_t Offset;
+    uint32_t Size;
+};
+
+struct VShaderBinding
+{
+    uint32_t Set;
+    uint32_t Binding;
+    uint32_t DescriptorType; //SpvReflectDescriptorType, same values as vk::DescriptorType
+    uint32_t Count;
+    uint32_t ArrayDimsCount;
+    uint32_t ArrayDim; //first dimension, 0 or 1 for unsized arrays
+};
+
 struct VShader
 {
     vk::ShaderModule ShaderModule = nullptr;
-    SpvReflectShaderModule ReflectionModule{};
+    vk::ShaderStageFlagBits Stage{};
+    std::vector<VShaderPushConstant> PushConstants{};
+    std::vector<VShaderBinding> Bindings{}; //ordered by set, the builders make one layout per set
+    std::shared_future<VShader*> Compiled{}; //shared by every builder that includes the shader
 };
 
 class VShaderCache
@@ -34,14 +59,15 @@ class VShaderCache
 public:
     tbb::concurrent_unordered_map<std::fpath, VShader> Shaders{};
 
-    tf::Executor TaskExecutor{};
+    JobGroup CompileJobs{JobPriority::Background};
     VContext* Context = nullptr;
 public:
 
     explicit VShaderCache(VContext* Context_);
     ~VShaderCache();
 
-    std::future<VShader*> CreateShader(const std::fpath& Path);
+    //safe to call from several threads at once, the shader is compiled by whichever call inserts it first
+    std::shared_future<VShader*> CreateShader(const std::fpath& Path);
     bool DestroyShader(const std::fpath& Path);
 
 private:
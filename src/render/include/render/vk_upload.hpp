@@ -0,0 +1,139 @@
+#ifndef STARSIGHT_VK_UPLOAD_HPP
+#define STARSIGHT_VK_UPLOAD_HPP
+
+#include "vk_memory_allocator.hpp"
+#include "vk_utility.hpp"
+#include "core/ssovector.hpp"
+
+#include <vulkan/vulkan.hpp>
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#ifndef STAGING_RING_SIZE
+#define STAGING_RING_SIZE (64ull * 1024ull * 1024ull)
+#endif
+
+#ifndef STAGING_RING_ALIGNMENT
+#define STAGING_RING_ALIGNMENT 16ull
+#endif
+
+class VContext;
+
+struct VStagingRange
+{
+    static constexpr uint64_t Open = UINT64_MAX; //still being written by its owner
+    static constexpr uint64_t Committed = 0; //waiting for the next flush
+
+    uint64_t Begin = 0; //virtual offsets into the ring, they only ever grow
+    uint64_t End = 0;
+    VAllocatedBuffer Dedicated{}; //used when an upload is too large for the ring
+    std::atomic_uint64_t Value = Open; //transfer timeline value that releases the range
+};
+
+struct VBufferUpload
+{
+    vk::Buffer SrcBuffer = nullptr;
+    const VAllocatedBuffer* DstBuffer = nullptr; //resolved when flushed, the buffer may be replaced by a larger one until then
+    vk::BufferCopy2 Region{};
+};
+
+//a whole mip chain of the largest texture stays inline, so queueing a texture upload does not touch the heap
+using VImageRegions = ssovector<vk::BufferImageCopy2, 16>;
+
+struct VImageUpload
+{
+    vk::Buffer SrcBuffer = nullptr;
+    vk::Image DstImage = nullptr;
+    vk::ImageSubresourceRange SubresourceRange{};
+    VImageRegions Regions{};
+};
+
+//staging memory handed out to a single loader, copies are recorded into it without any locking
+struct VStagingBlock
+{
+    void* MappedData = nullptr;
+    uint64_t Size = 0;
+    uint64_t BufferOffset = 0;
+    vk::Buffer Buffer = nullptr;
+    VStagingRange* Range = nullptr;
+
+    std::vector<VBufferUpload> BufferUploads{};
+    std::vector<VImageUpload> ImageUploads{};
+
+    void CopyToBuffer(const VAllocatedBuffer* DstBuffer, uint64_t SrcOffset, uint64_t DstOffset, uint64_t CopySize);
+    void CopyToImage(vk::Image DstImage, const vk::ImageSubresourceRange& SubresourceRange, VImageRegions Regions); //region offsets are relative to the block
+};
+
+class VUploadManager
+{
+private:
+    struct VThreadRecording
+    {
+        std::mutex RecordingMx{};
+        std::vector<VBufferUpload> BufferUploads{};
+        std::vector<VImageUpload> ImageUploads{};
+        std::vector<VStagingRange*> Ranges{};
+    };
+
+    struct VInFlightCommands
+    {
+        vk::CommandBuffer CommandBuffer = nullptr;
+        uint64_t Value = 0;
+    };
+
+    VContext* Context = nullptr;
+
+    VAllocatedBuffer RingBuffer{};
+    uint64_t RingHead = 0;
+    std::deque<VStagingRange> Ranges{};
+    std::mutex RingMx{};
+
+    vk::Semaphore TransferTimeline = nullptr;
+    std::atomic_uint64_t NextValue = 1;
+    std::atomic_uint64_t PendingCommits = 0;
+    std::atomic_uint64_t DeviceWaitValue = 0;
+
+    std::vector<std::unique_ptr<VThreadRecording>> ThreadRecordings{};
+    std::mutex ThreadRecordingsMx{};
+
+    vk::CommandPool CommandPool = nullptr;
+    std::deque<VInFlightCommands> InFlightCommands{};
+    std::mutex FlushMx{};
+
+public:
+
+    VUploadManager(VContext* Context_);
+    ~VUploadManager();
+
+    //blocks until enough of the ring has been released by finished transfers, flushing committed uploads itself when the ring is full
+    VStagingBlock Reserve(uint64_t Size, const std::string& Name = "");
+
+    //hands the recorded copies over to the next flush, returns the timeline value that marks their completion
+    uint64_t Commit(VStagingBlock&& Block);
+
+    //submits every committed upload in a single batch, should be called once per tick
+    void Flush();
+
+    bool IsComplete(uint64_t Value) const;
+    void Wait(uint64_t Value) const;
+
+    //flushes and waits for everything committed so far
+    void WaitIdle();
+
+    //non zero when a flush replaced buffers the next graphics submit reads, it has to wait for this value on the timeline
+    uint64_t TakeDeviceWaitValue();
+    vk::Semaphore GetTimeline() const { return TransferTimeline; }
+
+private:
+
+    VThreadRecording* GetThreadRecording();
+    VStagingRange* TryReserve_Locked(uint64_t Size);
+    void Reclaim_Locked();
+    vk::CommandBuffer GrabCommandBuffer();
+};
+
+#endif //STARSIGHT_VK_UPLOAD_HPP
@@ -6,6 +6,10 @@
 
 #include <ratio>
 
+#ifndef FRAMES_IN_FLIGHT
+#define FRAMES_IN_FLIGHT 2
+#endif
+
 class result_checker_t
 {
 public:
@@ -42,6 +46,7 @@ struct BufferAllocationSlot
 {
     uint32_t Offset;
     uint32_t Size;
+    uint32_t Node = UINT32_MAX; //range allocator handle
 };
 
 namespace vkutil
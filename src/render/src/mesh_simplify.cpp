@@ -0,0 +1,362 @@
+#include "mesh_simplify.hpp"
+#include "core/assertion.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <unordered_map>
+
+namespace
+{
+    //symmetric 4x4 plane distance matrix, Weight is the face area the planes came from
+    struct VQuadric
+    {
+        double A2 = 0.0, B2 = 0.0, C2 = 0.0, D2 = 0.0;
+        double AB = 0.0, AC = 0.0, AD = 0.0;
+        double BC = 0.0, BD = 0.0, CD = 0.0;
+        double Weight = 0.0;
+
+        static VQuadric FromPlane(glm::dvec3 Normal, double Distance, double PlaneWeight)
+        {
+            VQuadric Result{};
+            Result.A2 = Normal.x * Normal.x * PlaneWeight;
+            Result.B2 = Normal.y * Normal.y * PlaneWeight;
+            Result.C2 = Normal.z * Normal.z * PlaneWeight;
+            Result.D2 = Distance * Distance * PlaneWeight;
+            Result.AB = Normal.x * Normal.y * PlaneWeight;
+            Result.AC = Normal.x * Normal.z * PlaneWeight;
+            Result.AD = Normal.x * Distance * PlaneWeight;
+            Result.BC = Normal.y * Normal.z * PlaneWeight;
+            Result.BD = Normal.y * Distance * PlaneWeight;
+            Result.CD = Normal.z * Distance * PlaneWeight;
+            return Result;
+        }
+
+        VQuadric& operator+=(const VQuadric& Other)
+        {
+            A2 += Other.A2; B2 += Other.B2; C2 += Other.C2; D2 += Other.D2;
+            AB += Other.AB; AC += Other.AC; AD += Other.AD;
+            BC += Other.BC; BD += Other.BD; CD += Other.CD;
+            Weight += Other.Weight;
+            return *this;
+        }
+
+        //weighted sum of squared distances to the planes
+        double Evaluate(glm::dvec3 P) const
+        {
+            double Result = A2 * P.x * P.x + B2 * P.y * P.y + C2 * P.z * P.z + D2;
+            Result += 2.0 * (AB * P.x * P.y + AC * P.x * P.z + BC * P.y * P.z);
+            Result += 2.0 * (AD * P.x + BD * P.y + CD * P.z);
+            return std::max(Result, 0.0);
+        }
+    };
+
+    struct VCollapse
+    {
+        double Cost;
+        uint32_t From;
+        uint32_t To;
+    };
+
+    uint64_t EdgeKey(uint32_t A, uint32_t B)
+    {
+        return (static_cast<uint64_t>(std::min(A, B)) << 32) | std::max(A, B);
+    }
+
+    struct VPositionHash
+    {
+        uint64_t operator()(const glm::fvec3& Position) const
+        {
+            uint64_t X = std::bit_cast<uint32_t>(Position.x);
+            uint64_t Y = std::bit_cast<uint32_t>(Position.y);
+            uint64_t Z = std::bit_cast<uint32_t>(Position.z);
+            return (X * 73856093) ^ (Y * 19349663) ^ (Z * 83492791);
+        }
+    };
+}
+
+std::vector<uint32_t> SimplifyMesh(std::span<const uint32_t> Indices, std::span<const glm::fvec3> Positions, uint32_t TargetIndexCount, float* OutError)
+{
+    ASSERT(Indices.size() % 3 == 0);
+
+    const uint32_t VertexCount = Positions.size();
+
+    //the first vertex at every position stands in for all of them
+    std::vector<uint32_t> Canonical(VertexCount);
+    {
+        std::unordered_map<glm::fvec3, uint32_t, VPositionHash> FirstAtPosition{};
+        FirstAtPosition.reserve(VertexCount);
+
+        for(uint32_t Vertex = 0; Vertex < VertexCount; ++Vertex)
+        {
+            Canonical[Vertex] = FirstAtPosition.try_emplace(Positions[Vertex], Vertex).first->second;
+        }
+    }
+
+    //canonical corners drive the collapses, the original corners keep the attributes of untouched vertices
+    std::vector<uint32_t> Triangles{};
+    std::vector<uint32_t> Corners{};
+    Triangles.reserve(Indices.size());
+    Corners.reserve(Indices.size());
+
+    for(uint64_t Index = 0; Index < Indices.size(); Index += 3)
+    {
+        uint32_t A = Canonical[Indices[Index + 0]];
+        uint32_t B = Canonical[Indices[Index + 1]];
+        uint32_t C = Canonical[Indices[Index + 2]];
+
+        if(A == B || B == C || A == C)
+        {
+            continue;
+        }
+
+        Triangles.insert(Triangles.end(), {A, B, C});
+        Corners.insert(Corners.end(), {Indices[Index + 0], Indices[Index + 1], Indices[Index + 2]});
+    }
+
+    std::vector<VQuadric> Quadrics(VertexCount);
+    std::unordered_map<uint64_t, uint32_t> EdgeUses{};
+    EdgeUses.reserve(Triangles.size());
+
+    for(uint64_t Index = 0; Index < Triangles.size(); Index += 3)
+    {
+        glm::dvec3 P0 = Positions[Triangles[Index + 0]];
+        glm::dvec3 P1 = Positions[Triangles[Index + 1]];
+        glm::dvec3 P2 = Positions[Triangles[Index + 2]];
+
+        glm::dvec3 Normal = glm::cross(P1 - P0, P2 - P0);
+        double Length = glm::length(Normal);
+        if(Length == 0.0)
+        {
+            continue;
+        }
+
+        Normal /= Length;
+        double Area = Length * 0.5;
+
+        VQuadric Plane = VQuadric::FromPlane(Normal, -glm::dot(Normal, P0), Area);
+        Plane.Weight = Area;
+
+        for(uint32_t Corner = 0; Corner < 3; ++Corner)
+        {
+            Quadrics[Triangles[Index + Corner]] += Plane;
+            EdgeUses[EdgeKey(Triangles[Index + Corner], Triangles[Index + (Corner + 1) % 3])] += 1;
+        }
+    }
+
+    //a plane through every open edge, perpendicular to its face, pins the border
+    for(uint64_t Index = 0; Index < Triangles.size(); Index += 3)
+    {
+        glm::dvec3 P0 = Positions[Triangles[Index + 0]];
+        glm::dvec3 P1 = Positions[Triangles[Index + 1]];
+        glm::dvec3 P2 = Positions[Triangles[Index + 2]];
+        glm::dvec3 FaceNormal = glm::cross(P1 - P0, P2 - P0);
+
+        for(uint32_t Corner = 0; Corner < 3; ++Corner)
+        {
+            uint32_t A = Triangles[Index + Corner];
+            uint32_t B = Triangles[Index + (Corner + 1) % 3];
+
+            if(EdgeUses[EdgeKey(A, B)] != 1)
+            {
+                continue;
+            }
+
+            glm::dvec3 Edge = glm::dvec3{Positions[B]} - glm::dvec3{Positions[A]};
+            glm::dvec3 Normal = glm::cross(Edge, FaceNormal);
+            double Length = glm::length(Normal);
+            if(Length == 0.0)
+            {
+                continue;
+            }
+
+            Normal /= Length;
+
+            VQuadric Plane = VQuadric::FromPlane(Normal, -glm::dot(Normal, glm::dvec3{Positions[A]}), glm::dot(Edge, Edge) * MESH_SIMPLIFY_BOUNDARY_WEIGHT);
+            Quadrics[A] += Plane;
+            Quadrics[B] += Plane;
+        }
+    }
+
+    auto CollapseCost = [&](uint32_t From, uint32_t To)
+    {
+        VQuadric Combined = Quadrics[From];
+        Combined += Quadrics[To];
+        return Combined.Evaluate(Positions[To]) / std::max(Combined.Weight, 1e-12);
+    };
+
+    std::vector<uint32_t> AdjacencyOffsets(VertexCount + 1);
+    std::vector<uint32_t> AdjacencyTriangles{};
+    std::vector<uint64_t> Edges{};
+    std::vector<VCollapse> Collapses{};
+    std::vector<uint32_t> Remap(VertexCount);
+    std::vector<bool> Locked(VertexCount);
+
+    double MaxCost = 0.0;
+
+    //every pass collapses a batch of independent edges in order of cost, then rebuilds the adjacency
+    while(Triangles.size() > TargetIndexCount)
+    {
+        std::fill(AdjacencyOffsets.begin(), AdjacencyOffsets.end(), 0);
+        for(uint32_t Vertex : Triangles)
+        {
+            AdjacencyOffsets[Vertex + 1] += 1;
+        }
+
+        for(uint32_t Vertex = 0; Vertex < VertexCount; ++Vertex)
+        {
+            AdjacencyOffsets[Vertex + 1] += AdjacencyOffsets[Vertex];
+        }
+
+        AdjacencyTriangles.resize(Triangles.size());
+        std::vector<uint32_t> AdjacencyCursor(AdjacencyOffsets.begin(), AdjacencyOffsets.end() - 1);
+
+        for(uint32_t Index = 0; Index < Triangles.size(); ++Index)
+        {
+            AdjacencyTriangles[AdjacencyCursor[Triangles[Index]]++] = Index / 3;
+        }
+
+        Edges.clear();
+        for(uint64_t Index = 0; Index < Triangles.size(); Index += 3)
+        {
+            for(uint32_t Corner = 0; Corner < 3; ++Corner)
+            {
+                Edges.emplace_back(EdgeKey(Triangles[Index + Corner], Triangles[Index + (Corner + 1) % 3]));
+            }
+        }
+
+        std::sort(Edges.begin(), Edges.end());
+        Edges.erase(std::unique(Edges.begin(), Edges.end()), Edges.end());
+
+        Collapses.clear();
+        for(uint64_t Edge : Edges)
+        {
+            uint32_t A = Edge >> 32;
+            uint32_t B = Edge & UINT32_MAX;
+
+            double CostAB = CollapseCost(A, B);
+            double CostBA = CollapseCost(B, A);
+
+            Collapses.emplace_back(CostAB <= CostBA ? VCollapse{CostAB, A, B} : VCollapse{CostBA, B, A});
+        }
+
+        std::sort(Collapses.begin(), Collapses.end(), [](const VCollapse& Lhs, const VCollapse& Rhs)
+        {
+            return Lhs.Cost < Rhs.Cost;
+        });
+
+        for(uint32_t Vertex = 0; Vertex < VertexCount; ++Vertex)
+        {
+            Remap[Vertex] = Vertex;
+        }
+        std::fill(Locked.begin(), Locked.end(), false);
+
+        uint64_t RemainingIndices = Triangles.size();
+        uint32_t CollapseCount = 0;
+
+        for(const VCollapse& Collapse : Collapses)
+        {
+            if(RemainingIndices <= TargetIndexCount)
+            {
+                break;
+            }
+
+            if(Locked[Collapse.From] || Locked[Collapse.To])
+            {
+                continue;
+            }
+
+            uint32_t RemovedTriangles = 0;
+            bool bFlips = false;
+
+            for(uint32_t Adjacent = AdjacencyOffsets[Collapse.From]; Adjacent < AdjacencyOffsets[Collapse.From + 1]; ++Adjacent)
+            {
+                const uint32_t* Triangle = &Triangles[AdjacencyTriangles[Adjacent] * 3];
+
+                if(Triangle[0] == Collapse.To || Triangle[1] == Collapse.To || Triangle[2] == Collapse.To)
+                {
+                    RemovedTriangles += 1;
+                    continue;
+                }
+
+                glm::dvec3 Before[3];
+                glm::dvec3 After[3];
+                for(uint32_t Corner = 0; Corner < 3; ++Corner)
+                {
+                    Before[Corner] = Positions[Triangle[Corner]];
+                    After[Corner] = Positions[Triangle[Corner] == Collapse.From ? Collapse.To : Triangle[Corner]];
+                }
+
+                glm::dvec3 NormalBefore = glm::cross(Before[1] - Before[0], Before[2] - Before[0]);
+                glm::dvec3 NormalAfter = glm::cross(After[1] - After[0], After[2] - After[0]);
+
+                //a face that turns around or collapses to a sliver would show up as a hole
+                if(glm::dot(NormalBefore, NormalAfter) <= 0.0)
+                {
+                    bFlips = true;
+                    break;
+                }
+            }
+
+            if(bFlips)
+            {
+                continue;
+            }
+
+            //everything around the moved vertex changes shape, later checks in this pass would be stale
+            for(uint32_t Adjacent = AdjacencyOffsets[Collapse.From]; Adjacent < AdjacencyOffsets[Collapse.From + 1]; ++Adjacent)
+            {
+                const uint32_t* Triangle = &Triangles[AdjacencyTriangles[Adjacent] * 3];
+                Locked[Triangle[0]] = true;
+                Locked[Triangle[1]] = true;
+                Locked[Triangle[2]] = true;
+            }
+
+            Remap[Collapse.From] = Collapse.To;
+            Quadrics[Collapse.To] += Quadrics[Collapse.From];
+            MaxCost = std::max(MaxCost, Collapse.Cost);
+
+            RemainingIndices -= RemovedTriangles * 3;
+            CollapseCount += 1;
+        }
+
+        if(CollapseCount == 0)
+        {
+            break;
+        }
+
+        uint64_t Write = 0;
+        for(uint64_t Index = 0; Index < Triangles.size(); Index += 3)
+        {
+            uint32_t A = Remap[Triangles[Index + 0]];
+            uint32_t B = Remap[Triangles[Index + 1]];
+            uint32_t C = Remap[Triangles[Index + 2]];
+
+            if(A == B || B == C || A == C)
+            {
+                continue;
+            }
+
+            //a moved corner takes the vertex it was collapsed onto, the others keep their own attributes
+            for(uint32_t Corner = 0; Corner < 3; ++Corner)
+            {
+                uint32_t Vertex = Triangles[Index + Corner];
+                Corners[Write + Corner] = Remap[Vertex] == Vertex ? Corners[Index + Corner] : Remap[Vertex];
+            }
+
+            Triangles[Write + 0] = A;
+            Triangles[Write + 1] = B;
+            Triangles[Write + 2] = C;
+            Write += 3;
+        }
+
+        Triangles.resize(Write);
+        Corners.resize(Write);
+    }
+
+    if(OutError)
+    {
+        *OutError = static_cast<float>(std::sqrt(MaxCost));
+    }
+
+    return Corners;
+}
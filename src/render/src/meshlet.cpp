@@ -0,0 +1,226 @@
+#include "meshlet.hpp"
+#include "core/assertion.hpp"
+#include "core/linear_arena.hpp"
+
+#include <algorithm>
+#include <limits>
+
+//https://github.com/zeux/meshoptimizer/blob/master/src/clusterizer.cpp
+static void ComputeMeshletBounds(VShaderMeshlet& Meshlet, std::span<const uint32_t> Indices, std::span<const uint32_t> Vertices, std::span<const glm::fvec3> Positions)
+{
+    glm::fvec3 BoundsMin{std::numeric_limits<float>::max()};
+    glm::fvec3 BoundsMax{std::numeric_limits<float>::lowest()};
+
+    for(uint32_t Vertex : Vertices)
+    {
+        BoundsMin = glm::min(BoundsMin, Positions[Vertex]);
+        BoundsMax = glm::max(BoundsMax, Positions[Vertex]);
+    }
+
+    glm::fvec3 Center = (BoundsMin + BoundsMax) * 0.5f;
+    float Radius = 0.f;
+
+    for(uint32_t Vertex : Vertices)
+    {
+        Radius = std::max(Radius, glm::distance(Center, Positions[Vertex]));
+    }
+
+    Meshlet.SphereBounds = glm::fvec4{Center, Radius};
+
+    //once per meshlet on every streaming worker, so it stays off the shared heap
+    ScratchScope Scratch{};
+    TArenaVector<glm::fvec3> Normals(Scratch.Get());
+    Normals.reserve(Indices.size() / 3);
+
+    glm::fvec3 NormalSum{0.f};
+
+    for(uint64_t Triangle = 0; Triangle < Indices.size(); Triangle += 3)
+    {
+        glm::fvec3 A = Positions[Indices[Triangle + 0]];
+        glm::fvec3 B = Positions[Indices[Triangle + 1]];
+        glm::fvec3 C = Positions[Indices[Triangle + 2]];
+
+        glm::fvec3 Normal = glm::cross(B - A, C - A);
+        float Area = glm::length(Normal);
+
+        //degenerate triangles can not be backfacing
+        if(Area == 0.f)
+        {
+            continue;
+        }
+
+        Normals.emplace_back(Normal / Area);
+        NormalSum += Normals.back();
+    }
+
+    float AxisLength = glm::length(NormalSum);
+    glm::fvec3 Axis = AxisLength == 0.f ? glm::fvec3{0.f} : NormalSum / AxisLength;
+
+    float MinDot = 1.f;
+    for(const glm::fvec3& Normal : Normals)
+    {
+        MinDot = std::min(MinDot, glm::dot(Axis, Normal));
+    }
+
+    //no valid triangles or the normals spread over more than a hemisphere, the cone can never be fully backfacing
+    if(Normals.empty() || AxisLength == 0.f || MinDot <= 0.1f)
+    {
+        Meshlet.ConeAxis = glm::fvec3{0.f};
+        Meshlet.ConeCutoff = 1.f;
+        return;
+    }
+
+    //the normal cone has an angle of acos(MinDot), widening it by 90 degrees on both sides and inverting it gives sin(a)
+    Meshlet.ConeAxis = Axis;
+    Meshlet.ConeCutoff = std::sqrt(1.f - MinDot * MinDot);
+}
+
+std::vector<VShaderMeshlet> BuildMeshlets(std::span<uint32_t> Indices, std::span<const glm::fvec3> Positions, uint32_t MaxVertices, uint32_t MaxTriangles)
+{
+    ASSERT(Indices.size() % 3 == 0);
+    ASSERT(MaxVertices >= 3 && MaxTriangles >= 1);
+
+    const uint32_t TriangleCount = Indices.size() / 3;
+    const uint32_t VertexCount = Positions.size();
+
+    //vertex to triangle adjacency
+    std::vector<uint32_t> AdjacencyOffsets(VertexCount + 1, 0);
+    for(uint32_t Index : Indices)
+    {
+        ASSERT(Index < VertexCount);
+        AdjacencyOffsets[Index + 1] += 1;
+    }
+
+    for(uint32_t Vertex = 0; Vertex < VertexCount; ++Vertex)
+    {
+        AdjacencyOffsets[Vertex + 1] += AdjacencyOffsets[Vertex];
+    }
+
+    std::vector<uint32_t> AdjacencyTriangles(Indices.size());
+    std::vector<uint32_t> AdjacencyCursor(AdjacencyOffsets.begin(), AdjacencyOffsets.end() - 1);
+
+    for(uint32_t Triangle = 0; Triangle < TriangleCount; ++Triangle)
+    {
+        for(uint32_t Corner = 0; Corner < 3; ++Corner)
+        {
+            AdjacencyTriangles[AdjacencyCursor[Indices[Triangle * 3 + Corner]]++] = Triangle;
+        }
+    }
+
+    //triangles of each vertex that are not in a meshlet yet, vertices close to being finished are preferred
+    std::vector<uint32_t> LiveTriangles(VertexCount);
+    for(uint32_t Vertex = 0; Vertex < VertexCount; ++Vertex)
+    {
+        LiveTriangles[Vertex] = AdjacencyOffsets[Vertex + 1] - AdjacencyOffsets[Vertex];
+    }
+
+    std::vector<bool> TriangleUsed(TriangleCount, false);
+    std::vector<uint32_t> VertexMeshlet(VertexCount, UINT32_MAX);
+
+    std::vector<VShaderMeshlet> Meshlets{};
+    std::vector<uint32_t> Reordered{};
+    Reordered.reserve(Indices.size());
+
+    std::vector<uint32_t> MeshletVertices{};
+    MeshletVertices.reserve(MaxVertices);
+
+    uint32_t ScanCursor = 0;
+
+    while(true)
+    {
+        //seed every meshlet with the first unused triangle in index order, which keeps some of the original cache locality
+        while(ScanCursor < TriangleCount && TriangleUsed[ScanCursor])
+        {
+            ++ScanCursor;
+        }
+
+        if(ScanCursor == TriangleCount)
+        {
+            break;
+        }
+
+        const uint32_t MeshletIndex = Meshlets.size();
+
+        VShaderMeshlet& Meshlet = Meshlets.emplace_back();
+        Meshlet.TriangleOffset = Reordered.size() / 3;
+        Meshlet.TriangleCount = 0;
+
+        MeshletVertices.clear();
+
+        uint32_t NextTriangle = ScanCursor;
+
+        while(NextTriangle != UINT32_MAX)
+        {
+            TriangleUsed[NextTriangle] = true;
+            Meshlet.TriangleCount += 1;
+
+            for(uint32_t Corner = 0; Corner < 3; ++Corner)
+            {
+                uint32_t Vertex = Indices[NextTriangle * 3 + Corner];
+                Reordered.emplace_back(Vertex);
+                LiveTriangles[Vertex] -= 1;
+
+                if(VertexMeshlet[Vertex] != MeshletIndex)
+                {
+                    VertexMeshlet[Vertex] = MeshletIndex;
+                    MeshletVertices.emplace_back(Vertex);
+                }
+            }
+
+            if(Meshlet.TriangleCount == MaxTriangles)
+            {
+                break;
+            }
+
+            //grow towards the neighbour that adds the fewest new vertices
+            NextTriangle = UINT32_MAX;
+            uint32_t BestNewVertices = UINT32_MAX;
+            uint32_t BestLiveTriangles = UINT32_MAX;
+
+            for(uint32_t Vertex : MeshletVertices)
+            {
+                for(uint32_t Adjacent = AdjacencyOffsets[Vertex]; Adjacent < AdjacencyOffsets[Vertex + 1]; ++Adjacent)
+                {
+                    uint32_t Triangle = AdjacencyTriangles[Adjacent];
+                    if(TriangleUsed[Triangle])
+                    {
+                        continue;
+                    }
+
+                    uint32_t NewVertices = 0;
+                    uint32_t Live = 0;
+
+                    for(uint32_t Corner = 0; Corner < 3; ++Corner)
+                    {
+                        uint32_t CornerVertex = Indices[Triangle * 3 + Corner];
+                        NewVertices += VertexMeshlet[CornerVertex] != MeshletIndex;
+                        Live += LiveTriangles[CornerVertex];
+                    }
+
+                    if(MeshletVertices.size() + NewVertices > MaxVertices)
+                    {
+                        continue;
+                    }
+
+                    if(NewVertices < BestNewVertices || (NewVertices == BestNewVertices && Live < BestLiveTriangles))
+                    {
+                        NextTriangle = Triangle;
+                        BestNewVertices = NewVertices;
+                        BestLiveTriangles = Live;
+                    }
+                }
+            }
+        }
+
+        Meshlet.VertexCount = MeshletVertices.size();
+        Meshlet.Pad = 0;
+
+        std::span<const uint32_t> MeshletIndices{Reordered.data() + Meshlet.TriangleOffset * 3, Meshlet.TriangleCount * 3};
+        ComputeMeshletBounds(Meshlet, MeshletIndices, MeshletVertices, Positions);
+    }
+
+    ASSERT(Reordered.size() == Indices.size());
+    std::copy(Reordered.begin(), Reordered.end(), Indices.begin());
+
+    return Meshlets;
+}
@@ -0,0 +1,702 @@
+#include "model_cook.hpp"
+#include "meshlet.hpp"
+#include "mesh_simplify.hpp"
+#include "core/assertion.hpp"
+#include "core/log.hpp"
+#include "core/math.hpp"
+#include "core/cpu_profiler.hpp"
+#include "core/utility_functions.hpp"
+#include "assimp/Importer.hpp"
+#include "assimp/scene.h"
+#include "assimp/mesh.h"
+#include "assimp/material.h"
+#include "assimp/postprocess.h"
+#include "assimp/DefaultIOSystem.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <optional>
+#include <unordered_map>
+
+static glm::vec3 aiVec2glmVec(aiVector3D aiV)
+{
+    glm::vec3 glmV;
+    glmV.x = aiV.x;
+    glmV.y = aiV.y;
+    glmV.z = aiV.z;
+    return glmV;
+}
+
+static glm::quat aiQuat2glmQuat(aiQuaternion aiQ)
+{
+    glm::quat glmQ;
+    glmQ.w = aiQ.w;
+    glmQ.x = aiQ.x;
+    glmQ.y = aiQ.y;
+    glmQ.z = aiQ.z;
+    return glmQ;
+}
+
+static constexpr uint32_t ImportPostprocessFlags()
+{
+    uint32_t PostprocessFlags =
+            aiProcess_Triangulate
+            | aiProcess_SortByPType
+            | aiProcess_JoinIdenticalVertices
+            | aiProcess_OptimizeMeshes
+            | aiProcess_OptimizeGraph
+            | aiProcess_ImproveCacheLocality
+            | aiProcess_FlipUVs
+            | aiProcess_GenNormals
+            | aiProcess_GenBoundingBoxes
+            | aiProcess_RemoveComponent
+            | aiProcess_RemoveRedundantMaterials
+            | aiProcess_FindInvalidData
+            | aiProcess_GenUVCoords
+            | aiProcess_TransformUVCoords
+            | aiProcess_FindInstances
+            | aiProcess_GlobalScale;
+            //| aiProcess_SplitLargeMeshes;
+
+#ifndef NDEBUG
+    PostprocessFlags |= aiProcess_ValidateDataStructure;
+#endif
+
+    return PostprocessFlags;
+}
+
+//records every file assimp opens, external buffers of a model become part of its cache key this way
+class RecordingIOSystem : public Assimp::DefaultIOSystem
+{
+public:
+    explicit RecordingIOSystem(std::vector<std::fpath>* OutOpened)
+        : Opened(OutOpened)
+    {
+    }
+
+    Assimp::IOStream* Open(const char* File, const char* Mode) override
+    {
+        Assimp::IOStream* Stream = DefaultIOSystem::Open(File, Mode);
+        if(Stream)
+        {
+            Opened->emplace_back(File);
+        }
+
+        return Stream;
+    }
+
+private:
+    std::vector<std::fpath>* Opened;
+};
+
+//the files a source pulled in are only known after an import, so they are cached under the source bytes alone
+static DerivedDataKey DependencyKey(std::span<const uint8_t> Source)
+{
+    return DerivedDataKey{"model dependencies", COOKED_MODEL_VERSION}.Append(Source);
+}
+
+static std::vector<uint8_t> SerializeDependencies(const std::vector<std::string>& Dependencies)
+{
+    std::vector<uint8_t> Data{};
+
+    for(const std::string& Dependency : Dependencies)
+    {
+        uint32_t Size = Dependency.size();
+        Data.insert(Data.end(), reinterpret_cast<const uint8_t*>(&Size), reinterpret_cast<const uint8_t*>(&Size) + sizeof(Size));
+        Data.insert(Data.end(), Dependency.begin(), Dependency.end());
+    }
+
+    return Data;
+}
+
+static std::optional<std::vector<std::string>> ParseDependencies(std::span<const uint8_t> Data)
+{
+    std::vector<std::string> Dependencies{};
+
+    while(!Data.empty())
+    {
+        uint32_t Size;
+        if(Data.size() < sizeof(Size))
+        {
+            return std::nullopt;
+        }
+
+        memcpy(&Size, Data.data(), sizeof(Size));
+        Data = Data.subspan(sizeof(Size));
+
+        if(Data.size() < Size)
+        {
+            return std::nullopt;
+        }
+
+        Dependencies.emplace_back(reinterpret_cast<const char*>(Data.data()), Size);
+        Data = Data.subspan(Size);
+    }
+
+    return Dependencies;
+}
+
+//the source, every file it depends on and every setting that shapes the cook
+//dependencies are relative to the source so a moved asset directory still hits
+static std::optional<DerivedDataKey> CookKey(const std::fpath& SourcePath, std::span<const uint8_t> Source, const std::vector<std::string>& Dependencies)
+{
+    DerivedDataKey Key{"cooked model", COOKED_MODEL_VERSION};
+    Key.Append(Source);
+    Key.Append(ImportPostprocessFlags());
+    Key.Append(uint32_t{MESH_MAX_LODS});
+    Key.Append(uint32_t{MESH_LOD_MIN_TRIANGLES});
+    Key.Append(float{MESH_LOD_MIN_REDUCTION});
+    Key.Append(double{MESH_SIMPLIFY_BOUNDARY_WEIGHT});
+    Key.Append(uint32_t{MESHLET_MAX_VERTICES});
+    Key.Append(uint32_t{MESHLET_MAX_TRIANGLES});
+
+    for(const std::string& Dependency : Dependencies)
+    {
+        std::fpath DependencyPath = SourcePath.parent_path() / Dependency;
+
+        std::error_code Error{};
+        if(!std::filesystem::is_regular_file(DependencyPath, Error))
+        {
+            return std::nullopt;
+        }
+
+        Key.Append(Dependency);
+        Key.Append(ReadFileBinary(DependencyPath));
+    }
+
+    return Key;
+}
+
+std::shared_ptr<const VCookedModel> VCookedModel::Find(const std::fpath& SourcePath)
+{
+    std::vector<uint8_t> Source = ReadFileBinary(SourcePath);
+
+    std::shared_ptr<const DerivedData> DependencyData = GetDerivedDataCache()->Find(DependencyKey(Source));
+    if(!DependencyData)
+    {
+        return nullptr;
+    }
+
+    std::optional<std::vector<std::string>> Dependencies = ParseDependencies(DependencyData->Payload());
+    if(!Dependencies)
+    {
+        return nullptr;
+    }
+
+    std::optional<DerivedDataKey> Key = CookKey(SourcePath, Source, *Dependencies);
+    if(!Key)
+    {
+        return nullptr;
+    }
+
+    std::shared_ptr<const DerivedData> Data = GetDerivedDataCache()->Find(*Key);
+    if(!Data)
+    {
+        return nullptr;
+    }
+
+    auto Cooked = std::make_shared<VCookedModel>();
+    Cooked->Mapping = std::move(Data);
+    Cooked->Bytes = Cooked->Mapping->Payload();
+
+    //the cache checksum passed, so this only fails for cooks of an older layout
+    if(!Cooked->Validate())
+    {
+        LOG_WARNING("cooked model of {} does not match this build, recooking", SourcePath);
+        return nullptr;
+    }
+
+    return Cooked;
+}
+
+std::shared_ptr<const VCookedModel> VCookedModel::FromMemory(std::vector<uint8_t>&& Data)
+{
+    auto Cooked = std::make_shared<VCookedModel>();
+    Cooked->Storage = std::move(Data);
+    Cooked->Bytes = Cooked->Storage;
+
+    VERIFY(Cooked->Validate());
+    return Cooked;
+}
+
+bool VCookedModel::Validate() const
+{
+    auto InBounds = [this](uint64_t Offset, uint64_t Size, uint64_t Alignment = 1)
+    {
+        return Offset % Alignment == 0 && Offset <= Bytes.size() && Size <= Bytes.size() - Offset;
+    };
+
+    if(Bytes.size() < sizeof(CookedModelHeader))
+    {
+        return false;
+    }
+
+    const CookedModelHeader& H = Header();
+
+    if(H.Magic != COOKED_MODEL_MAGIC || H.Version != COOKED_MODEL_VERSION || H.FileSize != Bytes.size())
+    {
+        return false;
+    }
+
+    if(H.MaxLods != MESH_MAX_LODS || H.MeshletMaxVertices != MESHLET_MAX_VERTICES || H.MeshletMaxTriangles != MESHLET_MAX_TRIANGLES)
+    {
+        return false;
+    }
+
+    if(H.NodeCount == 0
+       || !InBounds(H.NodeTableOffset, uint64_t{H.NodeCount} * sizeof(CookedNode), alignof(CookedNode))
+       || !InBounds(H.MeshTableOffset, uint64_t{H.MeshCount} * sizeof(CookedMesh), alignof(CookedMesh))
+       || !InBounds(H.TextureTableOffset, uint64_t{H.TextureCount} * sizeof(CookedTexture), alignof(CookedTexture))
+       || !InBounds(H.RefTableOffset, uint64_t{H.RefCount} * sizeof(uint32_t), alignof(uint32_t)))
+    {
+        return false;
+    }
+
+    std::span<const uint32_t> RefTable = Refs();
+
+    auto RefsInBounds = [&RefTable](uint32_t First, uint32_t Count, uint32_t Limit)
+    {
+        if(uint64_t{First} + Count > RefTable.size())
+        {
+            return false;
+        }
+
+        return std::all_of(RefTable.begin() + First, RefTable.begin() + First + Count, [Limit](uint32_t Ref){ return Ref < Limit; });
+    };
+
+    for(uint32_t Node = 0; Node < H.NodeCount; ++Node)
+    {
+        const CookedNode& NodeEntry = Nodes()[Node];
+
+        bool bValidParent = Node == 0 ? NodeEntry.Parent == UINT32_MAX : NodeEntry.Parent < Node;
+        if(!bValidParent || !RefsInBounds(NodeEntry.FirstMeshRef, NodeEntry.MeshRefCount, H.MeshCount))
+        {
+            return false;
+        }
+    }
+
+    for(const CookedMesh& Mesh : Meshes())
+    {
+        uint64_t BlobSize = uint64_t{Mesh.IndexBufferSize} + Mesh.PositionBufferSize + Mesh.NormalUVBufferSize + Mesh.MeshletBufferSize;
+
+        if(!InBounds(Mesh.NameOffset, Mesh.NameSize) || !InBounds(Mesh.BlobOffset, BlobSize))
+        {
+            return false;
+        }
+
+        if(Mesh.LodCount == 0 || Mesh.LodCount > MESH_MAX_LODS || !RefsInBounds(Mesh.FirstTextureRef, Mesh.TextureRefCount, H.TextureCount))
+        {
+            return false;
+        }
+    }
+
+    for(const CookedTexture& Texture : Textures())
+    {
+        if(!InBounds(Texture.NameOffset, Texture.NameSize) || !InBounds(Texture.DataOffset, Texture.DataSize))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+const CookedModelHeader& VCookedModel::Header() const
+{
+    return *reinterpret_cast<const CookedModelHeader*>(Bytes.data());
+}
+
+std::span<const CookedNode> VCookedModel::Nodes() const
+{
+    return {reinterpret_cast<const CookedNode*>(Bytes.data() + Header().NodeTableOffset), Header().NodeCount};
+}
+
+std::span<const CookedMesh> VCookedModel::Meshes() const
+{
+    return {reinterpret_cast<const CookedMesh*>(Bytes.data() + Header().MeshTableOffset), Header().MeshCount};
+}
+
+std::span<const CookedTexture> VCookedModel::Textures() const
+{
+    return {reinterpret_cast<const CookedTexture*>(Bytes.data() + Header().TextureTableOffset), Header().TextureCount};
+}
+
+std::span<const uint32_t> VCookedModel::Refs() const
+{
+    return {reinterpret_cast<const uint32_t*>(Bytes.data() + Header().RefTableOffset), Header().RefCount};
+}
+
+std::string_view VCookedModel::String(uint64_t Offset, uint32_t Size) const
+{
+    return {reinterpret_cast<const char*>(Bytes.data() + Offset), Size};
+}
+
+const uint8_t* VCookedModel::Data(uint64_t Offset) const
+{
+    return Bytes.data() + Offset;
+}
+
+struct CookedMeshData
+{
+    CookedMesh Mesh{};
+    std::string Name;
+    std::vector<uint32_t> TextureRefs;
+    std::vector<uint8_t> Blob;
+};
+
+struct CookedTextureData
+{
+    CookedTexture Texture{};
+    std::string Name;
+    const aiTexture* EmbeddedTexture = nullptr;
+};
+
+static void CookMesh(CookedMeshData* OutMesh, const aiMesh* ImportMesh)
+{
+    PROFILE_SCOPE("Cook Mesh");
+
+    CookedMesh& Mesh = OutMesh->Mesh;
+    Mesh.IndexCount = ImportMesh->mNumFaces * 3u;
+    Mesh.VertexCount = ImportMesh->mNumVertices;
+
+    glm::vec3 BoundsMin = aiVec2glmVec(ImportMesh->mAABB.mMin);
+    glm::vec3 BoundsMax = aiVec2glmVec(ImportMesh->mAABB.mMax);
+    glm::vec3 BoundsCenter = (BoundsMin + BoundsMax) / 2.0f;
+    float BoundsRadius = glm::distance(BoundsMin, BoundsMax) / 2.0f;
+    Mesh.SphereBounds = glm::vec4{BoundsCenter, BoundsRadius};
+
+    //the simplifier and meshlet builder rewrite the triangles, so indices and positions are gathered before the blob is written
+    std::vector<uint32_t> Indices(Mesh.IndexCount);
+    std::vector<glm::fvec3> Positions(Mesh.VertexCount);
+
+    for(uint64_t face = 0; face < ImportMesh->mNumFaces; ++face)
+    {
+        ASSERT(ImportMesh->mFaces[face].mNumIndices == 3);
+        for(uint64_t index = 0; index < ImportMesh->mFaces[face].mNumIndices; ++index)
+        {
+            ASSERT(ImportMesh->mFaces[face].mIndices[index] <= UINT32_MAX);
+            Indices[(face * 3) + index] = ImportMesh->mFaces[face].mIndices[index];
+        }
+    }
+
+    for(uint64_t vertex = 0; vertex < ImportMesh->mNumVertices; ++vertex)
+    {
+        Positions[vertex] = aiVec2glmVec(ImportMesh->mVertices[vertex]);
+    }
+
+    //every level halves the previous one until the simplifier stops making progress
+    std::vector<std::vector<uint32_t>> LodIndices{};
+    std::vector<float> LodErrors{};
+    LodIndices.emplace_back(std::move(Indices));
+    LodErrors.emplace_back(0.f);
+
+    while(LodIndices.size() < MESH_MAX_LODS && LodIndices.back().size() / 3 > MESH_LOD_MIN_TRIANGLES)
+    {
+        const std::vector<uint32_t>& Previous = LodIndices.back();
+
+        float Error = 0.f;
+        std::vector<uint32_t> Simplified = SimplifyMesh(Previous, Positions, Previous.size() / 6 * 3, &Error);
+
+        if(Simplified.empty() || Simplified.size() > Previous.size() * MESH_LOD_MIN_REDUCTION)
+        {
+            break;
+        }
+
+        //the error is measured against the previous level, not the original surface
+        LodErrors.emplace_back(LodErrors.back() + Error);
+        LodIndices.emplace_back(std::move(Simplified));
+    }
+
+    //all levels end up back to back in one index range
+    Indices.clear();
+
+    std::vector<VShaderMeshlet> Meshlets{};
+    Mesh.LodCount = LodIndices.size();
+    Mesh.MeshletCount = 0;
+
+    for(uint32_t Lod = 0; Lod < Mesh.LodCount; ++Lod)
+    {
+        std::vector<VShaderMeshlet> LodMeshlets = BuildMeshlets(LodIndices[Lod], Positions);
+
+        VShaderMeshLod& MeshLod = Mesh.Lods[Lod];
+        MeshLod.indexOffset = Indices.size();
+        MeshLod.indexCount = LodIndices[Lod].size();
+        MeshLod.meshletOffset = Meshlets.size();
+        MeshLod.meshletCount = LodMeshlets.size();
+        MeshLod.error = LodErrors[Lod];
+
+        //meshlets address triangles from the start of the mesh index slot
+        for(VShaderMeshlet& Meshlet : LodMeshlets)
+        {
+            Meshlet.TriangleOffset += MeshLod.indexOffset / 3;
+        }
+
+        Indices.insert(Indices.end(), LodIndices[Lod].begin(), LodIndices[Lod].end());
+        Meshlets.insert(Meshlets.end(), LodMeshlets.begin(), LodMeshlets.end());
+        Mesh.MeshletCount = std::max<uint32_t>(Mesh.MeshletCount, LodMeshlets.size());
+    }
+
+    LOG_DEBUG("mesh {} has {} levels of detail, {} to {} triangles", OutMesh->Name, Mesh.LodCount, Mesh.Lods[0].indexCount / 3, Mesh.Lods[Mesh.LodCount - 1].indexCount / 3);
+
+    Mesh.IndexBufferSize = Indices.size() * sizeof(uint32_t);
+    Mesh.PositionBufferSize = Mesh.VertexCount * sizeof(glm::fvec3);
+    Mesh.NormalUVBufferSize = Mesh.VertexCount * sizeof(NormalUV);
+    Mesh.MeshletBufferSize = Meshlets.size() * sizeof(VShaderMeshlet);
+
+    OutMesh->Blob.resize(Mesh.IndexBufferSize + Mesh.PositionBufferSize + Mesh.NormalUVBufferSize + Mesh.MeshletBufferSize);
+    uint8_t* Blob = OutMesh->Blob.data();
+
+    auto* NormalsUVs = reinterpret_cast<NormalUV*>(Blob + Mesh.IndexBufferSize + Mesh.PositionBufferSize);
+
+    memcpy(Blob + 0, Indices.data(), Mesh.IndexBufferSize);
+    memcpy(Blob + Mesh.IndexBufferSize, Positions.data(), Mesh.PositionBufferSize);
+    memcpy(Blob + Mesh.IndexBufferSize + Mesh.PositionBufferSize + Mesh.NormalUVBufferSize, Meshlets.data(), Mesh.MeshletBufferSize);
+
+    for(uint64_t vertex = 0; vertex < ImportMesh->mNumVertices; ++vertex)
+    {
+        if(ImportMesh->HasNormals())
+        {
+            glm::vec3 Normal = aiVec2glmVec(ImportMesh->mNormals[vertex]);
+            glm::vec2 OctNormal = math::oct_encode(glm::normalize(Normal));
+            NormalsUVs[vertex].Normal = glm::packSnorm2x16(OctNormal);
+        }
+        else
+        {
+            NormalsUVs[vertex].Normal = 0;
+        }
+
+        if(ImportMesh->HasTextureCoords(0))
+        {
+            glm::vec3 UVW = aiVec2glmVec(ImportMesh->mTextureCoords[0][vertex]);
+            NormalsUVs[vertex].UV = glm::packUnorm2x16(UVW.xy);
+        }
+        else
+        {
+            NormalsUVs[vertex].UV = 0;
+        }
+    }
+}
+
+static void FlattenNodes(const aiNode* ImportNode, uint32_t Parent, std::vector<CookedNode>& Nodes, std::vector<uint32_t>& Refs, std::vector<uint32_t>& MeshRemap, std::vector<uint32_t>& MeshSources)
+{
+    uint32_t NodeIndex = Nodes.size();
+    CookedNode& Node = Nodes.emplace_back();
+    Node.Parent = Parent;
+    Node.FirstMeshRef = Refs.size();
+    Node.MeshRefCount = ImportNode->mNumMeshes;
+
+    aiVector3D Translation; aiQuaternion Rotation; aiVector3D Scale;
+    ImportNode->mTransformation.Decompose(Scale, Rotation, Translation);
+
+    Node.Transform.Translation = aiVec2glmVec(Translation);
+    Node.Transform.Rotation = aiQuat2glmQuat(Rotation);
+    Node.Transform.Scale = aiVec2glmVec(Scale);
+
+    //instanced meshes are cooked once and referenced by every node that uses them
+    for(uint64_t Mesh = 0; Mesh < ImportNode->mNumMeshes; ++Mesh)
+    {
+        uint32_t SourceIndex = ImportNode->mMeshes[Mesh];
+        if(MeshRemap[SourceIndex] == UINT32_MAX)
+        {
+            MeshRemap[SourceIndex] = MeshSources.size();
+            MeshSources.emplace_back(SourceIndex);
+        }
+
+        Refs.emplace_back(MeshRemap[SourceIndex]);
+    }
+
+    for(uint64_t Child = 0; Child < ImportNode->mNumChildren; ++Child)
+    {
+        FlattenNodes(ImportNode->mChildren[Child], NodeIndex, Nodes, Refs, MeshRemap, MeshSources);
+    }
+}
+
+std::vector<uint8_t> CookModel(const std::fpath& SourcePath)
+{
+    PROFILE_SCOPE("Cook Model");
+    LOG_INFO("cooking model - {}", SourcePath);
+
+    CookedModelHeader Header{};
+    Header.Magic = COOKED_MODEL_MAGIC;
+    Header.Version = COOKED_MODEL_VERSION;
+    Header.MaxLods = MESH_MAX_LODS;
+    Header.MeshletMaxVertices = MESHLET_MAX_VERTICES;
+    Header.MeshletMaxTriangles = MESHLET_MAX_TRIANGLES;
+
+    std::vector<uint8_t> Source = ReadFileBinary(SourcePath);
+    std::vector<std::fpath> Opened{};
+
+    Assimp::Importer Importer{};
+    Importer.SetIOHandler(new RecordingIOSystem{&Opened});
+    Importer.SetPropertyInteger(AI_CONFIG_PP_RVC_FLAGS, aiComponent_COLORS | aiComponent_CAMERAS);
+    Importer.SetPropertyInteger(AI_CONFIG_PP_SBP_REMOVE, aiPrimitiveType_LINE | aiPrimitiveType_POINT);
+    Importer.SetPropertyInteger(AI_CONFIG_PP_SLM_TRIANGLE_LIMIT, UINT16_MAX / 3u);
+    Importer.SetPropertyInteger(AI_CONFIG_PP_SLM_VERTEX_LIMIT, INT32_MAX);
+    Importer.SetPropertyInteger(AI_CONFIG_PP_ICL_PTCACHE_SIZE, 24); //Just a guess
+
+#ifndef NDEBUG
+    Importer.SetExtraVerbose(true);
+#endif
+
+    const aiScene* Scene = Importer.ReadFile(SourcePath, ImportPostprocessFlags());
+    VERIFY(Scene && Scene->mRootNode && !(Scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE), Importer.GetErrorString());
+
+    std::string SceneName{Scene->mName.data, Scene->mName.length};
+
+    std::vector<CookedNode> Nodes{};
+    std::vector<uint32_t> Refs{};
+    std::vector<uint32_t> MeshRemap(Scene->mNumMeshes, UINT32_MAX);
+    std::vector<uint32_t> MeshSources{};
+
+    FlattenNodes(Scene->mRootNode, UINT32_MAX, Nodes, Refs, MeshRemap, MeshSources);
+
+    std::vector<CookedMeshData> Meshes(MeshSources.size());
+    std::vector<CookedTextureData> Textures{};
+    std::unordered_map<std::string, uint32_t> TextureRemap{};
+
+    for(uint32_t Mesh = 0; Mesh < Meshes.size(); ++Mesh)
+    {
+        uint32_t SourceIndex = MeshSources[Mesh];
+        const aiMesh* ImportMesh = Scene->mMeshes[SourceIndex];
+
+        std::string MeshName{ImportMesh->mName.data, ImportMesh->mName.length};
+        if(MeshName.empty())
+        {
+            MeshName = "empty_name";
+        }
+
+        Meshes[Mesh].Name = fmt::format("{}.{}.[{}]", SceneName, MeshName, SourceIndex);
+
+        const aiMaterial* Material = Scene->mMaterials[ImportMesh->mMaterialIndex];
+
+        auto ProcessTexture = [&](aiTextureType TextureType)
+        {
+            for(uint32_t idx = 0; idx < Material->GetTextureCount(TextureType); ++idx)
+            {
+                aiString AiTextureName;
+                VERIFY(Material->GetTexture(TextureType, idx, &AiTextureName) == AI_SUCCESS);
+
+                const aiTexture* EmbeddedTexture = Scene->GetEmbeddedTexture(AiTextureName.C_Str());
+
+                std::string TextureName = EmbeddedTexture ? fmt::format("{}.{}", SceneName, AiTextureName.C_Str()) : std::string{AiTextureName.C_Str()};
+
+                auto[it, inserted] = TextureRemap.emplace(TextureName, Textures.size());
+                if(inserted)
+                {
+                    CookedTextureData& Texture = Textures.emplace_back();
+                    Texture.Name = std::move(TextureName);
+                    Texture.Texture.Type = TextureType;
+                    Texture.EmbeddedTexture = EmbeddedTexture;
+                }
+
+                Meshes[Mesh].TextureRefs.emplace_back(it->second);
+            }
+        };
+
+        ProcessTexture(aiTextureType_BASE_COLOR);
+    }
+
+    //the levels of detail and meshlets are what makes a cook slow, every mesh is built on its own worker
+    global::Scheduler.ParallelFor(JobPriority::Streaming, 0, Meshes.size(), [&](uint64_t Mesh)
+    {
+        CookMesh(&Meshes[Mesh], Scene->mMeshes[MeshSources[Mesh]]);
+    });
+
+    for(CookedMeshData& Mesh : Meshes)
+    {
+        Mesh.Mesh.FirstTextureRef = Refs.size();
+        Mesh.Mesh.TextureRefCount = Mesh.TextureRefs.size();
+        Refs.insert(Refs.end(), Mesh.TextureRefs.begin(), Mesh.TextureRefs.end());
+    }
+
+    std::vector<uint8_t> Data{};
+
+    auto Allocate = [&Data](uint64_t Size, uint64_t Alignment)
+    {
+        uint64_t Offset = math::PadSize2Alignment(Data.size(), Alignment);
+        Data.resize(Offset + Size);
+        return Offset;
+    };
+
+    auto Append = [&Data, &Allocate](const void* Source, uint64_t Size, uint64_t Alignment)
+    {
+        uint64_t Offset = Allocate(Size, Alignment);
+        memcpy(Data.data() + Offset, Source, Size);
+        return Offset;
+    };
+
+    Allocate(sizeof(CookedModelHeader), alignof(CookedModelHeader));
+
+    Header.NodeCount = Nodes.size();
+    Header.MeshCount = Meshes.size();
+    Header.TextureCount = Textures.size();
+    Header.RefCount = Refs.size();
+    Header.NodeTableOffset = Append(Nodes.data(), Nodes.size() * sizeof(CookedNode), alignof(CookedNode));
+    Header.MeshTableOffset = Allocate(Meshes.size() * sizeof(CookedMesh), alignof(CookedMesh));
+    Header.TextureTableOffset = Allocate(Textures.size() * sizeof(CookedTexture), alignof(CookedTexture));
+    Header.RefTableOffset = Append(Refs.data(), Refs.size() * sizeof(uint32_t), alignof(uint32_t));
+
+    for(CookedMeshData& Mesh : Meshes)
+    {
+        Mesh.Mesh.NameOffset = Append(Mesh.Name.data(), Mesh.Name.size(), 1);
+        Mesh.Mesh.NameSize = Mesh.Name.size();
+        Mesh.Mesh.BlobOffset = Append(Mesh.Blob.data(), Mesh.Blob.size(), 16);
+    }
+
+    for(CookedTextureData& Texture : Textures)
+    {
+        Texture.Texture.NameOffset = Append(Texture.Name.data(), Texture.Name.size(), 1);
+        Texture.Texture.NameSize = Texture.Name.size();
+
+        if(const aiTexture* EmbeddedTexture = Texture.EmbeddedTexture)
+        {
+            //compressed images keep their size in mWidth, raw ones are mWidth * mHeight texels
+            Texture.Texture.Width = EmbeddedTexture->mWidth;
+            Texture.Texture.Height = EmbeddedTexture->mHeight;
+            Texture.Texture.DataSize = EmbeddedTexture->mHeight == 0 ? EmbeddedTexture->mWidth : EmbeddedTexture->mWidth * EmbeddedTexture->mHeight * sizeof(aiTexel);
+            Texture.Texture.DataOffset = Append(EmbeddedTexture->pcData, Texture.Texture.DataSize, 16);
+        }
+    }
+
+    //the tables are filled last since they hold the offsets of everything after them
+    for(uint32_t Mesh = 0; Mesh < Meshes.size(); ++Mesh)
+    {
+        memcpy(Data.data() + Header.MeshTableOffset + Mesh * sizeof(CookedMesh), &Meshes[Mesh].Mesh, sizeof(CookedMesh));
+    }
+
+    for(uint32_t Texture = 0; Texture < Textures.size(); ++Texture)
+    {
+        memcpy(Data.data() + Header.TextureTableOffset + Texture * sizeof(CookedTexture), &Textures[Texture].Texture, sizeof(CookedTexture));
+    }
+
+    Header.FileSize = Data.size();
+    memcpy(Data.data(), &Header, sizeof(CookedModelHeader));
+
+    std::error_code Error{};
+    std::fpath SourceDirectory = std::filesystem::weakly_canonical(SourcePath, Error).parent_path();
+    std::vector<std::string> Dependencies{};
+
+    for(const std::fpath& File : Opened)
+    {
+        std::fpath Dependency = std::filesystem::weakly_canonical(File, Error).lexically_relative(SourceDirectory);
+        if(!Dependency.empty() && Dependency != SourcePath.filename())
+        {
+            Dependencies.emplace_back(Dependency.string());
+        }
+    }
+
+    std::sort(Dependencies.begin(), Dependencies.end());
+    Dependencies.erase(std::unique(Dependencies.begin(), Dependencies.end()), Dependencies.end());
+
+    std::optional<DerivedDataKey> Key = CookKey(SourcePath, Source, Dependencies);
+    if(Key)
+    {
+        //the cook goes in first, a dependency list without its cook would only cost a miss
+        GetDerivedDataCache()->Store(*Key, Data);
+        GetDerivedDataCache()->Store(DependencyKey(Source), SerializeDependencies(Dependencies));
+    }
+
+    LOG_INFO("finished cooking model - {}, {} nodes {} meshes {} bytes", SourcePath, Nodes.size(), Meshes.size(), Data.size());
+    return Data;
+}
@@ -0,0 +1,96 @@
+#include "vk_bindless.hpp"
+#include "core/assertion.hpp"
+
+void VBindlessTable::Reset(vk::DescriptorPoolSize PoolSize_, uint32_t Binding_)
+{
+    ASSERT(PoolSize_.descriptorCount <= BINDLESS_INDEX_MASK + 1);
+
+    PoolSize = PoolSize_;
+    Binding = Binding_;
+
+    Next = std::make_unique<std::atomic_uint32_t[]>(PoolSize.descriptorCount);
+    Generations = std::make_unique<std::atomic_uint32_t[]>(PoolSize.descriptorCount);
+    FreeHead.store(NoSlot, std::memory_order_relaxed);
+    HighWater.store(1, std::memory_order_relaxed);
+    Frame.store(0, std::memory_order_relaxed);
+}
+
+void VBindlessTable::Push(uint32_t Index)
+{
+    uint64_t Head = FreeHead.load(std::memory_order_relaxed);
+    uint64_t NewHead;
+
+    do
+    {
+        Next[Index].store(static_cast<uint32_t>(Head), std::memory_order_relaxed);
+        NewHead = ((Head >> 32) + 1) << 32 | Index;
+    }
+    while(!FreeHead.compare_exchange_weak(Head, NewHead, std::memory_order_release, std::memory_order_relaxed));
+}
+
+uint32_t VBindlessTable::Pop()
+{
+    uint64_t Head = FreeHead.load(std::memory_order_acquire);
+    uint64_t NewHead;
+
+    do
+    {
+        uint32_t Index = static_cast<uint32_t>(Head);
+        if(Index == NoSlot)
+        {
+            return NoSlot;
+        }
+
+        //the links live as long as the table, so reading one that was popped meanwhile is harmless, the tag fails the exchange
+        NewHead = ((Head >> 32) + 1) << 32 | Next[Index].load(std::memory_order_relaxed);
+    }
+    while(!FreeHead.compare_exchange_weak(Head, NewHead, std::memory_order_acquire, std::memory_order_acquire));
+
+    return static_cast<uint32_t>(Head);
+}
+
+VBindlessHandle VBindlessTable::Grab()
+{
+    uint32_t Index = Pop();
+    if(Index == NoSlot)
+    {
+        Index = HighWater.fetch_add(1, std::memory_order_relaxed);
+        VERIFY(Index < PoolSize.descriptorCount, "bindless table is full", vk::to_string(PoolSize.type));
+    }
+
+    uint32_t Generation = Generations[Index].load(std::memory_order_relaxed);
+    return VBindlessHandle{(Generation << BINDLESS_INDEX_BITS) | Index};
+}
+
+void VBindlessTable::Free(VBindlessHandle Handle)
+{
+    ASSERT(IsCurrent(Handle), Handle.Index(), Handle.Generation());
+
+    uint32_t Index = Handle.Index();
+    Generations[Index].fetch_add(1, std::memory_order_relaxed);
+
+    Retired[Frame.load(std::memory_order_acquire) % Retired.size()].enqueue(Index);
+}
+
+bool VBindlessTable::IsCurrent(VBindlessHandle Handle) const
+{
+    uint32_t Generation = Generations[Handle.Index()].load(std::memory_order_relaxed);
+    return Handle && (Generation & (UINT32_MAX >> BINDLESS_INDEX_BITS)) == Handle.Generation();
+}
+
+void VBindlessTable::BeginFrame()
+{
+    uint64_t Current = Frame.fetch_add(1, std::memory_order_acq_rel) + 1;
+
+    //the bucket of frame Current - FRAMES_IN_FLIGHT, whose fence was just waited on
+    moodycamel::ConcurrentQueue<uint32_t>& Bucket = Retired[(Current + 1) % Retired.size()];
+
+    std::array<uint32_t, 64> Indices;
+    while(uint64_t Count = Bucket.try_dequeue_bulk(Indices.data(), Indices.size()))
+    {
+        for(uint64_t Index = 0; Index < Count; ++Index)
+        {
+            Push(Indices[Index]);
+        }
+    }
+}
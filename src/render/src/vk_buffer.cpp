@@ -21,9 +21,6 @@ void vka::AllocatedBuffer::Resize(uint64_t NewSize)
     }
     else
     {
-        vk::CommandBuffer CommandBuffer = vkContext->RequestTransferCommandBuffer("buffer data copy");
-        //vkContext->SubmitTransferCommands(CommandBuffer);
-
         auto BufferCreateInfo = vk::BufferCreateInfo{}
                 .setSize(TotalSize)
                 .setUsage(BufferUsage);
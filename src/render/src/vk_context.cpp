@@ -324,6 +324,9 @@ VContext::VContext(const BaseInitializer& Initializer)
     ShaderModuleCache.emplace(this);
     DestructionQueue.emplace_back([this]{ShaderModuleCache.reset();});
 
+    Uploader.emplace(this);
+    DestructionQueue.emplace_back([this]{Uploader.reset();});
+
     ModelManager.emplace(this);
     DestructionQueue.emplace_back([this]{ModelManager.reset();});
 }
@@ -498,6 +501,14 @@ duplicate:;
     NameObject(QueueHandles.Present, "presentation queue");
     NameObject(QueueHandles.Transfer, "transfer queue");
     NameObject(QueueHandles.Compute, "compute queue");
+
+    bAsyncCompute = ASYNC_COMPUTE && QueueIndices.Compute != UINT32_MAX && QueueIndices.Compute != QueueIndices.Graphics;
+    if(bAsyncCompute)
+    {
+        SharedQueueFamilies = {QueueIndices.Graphics, QueueIndices.Compute};
+    }
+
+    LOG_INFO("async compute {}", bAsyncCompute ? "enabled" : "disabled, compute shares the graphics family");
 }
 
 void VContext::CreateMemoryAllocator()
@@ -533,16 +544,19 @@ void VContext::CreateCommandPool()
         Device.destroyCommandPool(GraphicsCommandPool);
     });
 
-    auto TransferPoolInfo = vk::CommandPoolCreateInfo{}
-            .setQueueFamilyIndex(QueueIndices.Transfer)
-            .setFlags(vk::CommandPoolCreateFlagBits::eTransient);
+    if(bAsyncCompute)
+    {
+        auto ComputePoolInfo = vk::CommandPoolCreateInfo{}
+                .setQueueFamilyIndex(QueueIndices.Compute)
+                .setFlags(vk::CommandPoolCreateFlagBits::eResetCommandBuffer);
 
-    TransferCommandPool = Device.createCommandPool(TransferPoolInfo);
-    NameObject(TransferCommandPool, "transfer command pool");
+        ComputeCommandPool = Device.createCommandPool(ComputePoolInfo);
+        NameObject(ComputeCommandPool, "compute command pool");
 
-    DestructionQueue.emplace_back([this]{
-        Device.destroyCommandPool(TransferCommandPool);
-    });
+        DestructionQueue.emplace_back([this]{
+            Device.destroyCommandPool(ComputeCommandPool);
+        });
+    }
 }
 
 VGraphicsPipelineBuilder VContext::MakeGraphicsPipelineBuilder()
@@ -560,44 +574,6 @@ VDescriptorBuilder VContext::MakeDescriptorBuilder()
     return VDescriptorBuilder{&DescriptorAllocator.value(), &DescriptorLayoutCache.value()};
 }
 
-vk::CommandBuffer VContext::RequestTransferCommandBuffer(std::string Description)
-{
-    TransferMutex.lock();
-
-    auto CommandBufferAllocateInfo = vk::CommandBufferAllocateInfo{}
-            .setCommandPool(TransferCommandPool)
-            .setLevel(vk::CommandBufferLevel::ePrimary)
-            .setCommandBufferCount(1);
-
-    vk::CommandBuffer CommandBuffer = nullptr;
-    vkResultCheck = Device.allocateCommandBuffers(&CommandBufferAllocateInfo, &CommandBuffer);
-
-    NameObject(CommandBuffer, Description);
-    vkutil::push_label(QueueHandles.Transfer, Description);
-
-    auto CommandBeginInfo = vk::CommandBufferBeginInfo{}
-            .setFlags(vk::CommandBufferUsageFlagBits::eOneTimeSubmit);
-
-    CommandBuffer.begin(CommandBeginInfo);
-    return CommandBuffer;
-}
-
-void VContext::SubmitTransferCommands(vk::CommandBuffer Commands, vk::SubmitInfo2 Submits)
-{
-    Commands.end();
-    QueueHandles.Transfer.submit2(Submits);
-
-    vkutil::pop_label(QueueHandles.Transfer);
-    TransferMutex.unlock();
-}
-
-void VContext::FreeTransferCommandBuffer(vk::CommandBuffer Commands)
-{
-    TransferMutex.lock();
-    Device.freeCommandBuffers(TransferCommandPool, Commands);
-    TransferMutex.unlock();
-}
-
 vk::Format VContext::PickImageFormat(vk::FormatFeatureFlags feature_flags, std::span<vk::Format> candidates) const
 {
     for(vk::Format format : candidates)
@@ -628,13 +604,13 @@ vk::Format VContext::PickBufferFormat(vk::FormatFeatureFlags feature_flags, std:
     VERIFY(false, "no viable buffer format found"); return {};
 }
 
-void VContext::NameObject(uint64_t Handle, vk::ObjectType Type, const std::string& Name)
+void VContext::NameObject(uint64_t Handle, vk::ObjectType Type, const char* Name)
 {
 #ifndef NDEBUG
     vk::DebugUtilsObjectNameInfoEXT info{};
     info.objectHandle = Handle;
     info.objectType = Type;
-    info.pObjectName = Name.c_str();
+    info.pObjectName = Name;
 
     Device.setDebugUtilsObjectNameEXT(info);
 #endif
@@ -651,8 +627,9 @@ void VContext::CreateShaderDescriptorTable()
 
     const vk::PhysicalDeviceLimits& Limits = PhysicalDeviceProperties.properties.limits;
 
+    //handles only have room for so many slots, some drivers report limits far past anything a scene uses
     std::array<vk::DescriptorPoolSize, 1> PoolSizes{
-        vk::DescriptorPoolSize{vk::DescriptorType::eCombinedImageSampler, Limits.maxPerStageDescriptorSampledImages},
+        vk::DescriptorPoolSize{vk::DescriptorType::eCombinedImageSampler, std::min(Limits.maxPerStageDescriptorSampledImages, BINDLESS_INDEX_MASK + 1)},
     };
 
     auto DescriptorPoolCreateInfo = vk::DescriptorPoolCreateInfo{}
@@ -672,13 +649,13 @@ void VContext::CreateShaderDescriptorTable()
 
     for(uint64_t Binding = 0; Binding < PoolSizes.size(); ++Binding)
     {
-        DescriptorSetFreeLists[Binding].PoolSize = PoolSizes[Binding];
+        BindlessTables[Binding].Reset(PoolSizes[Binding], Binding);
 
         LayoutBindings[Binding]
                 .setBinding(Binding)
                 .setDescriptorCount(PoolSizes[Binding].descriptorCount)
                 .setDescriptorType(PoolSizes[Binding].type)
-                .setStageFlags(vk::ShaderStageFlagBits::eFragment);
+                .setStageFlags(ShaderResourceStages);
 
         LayoutFlags[Binding] = vk::DescriptorBindingFlagBits::ePartiallyBound | vk::DescriptorBindingFlagBits::eUpdateAfterBind;
     }
@@ -707,42 +684,69 @@ void VContext::CreateShaderDescriptorTable()
     NameObject(ShaderResourceSet, "ShaderResourceSet");
 }
 
-uint32_t VContext::GrabDescriptorSlot(vk::DescriptorType Type)
+VBindlessHandle VContext::GrabDescriptorSlot(vk::DescriptorType Type)
+{
+    return FindBindlessTable(Type)->Grab();
+}
+
+void VContext::FreeDescriptorSlot(vk::DescriptorType Type, VBindlessHandle Handle)
 {
-    DescriptorSetFreeList* List = FindFreeList(Type);
-    std::lock_guard Lock{List->ListMX};
+    FindBindlessTable(Type)->Free(Handle);
+}
+
+void VContext::WriteDescriptorSlot(vk::DescriptorType Type, VBindlessHandle Handle, const vk::DescriptorImageInfo& ImageInfo)
+{
+    PendingBindlessWrites.enqueue(VBindlessWrite{Handle, Type, ImageInfo});
+}
 
-    if(!List->FreeList.empty())
+void VContext::BeginBindlessFrame()
+{
+    for(VBindlessTable& Table : BindlessTables)
     {
-        uint32_t Slot = List->FreeList.front();
-        List->FreeList.pop_front();
-        return Slot;
+        Table.BeginFrame();
     }
-    else
-    {
-        ASSERT(List->LastSlot < List->PoolSize.descriptorCount);
 
-        List->LastSlot += 1;
-        return List->LastSlot;
+    std::vector<VBindlessWrite> Pending(PendingBindlessWrites.size_approx());
+    Pending.resize(PendingBindlessWrites.try_dequeue_bulk(Pending.begin(), Pending.size()));
+
+    if(Pending.empty())
+    {
+        return;
     }
-}
 
-void VContext::FreeDescriptorSlot(vk::DescriptorType Type, uint32_t Slot)
-{
-    DescriptorSetFreeList* List = FindFreeList(Type);
+    std::vector<vk::WriteDescriptorSet> Writes{};
+    Writes.reserve(Pending.size());
 
-    List->ListMX.lock();
-    List->FreeList.push_back(Slot);
-    List->ListMX.unlock();
+    for(const VBindlessWrite& Write : Pending)
+    {
+        VBindlessTable* Table = FindBindlessTable(Write.Type);
+
+        //freed before it was ever written, the slot may already belong to someone else
+        if(!Table->IsCurrent(Write.Handle))
+        {
+            continue;
+        }
+
+        Writes.emplace_back()
+                .setDescriptorType(Write.Type)
+                .setDescriptorCount(1)
+                .setDstSet(ShaderResourceSet)
+                .setDstBinding(Table->Binding)
+                .setDstArrayElement(Write.Handle.Index())
+                .setPImageInfo(&Write.ImageInfo);
+    }
+
+    //update after bind, so slots the frames in flight do not use can change under them
+    Device.updateDescriptorSets(Writes, {});
 }
 
-DescriptorSetFreeList* VContext::FindFreeList(vk::DescriptorType Type)
+VBindlessTable* VContext::FindBindlessTable(vk::DescriptorType Type)
 {
-    for(DescriptorSetFreeList& FreeList : DescriptorSetFreeLists)
+    for(VBindlessTable& Table : BindlessTables)
     {
-        if(FreeList.PoolSize.type == Type)
+        if(Table.PoolSize.type == Type)
         {
-            return &FreeList;
+            return &Table;
         }
     }
 
@@ -762,6 +766,14 @@ VAllocatedBuffer VContext::AllocateBuffer(uint64_t Size, vk::BufferUsageFlags Bu
             .setUsage(BufferUsage)
             .setSharingMode(vk::SharingMode::eExclusive);
 
+    //the scene and culling buffers are written on the compute queue and read on the graphics queue every frame
+    if(!SharedQueueFamilies.empty())
+    {
+        BufferCreateInfo
+                .setSharingMode(vk::SharingMode::eConcurrent)
+                .setQueueFamilyIndices(SharedQueueFamilies);
+    }
+
     auto AllocationCreateInfo = vma::AllocationCreateInfo{}
             .setFlags(AllocationFlags)
             .setUsage(MemoryUsage);
@@ -831,121 +843,291 @@ void VContext::AllocateGlobalIndexAndVertexBuffer()
 {
     LOG_INFO("allocating global index and vertex buffer");
 
-    GlobalIndexBuffer = AllocateBuffer(100000000, //1 gigabyte
-                   vk::BufferUsageFlagBits::eIndexBuffer | vk::BufferUsageFlagBits::eTransferDst,
+    GlobalIndexBuffer = AllocateBuffer(GEOMETRY_BUFFER_INITIAL_SIZE,
+                   vk::BufferUsageFlagBits::eIndexBuffer | vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eTransferSrc | vk::BufferUsageFlagBits::eShaderDeviceAddress,
                    vma::AllocationCreateFlagBits::eDedicatedMemory | vma::AllocationCreateFlagBits::eStrategyBestFit,
                     vma::MemoryUsage::eAutoPreferDevice,
                     "Global Index Buffer");
 
+    IndexBufferAllocator.emplace(GlobalIndexBuffer.Size);
+
     DestructionQueue.emplace_back([this]{
-        ASSERT(IndexBufferAllocationList.size() == 2, ASSERTION::NONFATAL);
+        ASSERT(IndexBufferAllocator->GetStats().AllocationCount == 0, ASSERTION::NONFATAL);
+        IndexBufferAllocator.reset();
         Allocator.destroyBuffer(GlobalIndexBuffer.Buffer, GlobalIndexBuffer.Allocation);
     });
 
-    IndexBufferAllocationList.emplace_back(BufferAllocationSlot{
-        .Offset = 0,
-        .Size = 0
-    });
-
-    IndexBufferAllocationList.emplace_back(BufferAllocationSlot{
-        .Offset = static_cast<uint32_t>(GlobalIndexBuffer.Size),
-        .Size = 0
-    });
-
-    GlobalVertexBuffer = AllocateBuffer(100000000, //1 gigabyte
-                   vk::BufferUsageFlagBits::eVertexBuffer | vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eShaderDeviceAddress,
+    GlobalVertexBuffer = AllocateBuffer(GEOMETRY_BUFFER_INITIAL_SIZE,
+                   vk::BufferUsageFlagBits::eVertexBuffer | vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eTransferSrc | vk::BufferUsageFlagBits::eShaderDeviceAddress,
                    vma::AllocationCreateFlagBits::eDedicatedMemory | vma::AllocationCreateFlagBits::eStrategyBestFit,
                    vma::MemoryUsage::eAutoPreferDevice,
                    "Global Vertex Buffer");
 
+    VertexBufferAllocator.emplace(GlobalVertexBuffer.Size);
+
     DestructionQueue.emplace_back([this]{
-        ASSERT(VertexBufferAllocationList.size() == 2, ASSERTION::NONFATAL);
+        ASSERT(VertexBufferAllocator->GetStats().AllocationCount == 0, ASSERTION::NONFATAL);
+        VertexBufferAllocator.reset();
         Allocator.destroyBuffer(GlobalVertexBuffer.Buffer, GlobalVertexBuffer.Allocation);
     });
-
-    VertexBufferAllocationList.emplace_back(BufferAllocationSlot{
-            .Offset = 0,
-            .Size = 0
-    });
-
-    VertexBufferAllocationList.emplace_back(BufferAllocationSlot{
-            .Offset = static_cast<uint32_t>(GlobalVertexBuffer.Size),
-            .Size = 0
-    });
 }
 
-BufferAllocationSlot VContext::GrabIndexBufferMemory(uint32_t Size, uint32_t Alignment)
+//only the bookkeeping grows here, the buffer itself is replaced on the next upload flush
+static RangeAllocation AllocateGrowing(RangeAllocator& RangeAlloc, uint32_t Size, uint32_t Alignment, uint64_t Owner, const char* BufferName)
 {
-    std::lock_guard Guard{IndexBufferMx};
+    RangeAllocation Range = RangeAlloc.Allocate(Size, Alignment, Owner);
 
-    for(auto it = IndexBufferAllocationList.begin(); it != IndexBufferAllocationList.end() - 1; ++it)
+    while(!Range.IsValid())
     {
-        int64_t Begin = math::PadSize2Alignment(it->Offset + it->Size, Alignment);
-        int64_t End = it[1].Offset;
+        uint64_t Capacity = RangeAlloc.GetCapacity();
+        uint64_t NewCapacity = std::min(std::max(Capacity * 2, Capacity + Size + Alignment), GEOMETRY_BUFFER_MAX_SIZE);
 
-        if((End - Begin) >= int64_t(Size))
-        {
-            BufferAllocationSlot NewSlot{.Offset = uint32_t(Begin), .Size = Size};
-            IndexBufferAllocationList.insert(it + 1, NewSlot);
-            return NewSlot;
-        }
+        VERIFY(NewCapacity > Capacity, "geometry buffer is at its maximum size", BufferName, Size, Alignment);
+
+        LOG_INFO("growing {} from {} to {} bytes", BufferName, Capacity, NewCapacity);
+        RangeAlloc.Grow(NewCapacity);
+
+        Range = RangeAlloc.Allocate(Size, Alignment, Owner);
     }
 
-    VERIFY(false, "failed to get index buffer memory", Size, Alignment);
-    return {};
+    return Range;
+}
+
+static BufferAllocationSlot RangeToSlot(const RangeAllocation& Range)
+{
+    return BufferAllocationSlot{
+        .Offset = static_cast<uint32_t>(Range.Offset),
+        .Size = static_cast<uint32_t>(Range.Size),
+        .Node = Range.Node
+    };
+}
+
+static RangeAllocation SlotToRange(const BufferAllocationSlot& Slot)
+{
+    return RangeAllocation{
+        .Offset = Slot.Offset,
+        .Size = Slot.Size,
+        .Node = Slot.Node
+    };
+}
+
+BufferAllocationSlot VContext::GrabIndexBufferMemory(uint32_t Size, uint32_t Alignment, uint64_t Owner)
+{
+    std::lock_guard Guard{IndexBufferMx};
+
+    return RangeToSlot(AllocateGrowing(*IndexBufferAllocator, Size, Alignment, Owner, "global index buffer"));
 }
 
 void VContext::FreeIndexBufferMemory(BufferAllocationSlot Slot)
 {
     std::lock_guard Guard{IndexBufferMx};
+    IndexBufferAllocator->Free(SlotToRange(Slot));
+}
+
+BufferAllocationSlot VContext::GrabVertexBufferMemory(uint32_t Size, uint32_t Alignment, uint64_t Owner)
+{
+    std::lock_guard Guard{VertexBufferMx};
 
-    for(auto it = IndexBufferAllocationList.begin() + 1; it != IndexBufferAllocationList.end() - 1; ++it)
+    return RangeToSlot(AllocateGrowing(*VertexBufferAllocator, Size, Alignment, Owner, "global vertex buffer"));
+}
+
+void VContext::FreeVertexBufferMemory(BufferAllocationSlot Slot)
+{
+    std::lock_guard Guard{VertexBufferMx};
+    VertexBufferAllocator->Free(SlotToRange(Slot));
+}
+
+uint32_t VContext::GrabMeshIndex()
+{
+    std::lock_guard Guard{MeshIndexMx};
+
+    if(!FreeMeshIndices.empty())
     {
-        if(Slot.Offset == it->Offset)
-        {
-            IndexBufferAllocationList.erase(it);
-            return;
-        }
+        uint32_t MeshIndex = FreeMeshIndices.back();
+        FreeMeshIndices.pop_back();
+        return MeshIndex;
     }
 
-    VERIFY(false, "failed to free index buffer memory", Slot);
+    return MeshIndexCount++;
+}
+
+void VContext::FreeMeshIndex(uint32_t MeshIndex)
+{
+    std::lock_guard Guard{MeshIndexMx};
+    FreeMeshIndices.emplace_back(MeshIndex);
+}
+
+uint32_t VContext::GetMeshIndexCount()
+{
+    std::lock_guard Guard{MeshIndexMx};
+    return MeshIndexCount;
 }
 
-BufferAllocationSlot VContext::GrabVertexBufferMemory(uint32_t Size, uint32_t Alignment)
+RangeAllocatorStats VContext::GetIndexBufferStats()
+{
+    std::lock_guard Guard{IndexBufferMx};
+    return IndexBufferAllocator->GetStats();
+}
+
+RangeAllocatorStats VContext::GetVertexBufferStats()
 {
     std::lock_guard Guard{VertexBufferMx};
+    return VertexBufferAllocator->GetStats();
+}
+
+std::vector<VGeometryRelocation> VContext::DefragmentGeometryBuffers(uint64_t MaxBytes, const std::function<bool(uint64_t Owner)>& CanMove)
+{
+    std::vector<VGeometryRelocation> Relocations{};
+    std::vector<RangeMove> Moves{};
+
+    auto CanMoveOwned = [&CanMove](uint64_t Owner)
+    {
+        return Owner != 0 && CanMove(Owner);
+    };
+
+    {
+        std::lock_guard Guard{IndexBufferMx};
+        IndexBufferAllocator->PlanDefragmentation(MaxBytes, Moves, CanMoveOwned);
+    }
 
-    for(auto it = VertexBufferAllocationList.begin(); it != VertexBufferAllocationList.end() - 1; ++it)
+    for(const RangeMove& Move : Moves)
     {
-        int64_t Begin = math::PadSize2Alignment(it->Offset + it->Size, Alignment);
-        int64_t End = it[1].Offset;
+        Relocations.emplace_back(VGeometryRelocation{
+            .Buffer = &GlobalIndexBuffer,
+            .Src = RangeToSlot(Move.Src),
+            .Dst = RangeToSlot(Move.Dst),
+            .Owner = Move.UserData
+        });
+    }
+
+    Moves.clear();
+
+    {
+        std::lock_guard Guard{VertexBufferMx};
+        VertexBufferAllocator->PlanDefragmentation(MaxBytes, Moves, CanMoveOwned);
+    }
 
-        if((End - Begin) >= int64_t(Size))
+    for(const RangeMove& Move : Moves)
+    {
+        Relocations.emplace_back(VGeometryRelocation{
+            .Buffer = &GlobalVertexBuffer,
+            .Src = RangeToSlot(Move.Src),
+            .Dst = RangeToSlot(Move.Dst),
+            .Owner = Move.UserData
+        });
+    }
+
+    if(!Relocations.empty())
+    {
+        std::lock_guard Guard{GeometryCopyMx};
+        PendingGeometryCopies.insert(PendingGeometryCopies.end(), Relocations.begin(), Relocations.end());
+    }
+
+    return Relocations;
+}
+
+void VContext::RecordGeometryCopies(vk::CommandBuffer CommandBuffer, vk::PipelineStageFlags2 ReadStages)
+{
+    std::vector<VGeometryRelocation> Copies{};
+    {
+        std::lock_guard Guard{GeometryCopyMx};
+        Copies.swap(PendingGeometryCopies);
+    }
+
+    if(Copies.empty())
+    {
+        return;
+    }
+
+    //a destination of the previous pass may be the source of this one
+    auto PreviousCopyBarrier = vk::MemoryBarrier2{}
+            .setSrcStageMask(vk::PipelineStageFlagBits2::eTransfer)
+            .setSrcAccessMask(vk::AccessFlagBits2::eTransferWrite)
+            .setDstStageMask(vk::PipelineStageFlagBits2::eTransfer)
+            .setDstAccessMask(vk::AccessFlagBits2::eTransferRead);
+
+    CommandBuffer.pipelineBarrier2(vk::DependencyInfo{}.setMemoryBarriers(PreviousCopyBarrier));
+
+    for(const VGeometryRelocation& Copy : Copies)
+    {
+        CommandBuffer.copyBuffer(Copy.Buffer->Buffer, Copy.Buffer->Buffer, vk::BufferCopy{Copy.Src.Offset, Copy.Dst.Offset, Copy.Src.Size});
+
+        //frames still in flight read from the old range, so it is only released once this frame has completed
+        auto Destruction = [this, Copy]()
         {
-            BufferAllocationSlot NewSlot{.Offset = uint32_t(Begin), .Size = Size};
-            VertexBufferAllocationList.insert(it + 1, NewSlot);
-            return NewSlot;
-        }
+            if(Copy.Buffer == &GlobalIndexBuffer)
+            {
+                FreeIndexBufferMemory(Copy.Src);
+            }
+            else
+            {
+                FreeVertexBufferMemory(Copy.Src);
+            }
+        };
+
+        DeferredDestructionQueue.enqueue(Destruction);
     }
 
-    VERIFY(false, "failed to get vertex buffer memory", Size, Alignment);
-    return {};
+    auto CopyBarrier = vk::MemoryBarrier2{}
+            .setSrcStageMask(vk::PipelineStageFlagBits2::eTransfer)
+            .setSrcAccessMask(vk::AccessFlagBits2::eTransferWrite)
+            .setDstStageMask(ReadStages)
+            .setDstAccessMask(ReadStages & vk::PipelineStageFlagBits2::eIndexInput ? vk::AccessFlagBits2::eIndexRead | vk::AccessFlagBits2::eShaderStorageRead : vk::AccessFlagBits2::eShaderStorageRead);
+
+    CommandBuffer.pipelineBarrier2(vk::DependencyInfo{}.setMemoryBarriers(CopyBarrier));
 }
 
-void VContext::FreeVertexBufferMemory(BufferAllocationSlot Slot)
+bool VContext::GrowGeometryBuffers(vk::CommandBuffer TransferCommandBuffer)
 {
-    std::lock_guard Guard{VertexBufferMx};
+    uint64_t IndexCapacity;
+    {
+        std::lock_guard Guard{IndexBufferMx};
+        IndexCapacity = IndexBufferAllocator->GetCapacity();
+    }
+
+    uint64_t VertexCapacity;
+    {
+        std::lock_guard Guard{VertexBufferMx};
+        VertexCapacity = VertexBufferAllocator->GetCapacity();
+    }
+
+    if(IndexCapacity <= GlobalIndexBuffer.Size && VertexCapacity <= GlobalVertexBuffer.Size) [[likely]]
+    {
+        return false;
+    }
+
+    //relocations recorded by earlier frames write to the old buffers, this is rare enough to simply wait for them
+    QueueHandles.Graphics.waitIdle();
 
-    for(auto it = VertexBufferAllocationList.begin() + 1; it != VertexBufferAllocationList.end() - 1; ++it)
+    //existing contents are copied in the same batch, before any of the uploads that are resolved against the new buffers
+    auto GrowBuffer = [this, TransferCommandBuffer](VAllocatedBuffer* Buffer, uint64_t NewSize)
     {
-        if(Slot.Offset == it->Offset)
+        if(NewSize <= Buffer->Size)
         {
-            VertexBufferAllocationList.erase(it);
             return;
         }
-    }
 
-    VERIFY(false, "failed to free vertex buffer memory", Slot);
+        std::string Name = Allocator.getAllocationInfo(Buffer->Allocation).pName;
+        VAllocatedBuffer NewBuffer = AllocateBuffer(NewSize, Buffer->BufferUsage, Buffer->AllocationFlags, Buffer->MemoryUsage, Name);
+
+        TransferCommandBuffer.copyBuffer(Buffer->Buffer, NewBuffer.Buffer, vk::BufferCopy{0, 0, Buffer->Size});
+
+        FreeBuffer(Buffer); //frames in flight still read from it
+        *Buffer = NewBuffer;
+    };
+
+    GrowBuffer(&GlobalIndexBuffer, IndexCapacity);
+    GrowBuffer(&GlobalVertexBuffer, VertexCapacity);
+
+    auto GrowBarrier = vk::MemoryBarrier2{}
+            .setSrcStageMask(vk::PipelineStageFlagBits2::eTransfer)
+            .setSrcAccessMask(vk::AccessFlagBits2::eTransferWrite)
+            .setDstStageMask(vk::PipelineStageFlagBits2::eTransfer)
+            .setDstAccessMask(vk::AccessFlagBits2::eTransferWrite);
+
+    TransferCommandBuffer.pipelineBarrier2(vk::DependencyInfo{}.setMemoryBarriers(GrowBarrier));
+
+    return true;
 }
 
 void VContext::CreateTransientDescriptorPool()
@@ -955,7 +1137,8 @@ void VContext::CreateTransientDescriptorPool()
     constexpr std::array PoolSizes
     {
         vk::DescriptorPoolSize{vk::DescriptorType::eCombinedImageSampler, 1000},
-        vk::DescriptorPoolSize{vk::DescriptorType::eSampledImage, 1000}
+        vk::DescriptorPoolSize{vk::DescriptorType::eSampledImage, 1000},
+        vk::DescriptorPoolSize{vk::DescriptorType::eStorageImage, 1000}
     };
 
     auto PoolInfo = vk::DescriptorPoolCreateInfo{}
@@ -135,7 +135,7 @@ vk::DescriptorPool VDescriptorAllocator::grab_pool()
         pool = Context->Device.createDescriptorPool(pool_info);
     }
 
-    Context->NameObject(pool, fmt::format("descriptor pool in use [{}]", used_pools.size()));
+    Context->NameObject(pool, "descriptor pool in use [{}]", used_pools.size());
     descriptor_tracker::pool_count += 1;
 
     return pool;
@@ -187,7 +187,7 @@ void VDescriptorAllocator::reset()
         Context->Device.resetDescriptorPool(used_pools[index]);
         free_pools.emplace_back(used_pools[index]);
 
-        Context->NameObject(used_pools[index], fmt::format("free descriptor pool [{}]", free_pools.size() - 1));
+        Context->NameObject(used_pools[index], "free descriptor pool [{}]", free_pools.size() - 1);
     }
 
     used_pools.clear();
@@ -231,6 +231,9 @@ vk::DescriptorSetLayout VDescriptorLayoutCache::create_layout(layout_info_t& inf
     memcpy(info.bindings.data(), ascending_bindings, sizeof(vk::DescriptorSetLayoutBinding) * info.bindings.size());
     memcpy(info.flags.data(), ascending_flags, sizeof(vk::DescriptorBindingFlags) * info.flags.size());
 
+    //pipelines are built in parallel
+    std::lock_guard Guard{layouts_mx};
+
     auto found_layout = layouts.find(info);
     if(found_layout != layouts.end())
     {
@@ -259,7 +262,7 @@ vk::DescriptorSetLayout VDescriptorLayoutCache::create_layout(layout_info_t& inf
         vk::DescriptorSetLayout new_layout = Context->Device.createDescriptorSetLayout(layout_info);
 
         layouts.insert(std::make_pair(std::move(LayoutInfoCopy), new_layout));
-        Context->NameObject(new_layout, fmt::format("cached descriptor layout [{}]", layouts.size() - 1));
+        Context->NameObject(new_layout, "cached descriptor layout [{}]", layouts.size() - 1);
 
         return new_layout;
     }
@@ -391,7 +394,7 @@ void VDescriptorBuilder::Build(vk::DescriptorSet& out_set, vk::DescriptorSetLayo
 
     if(!debug_name.empty())
     {
-        DescriptorAllocator->Context->NameObject(out_set, fmt::format("{} descriptor set", debug_name));
+        DescriptorAllocator->Context->NameObject(out_set, "{} descriptor set", debug_name);
     }
 
     if(!writes.empty())
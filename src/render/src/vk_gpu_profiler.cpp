@@ -0,0 +1,271 @@
+#include "vk_gpu_profiler.hpp"
+#include "vk_context.hpp"
+#include "core/log.hpp"
+#include "core/assertion.hpp"
+#include "fmt/format.h"
+
+//results come back in bit order, so the members of VGpuPassTiming follow the same order
+static constexpr vk::QueryPipelineStatisticFlags StatisticFlags =
+        vk::QueryPipelineStatisticFlagBits::eInputAssemblyVertices
+        | vk::QueryPipelineStatisticFlagBits::eInputAssemblyPrimitives
+        | vk::QueryPipelineStatisticFlagBits::eVertexShaderInvocations
+        | vk::QueryPipelineStatisticFlagBits::eClippingPrimitives
+        | vk::QueryPipelineStatisticFlagBits::eFragmentShaderInvocations
+        | vk::QueryPipelineStatisticFlagBits::eComputeShaderInvocations;
+
+static constexpr uint32_t StatisticCount = 6;
+
+static VGpuPassTiming& FindOrAddPass(std::vector<VGpuPassTiming>& Passes, std::string_view Name)
+{
+    for(VGpuPassTiming& Pass : Passes)
+    {
+        if(Pass.Name == Name)
+        {
+            return Pass;
+        }
+    }
+
+    return Passes.emplace_back(VGpuPassTiming{.Name = Name});
+}
+
+void VGpuProfiler::Init(VContext* Context_)
+{
+    Context = Context_;
+
+    const vk::PhysicalDeviceLimits& Limits = Context->PhysicalDeviceProperties.properties.limits;
+    NanosecondsPerTick = Limits.timestampPeriod;
+
+    uint32_t ValidBits = Context->PhysicalDevice.getQueueFamilyProperties()[Context->QueueIndices.Graphics].timestampValidBits;
+    VERIFY(ValidBits != 0 && Limits.timestampComputeAndGraphics, "the graphics queue has no timestamps");
+
+    bStatistics = Context->PhysicalDeviceFeatures.features2.features.pipelineStatisticsQuery;
+
+    if(std::string_view{GPU_PROFILER_CSV}.size() != 0)
+    {
+        SetCsvOutput(ProjectAbsolutePath(GPU_PROFILER_CSV));
+    }
+}
+
+void VGpuProfiler::CreateQueries(VGpuFrameQueries& Queries, std::string_view DebugName, uint32_t QueueFamily)
+{
+    vk::QueueFamilyProperties FamilyProperties = Context->PhysicalDevice.getQueueFamilyProperties()[QueueFamily];
+
+    uint32_t ValidBits = FamilyProperties.timestampValidBits;
+    if(ValidBits == 0)
+    {
+        LOG_WARNING("queue family {} has no timestamps, {} is not profiled", QueueFamily, DebugName);
+        return;
+    }
+
+    Queries.TimestampMask = ValidBits == 64 ? UINT64_MAX : (uint64_t{1} << ValidBits) - 1;
+
+    auto TimestampPoolInfo = vk::QueryPoolCreateInfo{}
+            .setQueryType(vk::QueryType::eTimestamp)
+            .setQueryCount(GPU_PROFILER_MAX_SCOPES * 2);
+
+    vkResultCheck = Context->Device.createQueryPool(&TimestampPoolInfo, nullptr, &Queries.Timestamps);
+    Context->NameObject(Queries.Timestamps, "{} timestamps", DebugName);
+
+    //graphics statistics can not be queried on a compute only queue
+    if(bStatistics && (FamilyProperties.queueFlags & vk::QueueFlagBits::eGraphics))
+    {
+        auto StatisticsPoolInfo = vk::QueryPoolCreateInfo{}
+                .setQueryType(vk::QueryType::ePipelineStatistics)
+                .setPipelineStatistics(StatisticFlags)
+                .setQueryCount(GPU_PROFILER_MAX_SCOPES);
+
+        vkResultCheck = Context->Device.createQueryPool(&StatisticsPoolInfo, nullptr, &Queries.Statistics);
+        Context->NameObject(Queries.Statistics, "{} pipeline statistics", DebugName);
+    }
+}
+
+void VGpuProfiler::DestroyQueries(VGpuFrameQueries& Queries)
+{
+    Context->Device.destroyQueryPool(Queries.Timestamps);
+    Context->Device.destroyQueryPool(Queries.Statistics);
+
+    Queries.Timestamps = nullptr;
+    Queries.Statistics = nullptr;
+}
+
+void VGpuProfiler::Reset(vk::CommandBuffer CommandBuffer, VGpuFrameQueries& Queries)
+{
+    ASSERT(Queries.ScopeCount == 0, "the previous results were never collected");
+
+    if(!Queries.Timestamps)
+    {
+        return;
+    }
+
+    CommandBuffer.resetQueryPool(Queries.Timestamps, 0, GPU_PROFILER_MAX_SCOPES * 2);
+
+    if(Queries.Statistics)
+    {
+        CommandBuffer.resetQueryPool(Queries.Statistics, 0, GPU_PROFILER_MAX_SCOPES);
+    }
+}
+
+void VGpuProfiler::BeginScope(vk::CommandBuffer CommandBuffer, VGpuFrameQueries& Queries, std::string_view Name)
+{
+    ASSERT(!Queries.bScopeOpen, Name);
+
+    if(!Queries.Timestamps || Queries.ScopeCount == GPU_PROFILER_MAX_SCOPES) [[unlikely]]
+    {
+        return;
+    }
+
+    uint32_t Scope = Queries.ScopeCount;
+    Queries.Scopes[Scope] = Name;
+    Queries.bScopeOpen = true;
+
+    CommandBuffer.writeTimestamp2(vk::PipelineStageFlagBits2::eAllCommands, Queries.Timestamps, Scope * 2);
+
+    if(Queries.Statistics)
+    {
+        CommandBuffer.beginQuery(Queries.Statistics, Scope, {});
+    }
+}
+
+void VGpuProfiler::EndScope(vk::CommandBuffer CommandBuffer, VGpuFrameQueries& Queries)
+{
+    if(!Queries.bScopeOpen) [[unlikely]]
+    {
+        return;
+    }
+
+    uint32_t Scope = Queries.ScopeCount;
+    Queries.ScopeCount += 1;
+    Queries.bScopeOpen = false;
+
+    if(Queries.Statistics)
+    {
+        CommandBuffer.endQuery(Queries.Statistics, Scope);
+    }
+
+    CommandBuffer.writeTimestamp2(vk::PipelineStageFlagBits2::eAllCommands, Queries.Timestamps, Scope * 2 + 1);
+}
+
+void VGpuProfiler::Collect(std::initializer_list<VGpuFrameQueries*> FrameQueries)
+{
+    std::vector<VGpuPassTiming> Passes{};
+    bool bReady = true;
+
+    for(VGpuFrameQueries* Queries : FrameQueries)
+    {
+        uint32_t ScopeCount = Queries->ScopeCount;
+        Queries->ScopeCount = 0;
+
+        if(ScopeCount == 0 || !bReady)
+        {
+            continue;
+        }
+
+        std::array<uint64_t, GPU_PROFILER_MAX_SCOPES * 2> Timestamps{};
+        std::array<uint64_t, GPU_PROFILER_MAX_SCOPES * StatisticCount> Statistics{};
+
+        //the fence has passed, so these are ready, a frame that is not is dropped rather than waited on
+        vk::Result Result = Context->Device.getQueryPoolResults(Queries->Timestamps, 0, ScopeCount * 2, ScopeCount * 2 * sizeof(uint64_t), Timestamps.data(), sizeof(uint64_t), vk::QueryResultFlagBits::e64);
+        if(Result != vk::Result::eSuccess)
+        {
+            LOG_DEBUG("gpu timestamps not ready - {}", vk::to_string(Result));
+            bReady = false;
+            continue;
+        }
+
+        if(Queries->Statistics)
+        {
+            Result = Context->Device.getQueryPoolResults(Queries->Statistics, 0, ScopeCount, ScopeCount * StatisticCount * sizeof(uint64_t), Statistics.data(), StatisticCount * sizeof(uint64_t), vk::QueryResultFlagBits::e64);
+            if(Result != vk::Result::eSuccess)
+            {
+                LOG_DEBUG("gpu pipeline statistics not ready - {}", vk::to_string(Result));
+                bReady = false;
+                continue;
+            }
+        }
+
+        for(uint32_t Scope = 0; Scope < ScopeCount; ++Scope)
+        {
+            VGpuPassTiming& Pass = FindOrAddPass(Passes, Queries->Scopes[Scope]);
+
+            uint64_t Ticks = (Timestamps[Scope * 2 + 1] - Timestamps[Scope * 2]) & Queries->TimestampMask;
+            Pass.Milliseconds += static_cast<double>(Ticks) * NanosecondsPerTick * 1e-6;
+
+            const uint64_t* Values = &Statistics[Scope * StatisticCount];
+            Pass.InputAssemblyVertices += Values[0];
+            Pass.InputAssemblyPrimitives += Values[1];
+            Pass.VertexShaderInvocations += Values[2];
+            Pass.ClippingPrimitives += Values[3];
+            Pass.FragmentShaderInvocations += Values[4];
+            Pass.ComputeShaderInvocations += Values[5];
+        }
+    }
+
+    if(!bReady || Passes.empty())
+    {
+        return;
+    }
+
+    Latest = std::move(Passes);
+
+    CollectedFrames += 1;
+    WriteSinks();
+}
+
+void VGpuProfiler::SetCsvOutput(const std::fpath& Path)
+{
+    std::error_code Error{};
+    std::filesystem::create_directories(Path.parent_path(), Error);
+
+    Csv = std::ofstream{Path, std::ios::out | std::ios::trunc};
+    if(!Csv)
+    {
+        LOG_WARNING("could not open gpu profile {}", Path);
+        return;
+    }
+
+    Csv << "frame,pass,milliseconds,ia_vertices,ia_primitives,vs_invocations,clipping_primitives,fs_invocations,cs_invocations\n";
+    LOG_INFO("writing gpu profile to {}", Path);
+}
+
+void VGpuProfiler::WriteSinks()
+{
+    if(Csv.is_open())
+    {
+        for(const VGpuPassTiming& Pass : Latest)
+        {
+            Csv << fmt::format("{},{},{:.4f},{},{},{},{},{},{}\n", CollectedFrames, Pass.Name, Pass.Milliseconds,
+                               Pass.InputAssemblyVertices, Pass.InputAssemblyPrimitives, Pass.VertexShaderInvocations,
+                               Pass.ClippingPrimitives, Pass.FragmentShaderInvocations, Pass.ComputeShaderInvocations);
+        }
+    }
+
+    if constexpr(GPU_PROFILER_LOG_INTERVAL != 0)
+    {
+        for(const VGpuPassTiming& Pass : Latest)
+        {
+            VGpuPassTiming& Sum = FindOrAddPass(Accumulated, Pass.Name);
+            Sum.Milliseconds += Pass.Milliseconds;
+            Sum.InputAssemblyPrimitives += Pass.InputAssemblyPrimitives;
+            Sum.FragmentShaderInvocations += Pass.FragmentShaderInvocations;
+            Sum.ComputeShaderInvocations += Pass.ComputeShaderInvocations;
+        }
+
+        AccumulatedFrames += 1;
+
+        if(AccumulatedFrames == GPU_PROFILER_LOG_INTERVAL)
+        {
+            double Total = 0.0;
+            for(const VGpuPassTiming& Sum : Accumulated)
+            {
+                Total += Sum.Milliseconds;
+                LOG_INFO("gpu {}: {:.3f} ms, {} primitives, {} fragment and {} compute invocations", Sum.Name, Sum.Milliseconds / AccumulatedFrames,
+                         Sum.InputAssemblyPrimitives / AccumulatedFrames, Sum.FragmentShaderInvocations / AccumulatedFrames, Sum.ComputeShaderInvocations / AccumulatedFrames);
+            }
+
+            LOG_INFO("gpu frame: {:.3f} ms averaged over {} frames", Total / AccumulatedFrames, AccumulatedFrames);
+
+            Accumulated.clear();
+            AccumulatedFrames = 0;
+        }
+    }
+}
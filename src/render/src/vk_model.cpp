@@ -2,61 +2,32 @@
 #include "core/assertion.hpp"
 #include "core/log.hpp"
 #include "core/filesystem.hpp"
-#include "assimp/Importer.hpp"
-#include "assimp/scene.h"
-#include "assimp/mesh.h"
+#include "core/derived_data_cache.hpp"
+#include "core/cpu_profiler.hpp"
 #include "assimp/material.h"
-#include "assimp/postprocess.h"
 #include "image.hpp"
+#include "model_cook.hpp"
 #include "vk_context.hpp"
 #include "vk_render_target.hpp"
 #include "core/utility_functions.hpp"
 
-static glm::vec3 aiVec2glmVec(aiVector3D aiV)
-{
-    glm::vec3 glmV;
-    glmV.x = aiV.x;
-    glmV.y = aiV.y;
-    glmV.z = aiV.z;
-    return glmV;
-}
-
-static glm::quat aiQuat2glmQuat(aiQuaternion aiQ)
-{
-    glm::quat glmQ;
-    glmQ.w = aiQ.w;
-    glmQ.x = aiQ.x;
-    glmQ.y = aiQ.y;
-    glmQ.z = aiQ.z;
-    return glmQ;
-}
-
 bool VTransferData::IsFinished() const
 {
-    vk::Semaphore Semaphore = TransferFinish.load(std::memory_order_relaxed);
-    if(Semaphore == nullptr)
+    uint64_t Ticket = TransferTicket.load(std::memory_order_acquire);
+    if(Ticket == 0)
     {
         return false;
     }
 
-    uint64_t Value;
-    vkResultCheck = vkContext->Device.getSemaphoreCounterValue(Semaphore, &Value);
-
-    return Value == 1;
+    return vkContext->Uploader->IsComplete(Ticket);
 }
 
 void VTransferData::WaitUntilFinished() const
 {
-    vk::Semaphore Semaphore = TransferFinish.load(std::memory_order_relaxed);
-    ASSERT(Semaphore != nullptr);
-
-    uint64_t WaitValue = 1;
-
-    auto WaitInfo = vk::SemaphoreWaitInfo{}
-            .setSemaphores(Semaphore)
-            .setValues(WaitValue);
+    uint64_t Ticket = TransferTicket.load(std::memory_order_acquire);
+    ASSERT(Ticket != 0);
 
-    vkResultCheck = vkContext->Device.waitSemaphores(WaitInfo, vkutil::default_timeout);
+    vkContext->Uploader->Wait(Ticket);
 }
 
 bool VModel::IsLoaded()
@@ -76,11 +47,11 @@ bool VModel::IsLoaded()
                 {
                     for(const auto& Mesh: MeshNode->Meshes)
                     {
-                        NodesLoaded &= vkContext->ModelManager->Meshes.at(Mesh.MeshName).IsFinished();
+                        NodesLoaded &= vkContext->ModelManager->Meshes.At(Mesh.Mesh).IsFinished();
 
                         for(const auto& Texture : Mesh.Textures)
                         {
-                            NodesLoaded &= vkContext->ModelManager->Textures.at(Texture.Name).IsFinished();
+                            NodesLoaded &= vkContext->ModelManager->Textures.At(Texture.Texture).IsFinished();
                         }
                     }
                 }
@@ -119,9 +90,14 @@ void VModel::ForEachNode(const std::function<void(scene::SceneNode*)>& callback)
     ForEachNode_Recurse(RootNode.get(), callback);
 }
 
-VModel* VModel::LoadAsset(const std::fpath& Path)
+VModel* VModel::LoadAsset(AssetId Id)
 {
-    return vkContext->ModelManager->LoadModel(Path);
+    return vkContext->ModelManager->LoadModel(Id);
+}
+
+void VModel::RetireAsset(AssetId Id)
+{
+    vkContext->ModelManager->RetireModel(Id);
 }
 
 VModelManager::VModelManager(VContext* Context_)
@@ -149,12 +125,16 @@ VModelManager::VModelManager(VContext* Context_)
 
 VModelManager::~VModelManager()
 {
-    TaskExecutor.wait_for_all();
+    //loaders blocked on a full staging ring need what is committed submitted first
+    Context->Uploader->Flush();
+    global::Scheduler.Wait(LoadJobs, JobPriority::FrameCritical); //the loads are left to the workers
+    Context->Uploader->WaitIdle();
 
     LOG_INFO("destroying model manager");
 
-    GarbageCollect(true);
-    
+    //the device is idle, so whatever is still retired can go regardless of the epochs
+    Retired.Drain();
+
     VERIFY(Textures.size() == 0, ASSERTION::NONFATAL);
     VERIFY(Meshes.size() == 0, ASSERTION::NONFATAL);
     VERIFY(Models.size() == 0, ASSERTION::NONFATAL);
@@ -163,319 +143,186 @@ VModelManager::~VModelManager()
     TextureSampler = nullptr;
 }
 
-VModel* VModelManager::LoadModel(const std::fpath& Path)
+template<typename T, typename KeyT>
+typename TAssetTable<T>::EmplaceResult VModelManager::EmplaceReference(TAssetTable<T>& Table, KeyT Key)
+{
+    std::lock_guard Guard{ReferenceMx};
+
+    typename TAssetTable<T>::EmplaceResult Result = Table.Emplace(Key);
+    Result.Object->AddReference();
+
+    return Result;
+}
+
+template<typename F>
+void VModelManager::SubmitLoad(F&& Job)
 {
-    auto[it, inserted] = Models.emplace(Path, VModel{});
-    if(inserted)
+    //pinned on submission, the job may only start after whatever it loads into has been retired
+    uint64_t Pinned = global::Epochs.Pin();
+
+    global::Scheduler.Submit(JobPriority::Streaming, [Pinned, Job = std::forward<F>(Job)]() mutable
+    {
+        Job();
+        global::Epochs.Unpin(Pinned);
+    }, &LoadJobs);
+}
+
+VModel* VModelManager::LoadModel(AssetId Id)
+{
+    auto[ModelId, Model, bInserted] = EmplaceReference(Models, Id);
+    if(bInserted)
     {
-        TaskExecutor.silent_async([=, this](){
-            LoadModel_Impl(TAssetPtr{it->first, &it->second});
+        //the reference the loader holds keeps the model from being retired before it is built
+        SubmitLoad([this, Asset = TAssetPtr{ModelId, Model}](){
+            LoadModel_Impl(Asset);
         });
     }
 
-    return &it->second;
+    return Model;
 }
 
 void VModelManager::LoadModel_Impl(TAssetPtr<VModel> Asset)
 {
+    PROFILE_SCOPE("Load Model");
     LOG_INFO("loading model - {}", Asset.GetPath());
 
-    auto Importer = std::make_shared<Assimp::Importer>();
-    Importer->SetPropertyInteger(AI_CONFIG_PP_RVC_FLAGS, aiComponent_COLORS | aiComponent_CAMERAS);
-    Importer->SetPropertyInteger(AI_CONFIG_PP_SBP_REMOVE, aiPrimitiveType_LINE | aiPrimitiveType_POINT);
-    Importer->SetPropertyInteger(AI_CONFIG_PP_SLM_TRIANGLE_LIMIT, UINT16_MAX / 3u);
-    Importer->SetPropertyInteger(AI_CONFIG_PP_SLM_VERTEX_LIMIT, INT32_MAX);
-    Importer->SetPropertyInteger(AI_CONFIG_PP_ICL_PTCACHE_SIZE, 24); //Just a guess
-
-    uint32_t PostprocessFlags =
-            aiProcess_Triangulate
-            | aiProcess_SortByPType
-            | aiProcess_JoinIdenticalVertices
-            | aiProcess_OptimizeMeshes
-            | aiProcess_OptimizeGraph
-            | aiProcess_ImproveCacheLocality
-            | aiProcess_FlipUVs
-            | aiProcess_GenNormals
-            | aiProcess_GenBoundingBoxes
-            | aiProcess_RemoveComponent
-            | aiProcess_RemoveRedundantMaterials
-            | aiProcess_FindInvalidData
-            | aiProcess_GenUVCoords
-            | aiProcess_TransformUVCoords
-            | aiProcess_FindInstances
-            | aiProcess_GlobalScale;
-            //| aiProcess_SplitLargeMeshes;
-
-#ifndef NDEBUG
-    Importer->SetExtraVerbose(true);
-    PostprocessFlags |= aiProcess_ValidateDataStructure;
-#endif
-
-    const aiScene* Scene = Importer->ReadFile(Asset.GetPath(), PostprocessFlags);
-    VERIFY(Scene && Scene->mRootNode && !(Scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE), Importer->GetErrorString());
-
-    VModel* Model = Asset.GetPtr();
-    RecurseNodes(Model->RootNode, nullptr, Scene->mRootNode, Importer, Asset);
-
-    Model->State.store(VModel::InTransfer, std::memory_order_relaxed);
-}
+    std::shared_ptr<const VCookedModel> Cooked = VCookedModel::Find(Asset.GetPath());
 
-void VModelManager::RecurseNodes(std::unique_ptr<scene::SceneNode>& SceneNode, scene::SceneNode* ParentNode, aiNode* ImportNode, std::shared_ptr<Assimp::Importer> Importer, TAssetPtr<VModel> Asset)
-{
-    if(ImportNode->mNumMeshes == 0)
-    {
-        SceneNode = std::make_unique<scene::SceneNode>();
-    }
-    else
+    if(!Cooked)
     {
-        SceneNode = std::make_unique<scene::MeshNode>();
+        Cooked = VCookedModel::FromMemory(CookModel(Asset.GetPath()));
     }
 
-    SceneNode->Parent = ParentNode;
-
-    aiVector3D Translation; aiQuaternion Rotation; aiVector3D Scale;
-    ImportNode->mTransformation.Decompose(Scale, Rotation, Translation);
+    VModel* Model = Asset.GetPtr();
 
-    SceneNode->Transform.Translation = aiVec2glmVec(Translation);
-    SceneNode->Transform.Rotation = aiQuat2glmQuat(Rotation);
-    SceneNode->Transform.Scale = aiVec2glmVec(Scale);
+    //parents are always cooked before their children, so the hierarchy is rebuilt in one pass
+    std::span<const CookedNode> CookedNodes = Cooked->Nodes();
+    std::vector<scene::SceneNode*> SceneNodes(CookedNodes.size());
 
-    for(uint64_t Mesh = 0; Mesh < ImportNode->mNumMeshes; ++Mesh)
+    for(uint32_t Node = 0; Node < CookedNodes.size(); ++Node)
     {
-        uint64_t MeshIndex = ImportNode->mMeshes[Mesh];
-        aiMesh* ImportMesh = Importer->GetScene()->mMeshes[MeshIndex];
-        auto* MeshNode = dynamic_cast<scene::MeshNode*>(SceneNode.get());
+        const CookedNode& ImportNode = CookedNodes[Node];
+        scene::SceneNode* ParentNode = ImportNode.Parent == UINT32_MAX ? nullptr : SceneNodes[ImportNode.Parent];
 
-        ProcessMeshNode(MeshNode, ImportMesh, MeshIndex, Importer, Asset);
-    }
+        std::unique_ptr<scene::SceneNode>& SceneNode = ParentNode ? ParentNode->Children.emplace_back() : Model->RootNode;
 
-    for(uint64_t Child = 0; Child < ImportNode->mNumChildren; ++Child)
-    {
-        std::unique_ptr<scene::SceneNode>& SceneChildNode = SceneNode->Children.emplace_back();
-        aiNode* ImportChildNode = ImportNode->mChildren[Child];
+        if(ImportNode.MeshRefCount == 0)
+        {
+            SceneNode = std::make_unique<scene::SceneNode>();
+        }
+        else
+        {
+            SceneNode = std::make_unique<scene::MeshNode>();
+        }
 
-        RecurseNodes(SceneChildNode, SceneNode.get(), ImportChildNode, Importer, Asset);
+        SceneNode->Parent = ParentNode;
+        SceneNode->Transform = ImportNode.Transform;
+        SceneNodes[Node] = SceneNode.get();
+
+        for(uint32_t MeshRef = ImportNode.FirstMeshRef; MeshRef < ImportNode.FirstMeshRef + ImportNode.MeshRefCount; ++MeshRef)
+        {
+            auto* MeshNode = dynamic_cast<scene::MeshNode*>(SceneNode.get());
+            ProcessMeshNode(MeshNode, Cooked, Cooked->Refs()[MeshRef], Asset);
+        }
     }
+
+    Model->State.store(VModel::InTransfer, std::memory_order_relaxed);
 }
 
-void VModelManager::ProcessMeshNode(scene::MeshNode* MeshNode, aiMesh* ImportMesh, uint64_t MeshIndex, std::shared_ptr<Assimp::Importer> Importer, TAssetPtr<VModel> Asset)
+void VModelManager::ProcessMeshNode(scene::MeshNode* MeshNode, std::shared_ptr<const VCookedModel> Cooked, uint32_t MeshIndex, TAssetPtr<VModel> Asset)
 {
-    std::string SceneName{Importer->GetScene()->mName.data, Importer->GetScene()->mName.length};
-    std::string MeshName{ImportMesh->mName.data, ImportMesh->mName.length};
-
-    if(MeshName.empty())
-    {
-        MeshName = "empty_name";
-    }
+    const CookedMesh& ImportMesh = Cooked->Meshes()[MeshIndex];
 
     auto& MeshData = MeshNode->Meshes.emplace_back();
-    MeshData.MeshName = fmt::format("{}.{}.[{}]", SceneName, MeshName, MeshIndex);
 
     {
-        auto[it, inserted] = Meshes.emplace(MeshData.MeshName, VMesh{});
-        it->second.AddReference();
+        auto[MeshId, Mesh, bInserted] = EmplaceReference(Meshes, Cooked->String(ImportMesh.NameOffset, ImportMesh.NameSize));
+        MeshData.Mesh = MeshId; //kept interned by the table for as long as the model references the mesh
 
-        if(inserted)
+        if(bInserted)
         {
-            TaskExecutor.silent_async([=, this](){
-                LoadMesh(&it->second, ImportMesh, Importer, Asset, it->first);
+            SubmitLoad([=, this](){
+                LoadMesh(Mesh, Cooked, MeshIndex, MeshId);
             });
         }
     }
 
-    aiMaterial* Material = Importer->GetScene()->mMaterials[ImportMesh->mMaterialIndex];
-
-    auto ProcessTexture = [&](aiTextureType TextureType)
+    for(uint32_t TextureRef = ImportMesh.FirstTextureRef; TextureRef < ImportMesh.FirstTextureRef + ImportMesh.TextureRefCount; ++TextureRef)
     {
-        for(uint64_t idx = 0; idx < Material->GetTextureCount(TextureType); ++idx)
-        {
-            auto& Texture = MeshData.Textures.emplace_back();
-            Texture.Type = TextureType;
+        uint32_t TextureIndex = Cooked->Refs()[TextureRef];
+        const CookedTexture& ImportTexture = Cooked->Textures()[TextureIndex];
+        std::string_view TextureName = Cooked->String(ImportTexture.NameOffset, ImportTexture.NameSize);
+        bool bEmbedded = ImportTexture.DataSize != 0;
 
-            aiString AiTextureName;
-            VERIFY(Material->GetTexture(TextureType, idx, &AiTextureName) == AI_SUCCESS);
+        auto& Texture = MeshData.Textures.emplace_back();
+        Texture.Type = static_cast<aiTextureType>(ImportTexture.Type);
 
-            const aiTexture* EmbeddedTexture = Importer->GetScene()->GetEmbeddedTexture(AiTextureName.C_Str());
+        {
+            auto[TextureId, TextureObject, bInserted] = bEmbedded
+                    ? EmplaceReference(Textures, TextureName)
+                    : EmplaceReference(Textures, std::string_view{Asset.GetPath().parent_path().append(TextureName).native()});
 
-            if(EmbeddedTexture)
-            {
-                Texture.Name = fmt::format("{}.{}", SceneName, AiTextureName.C_Str());
-            }
-            else
-            {
-                Texture.Name = Asset.GetPath().parent_path().append(AiTextureName.C_Str());
-            }
+            Texture.Texture = TextureId;
 
+            if(bInserted)
             {
-                auto[it, inserted] = Textures.emplace(Texture.Name, VTexture{});
-                it->second.AddReference();
+                TextureObject->Type = Texture.Type;
 
-                if(inserted)
+                if(bEmbedded)
                 {
-                    it->second.Type = TextureType;
-
-                    if(EmbeddedTexture)
-                    {
-                        TaskExecutor.silent_async([=, this](){
-                            LoadEmbeddedTexture(&it->second, EmbeddedTexture, Importer, Asset);
-                        });
-                    }
-                    else
-                    {
-                        TaskExecutor.silent_async([=, this](){
-                            LoadFileTexture(&it->second, Texture.Name, Importer, Asset);
-                        });
-                    }
+                    SubmitLoad([=, this](){
+                        LoadEmbeddedTexture(TextureObject, Cooked, TextureIndex, TextureId);
+                    });
+                }
+                else
+                {
+                    SubmitLoad([=, this](){
+                        LoadFileTexture(TextureObject, TextureId);
+                    });
                 }
             }
         }
-    };
-
-    ProcessTexture(aiTextureType_BASE_COLOR);
-/*
-    for(std::underlying_type_t<aiTextureType> TextureType = 0; TextureType <= AI_TEXTURE_TYPE_MAX; ++TextureType)
-    {
-        ProcessTexture(static_cast<aiTextureType>(TextureType));
     }
-    */
 }
 
-void VModelManager::LoadMesh(VMesh* OutMesh, aiMesh* ImportMesh, std::shared_ptr<Assimp::Importer> Importer, TAssetPtr<VModel> Asset, std::string_view MeshName)
+void VModelManager::LoadMesh(VMesh* OutMesh, std::shared_ptr<const VCookedModel> Cooked, uint32_t MeshIndex, AssetId Id)
 {
+    PROFILE_SCOPE("Load Mesh");
+    std::string_view MeshName = global::Assets.GetName(Id);
     LOG_INFO("loading mesh - {}", MeshName);
 
-    OutMesh->IndexCount = ImportMesh->mNumFaces * 3u;
-    OutMesh->VertexCount = ImportMesh->mNumVertices;
+    const CookedMesh& ImportMesh = Cooked->Meshes()[MeshIndex];
 
-    const uint32_t IndexBufferSize = OutMesh->IndexCount * sizeof(uint32_t);
-    const uint32_t PositionBufferSize = OutMesh->VertexCount * sizeof(glm::fvec3);
-    const uint32_t NormalUVBufferSize = OutMesh->VertexCount * sizeof(NormalUV);
+    OutMesh->IndexCount = ImportMesh.IndexCount;
+    OutMesh->VertexCount = ImportMesh.VertexCount;
+    OutMesh->SphereBounds = ImportMesh.SphereBounds;
+    OutMesh->MeshletCount = ImportMesh.MeshletCount;
+    OutMesh->LodCount = ImportMesh.LodCount;
+    OutMesh->Lods = ImportMesh.Lods;
+    OutMesh->MeshIndex = vkContext->GrabMeshIndex();
 
-    glm::vec3 BoundsMin = aiVec2glmVec(ImportMesh->mAABB.mMin);
-    glm::vec3 BoundsMax = aiVec2glmVec(ImportMesh->mAABB.mMax);
-    glm::vec3 BoundsCenter = (BoundsMin + BoundsMax) / 2.0f;
-    float BoundsRadius = glm::distance(BoundsMin, BoundsMax) / 2.0f;
-    OutMesh->SphereBounds = glm::vec4{BoundsCenter, BoundsRadius};
+    const uint32_t IndexBufferSize = ImportMesh.IndexBufferSize;
+    const uint32_t PositionBufferSize = ImportMesh.PositionBufferSize;
+    const uint32_t NormalUVBufferSize = ImportMesh.NormalUVBufferSize;
+    const uint32_t MeshletBufferSize = ImportMesh.MeshletBufferSize;
 
-    VAllocatedBuffer StagingBuffer = Context->AllocateBuffer(
-            IndexBufferSize + PositionBufferSize + NormalUVBufferSize,
-            vk::BufferUsageFlagBits::eTransferSrc,
-            vma::AllocationCreateFlagBits::eMapped | vma::AllocationCreateFlagBits::eHostAccessRandom | vma::AllocationCreateFlagBits::eStrategyFirstFit,
-            vma::MemoryUsage::eAutoPreferHost,
-            fmt::format("{} [index, normal, uv] staging buffer", MeshName)
-    );
+    //the cooked blob already has the staging layout, so the whole mesh is one copy out of the mapping
+    VStagingBlock Staging = Context->Uploader->Reserve(IndexBufferSize + PositionBufferSize + NormalUVBufferSize + MeshletBufferSize, std::string{MeshName});
+    memcpy(Staging.MappedData, Cooked->Data(ImportMesh.BlobOffset), IndexBufferSize + PositionBufferSize + NormalUVBufferSize + MeshletBufferSize);
 
-    auto* Indices = reinterpret_cast<uint32_t*>(static_cast<uint8_t*>(StagingBuffer.MappedData) + 0);
-    auto* Positions = reinterpret_cast<glm::fvec3*>(static_cast<uint8_t*>(StagingBuffer.MappedData) + IndexBufferSize);
-    auto* NormalsUVs = reinterpret_cast<NormalUV*>(static_cast<uint8_t*>(StagingBuffer.MappedData) + IndexBufferSize + PositionBufferSize);
+    //the mesh is registered as the owner so defragmentation can patch its slots
+    uint64_t Owner = reinterpret_cast<uint64_t>(OutMesh);
+    OutMesh->IndexSlot = vkContext->GrabIndexBufferMemory(IndexBufferSize, 4u, Owner);
+    OutMesh->PositionSlot = vkContext->GrabVertexBufferMemory(PositionBufferSize, 4u, Owner);
+    OutMesh->NormalUVSlot = vkContext->GrabVertexBufferMemory(NormalUVBufferSize, 8u, Owner);
+    OutMesh->MeshletSlot = vkContext->GrabVertexBufferMemory(MeshletBufferSize, 16u, Owner);
 
-    for(uint64_t face = 0; face < ImportMesh->mNumFaces; ++face)
-    {
-        ASSERT(ImportMesh->mFaces[face].mNumIndices == 3);
-        for(uint64_t index = 0; index < ImportMesh->mFaces[face].mNumIndices; ++index)
-        {
-            ASSERT(ImportMesh->mFaces[face].mIndices[index] <= UINT32_MAX);
-            Indices[(face * 3) + index] = ImportMesh->mFaces[face].mIndices[index];
-        }
-    }
+    Staging.CopyToBuffer(&vkContext->GlobalIndexBuffer, 0, OutMesh->IndexSlot.Offset, IndexBufferSize);
+    Staging.CopyToBuffer(&vkContext->GlobalVertexBuffer, IndexBufferSize, OutMesh->PositionSlot.Offset, PositionBufferSize);
+    Staging.CopyToBuffer(&vkContext->GlobalVertexBuffer, IndexBufferSize + PositionBufferSize, OutMesh->NormalUVSlot.Offset, NormalUVBufferSize);
+    Staging.CopyToBuffer(&vkContext->GlobalVertexBuffer, IndexBufferSize + PositionBufferSize + NormalUVBufferSize, OutMesh->MeshletSlot.Offset, MeshletBufferSize);
 
-    for(uint64_t vertex = 0; vertex < ImportMesh->mNumVertices; ++vertex)
-    {
-        Positions[vertex] = aiVec2glmVec(ImportMesh->mVertices[vertex]);
-
-        if(ImportMesh->HasNormals())
-        {
-            glm::vec3 Normal = aiVec2glmVec(ImportMesh->mNormals[vertex]);
-            glm::vec2 OctNormal = math::oct_encode(glm::normalize(Normal));
-            NormalsUVs[vertex].Normal = glm::packSnorm2x16(OctNormal);
-        }
-        else
-        {
-            NormalsUVs[vertex].Normal = 0;
-        }
-
-        if(ImportMesh->HasTextureCoords(0))
-        {
-            glm::vec3 UVW = aiVec2glmVec(ImportMesh->mTextureCoords[0][vertex]);
-            NormalsUVs[vertex].UV = glm::packUnorm2x16(UVW.xy);
-        }
-        else
-        {
-            NormalsUVs[vertex].UV = 0;
-        }
-    }
-
-    OutMesh->IndexSlot = vkContext->GrabIndexBufferMemory(IndexBufferSize, 4u);
-    OutMesh->PositionSlot = vkContext->GrabVertexBufferMemory(PositionBufferSize, 4u);
-    OutMesh->NormalUVSlot = vkContext->GrabVertexBufferMemory(NormalUVBufferSize, 8u);
-
-    auto TimelineInfo = vk::SemaphoreTypeCreateInfo{}
-            .setSemaphoreType(vk::SemaphoreType::eTimeline)
-            .setInitialValue(0);
-
-    auto SemaphoreInfo = vk::SemaphoreCreateInfo{}
-            .setPNext(&TimelineInfo);
-
-    vk::Semaphore Semaphore;
-    vkResultCheck = Context->Device.createSemaphore(&SemaphoreInfo, nullptr, &Semaphore);
-    Context->NameObject(Semaphore, fmt::format("TransferFinish {}", MeshName));
-
-    OutMesh->TransferFinish.store(Semaphore, std::memory_order_relaxed);
-
-    vk::CommandBuffer CommandBuffer = Context->RequestTransferCommandBuffer(std::string{MeshName});
-
-    OutMesh->Staging.emplace();
-    OutMesh->Staging->Allocation = StagingBuffer.Allocation;
-    OutMesh->Staging->StagingBuffer = StagingBuffer.Buffer;
-    OutMesh->Staging->CommandBuffer = CommandBuffer;
-
-    auto IndexCopyRegion = vk::BufferCopy2{}
-            .setDstOffset(OutMesh->IndexSlot.Offset)
-            .setSrcOffset(0)
-            .setSize(IndexBufferSize);
-
-    auto PositionCopyRegion = vk::BufferCopy2{}
-            .setDstOffset(OutMesh->PositionSlot.Offset)
-            .setSrcOffset(IndexBufferSize)
-            .setSize(PositionBufferSize);
-
-    auto NormalUVCopyRegion = vk::BufferCopy2{}
-            .setDstOffset(OutMesh->NormalUVSlot.Offset)
-            .setSrcOffset(IndexBufferSize + PositionBufferSize)
-            .setSize(NormalUVBufferSize);
-
-    auto IndexCopyBufferInfo = vk::CopyBufferInfo2{}
-            .setDstBuffer(vkContext->GlobalIndexBuffer.Buffer)
-            .setSrcBuffer(StagingBuffer.Buffer)
-            .setRegions(IndexCopyRegion);
-
-    auto PositionCopyBufferInfo = vk::CopyBufferInfo2{}
-            .setDstBuffer(vkContext->GlobalVertexBuffer.Buffer)
-            .setSrcBuffer(StagingBuffer.Buffer)
-            .setRegions(PositionCopyRegion);
-
-    auto NormalUVCopyBufferInfo = vk::CopyBufferInfo2{}
-            .setDstBuffer(vkContext->GlobalVertexBuffer.Buffer)
-            .setSrcBuffer(StagingBuffer.Buffer)
-            .setRegions(NormalUVCopyRegion);
-
-    CommandBuffer.copyBuffer2(IndexCopyBufferInfo);
-    CommandBuffer.copyBuffer2(PositionCopyBufferInfo);
-    CommandBuffer.copyBuffer2(NormalUVCopyBufferInfo);
-
-    auto CommandBufferSubmitInfo = vk::CommandBufferSubmitInfo{}
-            .setCommandBuffer(CommandBuffer)
-            .setDeviceMask(1);
-
-    auto SignalInfo = vk::SemaphoreSubmitInfo{}
-            .setSemaphore(Semaphore)
-            .setValue(1);
-
-    auto SubmitInfo = vk::SubmitInfo2{}
-            .setCommandBufferInfos(CommandBufferSubmitInfo)
-            .setSignalSemaphoreInfos(SignalInfo);
-
-    Context->SubmitTransferCommands(CommandBuffer, SubmitInfo);
+    OutMesh->TransferTicket.store(Context->Uploader->Commit(std::move(Staging)), std::memory_order_release);
 
     LOG_INFO("finished loading mesh - {}", MeshName);
 }
@@ -544,28 +391,11 @@ static void MipMapImage(const glm::vec<4, uint8_t>* src, uint64_t src_width, uin
     }
 }
 
-void VModelManager::LoadTexture(uint8_t* Pixels, uint64_t Width, uint64_t Height, VTexture* OutTexture, std::string Name)
+//the full chain back to back, largest level first
+static void BuildMipChain(uint8_t* Chain, uint64_t Width, uint64_t Height, uint64_t PixelSize, uint64_t MipMaps)
 {
-    vk::Format ImageFormat = aiTextureType2vkFormat(OutTexture->Type);
-    VERIFY((ImageFormat != vk::Format::eUndefined), OutTexture->Type);
-
-    uint64_t TextureSize;
-    uint64_t MipMaps;
-    uint64_t PixelSize = 4;
-    PreCalculateTextureSizeAndMips(Width, Height, PixelSize, &TextureSize, &MipMaps);
-
-    OutTexture->Extent = vk::Extent2D{static_cast<uint32_t>(Width), static_cast<uint32_t>(Height)};
-    OutTexture->MipMaps = MipMaps;
-
-    VAllocatedBuffer StagingBuffer = Context->AllocateBuffer(
-            TextureSize,
-            vk::BufferUsageFlagBits::eTransferSrc, vma::AllocationCreateFlagBits::eMapped | vma::AllocationCreateFlagBits::eHostAccessRandom | vma::AllocationCreateFlagBits::eStrategyFirstFit,
-            vma::MemoryUsage::eAutoPreferHost);
-
-    memcpy(StagingBuffer.MappedData, Pixels, Width * Height * PixelSize);
-
     uint8_t* Source = nullptr;
-    uint8_t* Dest = static_cast<uint8_t*>(StagingBuffer.MappedData);
+    uint8_t* Dest = Chain;
 
     for(uint64_t MipMapLevel = 0; MipMapLevel < MipMaps; ++MipMapLevel)
     {
@@ -579,6 +409,90 @@ void VModelManager::LoadTexture(uint8_t* Pixels, uint64_t Width, uint64_t Height
 
         MipMapImage(reinterpret_cast<glm::vec<4, uint8_t>*>(Source), SrcWidth, SrcHeight, reinterpret_cast<glm::vec<4, uint8_t>*>(Dest), DstWidth, DstHeight);
     }
+}
+
+void VModelManager::LoadDerivedTexture(VTexture* OutTexture, std::span<const uint8_t> Source, uint32_t RawWidth, uint32_t RawHeight, std::string Name)
+{
+    PROFILE_SCOPE("Derive Texture");
+
+    struct TextureHeader
+    {
+        uint32_t Width;
+        uint32_t Height;
+    };
+
+    const uint64_t PixelSize = 4;
+
+    DerivedDataKey Key{"texture", TEXTURE_DDC_VERSION};
+    Key.Append(Source);
+    Key.Append(RawWidth);
+    Key.Append(RawHeight);
+    Key.Append(PixelSize);
+
+    if(std::shared_ptr<const DerivedData> Cached = GetDerivedDataCache()->Find(Key))
+    {
+        TextureHeader Header;
+        memcpy(&Header, Cached->Payload().data(), sizeof(Header));
+
+        uint64_t TextureSize;
+        uint64_t MipMaps;
+        PreCalculateTextureSizeAndMips(Header.Width, Header.Height, PixelSize, &TextureSize, &MipMaps);
+
+        if(Cached->Payload().size() == sizeof(Header) + TextureSize)
+        {
+            LoadTexture(Cached->Payload().data() + sizeof(Header), Header.Width, Header.Height, OutTexture, std::move(Name));
+            return;
+        }
+    }
+
+    int32_t Width = RawWidth;
+    int32_t Height = RawHeight;
+    uint8_t* Pixels = nullptr;
+
+    //raw textures are already 8 bit rgba, everything else is an encoded image
+    if(RawHeight == 0)
+    {
+        int32_t Channels;
+        Pixels = stbi_load_from_memory(Source.data(), Source.size(), &Width, &Height, &Channels, PixelSize);
+        VERIFY(Pixels != nullptr, stbi_failure_reason());
+    }
+
+    uint64_t TextureSize;
+    uint64_t MipMaps;
+    PreCalculateTextureSizeAndMips(Width, Height, PixelSize, &TextureSize, &MipMaps);
+
+    std::vector<uint8_t> Payload(sizeof(TextureHeader) + TextureSize);
+
+    TextureHeader Header{static_cast<uint32_t>(Width), static_cast<uint32_t>(Height)};
+    memcpy(Payload.data(), &Header, sizeof(Header));
+    memcpy(Payload.data() + sizeof(Header), Pixels ? Pixels : Source.data(), Width * Height * PixelSize);
+
+    if(Pixels)
+    {
+        SafeFree(Pixels);
+    }
+
+    BuildMipChain(Payload.data() + sizeof(Header), Width, Height, PixelSize, MipMaps);
+    GetDerivedDataCache()->Store(Key, Payload);
+
+    LoadTexture(Payload.data() + sizeof(Header), Width, Height, OutTexture, std::move(Name));
+}
+
+void VModelManager::LoadTexture(const uint8_t* MipChain, uint64_t Width, uint64_t Height, VTexture* OutTexture, std::string Name)
+{
+    vk::Format ImageFormat = aiTextureType2vkFormat(OutTexture->Type);
+    VERIFY((ImageFormat != vk::Format::eUndefined), OutTexture->Type);
+
+    uint64_t TextureSize;
+    uint64_t MipMaps;
+    uint64_t PixelSize = 4;
+    PreCalculateTextureSizeAndMips(Width, Height, PixelSize, &TextureSize, &MipMaps);
+
+    OutTexture->Extent = vk::Extent2D{static_cast<uint32_t>(Width), static_cast<uint32_t>(Height)};
+    OutTexture->MipMaps = MipMaps;
+
+    VStagingBlock Staging = Context->Uploader->Reserve(TextureSize, Name);
+    memcpy(Staging.MappedData, MipChain, TextureSize);
 
     auto TextureImageInfo = vk::ImageCreateInfo{}
             .setUsage(vk::ImageUsageFlagBits::eSampled | vk::ImageUsageFlagBits::eTransferDst)
@@ -596,7 +510,7 @@ void VModelManager::LoadTexture(uint8_t* Pixels, uint64_t Width, uint64_t Height
             .setUsage(vma::MemoryUsage::eAutoPreferDevice);
 
     vkResultCheck = Context->Allocator.createImage(&TextureImageInfo, &TextureAllocationInfo, &OutTexture->Image, &OutTexture->Allocation, &OutTexture->AllocationInfo);
-    Context->NameObject(OutTexture->Image, fmt::format("{} image", Name));
+    Context->NameObject(OutTexture->Image, "{} image", Name);
 
     auto ImageViewInfo = vk::ImageViewCreateInfo{}
             .setImage(OutTexture->Image)
@@ -612,30 +526,9 @@ void VModelManager::LoadTexture(uint8_t* Pixels, uint64_t Width, uint64_t Height
             });
 
     OutTexture->ImageView = Context->Device.createImageView(ImageViewInfo);
-    Context->NameObject(OutTexture->ImageView, fmt::format("{} image view", Name));
-
-    auto TimelineInfo = vk::SemaphoreTypeCreateInfo{}
-            .setSemaphoreType(vk::SemaphoreType::eTimeline)
-            .setInitialValue(0);
-
-    auto SemaphoreInfo = vk::SemaphoreCreateInfo{}
-            .setPNext(&TimelineInfo);
-
-    vk::Semaphore Semaphore;
-    vkResultCheck = Context->Device.createSemaphore(&SemaphoreInfo, nullptr, &Semaphore);
-    Context->NameObject(Semaphore, fmt::format("TransferFinish {}", Name));
-
-    OutTexture->TransferFinish.store(Semaphore, std::memory_order_relaxed);
-
-    //protected by mutex from here
-    vk::CommandBuffer CommandBuffer = Context->RequestTransferCommandBuffer(Name);
-
-    OutTexture->Staging.emplace();
-    OutTexture->Staging->Allocation = StagingBuffer.Allocation;
-    OutTexture->Staging->StagingBuffer = StagingBuffer.Buffer;
-    OutTexture->Staging->CommandBuffer = CommandBuffer;
+    Context->NameObject(OutTexture->ImageView, "{} image view", Name);
 
-    std::vector<vk::BufferImageCopy2> CopyRegions(MipMaps);
+    VImageRegions CopyRegions(MipMaps);
     uint32_t BufferOffset = 0;
     for(uint32_t MipMapLevel = 0; MipMapLevel < MipMaps; ++MipMapLevel)
     {
@@ -658,262 +551,236 @@ void VModelManager::LoadTexture(uint8_t* Pixels, uint64_t Width, uint64_t Height
         BufferOffset += CopyWidth * CopyHeight * PixelSize;
     }
 
-    auto CopyBuffer2ImageInfo = vk::CopyBufferToImageInfo2{}
-            .setDstImage(OutTexture->Image)
-            .setDstImageLayout(vk::ImageLayout::eTransferDstOptimal)
-            .setSrcBuffer(StagingBuffer.Buffer)
-            .setRegions(CopyRegions);
-
-    auto Undefined2TransferDst = vk::ImageMemoryBarrier2{}
-            .setImage(OutTexture->Image)
-            .setOldLayout(vk::ImageLayout::eUndefined)
-            .setNewLayout(vk::ImageLayout::eTransferDstOptimal)
-            .setSrcStageMask(vk::PipelineStageFlagBits2::eNone)
-            .setSrcAccessMask(vk::AccessFlagBits2::eNone)
-            .setDstStageMask(vk::PipelineStageFlagBits2::eTransfer)
-            .setDstAccessMask(vk::AccessFlagBits2::eTransferWrite)
-            .setSubresourceRange(vk::ImageSubresourceRange{
-                    vk::ImageAspectFlagBits::eColor,
-                    0,
-                    static_cast<uint32_t>(MipMaps),
-                    0,
-                    1
-            });
-
-    auto TransferDst2ReadOnly = vk::ImageMemoryBarrier2{}
-            .setImage(OutTexture->Image)
-            .setOldLayout(vk::ImageLayout::eTransferDstOptimal)
-            .setNewLayout(vk::ImageLayout::eReadOnlyOptimal)
-            .setSrcStageMask(vk::PipelineStageFlagBits2::eTransfer)
-            .setSrcAccessMask(vk::AccessFlagBits2::eTransferWrite)
-            .setDstStageMask(vk::PipelineStageFlagBits2::eNone)
-            .setDstAccessMask(vk::AccessFlagBits2::eNone)
-            .setSubresourceRange(vk::ImageSubresourceRange{
-                    vk::ImageAspectFlagBits::eColor,
-                    0,
-                    static_cast<uint32_t>(MipMaps),
-                    0,
-                    1
-            });
-
-    auto Undefined2TransferDst_Dependency = vk::DependencyInfo{}.setImageMemoryBarriers(Undefined2TransferDst);
-    auto TransferDst2ReadOnly_Dependency = vk::DependencyInfo{}.setImageMemoryBarriers(TransferDst2ReadOnly);
-
-    CommandBuffer.pipelineBarrier2(Undefined2TransferDst_Dependency);
-    CommandBuffer.copyBufferToImage2(CopyBuffer2ImageInfo);
-    CommandBuffer.pipelineBarrier2(TransferDst2ReadOnly_Dependency);
-
-    auto CommandBufferSubmitInfo = vk::CommandBufferSubmitInfo{}
-            .setCommandBuffer(CommandBuffer)
-            .setDeviceMask(1);
-
-    auto SignalInfo = vk::SemaphoreSubmitInfo{}
-            .setSemaphore(OutTexture->TransferFinish)
-            .setValue(1);
-
-    auto SubmitInfo = vk::SubmitInfo2{}
-            .setCommandBufferInfos(CommandBufferSubmitInfo)
-            .setSignalSemaphoreInfos(SignalInfo);
-
-    Context->SubmitTransferCommands(CommandBuffer, SubmitInfo);
+    auto SubresourceRange = vk::ImageSubresourceRange{
+            vk::ImageAspectFlagBits::eColor,
+            0,
+            static_cast<uint32_t>(MipMaps),
+            0,
+            1
+    };
 
-    OutTexture->DescriptorSlot = Context->GrabDescriptorSlot(vk::DescriptorType::eCombinedImageSampler);
+    //queued before the upload is committed, so the write is applied no later than the frame that submits the upload
+    OutTexture->DescriptorHandle = Context->GrabDescriptorSlot(vk::DescriptorType::eCombinedImageSampler);
 
     auto DescriptorImageInfo = vk::DescriptorImageInfo{}
     .setImageLayout(vk::ImageLayout::eReadOnlyOptimal)
     .setImageView(OutTexture->ImageView)
     .setSampler(TextureSampler);
 
-    auto WriteDescriptorSet = vk::WriteDescriptorSet{}
-            .setDescriptorType(vk::DescriptorType::eCombinedImageSampler)
-            .setDescriptorCount(1)
-            .setDstSet(Context->ShaderResourceSet)
-            .setDstBinding(0)
-            .setDstArrayElement(OutTexture->DescriptorSlot)
-            .setImageInfo(DescriptorImageInfo);
+    Context->WriteDescriptorSlot(vk::DescriptorType::eCombinedImageSampler, OutTexture->DescriptorHandle, DescriptorImageInfo);
 
-    Context->Device.updateDescriptorSets(WriteDescriptorSet, {});
+    //layout transitions are recorded by the upload manager
+    Staging.CopyToImage(OutTexture->Image, SubresourceRange, std::move(CopyRegions));
+    OutTexture->TransferTicket.store(Context->Uploader->Commit(std::move(Staging)), std::memory_order_release);
 }
 
-void VModelManager::LoadFileTexture(VTexture* OutTexture, std::fpath Path, std::shared_ptr<Assimp::Importer> Importer, TAssetPtr<VModel> Asset)
+void VModelManager::LoadFileTexture(VTexture* OutTexture, AssetId Id)
 {
+    PROFILE_SCOPE("Load File Texture");
+    std::fpath Path = global::Assets.GetPath(Id);
     LOG_INFO("loading file texture - {}", Path);
 
-    FILE* file = fopen(Path.c_str(), "r");
-    VERIFY(file != nullptr, strerror(errno));
-
-    int32_t Width; int32_t Height; int32_t Channels;
-    uint8_t* Pixels = stbi_load_from_file(file, &Width, &Height, &Channels, 4);
-    VERIFY(Pixels != nullptr, stbi_failure_reason());
-
-    fclose(file);
-
-    LoadTexture(Pixels, Width, Height, OutTexture, Path);
-    SafeFree(Pixels)
+    std::vector<uint8_t> Source = ReadFileBinary(Path);
+    LoadDerivedTexture(OutTexture, Source, 0, 0, Path);
 
     LOG_INFO("finished loading file texture - {}", Path);
 }
 
-void VModelManager::LoadEmbeddedTexture(VTexture* OutTexture, const aiTexture* EmbeddedTexture, std::shared_ptr<Assimp::Importer> Importer, TAssetPtr<VModel> Asset)
+void VModelManager::LoadEmbeddedTexture(VTexture* OutTexture, std::shared_ptr<const VCookedModel> Cooked, uint32_t TextureIndex, AssetId Id)
 {
-    LOG_INFO("loading embedded texture - {}", EmbeddedTexture->mFilename.C_Str());
+    PROFILE_SCOPE("Load Embedded Texture");
+    std::string Name{global::Assets.GetName(Id)};
+    LOG_INFO("loading embedded texture - {}", Name);
 
-    if(EmbeddedTexture->mHeight == 0)
-    {
-        int32_t Width; int32_t Height; int32_t Channels;
-        uint8_t* Pixels = stbi_load_from_memory(reinterpret_cast<uint8_t*>(EmbeddedTexture->pcData), EmbeddedTexture->mWidth, &Width, &Height, &Channels, 4);
-        VERIFY(Pixels != nullptr, stbi_failure_reason());
+    const CookedTexture& EmbeddedTexture = Cooked->Textures()[TextureIndex];
+    std::span<const uint8_t> Source{Cooked->Data(EmbeddedTexture.DataOffset), EmbeddedTexture.DataSize};
 
-        LoadTexture(Pixels, Width, Height, OutTexture, EmbeddedTexture->mFilename.C_Str());
-        SafeFree(Pixels);
+    if(EmbeddedTexture.Height == 0)
+    {
+        LoadDerivedTexture(OutTexture, Source, 0, 0, Name);
     }
     else
     {
-        LoadTexture(reinterpret_cast<uint8_t*>(EmbeddedTexture->pcData), EmbeddedTexture->mWidth, EmbeddedTexture->mHeight, OutTexture, EmbeddedTexture->mFilename.C_Str());
+        LoadDerivedTexture(OutTexture, Source, EmbeddedTexture.Width, EmbeddedTexture.Height, Name);
     }
 
-    LOG_INFO("finished loading embedded texture - {}", EmbeddedTexture->mFilename.C_Str());
+    LOG_INFO("finished loading embedded texture - {}", Name);
 }
 
-void VModelManager::GarbageCollect(bool InDestruction)
+void VModelManager::RetireModel(AssetId Id)
 {
-    if(TaskExecutor.num_topologies() != 0)
+    std::lock_guard Guard{ReferenceMx};
+
+    //a reclaim may have freed it already, or it got referenced again since the last reference was dropped
+    VModel* Model = Models.Find(Id);
+    if(Model == nullptr || Model->GetRefCount() != 0)
     {
         return;
     }
 
-    bool bModelIsLoaded;
-    bool bFreeModel;
-    std::function<void(scene::SceneNode* Node)> CheckSceneNode = [this, &bModelIsLoaded, &bFreeModel, InDestruction](scene::SceneNode* Node)
+    Model->SetRetiredIn(Retired.Retire([this, Id](uint64_t Epoch)
     {
-        if(auto* MeshNode = dynamic_cast<scene::MeshNode*>(Node))
+        std::lock_guard Guard{ReferenceMx};
+
+        VModel* Model = FindRetired(Models, Id, Epoch);
+        if(Model == nullptr)
         {
-            for(const auto& MeshRef : MeshNode->Meshes)
+            return true;
+        }
+
+        //the meshes and textures the model was the last user of wait for the frames of this epoch in turn
+        Model->ForEachNode([this](scene::SceneNode* Node)
+        {
+            if(auto* MeshNode = dynamic_cast<scene::MeshNode*>(Node))
             {
+                for(const auto& MeshRef : MeshNode->Meshes)
                 {
-                    auto MeshIt = Meshes.find(MeshRef.MeshName);
-                    VMesh& Mesh = MeshIt->second;
-
-                    if(bFreeModel)
+                    VMesh& Mesh = Meshes.At(MeshRef.Mesh);
+                    if(Mesh.RemoveReference() == 1)
                     {
-                        if(Mesh.RemoveReference() == 1)
-                        {
-                            auto Destruction = [Copy = Mesh]()
-                            {
-                                vkContext->Device.destroySemaphore(Copy.TransferFinish);
-
-                                vkContext->FreeIndexBufferMemory(Copy.IndexSlot);
-                                vkContext->FreeVertexBufferMemory(Copy.PositionSlot);
-                                vkContext->FreeVertexBufferMemory(Copy.NormalUVSlot);
-                            };
-
-                            if(InDestruction)
-                            {
-                                Destruction();
-                            }
-                            else
-                            {
-                                vkContext->DeferredDestructionQueue.enqueue(Destruction);
-                            }
-
-                            LOG_DEBUG("GC,d mesh {}", MeshIt->first);
-                            Meshes.unsafe_erase(MeshIt);
-                        }
+                        RetireMesh(MeshRef.Mesh, Mesh);
                     }
-                    else
-                    {
-                        if(Mesh.IsFinished())
-                        {
-                            if(Mesh.Staging.has_value())
-                            {
-                                LOG_DEBUG("GC,d staging buffer {}", MeshIt->first);
-                                Context->Allocator.destroyBuffer(Mesh.Staging->StagingBuffer, Mesh.Staging->Allocation);
-                                Context->FreeTransferCommandBuffer(Mesh.Staging->CommandBuffer);
-                                Mesh.Staging.reset();
-                            }
-                        }
-                        else
-                        {
-                            bModelIsLoaded = false;
-                        }
-                    }
-                }
 
-                for(const auto& TextureRef : MeshRef.Textures)
-                {
-                    auto TextureIt = Textures.find(TextureRef.Name);
-                    VTexture& Texture = TextureIt->second;
-
-                    if(bFreeModel)
+                    for(const auto& TextureRef : MeshRef.Textures)
                     {
+                        VTexture& Texture = Textures.At(TextureRef.Texture);
                         if(Texture.RemoveReference() == 1)
                         {
-                            auto Destruction = [Copy = Texture]()
-                            {
-                                vkContext->FreeDescriptorSlot(vk::DescriptorType::eCombinedImageSampler, Copy.DescriptorSlot);
-                                vkContext->Device.destroySemaphore(Copy.TransferFinish);
-                                vkContext->Device.destroyImageView(Copy.ImageView);
-                                vkContext->Allocator.destroyImage(Copy.Image, Copy.Allocation);
-                            };
-
-                            if(InDestruction)
-                            {
-                                Destruction();
-                            }
-                            else
-                            {
-                                vkContext->DeferredDestructionQueue.enqueue(Destruction);
-                            }
-
-                            LOG_DEBUG("GC,d texture {}", TextureIt->first);
-                            Textures.unsafe_erase(TextureIt);
-                        }
-                    }
-                    else
-                    {
-                        if(Texture.IsFinished())
-                        {
-                            if(Texture.Staging.has_value())
-                            {
-                                LOG_DEBUG("GC,d staging buffer {}", TextureIt->first);
-                                Context->Allocator.destroyBuffer(Texture.Staging->StagingBuffer, Texture.Staging->Allocation);
-                                Context->FreeTransferCommandBuffer(Texture.Staging->CommandBuffer);
-                                Texture.Staging.reset();
-                            }
-                        }
-                        else
-                        {
-                            bModelIsLoaded = false;
+                            RetireTexture(TextureRef.Texture, Texture);
                         }
                     }
                 }
             }
+        });
+
+        LOG_DEBUG("freeing model {}", global::Assets.GetName(Id));
+        Models.Erase(Id);
+
+        return true;
+    }));
+}
+
+void VModelManager::RetireMesh(AssetId Id, VMesh& Mesh)
+{
+    Mesh.SetRetiredIn(Retired.Retire([this, Id](uint64_t Epoch)
+    {
+        std::lock_guard Guard{ReferenceMx};
+
+        VMesh* Mesh = FindRetired(Meshes, Id, Epoch);
+        if(Mesh == nullptr)
+        {
+            return true;
+        }
+
+        //the upload may still be writing into the slots
+        if(!Mesh->IsFinished())
+        {
+            return false;
         }
-    };
 
-    auto it = Models.begin();
-    while(it != Models.end())
+        Context->FreeIndexBufferMemory(Mesh->IndexSlot);
+        Context->FreeVertexBufferMemory(Mesh->PositionSlot);
+        Context->FreeVertexBufferMemory(Mesh->NormalUVSlot);
+        Context->FreeVertexBufferMemory(Mesh->MeshletSlot);
+        Context->FreeMeshIndex(Mesh->MeshIndex);
+
+        LOG_DEBUG("freeing mesh {}", global::Assets.GetName(Id));
+        Meshes.Erase(Id);
+
+        return true;
+    }));
+}
+
+void VModelManager::RetireTexture(AssetId Id, VTexture& Texture)
+{
+    Texture.SetRetiredIn(Retired.Retire([this, Id](uint64_t Epoch)
     {
-        bModelIsLoaded = true;
-        bFreeModel = false;
-        it->second.ForEachNode(CheckSceneNode);
+        std::lock_guard Guard{ReferenceMx};
 
-        if(bModelIsLoaded && it->second.GetRefCount() == 0)
+        VTexture* Texture = FindRetired(Textures, Id, Epoch);
+        if(Texture == nullptr)
         {
-            bModelIsLoaded = true;
-            bFreeModel = true;
-            it->second.ForEachNode(CheckSceneNode);
+            return true;
+        }
 
-            LOG_DEBUG("GC,d model {}", it->first);
-            it = Models.unsafe_erase(it);
+        if(!Texture->IsFinished())
+        {
+            return false;
         }
-        else
+
+        if(Texture->DescriptorHandle)
         {
-            ++it;
+            Context->FreeDescriptorSlot(vk::DescriptorType::eCombinedImageSampler, Texture->DescriptorHandle);
         }
-    }
+
+        Context->Device.destroyImageView(Texture->ImageView);
+        Context->Allocator.destroyImage(Texture->Image, Texture->Allocation);
+
+        LOG_DEBUG("freeing texture {}", global::Assets.GetName(Id));
+        Textures.Erase(Id);
+
+        return true;
+    }));
+}
+
+void VModelManager::Reclaim()
+{
+    Retired.Reclaim();
 }
 
+std::vector<VGeometryRelocation> VModelManager::DefragmentGeometry(uint64_t MaxBytes)
+{
+    //loaders insert meshes and grab memory concurrently, so only run while they are idle
+    if(LoadJobs.IsBusy())
+    {
+        return {};
+    }
 
+    RangeAllocatorStats IndexStats = Context->GetIndexBufferStats();
+    RangeAllocatorStats VertexStats = Context->GetVertexBufferStats();
 
+    if(IndexStats.Fragmentation() < GEOMETRY_DEFRAG_THRESHOLD && VertexStats.Fragmentation() < GEOMETRY_DEFRAG_THRESHOLD)
+    {
+        return {};
+    }
+
+    //retired meshes may be reclaimed before the copy is recorded, a mesh referenced now is retired in this epoch at the earliest
+    std::lock_guard Guard{ReferenceMx};
+
+    //meshes still in transfer would have their copy race the upload
+    std::vector<VGeometryRelocation> Relocations = Context->DefragmentGeometryBuffers(MaxBytes, [](uint64_t Owner)
+    {
+        const VMesh* Mesh = reinterpret_cast<const VMesh*>(Owner);
+        return Mesh->GetRefCount() != 0 && Mesh->IsFinished();
+    });
 
+    for(const VGeometryRelocation& Relocation : Relocations)
+    {
+        VMesh* Mesh = reinterpret_cast<VMesh*>(Relocation.Owner);
+
+        if(Relocation.Buffer == &Context->GlobalIndexBuffer)
+        {
+            Mesh->IndexSlot = Relocation.Dst;
+        }
+        else if(Mesh->PositionSlot.Offset == Relocation.Src.Offset)
+        {
+            Mesh->PositionSlot = Relocation.Dst;
+        }
+        else if(Mesh->NormalUVSlot.Offset == Relocation.Src.Offset)
+        {
+            Mesh->NormalUVSlot = Relocation.Dst;
+        }
+        else
+        {
+            ASSERT(Mesh->MeshletSlot.Offset == Relocation.Src.Offset);
+            Mesh->MeshletSlot = Relocation.Dst;
+        }
+    }
+
+    if(!Relocations.empty())
+    {
+        LOG_DEBUG("relocating {} geometry ranges, fragmentation index {:.2f} vertex {:.2f}", Relocations.size(), IndexStats.Fragmentation(), VertexStats.Fragmentation());
+    }
+
+    return Relocations;
+}
@@ -10,6 +10,9 @@
 
 vk::PipelineLayout VPipelineLayoutCache::create_layout(const layout_info_t& layout_info)
 {
+    //pipelines are built in parallel
+    std::lock_guard Guard{layouts_mx};
+
     auto found_layout = layouts.find(layout_info);
 
     if(found_layout != layouts.end())
@@ -31,7 +34,7 @@ vk::PipelineLayout VPipelineLayoutCache::create_layout(const layout_info_t& layo
         vk::PipelineLayout new_layout = Context->Device.createPipelineLayout(info);
 
         layouts.insert(std::make_pair(std::move(LayoutInfoCopy), new_layout));
-        Context->NameObject(new_layout, fmt::format("cached pipeline layout [{}]", layouts.size() - 1));
+        Context->NameObject(new_layout, "cached pipeline layout [{}]", layouts.size() - 1);
 
         return new_layout;
     }
@@ -77,7 +80,7 @@ VPipelineLayoutCache::VPipelineLayoutCache(VContext* Context_)
     Context = Context_;
     pipeline_cache_path = ProjectAbsolutePath("saved/pipeline_cache_data");
 
-    PipelineCache = global::TaskExecutor.async([this]()
+    PipelineCache = global::Scheduler.Async(JobPriority::Background, [this]()
     {
         LOG_INFO("reading pipeline cache from {}", pipeline_cache_path);
         std::vector<uint8_t> PipelineData = ReadFileBinary(pipeline_cache_path, true);
@@ -108,7 +111,8 @@ VPipelineLayoutCache::~VPipelineLayoutCache()
 
 vk::PipelineCache VPipelineLayoutCache::GetPipelineCache()
 {
-    return PipelineCache.get();
+    //builders run as jobs, so they run other jobs while the cache is read instead of holding a worker
+    return global::Scheduler.Await(PipelineCache);
 }
 
 size_t VPipelineLayoutCache::layout_info_hasher::operator()(const VPipelineLayoutCache::layout_info_t& layout_info) const
@@ -135,50 +139,53 @@ void VComputePipelineBuilder::Build(vk::PipelineLayout* out_layout, vk::Pipeline
 
     for(VDeferredShader& DeferredShader : Shaders)
     {
-        VShader* CachedShader = DeferredShader.Shader.get();
-        const SpvReflectShaderModule* ReflectionModule = &CachedShader->ReflectionModule;
-
-        auto ShaderStage = static_cast<vk::ShaderStageFlagBits>(ReflectionModule->shader_stage);
-
-        uint32_t PushConstantBlocksCount = 0;
-        spvResultCheck = spvReflectEnumeratePushConstantBlocks(ReflectionModule, &PushConstantBlocksCount, nullptr);
+        VShader* CachedShader = global::Scheduler.Await(DeferredShader.Shader);
+        vk::ShaderStageFlagBits ShaderStage = CachedShader->Stage;
 
-        std::vector<SpvReflectBlockVariable*> PushConstantBlocks(PushConstantBlocksCount);
-        spvResultCheck = spvReflectEnumeratePushConstantBlocks(ReflectionModule, &PushConstantBlocksCount, PushConstantBlocks.data());
-
-        for(SpvReflectBlockVariable* ReflectedPC : PushConstantBlocks)
+        for(const VShaderPushConstant& PushConstant : CachedShader->PushConstants)
         {
             PipelineLayoutInfo.push_constants.emplace_back()
                     .setStageFlags(ShaderStage)
-                    .setSize(ReflectedPC->size)
-                    .setOffset(ReflectedPC->offset);
+                    .setSize(PushConstant.Size)
+                    .setOffset(PushConstant.Offset);
         }
 
-        uint32_t DescriptorSetCount = 0;
-        spvResultCheck = spvReflectEnumerateDescriptorSets(ReflectionModule, &DescriptorSetCount, nullptr);
-
-        std::vector<SpvReflectDescriptorSet*> DescriptorSets(DescriptorSetCount);
-        spvResultCheck = spvReflectEnumerateDescriptorSets(ReflectionModule, &DescriptorSetCount, DescriptorSets.data());
-
-        for(SpvReflectDescriptorSet* ReflectedDS : DescriptorSets)
+        //the bindings are ordered by set, each run of the same set becomes one layout
+        for(uint64_t SetStart = 0; SetStart < CachedShader->Bindings.size();)
         {
             VDescriptorLayoutCache::layout_info_t DescriptorLayoutInfo{};
 
-            for(uint32_t binding_idx = 0; binding_idx < ReflectedDS->binding_count; ++binding_idx)
+            uint64_t SetEnd = SetStart;
+            for(; SetEnd < CachedShader->Bindings.size() && CachedShader->Bindings[SetEnd].Set == CachedShader->Bindings[SetStart].Set; ++SetEnd)
             {
-                const SpvReflectDescriptorBinding* ReflectedBinding = ReflectedDS->bindings[binding_idx];
+                const VShaderBinding& ReflectedBinding = CachedShader->Bindings[SetEnd];
+
+                auto DescriptorType = static_cast<vk::DescriptorType>(ReflectedBinding.DescriptorType);
+                vk::DescriptorBindingFlags DescriptorFlags{};
+                vk::ShaderStageFlags StageFlags = ShaderStage;
+                uint32_t DescriptorCount = ReflectedBinding.Count;
+
+                //unsized arrays are the bindless shader resources, same as in the graphics builder
+                if(ReflectedBinding.ArrayDimsCount != 0 && (ReflectedBinding.ArrayDim == 0 || ReflectedBinding.ArrayDim == 1))
+                {
+                    DescriptorCount = PipelineLayoutCache->Context->FindBindlessTable(DescriptorType)->PoolSize.descriptorCount;
+                    DescriptorFlags |= vk::DescriptorBindingFlagBits::ePartiallyBound | vk::DescriptorBindingFlagBits::eUpdateAfterBind;
+                    StageFlags = VContext::ShaderResourceStages;
+                }
 
                 DescriptorLayoutInfo.bindings.emplace_back()
-                        .setStageFlags(ShaderStage)
-                        .setBinding(ReflectedBinding->binding)
-                        .setDescriptorCount(ReflectedBinding->count)
-                        .setDescriptorType(static_cast<vk::DescriptorType>(ReflectedBinding->descriptor_type));
+                        .setStageFlags(StageFlags)
+                        .setBinding(ReflectedBinding.Binding)
+                        .setDescriptorCount(DescriptorCount)
+                        .setDescriptorType(DescriptorType);
 
-                DescriptorLayoutInfo.flags.emplace_back(); //todo add support for flags?
+                DescriptorLayoutInfo.flags.emplace_back(DescriptorFlags);
             }
 
             vk::DescriptorSetLayout SetLayout = DescriptorLayoutCache->create_layout(DescriptorLayoutInfo);
             PipelineLayoutInfo.set_layouts.emplace_back(SetLayout);
+
+            SetStart = SetEnd;
         }
 
         ShaderCreateInfos.emplace_back()
@@ -198,7 +205,7 @@ void VComputePipelineBuilder::Build(vk::PipelineLayout* out_layout, vk::Pipeline
 
     if(!debug_name.empty())
     {
-        PipelineLayoutCache->Context->NameObject(*out_pipeline, fmt::format("{} compute pipeline", debug_name));
+        PipelineLayoutCache->Context->NameObject(*out_pipeline, "{} compute pipeline", debug_name);
     }
 }
 
@@ -211,72 +218,59 @@ void VGraphicsPipelineBuilder::Build(vk::PipelineLayout* out_layout, vk::Pipelin
 
     for(VDeferredShader& DeferredShader : Shaders)
     {
-        DeferredShader.Shader.wait();
-
-        VShader* CachedShader = DeferredShader.Shader.get();
-        const SpvReflectShaderModule* ReflectionModule = &CachedShader->ReflectionModule;
-
-        auto ShaderStage = static_cast<vk::ShaderStageFlagBits>(ReflectionModule->shader_stage);
+        VShader* CachedShader = global::Scheduler.Await(DeferredShader.Shader);
+        vk::ShaderStageFlagBits ShaderStage = CachedShader->Stage;
 
-        uint32_t PushConstantBlocksCount = 0;
-        spvResultCheck = spvReflectEnumeratePushConstantBlocks(ReflectionModule, &PushConstantBlocksCount, nullptr);
-
-        std::vector<SpvReflectBlockVariable*> PushConstantBlocks(PushConstantBlocksCount);
-        spvResultCheck = spvReflectEnumeratePushConstantBlocks(ReflectionModule, &PushConstantBlocksCount, PushConstantBlocks.data());
-
-        for(SpvReflectBlockVariable* ReflectedPC : PushConstantBlocks)
+        for(const VShaderPushConstant& PushConstant : CachedShader->PushConstants)
         {
             PipelineLayoutInfo.push_constants.emplace_back()
                     .setStageFlags(ShaderStage)
-                    .setSize(ReflectedPC->size)
-                    .setOffset(ReflectedPC->offset);
+                    .setSize(PushConstant.Size)
+                    .setOffset(PushConstant.Offset);
         }
 
-        uint32_t DescriptorSetCount = 0;
-        spvResultCheck = spvReflectEnumerateDescriptorSets(ReflectionModule, &DescriptorSetCount, nullptr);
-
-        std::vector<SpvReflectDescriptorSet*> DescriptorSets(DescriptorSetCount);
-        spvResultCheck = spvReflectEnumerateDescriptorSets(ReflectionModule, &DescriptorSetCount, DescriptorSets.data());
-
-        for(SpvReflectDescriptorSet* ReflectedDS : DescriptorSets)
+        for(uint64_t SetStart = 0; SetStart < CachedShader->Bindings.size();)
         {
             VDescriptorLayoutCache::layout_info_t DescriptorLayoutInfo{};
 
-            for(uint32_t binding_idx = 0; binding_idx < ReflectedDS->binding_count; ++binding_idx)
+            uint64_t SetEnd = SetStart;
+            for(; SetEnd < CachedShader->Bindings.size() && CachedShader->Bindings[SetEnd].Set == CachedShader->Bindings[SetStart].Set; ++SetEnd)
             {
-                const SpvReflectDescriptorBinding* ReflectedBinding = ReflectedDS->bindings[binding_idx];
+                const VShaderBinding& ReflectedBinding = CachedShader->Bindings[SetEnd];
 
-                auto DescriptorType = static_cast<vk::DescriptorType>(ReflectedBinding->descriptor_type);
+                auto DescriptorType = static_cast<vk::DescriptorType>(ReflectedBinding.DescriptorType);
                 if(DescriptorType == vk::DescriptorType::eUniformBuffer)
                 {
                     DescriptorType = vk::DescriptorType::eUniformBufferDynamic; //hacky workaround
                 }
 
                 vk::DescriptorBindingFlags DescriptorFlags{};
+                vk::ShaderStageFlags StageFlags = ShaderStage;
 
                 uint32_t DescriptorCount;
-                if(ReflectedBinding->array.dims_count != 0)
+                if(ReflectedBinding.ArrayDimsCount != 0)
                 {
-                    ASSERT(ReflectedBinding->array.dims_count == 1);
+                    ASSERT(ReflectedBinding.ArrayDimsCount == 1);
 
-                    if(ReflectedBinding->array.dims[0] == 0 || ReflectedBinding->array.dims[0] == 1) //unacessed array has dimension of 1....
+                    if(ReflectedBinding.ArrayDim == 0 || ReflectedBinding.ArrayDim == 1) //unacessed array has dimension of 1....
                     {
-                        DescriptorCount = PipelineLayoutCache->Context->FindFreeList(DescriptorType)->PoolSize.descriptorCount;
+                        DescriptorCount = PipelineLayoutCache->Context->FindBindlessTable(DescriptorType)->PoolSize.descriptorCount;
                         DescriptorFlags |= vk::DescriptorBindingFlagBits::ePartiallyBound | vk::DescriptorBindingFlagBits::eUpdateAfterBind;
+                        StageFlags = VContext::ShaderResourceStages; //has to match ShaderResourceLayout
                     }
                     else
                     {
-                        DescriptorCount = ReflectedBinding->array.dims[0];
+                        DescriptorCount = ReflectedBinding.ArrayDim;
                     }
                 }
                 else
                 {
-                    DescriptorCount = ReflectedBinding->count;
+                    DescriptorCount = ReflectedBinding.Count;
                 }
 
                 DescriptorLayoutInfo.bindings.emplace_back()
-                        .setStageFlags(ShaderStage)
-                        .setBinding(ReflectedBinding->binding)
+                        .setStageFlags(StageFlags)
+                        .setBinding(ReflectedBinding.Binding)
                         .setDescriptorCount(DescriptorCount)
                         .setDescriptorType(DescriptorType);
 
@@ -285,6 +279,8 @@ void VGraphicsPipelineBuilder::Build(vk::PipelineLayout* out_layout, vk::Pipelin
 
             vk::DescriptorSetLayout SetLayout = DescriptorLayoutCache->create_layout(DescriptorLayoutInfo);
             PipelineLayoutInfo.set_layouts.emplace_back(SetLayout);
+
+            SetStart = SetEnd;
         }
 
         ShaderCreateInfos.emplace_back()
@@ -0,0 +1,509 @@
+#include "vk_render_graph.hpp"
+#include "vk_context.hpp"
+#include "vk_gpu_profiler.hpp"
+#include "core/log.hpp"
+#include "core/assertion.hpp"
+#include "core/math.hpp"
+#include "fmt/format.h"
+#include <algorithm>
+
+static constexpr vk::AccessFlags2 WriteAccessMask =
+        vk::AccessFlagBits2::eShaderWrite
+        | vk::AccessFlagBits2::eShaderStorageWrite
+        | vk::AccessFlagBits2::eColorAttachmentWrite
+        | vk::AccessFlagBits2::eDepthStencilAttachmentWrite
+        | vk::AccessFlagBits2::eTransferWrite
+        | vk::AccessFlagBits2::eHostWrite
+        | vk::AccessFlagBits2::eMemoryWrite;
+
+static bool IsWrite(const VImageUse& Use)
+{
+    return static_cast<bool>(Use.Access & WriteAccessMask);
+}
+
+static bool IsRead(const VImageUse& Use)
+{
+    return static_cast<bool>(Use.Access & ~WriteAccessMask) || !IsWrite(Use);
+}
+
+VRenderGraphPass& VRenderGraphPass::Use(VRenderGraphImage Image, const VImageUse& ImageUse)
+{
+    ASSERT(Image);
+    ASSERT(std::none_of(Accesses.begin(), Accesses.end(), [Image](const ImageAccess& Access){ return Access.Image == Image.Index; }), Name, "uses an image twice");
+
+    Accesses.emplace_back(ImageAccess{Image.Index, ImageUse});
+    return *this;
+}
+
+VRenderGraphPass& VRenderGraphPass::SetSideEffects()
+{
+    bSideEffects = true;
+    return *this;
+}
+
+void VRenderGraph::Init(VContext* Context_, VGpuProfiler* Profiler_)
+{
+    Context = Context_;
+    Profiler = Profiler_;
+}
+
+VRenderGraphImage VRenderGraph::ImportImage(std::string Name, vk::ImageAspectFlags Aspect, std::optional<VImageUse> Initial)
+{
+    ASSERT(!bCompiled);
+
+    ImageEntry& Entry = Images.emplace_back();
+    Entry.Name = std::move(Name);
+    Entry.Aspect = Aspect;
+    Entry.Initial = Initial;
+
+    return VRenderGraphImage{static_cast<uint32_t>(Images.size() - 1)};
+}
+
+VRenderGraphImage VRenderGraph::CreateImage(std::string Name, const vk::ImageCreateInfo& CreateInfo, vk::ImageAspectFlags Aspect, vk::ImageUsageFlags ViewUsage)
+{
+    ASSERT(!bCompiled);
+
+    ImageEntry& Entry = Images.emplace_back();
+    Entry.Name = std::move(Name);
+    Entry.Aspect = Aspect;
+    Entry.bTransient = true;
+    Entry.CreateInfo = CreateInfo;
+    Entry.ViewUsage = ViewUsage;
+
+    return VRenderGraphImage{static_cast<uint32_t>(Images.size() - 1)};
+}
+
+void VRenderGraph::ExportImage(VRenderGraphImage Image, const VImageUse& Final)
+{
+    Images[Image.Index].Final = Final;
+}
+
+VRenderGraphPass& VRenderGraph::AddPass(std::string_view Name, uint32_t Segment, std::function<void(vk::CommandBuffer)> Record)
+{
+    ASSERT(!bCompiled);
+
+    VRenderGraphPass& Pass = Passes.emplace_back();
+    Pass.Name = Name;
+    Pass.Segment = Segment;
+    Pass.Record = std::move(Record);
+
+    return Pass;
+}
+
+void VRenderGraph::Compile()
+{
+    ASSERT(!bCompiled);
+
+    CullPasses();
+    PlaceTransientImages();
+    BuildBarriers();
+
+    bCompiled = true;
+
+    uint64_t LivePasses = std::count_if(Passes.begin(), Passes.end(), [](const VRenderGraphPass& Pass){ return !Pass.bCulled; });
+    LOG_INFO("render graph compiled, {} of {} passes, {:.1f} MiB transient memory, {:.1f} MiB unaliased", LivePasses, Passes.size(),
+             static_cast<double>(TransientBytes) / (1024.0 * 1024.0), static_cast<double>(UnaliasedBytes) / (1024.0 * 1024.0));
+}
+
+void VRenderGraph::CullPasses()
+{
+    //walking backwards, an image is needed while a later live pass reads what is currently in it
+    std::vector<bool> Needed(Images.size(), false);
+    for(uint32_t Image = 0; Image < Images.size(); ++Image)
+    {
+        Needed[Image] = Images[Image].Final.has_value();
+    }
+
+    for(auto Pass = Passes.rbegin(); Pass != Passes.rend(); ++Pass)
+    {
+        bool bNeeded = Pass->bSideEffects;
+        for(const VRenderGraphPass::ImageAccess& Access : Pass->Accesses)
+        {
+            bNeeded |= IsWrite(Access.Use) && Needed[Access.Image];
+        }
+
+        Pass->bCulled = !bNeeded;
+        if(Pass->bCulled)
+        {
+            LOG_DEBUG("render graph culled {}", Pass->Name);
+            continue;
+        }
+
+        for(const VRenderGraphPass::ImageAccess& Access : Pass->Accesses)
+        {
+            Needed[Access.Image] = IsRead(Access.Use);
+        }
+    }
+
+    for(uint32_t PassIndex = 0; PassIndex < Passes.size(); ++PassIndex)
+    {
+        if(Passes[PassIndex].bCulled)
+        {
+            continue;
+        }
+
+        for(const VRenderGraphPass::ImageAccess& Access : Passes[PassIndex].Accesses)
+        {
+            ImageEntry& Entry = Images[Access.Image];
+            Entry.FirstPass = std::min(Entry.FirstPass, PassIndex);
+            Entry.LastPass = std::max(Entry.LastPass, PassIndex);
+        }
+    }
+}
+
+bool VRenderGraph::SharesMemory(const ImageEntry& A, const ImageEntry& B) const
+{
+    if(!A.bTransient || !B.bTransient || A.Block != B.Block || A.Block == UINT32_MAX)
+    {
+        return false;
+    }
+
+    return A.Offset < B.Offset + B.Requirements.size && B.Offset < A.Offset + A.Requirements.size;
+}
+
+void VRenderGraph::PlaceTransientImages()
+{
+    vk::Device Device = Context->Device;
+
+    std::vector<uint32_t> Placement{};
+    for(uint32_t Index = 0; Index < Images.size(); ++Index)
+    {
+        ImageEntry& Entry = Images[Index];
+        if(!Entry.bTransient || Entry.FirstPass == UINT32_MAX)
+        {
+            continue;
+        }
+
+        Entry.Image = Device.createImage(Entry.CreateInfo);
+        Context->NameObject(Entry.Image, "{} image", Entry.Name);
+
+        Entry.Requirements = Device.getImageMemoryRequirements(Entry.Image);
+        UnaliasedBytes += Entry.Requirements.size;
+
+        Placement.emplace_back(Index);
+    }
+
+    //largest first, each at the lowest offset not taken by an image it is alive together with
+    std::sort(Placement.begin(), Placement.end(), [this](uint32_t A, uint32_t B)
+    {
+        return Images[A].Requirements.size > Images[B].Requirements.size;
+    });
+
+    for(uint32_t Index : Placement)
+    {
+        ImageEntry& Entry = Images[Index];
+
+        auto Block = std::find_if(Blocks.begin(), Blocks.end(), [&Entry](const MemoryBlock& Candidate)
+        {
+            return (Candidate.MemoryTypeBits & Entry.Requirements.memoryTypeBits) != 0;
+        });
+
+        if(Block == Blocks.end())
+        {
+            Block = Blocks.emplace(Blocks.end(), MemoryBlock{.MemoryTypeBits = Entry.Requirements.memoryTypeBits});
+        }
+
+        Entry.Block = static_cast<uint32_t>(Block - Blocks.begin());
+
+        std::vector<std::pair<vk::DeviceSize, vk::DeviceSize>> Taken{};
+        for(const ImageEntry& Other : Images)
+        {
+            bool bOverlaps = Other.FirstPass <= Entry.LastPass && Entry.FirstPass <= Other.LastPass;
+            if(&Other != &Entry && Other.Block == Entry.Block && Other.Image && bOverlaps)
+            {
+                Taken.emplace_back(Other.Offset, Other.Offset + Other.Requirements.size);
+            }
+        }
+
+        std::sort(Taken.begin(), Taken.end());
+
+        vk::DeviceSize Offset = 0;
+        for(auto[Begin, End] : Taken)
+        {
+            if(Offset + Entry.Requirements.size <= Begin)
+            {
+                break;
+            }
+
+            Offset = std::max<vk::DeviceSize>(Offset, math::PadSize2Alignment(End, Entry.Requirements.alignment));
+        }
+
+        Entry.Offset = Offset;
+
+        Block->MemoryTypeBits &= Entry.Requirements.memoryTypeBits;
+        Block->Size = std::max(Block->Size, Offset + Entry.Requirements.size);
+        Block->Alignment = std::max(Block->Alignment, Entry.Requirements.alignment);
+    }
+
+    auto AllocationCreateInfo = vma::AllocationCreateInfo{}
+            .setRequiredFlags(vk::MemoryPropertyFlagBits::eDeviceLocal);
+
+    for(uint32_t BlockIndex = 0; BlockIndex < Blocks.size(); ++BlockIndex)
+    {
+        MemoryBlock& Block = Blocks[BlockIndex];
+
+        auto BlockRequirements = vk::MemoryRequirements{}
+                .setSize(Block.Size)
+                .setAlignment(Block.Alignment)
+                .setMemoryTypeBits(Block.MemoryTypeBits);
+
+        vkResultCheck = Context->Allocator.allocateMemory(&BlockRequirements, &AllocationCreateInfo, &Block.Allocation, nullptr);
+        Context->Allocator.setAllocationName(Block.Allocation, fmt::format("render graph transient memory [{}]", BlockIndex).c_str());
+
+        TransientBytes += Block.Size;
+    }
+
+    for(uint32_t Index : Placement)
+    {
+        ImageEntry& Entry = Images[Index];
+        vkResultCheck = Context->Allocator.bindImageMemory2(Blocks[Entry.Block].Allocation, Entry.Offset, Entry.Image, nullptr);
+
+        auto ViewUsage = vk::ImageViewUsageCreateInfo{}
+                .setUsage(Entry.ViewUsage);
+
+        auto ViewCreateInfo = vk::ImageViewCreateInfo{}
+                .setPNext(Entry.ViewUsage ? &ViewUsage : nullptr)
+                .setImage(Entry.Image)
+                .setFormat(Entry.CreateInfo.format)
+                .setViewType(vk::ImageViewType::e2D)
+                .setComponents(vk::ComponentMapping{})
+                .setSubresourceRange(vk::ImageSubresourceRange{Entry.Aspect, 0, VK_REMAINING_MIP_LEVELS, 0, VK_REMAINING_ARRAY_LAYERS});
+
+        vkResultCheck = Device.createImageView(&ViewCreateInfo, nullptr, &Entry.ImageView);
+        Context->NameObject(Entry.ImageView, "{} image view", Entry.Name);
+    }
+}
+
+void VRenderGraph::BuildBarriers()
+{
+    //what has to finish before the next access, the stages the last write is visible to and the current layout
+    struct ImageState
+    {
+        vk::PipelineStageFlags2 WriteStages{};
+        vk::AccessFlags2 WriteAccess{};
+        vk::PipelineStageFlags2 ReadStages{};
+        vk::PipelineStageFlags2 VisibleStages{};
+        vk::AccessFlags2 VisibleAccess{};
+        vk::ImageLayout Layout = vk::ImageLayout::eUndefined;
+    };
+
+    //the last use of an image in the frame, which the next frame starts after
+    auto LastUse = [this](uint32_t Image) -> VImageUse
+    {
+        const ImageEntry& Entry = Images[Image];
+        if(Entry.Final)
+        {
+            return *Entry.Final;
+        }
+
+        for(const VRenderGraphPass::ImageAccess& Access : Passes[Entry.LastPass].Accesses)
+        {
+            if(Access.Image == Image)
+            {
+                return Access.Use;
+            }
+        }
+
+        return VImageUse{};
+    };
+
+    std::vector<ImageState> States(Images.size());
+    for(uint32_t Image = 0; Image < Images.size(); ++Image)
+    {
+        const ImageEntry& Entry = Images[Image];
+        if(Entry.FirstPass == UINT32_MAX)
+        {
+            continue;
+        }
+
+        //contents are never kept, but whatever used the memory last has to be done with it, in this frame or the one before
+        VImageUse Previous = Entry.Initial.value_or(LastUse(Image));
+        States[Image].WriteStages = Previous.Stages;
+        States[Image].WriteAccess = Previous.Access & WriteAccessMask;
+
+        for(uint32_t Other = 0; Other < Images.size(); ++Other)
+        {
+            if(Other != Image && SharesMemory(Entry, Images[Other]))
+            {
+                VImageUse OtherUse = LastUse(Other);
+                States[Image].WriteStages |= OtherUse.Stages;
+                States[Image].WriteAccess |= OtherUse.Access & WriteAccessMask;
+            }
+        }
+
+        if(!States[Image].WriteStages)
+        {
+            States[Image].WriteStages = vk::PipelineStageFlagBits2::eAllCommands;
+        }
+    }
+
+    auto MakeBarrier = [this](uint32_t Image, const ImageState& State, const VImageUse& Use, vk::PipelineStageFlags2 SrcStages)
+    {
+        return vk::ImageMemoryBarrier2{}
+                .setOldLayout(State.Layout)
+                .setNewLayout(Use.Layout)
+                .setSrcStageMask(SrcStages)
+                .setSrcAccessMask(State.WriteAccess)
+                .setDstStageMask(Use.Stages)
+                .setDstAccessMask(Use.Access)
+                .setSubresourceRange(vk::ImageSubresourceRange{Images[Image].Aspect, 0, VK_REMAINING_MIP_LEVELS, 0, VK_REMAINING_ARRAY_LAYERS});
+    };
+
+    uint32_t SegmentCount = 0;
+    for(VRenderGraphPass& Pass : Passes)
+    {
+        SegmentCount = std::max(SegmentCount, Pass.Segment + 1);
+        Pass.Barriers.clear();
+        Pass.BarrierImages.clear();
+
+        if(Pass.bCulled)
+        {
+            continue;
+        }
+
+        for(const VRenderGraphPass::ImageAccess& Access : Pass.Accesses)
+        {
+            ImageState& State = States[Access.Image];
+            const VImageUse& Use = Access.Use;
+
+            bool bLayoutChange = Use.Layout != State.Layout;
+
+            if(IsWrite(Use) || bLayoutChange)
+            {
+                //write after write and write after read, a layout transition is a write as well
+                Pass.Barriers.emplace_back(MakeBarrier(Access.Image, State, Use, State.WriteStages | State.ReadStages));
+                Pass.BarrierImages.emplace_back(Access.Image);
+
+                State.WriteStages = Use.Stages;
+                State.WriteAccess = Use.Access & WriteAccessMask;
+                State.ReadStages = IsWrite(Use) ? vk::PipelineStageFlags2{} : Use.Stages;
+                State.VisibleStages = Use.Stages;
+                State.VisibleAccess = Use.Access;
+                State.Layout = Use.Layout;
+            }
+            else if((Use.Stages & ~State.VisibleStages) || (Use.Access & ~State.VisibleAccess))
+            {
+                //read after write by stages the write is not visible to yet, reads after reads need nothing
+                Pass.Barriers.emplace_back(MakeBarrier(Access.Image, State, Use, State.WriteStages));
+                Pass.BarrierImages.emplace_back(Access.Image);
+
+                State.ReadStages |= Use.Stages;
+                State.VisibleStages |= Use.Stages;
+                State.VisibleAccess |= Use.Access;
+            }
+            else
+            {
+                State.ReadStages |= Use.Stages;
+            }
+        }
+    }
+
+    FinalBarriers.assign(SegmentCount, {});
+    FinalBarrierImages.assign(SegmentCount, {});
+
+    for(uint32_t Image = 0; Image < Images.size(); ++Image)
+    {
+        const ImageEntry& Entry = Images[Image];
+        if(!Entry.Final || Entry.FirstPass == UINT32_MAX)
+        {
+            continue;
+        }
+
+        const ImageState& State = States[Image];
+        uint32_t Segment = Passes[Entry.LastPass].Segment;
+
+        FinalBarriers[Segment].emplace_back(MakeBarrier(Image, State, *Entry.Final, State.WriteStages | State.ReadStages));
+        FinalBarrierImages[Segment].emplace_back(Image);
+    }
+}
+
+void VRenderGraph::Execute(uint32_t Segment, vk::CommandBuffer CommandBuffer, VGpuFrameQueries* Queries)
+{
+    ASSERT(bCompiled);
+
+    auto RecordBarriers = [this, CommandBuffer](const std::vector<vk::ImageMemoryBarrier2>& Barriers, const std::vector<uint32_t>& BarrierImages)
+    {
+        if(Barriers.empty())
+        {
+            return;
+        }
+
+        ScratchBarriers.assign(Barriers.begin(), Barriers.end());
+        for(uint64_t Index = 0; Index < ScratchBarriers.size(); ++Index)
+        {
+            ASSERT(Images[BarrierImages[Index]].Image, Images[BarrierImages[Index]].Name);
+            ScratchBarriers[Index].setImage(Images[BarrierImages[Index]].Image);
+        }
+
+        CommandBuffer.pipelineBarrier2(vk::DependencyInfo{}.setImageMemoryBarriers(ScratchBarriers));
+    };
+
+    for(VRenderGraphPass& Pass : Passes)
+    {
+        if(Pass.Segment != Segment || Pass.bCulled)
+        {
+            continue;
+        }
+
+        if(Queries)
+        {
+            Profiler->BeginScope(CommandBuffer, *Queries, Pass.Name);
+        }
+
+        RecordBarriers(Pass.Barriers, Pass.BarrierImages);
+        Pass.Record(CommandBuffer);
+
+        if(Queries)
+        {
+            Profiler->EndScope(CommandBuffer, *Queries);
+        }
+    }
+
+    if(Segment < FinalBarriers.size())
+    {
+        RecordBarriers(FinalBarriers[Segment], FinalBarrierImages[Segment]);
+    }
+}
+
+void VRenderGraph::SetImage(VRenderGraphImage Image, vk::Image Handle)
+{
+    ASSERT(!Images[Image.Index].bTransient, Images[Image.Index].Name);
+    Images[Image.Index].Image = Handle;
+}
+
+vk::Image VRenderGraph::GetImage(VRenderGraphImage Image) const
+{
+    return Images[Image.Index].Image;
+}
+
+vk::ImageView VRenderGraph::GetImageView(VRenderGraphImage Image) const
+{
+    return Images[Image.Index].ImageView;
+}
+
+void VRenderGraph::Reset()
+{
+    for(ImageEntry& Entry : Images)
+    {
+        if(Entry.bTransient)
+        {
+            Context->Device.destroyImageView(Entry.ImageView);
+            Context->Device.destroyImage(Entry.Image);
+        }
+    }
+
+    for(MemoryBlock& Block : Blocks)
+    {
+        Context->Allocator.freeMemory(Block.Allocation);
+    }
+
+    Images.clear();
+    Passes.clear();
+    Blocks.clear();
+    FinalBarriers.clear();
+    FinalBarrierImages.clear();
+
+    TransientBytes = 0;
+    UnaliasedBytes = 0;
+    bCompiled = false;
+}
@@ -3,7 +3,11 @@
 #include "window/window.hpp"
 #include "core/log.hpp"
 #include "core/assertion.hpp"
+#include "core/utility_functions.hpp"
+#include "core/epoch.hpp"
+#include "image.hpp"
 #include "../../world/include/world/camera_component.hpp"
+#include <bit>
 
 using PipelineStage = vk::PipelineStageFlagBits2;
 using AccessFlag = vk::AccessFlagBits2;
@@ -88,15 +92,20 @@ static VContext::BaseInitializer MakeVulkanBaseInitializer(GLFWwindow* Window)
 {
     VContext::BaseInitializer Initializer{};
 
-    uint32_t NumInstanceExtensions;
-    const char** InstanceExtensions = glfwGetRequiredInstanceExtensions(&NumInstanceExtensions);
-
-    for(uint32_t idx = 0; idx < NumInstanceExtensions; ++idx)
+    //headless needs neither surface nor swapchain extensions, so a software device without a display works
+    if(Window != nullptr)
     {
-        Initializer.InstanceExtensions.emplace_back(InstanceExtensions[idx]);
+        uint32_t NumInstanceExtensions;
+        const char** InstanceExtensions = glfwGetRequiredInstanceExtensions(&NumInstanceExtensions);
+
+        for(uint32_t idx = 0; idx < NumInstanceExtensions; ++idx)
+        {
+            Initializer.InstanceExtensions.emplace_back(InstanceExtensions[idx]);
+        }
+
+        Initializer.DeviceExtensions.emplace_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
     }
 
-    Initializer.DeviceExtensions.emplace_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
     Initializer.DeviceExtensions.emplace_back(VK_EXT_CONDITIONAL_RENDERING_EXTENSION_NAME);
 
 #ifndef NDEBUG
@@ -107,6 +116,11 @@ static VContext::BaseInitializer MakeVulkanBaseInitializer(GLFWwindow* Window)
     Initializer.PhysicalDeviceFeatures.features2.features.samplerAnisotropy = true;
     Initializer.PhysicalDeviceFeatures.features2.features.shaderInt16 = true;
     Initializer.PhysicalDeviceFeatures.features2.features.shaderInt64 = true;
+    Initializer.PhysicalDeviceFeatures.features2.features.pipelineStatisticsQuery = true;
+#if VISIBILITY_BUFFER
+    Initializer.PhysicalDeviceFeatures.features2.features.geometryShader = true; //gl_PrimitiveID in the fragment shader
+    Initializer.PhysicalDeviceFeatures.features2.features.shaderStorageImageWriteWithoutFormat = true;
+#endif
     Initializer.PhysicalDeviceFeatures.vk11features.shaderDrawParameters = true;
     Initializer.PhysicalDeviceFeatures.vk11features.storageBuffer16BitAccess = true;
     Initializer.PhysicalDeviceFeatures.vk12features.storageBuffer8BitAccess = true;
@@ -119,6 +133,7 @@ static VContext::BaseInitializer MakeVulkanBaseInitializer(GLFWwindow* Window)
     Initializer.PhysicalDeviceFeatures.vk12features.timelineSemaphore = true;
     Initializer.PhysicalDeviceFeatures.vk12features.scalarBlockLayout = true;
     Initializer.PhysicalDeviceFeatures.vk12features.bufferDeviceAddress = true;
+    Initializer.PhysicalDeviceFeatures.vk12features.samplerFilterMinmax = true;
     Initializer.PhysicalDeviceFeatures.vk12features.vulkanMemoryModel = true;
     Initializer.PhysicalDeviceFeatures.vk12features.vulkanMemoryModelDeviceScope = true;
     Initializer.PhysicalDeviceFeatures.vk13features.synchronization2 = true;
@@ -150,21 +165,88 @@ VStarSightRenderer::VStarSightRenderer(GLFWwindow* Window_)
         }
     });
 
+    Initialize();
+}
+
+VStarSightRenderer::VStarSightRenderer(const VHeadlessOptions& Options)
+    : VContext(MakeVulkanBaseInitializer(nullptr))
+    , bHeadless(true)
+    , Headless(Options)
+{
+    LOG_INFO("rendering headless at {}x{}", Headless.Width, Headless.Height);
+
+    PresentLayout = vk::ImageLayout::eTransferSrcOptimal;
+
+    CreateOffscreenImages();
+
+    DestructionQueue.emplace_back([this]()
+    {
+        for(uint64_t index = 0; index < OffscreenImages.size(); ++index)
+        {
+            Device.destroyImageView(OffscreenImages[index].ImageView);
+            Allocator.destroyImage(OffscreenImages[index].Image, OffscreenImages[index].Allocation);
+        }
+    });
+
+    Initialize();
+}
+
+void VStarSightRenderer::Initialize()
+{
     CreateFrames();
     ActiveFrame = Frames.begin();
 
+    FrameGraph.Init(this, &GpuProfiler);
     CreateGBuffer();
 
     DestructionQueue.emplace_back([this](){
         DestroyGBuffer();
     });
 
-    CreateForwardPipeline();
-    CreateGeometryPipeline();
-    CreateGlobalLightPipeline();
-    CreateDrawCommandsPipeline();
+    //the pipelines only share the locked layout caches and the pipeline cache, so they are built side by side
+    //the builders wait on their shaders and the pipeline cache by running the compiles themselves, so they never starve the workers
+    {
+        JobGroup PipelineJobs{JobPriority::Background};
+        auto Build = [&PipelineJobs](std::function<void()> Function)
+        {
+            global::Scheduler.Submit(JobPriority::Background, std::move(Function), &PipelineJobs);
+        };
+
+        Build([this]{ CreateDepthReducePipeline(); });
+        Build([this]{ CreateForwardPipeline(); });
+
+        if(bVisibilityBuffer)
+        {
+            Build([this]{ CreateVisibilityPipeline(); });
+            Build([this]{ CreateMaterialPipeline(); });
+        }
+        else
+        {
+            Build([this]{ CreateGeometryPipeline(); });
+        }
+
+        Build([this]{ CreateGlobalLightPipeline(); });
+        Build([this]{ CreateClusterLightsPipeline(); });
+        Build([this]{ CreateCullMeshesPipeline(); });
+        Build([this]{ CreateDrawCommandsPipeline(); });
+        Build([this]{ CreateInstancingPipelines(); });
+        Build([this]{ CreateSceneScatterPipeline(); });
+
+        global::Scheduler.Wait(PipelineJobs, JobPriority::Background);
+    }
+
+    //uses the sampler made with the depth reduce pipeline
+    CreateDepthPyramid();
+
+    DestructionQueue.emplace_back([this](){
+        DestroyDepthPyramid();
+    });
     CreateCameraBuffer();
     CreateIndirectCommandsBuffer();
+    CreateMeshletTasksBuffer();
+    CreateSceneBuffers();
+    CreateInstanceBuffers();
+    CreateClusterBuffers();
 }
 
 VStarSightRenderer::~VStarSightRenderer()
@@ -324,21 +406,76 @@ void VStarSightRenderer::CreateSwapChainViews()
 
     for(uint64_t index = 0; index < Images.size(); ++index)
     {
-        NameObject(Images[index], fmt::format("swapchain image [{}]", index));
+        NameObject(Images[index], "swapchain image [{}]", index);
 
         view_info.setImage(Images[index]);
 
         ImageViews[index] = Device.createImageView(view_info);
-        NameObject(ImageViews[index], fmt::format("swapchain image view [{}]", index));
+        NameObject(ImageViews[index], "swapchain image view [{}]", index);
+    }
+}
+
+void VStarSightRenderer::CreateOffscreenImages()
+{
+    LOG_INFO("creating offscreen images");
+
+    //the same format the swapchain is forced to, so every pipeline is built the same headless or not
+    SurfaceFormat = vk::SurfaceFormatKHR{vk::Format::eB8G8R8A8Unorm, vk::ColorSpaceKHR::eSrgbNonlinear};
+    ImageExtent = vk::Extent2D{Headless.Width, Headless.Height};
+    MinImageCount = FRAMES_IN_FLIGHT;
+    SharingMode = vk::SharingMode::eExclusive;
+
+    auto ImageCreateInfo = vk::ImageCreateInfo{}
+            .setUsage(vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eStorage | vk::ImageUsageFlagBits::eTransferSrc)
+            .setExtent(vk::Extent3D{ImageExtent.width, ImageExtent.height, 1})
+            .setArrayLayers(1)
+            .setMipLevels(1)
+            .setFormat(SurfaceFormat.format)
+            .setImageType(vk::ImageType::e2D)
+            .setTiling(vk::ImageTiling::eOptimal)
+            .setSamples(vk::SampleCountFlagBits::e1)
+            .setSharingMode(SharingMode)
+            .setInitialLayout(vk::ImageLayout::eUndefined);
+
+    auto AllocateInfo = vma::AllocationCreateInfo{}
+            .setFlags(vma::AllocationCreateFlagBits::eStrategyBestFit)
+            .setUsage(vma::MemoryUsage::eAutoPreferDevice);
+
+    OffscreenImages.resize(MinImageCount);
+    Images.resize(MinImageCount);
+    ImageViews.resize(MinImageCount);
+
+    for(uint64_t index = 0; index < OffscreenImages.size(); ++index)
+    {
+        VAllocatedImage& Offscreen = OffscreenImages[index];
+        vkResultCheck = Allocator.createImage(&ImageCreateInfo, &AllocateInfo, &Offscreen.Image, &Offscreen.Allocation, &Offscreen.Info);
+        NameObject(Offscreen.Image, "offscreen image [{}]", index);
+
+        auto ViewCreateInfo = vk::ImageViewCreateInfo{}
+                .setImage(Offscreen.Image)
+                .setFormat(SurfaceFormat.format)
+                .setViewType(vk::ImageViewType::e2D)
+                .setComponents(vk::ComponentMapping{})
+                .setSubresourceRange(vkutil::flat_subresource_range(vk::ImageAspectFlagBits::eColor));
+
+        vkResultCheck = Device.createImageView(&ViewCreateInfo, nullptr, &Offscreen.ImageView);
+        NameObject(Offscreen.ImageView, "offscreen image view [{}]", index);
+
+        Images[index] = Offscreen.Image;
+        ImageViews[index] = Offscreen.ImageView;
     }
 }
 
 void VStarSightRenderer::RecreateSwapChain()
 {
+    VERIFY(!bHeadless, "offscreen images are never out of date");
+
     WaitForFrames();
 
+    DestroyDepthPyramid();
     DestroyGBuffer();
     CreateGBuffer();
+    CreateDepthPyramid();
 
     for(vk::ImageView view : ImageViews)
     {
@@ -378,10 +515,10 @@ void VStarSightRenderer::CreateFrames()
         Frames[frame].ImageAvailable = Device.createSemaphore(SemaphoreCreateInfo);
         Frames[frame].DrawFinished = Device.createSemaphore(SemaphoreCreateInfo);
 
-        NameObject(Frames[frame].CommandBuffer, fmt::format("command buffer {} [{}]", GetWindowName(), frame));
-        NameObject(Frames[frame].InFlight, fmt::format("in flight {} [{}]", GetWindowName(), frame));
-        NameObject(Frames[frame].ImageAvailable, fmt::format("image available {} [{}]", GetWindowName(), frame));
-        NameObject(Frames[frame].DrawFinished, fmt::format("draw finished {} [{}]", GetWindowName(), frame));
+        NameObject(Frames[frame].CommandBuffer, "command buffer {} [{}]", GetWindowName(), frame);
+        NameObject(Frames[frame].InFlight, "in flight {} [{}]", GetWindowName(), frame);
+        NameObject(Frames[frame].ImageAvailable, "image available {} [{}]", GetWindowName(), frame);
+        NameObject(Frames[frame].DrawFinished, "draw finished {} [{}]", GetWindowName(), frame);
 
         DestructionQueue.emplace_back([frame, this](){
             Device.destroy(Frames[frame].InFlight);
@@ -390,277 +527,786 @@ void VStarSightRenderer::CreateFrames()
         });
     }
 
-    LOG_INFO("allocating MeshTransforms");
+    if(bAsyncCompute)
+    {
+        LOG_INFO("creating async compute frames");
+
+        auto ComputeCommandBufferInfo = vk::CommandBufferAllocateInfo{}
+                .setCommandBufferCount(FRAMES_IN_FLIGHT)
+                .setCommandPool(ComputeCommandPool)
+                .setLevel(vk::CommandBufferLevel::ePrimary);
+
+        std::array<vk::CommandBuffer, FRAMES_IN_FLIGHT> ComputeCommandBuffers{};
+        vkResultCheck = Device.allocateCommandBuffers(&ComputeCommandBufferInfo, ComputeCommandBuffers.data());
+
+        std::array<vk::CommandBuffer, FRAMES_IN_FLIGHT> LightingCommandBuffers{};
+        vkResultCheck = Device.allocateCommandBuffers(&CommandBufferInfo, LightingCommandBuffers.data());
+
+        for(uint64_t frame = 0; frame < Frames.size(); ++frame)
+        {
+            Frames[frame].ComputeCommandBuffer = ComputeCommandBuffers[frame];
+            Frames[frame].LightingCommandBuffer = LightingCommandBuffers[frame];
+
+            NameObject(Frames[frame].ComputeCommandBuffer, "compute command buffer {} [{}]", GetWindowName(), frame);
+            NameObject(Frames[frame].LightingCommandBuffer, "lighting command buffer {} [{}]", GetWindowName(), frame);
+        }
+
+        auto TimelineInfo = vk::SemaphoreTypeCreateInfo{}
+                .setSemaphoreType(vk::SemaphoreType::eTimeline)
+                .setInitialValue(0);
+
+        auto TimelineCreateInfo = vk::SemaphoreCreateInfo{}
+                .setPNext(&TimelineInfo);
+
+        vkResultCheck = Device.createSemaphore(&TimelineCreateInfo, nullptr, &CullTimeline);
+        vkResultCheck = Device.createSemaphore(&TimelineCreateInfo, nullptr, &GeometryTimeline);
+
+        NameObject(CullTimeline, "cull timeline {}", GetWindowName());
+        NameObject(GeometryTimeline, "geometry timeline {}", GetWindowName());
+
+        DestructionQueue.emplace_back([this](){
+            Device.destroy(CullTimeline);
+            Device.destroy(GeometryTimeline);
+        });
+    }
+
+    LOG_INFO("creating gpu queries");
+
+    GpuProfiler.Init(this);
 
     for(uint64_t frame = 0; frame < Frames.size(); ++frame)
     {
-        VAllocatedBuffer& MeshTransforms = Frames[frame].MeshTransforms;
+        GpuProfiler.CreateQueries(Frames[frame].Queries, fmt::format("{} [{}]", GetWindowName(), frame), QueueIndices.Graphics);
+
+        if(bAsyncCompute)
+        {
+            GpuProfiler.CreateQueries(Frames[frame].ComputeQueries, fmt::format("{} compute [{}]", GetWindowName(), frame), QueueIndices.Compute);
+        }
+
+        DestructionQueue.emplace_back([frame, this](){
+            GpuProfiler.DestroyQueries(Frames[frame].Queries);
+            GpuProfiler.DestroyQueries(Frames[frame].ComputeQueries);
+        });
+    }
 
-        uint64_t BufferSize = sizeof(VShaderTransform) * DEVICE_MESH_ALLOCATION_STEP;
+    LOG_INFO("allocating SceneUpdates");
+
+    for(uint64_t frame = 0; frame < Frames.size(); ++frame)
+    {
+        uint64_t BufferSize = sizeof(VShaderSceneUpdate) * DEVICE_MESH_ALLOCATION_STEP;
         vk::BufferUsageFlags BufferFlags = vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eShaderDeviceAddress;
         vma::AllocationCreateFlags AllocationFlags = vma::AllocationCreateFlagBits::eMapped | vma::AllocationCreateFlagBits::eHostAccessSequentialWrite | vma::AllocationCreateFlagBits::eStrategyBestFit;
         vma::MemoryUsage MemoryUsage = vma::MemoryUsage::eAutoPreferDevice;
 
-        MeshTransforms = AllocateBuffer(BufferSize, BufferFlags, AllocationFlags, MemoryUsage, fmt::format("MeshTransforms [{}]", frame));
+        VAllocatedBuffer& SceneUpdates = Frames[frame].SceneUpdates;
+        SceneUpdates = AllocateBuffer(BufferSize, BufferFlags, AllocationFlags, MemoryUsage, fmt::format("SceneUpdates [{}]", frame));
 
-        DestructionQueue.emplace_back([this, MeshTransforms = &MeshTransforms](){
-                Allocator.destroyBuffer(MeshTransforms->Buffer, MeshTransforms->Allocation);
+        DestructionQueue.emplace_back([this, SceneUpdates = &SceneUpdates](){
+            Allocator.destroyBuffer(SceneUpdates->Buffer, SceneUpdates->Allocation);
         });
     }
 
-    LOG_INFO("allocating MeshBounds");
+    LOG_INFO("allocating CullStatistics");
 
     for(uint64_t frame = 0; frame < Frames.size(); ++frame)
     {
-        uint64_t BufferSize = sizeof(glm::fvec4) * DEVICE_MESH_ALLOCATION_STEP;
-        vk::BufferUsageFlags BufferFlags = vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eShaderDeviceAddress;
-        vma::AllocationCreateFlags AllocationFlags = vma::AllocationCreateFlagBits::eMapped | vma::AllocationCreateFlagBits::eHostAccessSequentialWrite | vma::AllocationCreateFlagBits::eStrategyBestFit;
-        vma::MemoryUsage MemoryUsage = vma::MemoryUsage::eAutoPreferDevice;
+        vk::BufferUsageFlags BufferFlags = vk::BufferUsageFlagBits::eTransferDst;
+        vma::AllocationCreateFlags AllocationFlags = vma::AllocationCreateFlagBits::eMapped | vma::AllocationCreateFlagBits::eHostAccessRandom;
+        vma::MemoryUsage MemoryUsage = vma::MemoryUsage::eAutoPreferHost;
 
-        VAllocatedBuffer& MeshBounds = Frames[frame].MeshBounds;
-        MeshBounds = AllocateBuffer(BufferSize, BufferFlags, AllocationFlags, MemoryUsage, fmt::format("MeshBounds [{}]", frame));
+        VAllocatedBuffer& CullStatistics = Frames[frame].CullStatistics;
+        CullStatistics = AllocateBuffer(sizeof(uint32_t) * 2, BufferFlags, AllocationFlags, MemoryUsage, fmt::format("CullStatistics [{}]", frame));
+        memset(CullStatistics.MappedData, 0, sizeof(uint32_t) * 2);
 
-        DestructionQueue.emplace_back([this, MeshBounds = &MeshBounds](){
-            Allocator.destroyBuffer(MeshBounds->Buffer, MeshBounds->Allocation);
+        DestructionQueue.emplace_back([this, CullStatistics = &CullStatistics](){
+            Allocator.destroyBuffer(CullStatistics->Buffer, CullStatistics->Allocation);
         });
     }
 
-    LOG_INFO("allocating MeshInfos");
+    LOG_INFO("allocating Lights");
 
     for(uint64_t frame = 0; frame < Frames.size(); ++frame)
     {
-        uint64_t BufferSize = sizeof(VShaderMeshInfo) * DEVICE_MESH_ALLOCATION_STEP;
+        uint64_t BufferSize = sizeof(VShaderLight) * DEVICE_MESH_ALLOCATION_STEP;
         vk::BufferUsageFlags BufferFlags = vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eShaderDeviceAddress;
         vma::AllocationCreateFlags AllocationFlags = vma::AllocationCreateFlagBits::eMapped | vma::AllocationCreateFlagBits::eHostAccessSequentialWrite | vma::AllocationCreateFlagBits::eStrategyBestFit;
         vma::MemoryUsage MemoryUsage = vma::MemoryUsage::eAutoPreferDevice;
 
-        VAllocatedBuffer& MeshInfos = Frames[frame].MeshInfos;
-        MeshInfos = AllocateBuffer(BufferSize, BufferFlags, AllocationFlags, MemoryUsage, fmt::format("MeshInfos [{}]", frame));
+        VAllocatedBuffer& Lights = Frames[frame].Lights;
+        Lights = AllocateBuffer(BufferSize, BufferFlags, AllocationFlags, MemoryUsage, fmt::format("Lights [{}]", frame));
 
-        DestructionQueue.emplace_back([this, MeshInfos = &MeshInfos](){
-            Allocator.destroyBuffer(MeshInfos->Buffer, MeshInfos->Allocation);
+        DestructionQueue.emplace_back([this, Lights = &Lights](){
+            Allocator.destroyBuffer(Lights->Buffer, Lights->Allocation);
         });
     }
 }
 
-void VStarSightRenderer::CreateDrawCommandsPipeline()
+void VStarSightRenderer::CreateSceneBuffers()
 {
-    VComputePipelineBuilder Builder = MakeComputePipelineBuilder();
-    Builder.IncludeShader(ProjectAbsolutePath("shaders/build_draw_commands.comp"));
-    Builder.Build(&BuildDrawCommandsLayout, &BuildDrawCommandsPipeline, "BuildDrawCommands");
+    LOG_INFO("creating scene buffers");
 
-    DestructionQueue.emplace_back([this]{
-        Device.destroyPipeline(BuildDrawCommandsPipeline);
+    SceneCapacity = DEVICE_MESH_ALLOCATION_STEP;
+
+    vk::BufferUsageFlags BufferFlags = vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eShaderDeviceAddress | vk::BufferUsageFlagBits::eTransferSrc | vk::BufferUsageFlagBits::eTransferDst;
+    vma::AllocationCreateFlags AllocationFlags = vma::AllocationCreateFlagBits::eStrategyBestFit;
+    vma::MemoryUsage MemoryUsage = vma::MemoryUsage::eAutoPreferDevice;
+
+    SceneMeshBounds = AllocateBuffer(sizeof(glm::fvec4) * SceneCapacity, BufferFlags, AllocationFlags, MemoryUsage, "Scene MeshBounds");
+    SceneMeshInfos = AllocateBuffer(sizeof(VShaderMeshInfo) * SceneCapacity, BufferFlags, AllocationFlags, MemoryUsage, "Scene MeshInfos");
+    SceneTransforms = AllocateBuffer(sizeof(VShaderTransform) * SceneCapacity, BufferFlags, AllocationFlags, MemoryUsage, "Scene MeshTransforms");
+    SceneVisibility = AllocateBuffer(sizeof(uint32_t) * SceneCapacity, BufferFlags, AllocationFlags, MemoryUsage, "Scene Visibility");
+    SceneInstanceEntries = AllocateBuffer(sizeof(VShaderInstanceEntry) * SceneCapacity, BufferFlags, AllocationFlags, MemoryUsage, "Scene InstanceEntries");
+
+    DestructionQueue.emplace_back([this](){
+        Allocator.destroyBuffer(SceneMeshBounds.Buffer, SceneMeshBounds.Allocation);
+        Allocator.destroyBuffer(SceneMeshInfos.Buffer, SceneMeshInfos.Allocation);
+        Allocator.destroyBuffer(SceneTransforms.Buffer, SceneTransforms.Allocation);
+        Allocator.destroyBuffer(SceneVisibility.Buffer, SceneVisibility.Allocation);
+        Allocator.destroyBuffer(SceneInstanceEntries.Buffer, SceneInstanceEntries.Allocation);
     });
 }
 
-void VStarSightRenderer::CreateForwardPipeline()
+void VStarSightRenderer::CreateSceneScatterPipeline()
 {
-    VGraphicsPipelineBuilder Builder = MakeGraphicsPipelineBuilder();
+    VComputePipelineBuilder Builder = MakeComputePipelineBuilder();
+    Builder.IncludeShader(ProjectAbsolutePath("shaders/scene_scatter.comp"));
+    Builder.Build(&SceneScatterLayout, &SceneScatterPipeline, "SceneScatter");
 
-    Builder.IncludeShader(ProjectAbsolutePath("shaders/forward.vert"));
-    Builder.IncludeShader(ProjectAbsolutePath("shaders/forward.frag"));
+    std::lock_guard Guard{DestructionMx};
+    DestructionQueue.emplace_back([this]{
+        Device.destroyPipeline(SceneScatterPipeline);
+    });
+}
 
-    Builder.dynamic_state = pipeline_helpers::dynamic_viewport_scissor();
-    Builder.viewport = pipeline_helpers::single_viewport_scissor();
-    Builder.rendering.setColorAttachmentFormats(SurfaceFormat.format);
-    Builder.rendering.setDepthAttachmentFormat(GBuffer.DepthFormat);
-    //Builder.vertex_input;
-    Builder.input_assembly = pipeline_helpers::topology(vk::PrimitiveTopology::eTriangleList);
-    Builder.rasterization = pipeline_helpers::rasterization(vk::CullModeFlagBits::eBack);
-    Builder.multisample = pipeline_helpers::no_multisample();
-    Builder.color_blend = pipeline_helpers::no_colorblend<1>();
-    Builder.depth_stencil = pipeline_helpers::reversed_depth();
+uint32_t VStarSightRenderer::GrabSceneSlot()
+{
+    std::lock_guard Guard{SceneMx};
 
-    Builder.Build(&ForwardPipelineLayout, &ForwardPipeline, fmt::format("forward pipeline {}", GetWindowName()));
+    if(!FreeSceneSlots.empty())
+    {
+        uint32_t Slot = FreeSceneSlots.back();
+        FreeSceneSlots.pop_back();
+        return Slot;
+    }
 
-    DestructionQueue.emplace_back([this](){
-        Device.destroyPipeline(ForwardPipeline);
-    });
+    return SceneSlotCount++;
 }
 
-void VStarSightRenderer::CreateGBuffer()
+uint32_t VStarSightRenderer::GetSceneSlotCount()
 {
-    LOG_INFO("creating GBuffer");
-
-    std::array PositionFormats{vk::Format::eR32G32B32Sfloat, vk::Format::eR32G32B32A32Sfloat};
-    std::array NormalFormats{vk::Format::eR16G16Snorm, vk::Format::eR32G32Sfloat};
-    std::array ColorFormats{vk::Format::eR8G8B8A8Srgb};
-    std::array DepthFormats{vk::Format::eD32Sfloat, vk::Format::eD32SfloatS8Uint, vk::Format::eD24UnormS8Uint};
+    std::lock_guard Guard{SceneMx};
+    return SceneSlotCount;
+}
 
-    GBuffer.PositionFormat = PickImageFormat(vk::FormatFeatureFlagBits::eColorAttachment | vk::FormatFeatureFlagBits::eSampledImage, PositionFormats);
-    GBuffer.NormalFormat = PickImageFormat(vk::FormatFeatureFlagBits::eColorAttachment | vk::FormatFeatureFlagBits::eSampledImage, NormalFormats);
-    GBuffer.ColorFormat = PickImageFormat(vk::FormatFeatureFlagBits::eColorAttachment | vk::FormatFeatureFlagBits::eSampledImage, ColorFormats);
-    GBuffer.DepthFormat = PickImageFormat(vk::FormatFeatureFlagBits::eDepthStencilAttachment | vk::FormatFeatureFlagBits::eSampledImage, DepthFormats);
+void VStarSightRenderer::PendingSceneUpdate_Locked(const VShaderSceneUpdate& Update)
+{
+    if(Update.Slot >= PendingSceneUpdateOfSlot.size())
+    {
+        PendingSceneUpdateOfSlot.resize(Update.Slot + 1, UINT32_MAX);
+    }
 
-    auto[Width, Height] = GetWindowExtent();
+    //the last update of a slot in a batch wins
+    uint32_t& Pending = PendingSceneUpdateOfSlot[Update.Slot];
+    if(Pending != UINT32_MAX)
+    {
+        PendingSceneUpdates[Pending] = Update;
+    }
+    else
+    {
+        Pending = static_cast<uint32_t>(PendingSceneUpdates.size());
+        PendingSceneUpdates.emplace_back(Update);
+    }
+}
 
-    auto PositionCreateInfo = vk::ImageCreateInfo{}
-            .setUsage(vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eSampled)
-            .setExtent(vk::Extent3D{Width, Height, 1})
-            .setArrayLayers(1)
-            .setMipLevels(1)
-            .setFormat(GBuffer.PositionFormat)
-            .setImageType(vk::ImageType::e2D)
-            .setTiling(vk::ImageTiling::eOptimal)
-            .setSamples(vk::SampleCountFlagBits::e1)
-            .setInitialLayout(vk::ImageLayout::eUndefined);
+void VStarSightRenderer::FreeSceneSlot(uint32_t Slot)
+{
+    std::lock_guard Guard{SceneMx};
 
-    auto PositionAllocateInfo = vma::AllocationCreateInfo{}
-            .setFlags(vma::AllocationCreateFlagBits::eStrategyBestFit)
-            .setUsage(vma::MemoryUsage::eAutoPreferDevice);
+    //an empty mesh info is skipped by the culling pass
+    VShaderSceneUpdate ClearUpdate;
+    memset(&ClearUpdate, 0, sizeof(VShaderSceneUpdate));
+    ClearUpdate.Slot = Slot;
+    PendingSceneUpdate_Locked(ClearUpdate);
 
-    auto NormalCreateInfo = vk::ImageCreateInfo{}
-            .setUsage(vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eSampled)
-            .setExtent(vk::Extent3D{Width, Height, 1})
-            .setArrayLayers(1)
-            .setMipLevels(1)
-            .setFormat(GBuffer.NormalFormat)
-            .setImageType(vk::ImageType::e2D)
-            .setTiling(vk::ImageTiling::eOptimal)
-            .setSamples(vk::SampleCountFlagBits::e1)
-            .setInitialLayout(vk::ImageLayout::eUndefined);
+    PendingFreeSceneSlots.emplace_back(Slot);
 
-    auto NormalAllocateInfo = vma::AllocationCreateInfo{}
-            .setFlags(vma::AllocationCreateFlagBits::eStrategyBestFit)
-            .setUsage(vma::MemoryUsage::eAutoPreferDevice);
+    if(Slot < SceneSlotMeshlets.size())
+    {
+        SceneMeshletCount -= SceneSlotMeshlets[Slot];
+        SceneSlotMeshlets[Slot] = 0;
+    }
+}
 
-    auto ColorCreateInfo = vk::ImageCreateInfo{}
-            .setUsage(vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eSampled)
-            .setExtent(vk::Extent3D{Width, Height, 1})
-            .setArrayLayers(1)
-            .setMipLevels(1)
-            .setFormat(GBuffer.ColorFormat)
-            .setImageType(vk::ImageType::e2D)
-            .setTiling(vk::ImageTiling::eOptimal)
-            .setSamples(vk::SampleCountFlagBits::e1)
-            .setInitialLayout(vk::ImageLayout::eUndefined);
+void VStarSightRenderer::UpdateSceneSlot(const VShaderSceneUpdate& Update)
+{
+    std::lock_guard Guard{SceneMx};
+    PendingSceneUpdate_Locked(Update);
 
-    auto ColorAllocateInfo = vma::AllocationCreateInfo{}
-            .setFlags(vma::AllocationCreateFlagBits::eStrategyBestFit)
-            .setUsage(vma::MemoryUsage::eAutoPreferDevice);
+    if(Update.Slot >= SceneSlotMeshlets.size())
+    {
+        SceneSlotMeshlets.resize(Update.Slot + 1, 0);
+    }
 
-    auto DepthCreateInfo = vk::ImageCreateInfo{}
-            .setUsage(vk::ImageUsageFlagBits::eDepthStencilAttachment | vk::ImageUsageFlagBits::eSampled)
-            .setExtent(vk::Extent3D{Width, Height, 1})
-            .setArrayLayers(1)
-            .setMipLevels(1)
-            .setFormat(GBuffer.DepthFormat)
-            .setImageType(vk::ImageType::e2D)
-            .setTiling(vk::ImageTiling::eOptimal)
-            .setSamples(vk::SampleCountFlagBits::e1)
-            .setInitialLayout(vk::ImageLayout::eUndefined);
+    SceneMeshletCount -= SceneSlotMeshlets[Update.Slot];
+    SceneMeshletCount += Update.MeshInfo.meshletCount;
+    SceneSlotMeshlets[Update.Slot] = Update.MeshInfo.meshletCount;
+}
 
-    auto DepthAllocateInfo = vma::AllocationCreateInfo{}
-            .setFlags(vma::AllocationCreateFlagBits::eStrategyBestFit)
-            .setUsage(vma::MemoryUsage::eAutoPreferDevice);
+void VStarSightRenderer::RecordSceneUpdates(vk::CommandBuffer CommandBuffer)
+{
+    RecordGeometryCopies(CommandBuffer, vk::PipelineStageFlagBits2::eIndexInput | VertexStages(CommandBuffer) | vk::PipelineStageFlagBits2::eComputeShader);
 
+    std::unique_lock Guard{SceneMx};
 
-    vkResultCheck = Allocator.createImage(&PositionCreateInfo, &PositionAllocateInfo, &GBuffer.Position.Image, &GBuffer.Position.Allocation, &GBuffer.Position.Info);
-    vkResultCheck = Allocator.createImage(&NormalCreateInfo, &NormalAllocateInfo, &GBuffer.Normal.Image, &GBuffer.Normal.Allocation, &GBuffer.Normal.Info);
-    vkResultCheck = Allocator.createImage(&ColorCreateInfo, &ColorAllocateInfo, &GBuffer.Color.Image, &GBuffer.Color.Allocation, &GBuffer.Color.Info);
-    vkResultCheck = Allocator.createImage(&DepthCreateInfo, &DepthAllocateInfo, &GBuffer.Depth.Image, &GBuffer.Depth.Allocation, &GBuffer.Depth.Info);
+    uint32_t UpdateCount = PendingSceneUpdates.size();
 
-    NameObject(GBuffer.Position.Image, "GBuffer Position image");
-    NameObject(GBuffer.Normal.Image, "GBuffer Normal image");
-    NameObject(GBuffer.Color.Image, "GBuffer Color image");
-    NameObject(GBuffer.Depth.Image, "GBuffer Depth image");
+    if(UpdateCount != 0)
+    {
+        uint64_t UpdatesSize = sizeof(VShaderSceneUpdate) * UpdateCount;
+        if(UpdatesSize > ActiveFrame->SceneUpdates.Size) [[unlikely]]
+        {
+            ReallocateBuffer(&ActiveFrame->SceneUpdates, sizeof(VShaderSceneUpdate) * math::PadSize2Alignment(UpdateCount, DEVICE_MESH_ALLOCATION_STEP));
+        }
 
-    auto PositionViewCreateInfo = vk::ImageViewCreateInfo{}
-            .setImage(GBuffer.Position.Image)
-            .setFormat(GBuffer.PositionFormat)
-            .setViewType(vk::ImageViewType::e2D)
-            .setComponents(vk::ComponentMapping{})
-            .setSubresourceRange(vkutil::flat_subresource_range(vk::ImageAspectFlagBits::eColor));
+        memcpy(ActiveFrame->SceneUpdates.MappedData, PendingSceneUpdates.data(), UpdatesSize);
+        Allocator.flushAllocation(ActiveFrame->SceneUpdates.Allocation, 0, UpdatesSize);
 
-    auto NormalViewCreateInfo = vk::ImageViewCreateInfo{}
-            .setImage(GBuffer.Normal.Image)
-            .setFormat(GBuffer.NormalFormat)
-            .setViewType(vk::ImageViewType::e2D)
-            .setComponents(vk::ComponentMapping{})
-            .setSubresourceRange(vkutil::flat_subresource_range(vk::ImageAspectFlagBits::eColor));
+        for(const VShaderSceneUpdate& Update : PendingSceneUpdates)
+        {
+            PendingSceneUpdateOfSlot[Update.Slot] = UINT32_MAX;
+        }
 
-    auto ColorViewCreateInfo = vk::ImageViewCreateInfo{}
-            .setImage(GBuffer.Color.Image)
-            .setFormat(GBuffer.ColorFormat)
-            .setViewType(vk::ImageViewType::e2D)
-            .setComponents(vk::ComponentMapping{})
-            .setSubresourceRange(vkutil::flat_subresource_range(vk::ImageAspectFlagBits::eColor));
+        PendingSceneUpdates.clear();
+    }
 
-    auto DepthViewCreateInfo = vk::ImageViewCreateInfo{}
-            .setImage(GBuffer.Depth.Image)
-            .setFormat(GBuffer.DepthFormat)
-            .setViewType(vk::ImageViewType::e2D)
-            .setComponents(vk::ComponentMapping{})
-            .setSubresourceRange(vkutil::flat_subresource_range(vk::ImageAspectFlagBits::eDepth));
+    FreeSceneSlots.insert(FreeSceneSlots.end(), PendingFreeSceneSlots.begin(), PendingFreeSceneSlots.end());
+    PendingFreeSceneSlots.clear();
 
-    vkResultCheck = Device.createImageView(&PositionViewCreateInfo, nullptr, &GBuffer.Position.ImageView);
-    vkResultCheck = Device.createImageView(&NormalViewCreateInfo, nullptr, &GBuffer.Normal.ImageView);
-    vkResultCheck = Device.createImageView(&ColorViewCreateInfo, nullptr, &GBuffer.Color.ImageView);
-    vkResultCheck = Device.createImageView(&DepthViewCreateInfo, nullptr, &GBuffer.Depth.ImageView);
+    uint32_t RequiredCapacity = SceneSlotCount;
+    uint64_t MeshletCount = SceneMeshletCount;
+    Guard.unlock();
 
-    NameObject(GBuffer.Position.ImageView, "GBuffer Position image view");
-    NameObject(GBuffer.Normal.ImageView, "GBuffer Normal image view");
-    NameObject(GBuffer.Color.ImageView, "GBuffer Color image view");
-    NameObject(GBuffer.Depth.ImageView, "GBuffer Depth image view");
-}
+    //one draw per visible meshlet
+    if(MeshletCount > DrawCommandsCapacity) [[unlikely]]
+    {
+        DrawCommandsCapacity = math::PadSize2Alignment(MeshletCount, DEVICE_MESH_ALLOCATION_STEP);
+        ReallocateBuffer(&DrawIndirectCommandsBuffer, sizeof(VShaderDrawIndirectCount) + sizeof(vk::DrawIndexedIndirectCommand) * DrawCommandsCapacity);
+    }
 
-void VStarSightRenderer::Draw(uint32_t MeshCount)
-{
-    uint32_t SwapChainImage = AcquireSwapChainImage();
-    if(SwapChainImage == UINT32_MAX)
+    //every mesh rounds its meshlets up to whole tasks
+    uint64_t RequiredTasks = RequiredCapacity + MeshletCount / MESHLET_TASK_SIZE + 1;
+    if(RequiredTasks > MeshletTasksCapacity) [[unlikely]]
     {
-        RecreateSwapChain();
-        return;
+        MeshletTasksCapacity = math::PadSize2Alignment(RequiredTasks, DEVICE_MESH_ALLOCATION_STEP);
+        ReallocateBuffer(&MeshletTasksBuffer, sizeof(VShaderMeshletTasksHeader) + sizeof(VShaderMeshletTask) * MeshletTasksCapacity);
     }
 
-    ActiveFrame->CommandBuffer.begin({vk::CommandBufferUsageFlagBits::eOneTimeSubmit});
+    if(RequiredCapacity > SceneCapacity) [[unlikely]]
+    {
+        //slots have to stay valid so the old contents are copied over before the scatter
+        uint32_t NewCapacity = math::PadSize2Alignment(RequiredCapacity + DEVICE_MESH_ALLOCATION_STEP, DEVICE_MESH_ALLOCATION_STEP);
 
-    ActiveFrame->CommandBuffer.fillBuffer(DrawIndirectCommandsBuffer.Buffer, 0, sizeof(uint32_t), 0u);
+        LOG_INFO("growing scene buffers from {} to {} slots", SceneCapacity, NewCapacity);
 
-    auto ZeroDrawCountBarrier = vk::BufferMemoryBarrier2{}
-            .setBuffer(DrawIndirectCommandsBuffer.Buffer)
-            .setSize(sizeof(uint32_t))
-            .setOffset(0)
-            .setSrcStageMask(vk::PipelineStageFlagBits2::eTransfer)
-            .setSrcAccessMask(vk::AccessFlagBits2::eTransferWrite)
-            .setDstStageMask(vk::PipelineStageFlagBits2::eComputeShader)
-            .setDstAccessMask(vk::AccessFlagBits2::eShaderStorageRead | vk::AccessFlagBits2::eShaderStorageWrite);
+        //the scatter and culling passes of the previous frame write the old buffers on this queue
+        auto PreviousWriteBarrier = vk::MemoryBarrier2{}
+                .setSrcStageMask(vk::PipelineStageFlagBits2::eComputeShader)
+                .setSrcAccessMask(vk::AccessFlagBits2::eShaderStorageWrite)
+                .setDstStageMask(vk::PipelineStageFlagBits2::eTransfer)
+                .setDstAccessMask(vk::AccessFlagBits2::eTransferRead);
 
-    auto ZeroDrawCount_Dependency = vk::DependencyInfo{}.setBufferMemoryBarriers(ZeroDrawCountBarrier);
-    ActiveFrame->CommandBuffer.pipelineBarrier2(ZeroDrawCount_Dependency);
+        CommandBuffer.pipelineBarrier2(vk::DependencyInfo{}.setMemoryBarriers(PreviousWriteBarrier));
 
-    VShaderBuildDrawCommandsPC PushConstants{};
-    PushConstants.pCamera = CameraBuffer.BufferAddress + (ActiveFrameIndex() * sizeof(VShaderCameraData));
-    PushConstants.pDrawIndirectCount = DrawIndirectCommandsBuffer.BufferAddress;
-    PushConstants.pMeshBounds = ActiveFrame->MeshBounds.BufferAddress;
-    PushConstants.pMeshes = ActiveFrame->MeshInfos.BufferAddress;
-    PushConstants.pTransforms = ActiveFrame->MeshTransforms.BufferAddress;
-    PushConstants.meshCount = MeshCount;
+        auto GrowBuffer = [this, CommandBuffer, NewCapacity](VAllocatedBuffer* Buffer, uint64_t ElementSize)
+        {
+            std::string Name = Allocator.getAllocationInfo(Buffer->Allocation).pName;
+            VAllocatedBuffer NewBuffer = AllocateBuffer(ElementSize * NewCapacity, Buffer->BufferUsage, Buffer->AllocationFlags, Buffer->MemoryUsage, Name);
 
-    ActiveFrame->CommandBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, BuildDrawCommandsPipeline);
-    ActiveFrame->CommandBuffer.pushConstants(BuildDrawCommandsLayout, vk::ShaderStageFlagBits::eCompute, 0, sizeof(PushConstants), &PushConstants);
-    ActiveFrame->CommandBuffer.dispatch(vkutil::GroupCount(MeshCount, 64u), 1u, 1u);
+            CommandBuffer.copyBuffer(Buffer->Buffer, NewBuffer.Buffer, vk::BufferCopy{0, 0, ElementSize * SceneCapacity});
 
-    auto DrawIndirectCommandsBarrier = vk::BufferMemoryBarrier2{}
-            .setBuffer(DrawIndirectCommandsBuffer.Buffer)
-            .setOffset(0)
-            .setSize(VK_WHOLE_SIZE)
-            .setDstStageMask(vk::PipelineStageFlagBits2::eDrawIndirect)
-            .setDstAccessMask(vk::AccessFlagBits2::eIndirectCommandRead)
-            .setSrcStageMask(vk::PipelineStageFlagBits2::eComputeShader)
-            .setSrcAccessMask(vk::AccessFlagBits2::eShaderStorageWrite);
+            FreeBuffer(Buffer);
+            *Buffer = NewBuffer;
+        };
 
-    auto DrawIndirectCommandsBarrier_Dependency = vk::DependencyInfo{}.setBufferMemoryBarriers(DrawIndirectCommandsBarrier);
-    ActiveFrame->CommandBuffer.pipelineBarrier2(DrawIndirectCommandsBarrier_Dependency);
+        GrowBuffer(&SceneMeshBounds, sizeof(glm::fvec4));
+        GrowBuffer(&SceneMeshInfos, sizeof(VShaderMeshInfo));
+        GrowBuffer(&SceneTransforms, sizeof(VShaderTransform));
+        GrowBuffer(&SceneVisibility, sizeof(uint32_t));
+        GrowBuffer(&SceneInstanceEntries, sizeof(VShaderInstanceEntry));
 
-    BeginSwapChainRender(SwapChainImage);
-    DrawShader(MeshCount);
-    EndSwapChainRender(SwapChainImage);
+        SceneCapacity = NewCapacity;
 
-    ActiveFrame->CommandBuffer.end();
+        auto CopyBarrier = vk::MemoryBarrier2{}
+                .setSrcStageMask(vk::PipelineStageFlagBits2::eTransfer)
+                .setSrcAccessMask(vk::AccessFlagBits2::eTransferWrite)
+                .setDstStageMask(vk::PipelineStageFlagBits2::eComputeShader)
+                .setDstAccessMask(vk::AccessFlagBits2::eShaderStorageWrite);
 
-    SubmitCommands();
+        CommandBuffer.pipelineBarrier2(vk::DependencyInfo{}.setMemoryBarriers(CopyBarrier));
+    }
+
+    uint64_t RequiredBuckets = static_cast<uint64_t>(GetMeshIndexCount()) * MESH_MAX_LODS;
+    if(RequiredBuckets > InstanceBucketCapacity) [[unlikely]]
+    {
+        InstanceBucketCapacity = math::PadSize2Alignment(RequiredBuckets, DEVICE_MESH_ALLOCATION_STEP);
+        ReallocateBuffer(&InstanceBuckets, sizeof(VShaderInstanceBucket) * InstanceBucketCapacity);
+    }
+
+    uint64_t RequiredInstanceSlots = static_cast<uint64_t>(DrawCommandsCapacity) + SceneCapacity;
+    if(RequiredInstanceSlots > InstanceSlotCapacity) [[unlikely]]
+    {
+        InstanceSlotCapacity = RequiredInstanceSlots;
+        ReallocateBuffer(&InstanceSlots, sizeof(uint32_t) * InstanceSlotCapacity);
+    }
+
+    if(UpdateCount == 0)
+    {
+        return;
+    }
+
+    //the previous frame may still be reading the slots that are about to be overwritten
+    auto PreviousReadBarrier = vk::MemoryBarrier2{}
+            .setSrcStageMask(vk::PipelineStageFlagBits2::eComputeShader | VertexStages(CommandBuffer))
+            .setSrcAccessMask(vk::AccessFlagBits2::eNone)
+            .setDstStageMask(vk::PipelineStageFlagBits2::eComputeShader)
+            .setDstAccessMask(vk::AccessFlagBits2::eNone);
+
+    CommandBuffer.pipelineBarrier2(vk::DependencyInfo{}.setMemoryBarriers(PreviousReadBarrier));
+
+    VShaderSceneScatterPC PushConstants{};
+    PushConstants.pUpdates = ActiveFrame->SceneUpdates.BufferAddress;
+    PushConstants.pMeshBounds = SceneMeshBounds.BufferAddress;
+    PushConstants.pMeshes = SceneMeshInfos.BufferAddress;
+    PushConstants.pTransforms = SceneTransforms.BufferAddress;
+    PushConstants.updateCount = UpdateCount;
+
+    CommandBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, SceneScatterPipeline);
+    CommandBuffer.pushConstants(SceneScatterLayout, vk::ShaderStageFlagBits::eCompute, 0, sizeof(PushConstants), &PushConstants);
+    CommandBuffer.dispatch(vkutil::GroupCount(UpdateCount, 64u), 1u, 1u);
+
+    auto ScatterBarrier = vk::MemoryBarrier2{}
+            .setSrcStageMask(vk::PipelineStageFlagBits2::eComputeShader)
+            .setSrcAccessMask(vk::AccessFlagBits2::eShaderStorageWrite)
+            .setDstStageMask(vk::PipelineStageFlagBits2::eComputeShader | VertexStages(CommandBuffer))
+            .setDstAccessMask(vk::AccessFlagBits2::eShaderStorageRead);
+
+    CommandBuffer.pipelineBarrier2(vk::DependencyInfo{}.setMemoryBarriers(ScatterBarrier));
+}
+
+void VStarSightRenderer::CreateCullMeshesPipeline()
+{
+    VComputePipelineBuilder Builder = MakeComputePipelineBuilder();
+    Builder.IncludeShader(ProjectAbsolutePath("shaders/cull_meshes.comp"));
+    Builder.Build(&CullMeshesLayout, &CullMeshesPipeline, "CullMeshes");
+
+    std::lock_guard Guard{DestructionMx};
+    DestructionQueue.emplace_back([this]{
+        Device.destroyPipeline(CullMeshesPipeline);
+    });
+}
+
+void VStarSightRenderer::CreateDrawCommandsPipeline()
+{
+    VComputePipelineBuilder Builder = MakeComputePipelineBuilder();
+    Builder.IncludeShader(ProjectAbsolutePath("shaders/build_draw_commands.comp"));
+    Builder.Build(&BuildDrawCommandsLayout, &BuildDrawCommandsPipeline, "BuildDrawCommands");
+
+    std::lock_guard Guard{DestructionMx};
+    DestructionQueue.emplace_back([this]{
+        Device.destroyPipeline(BuildDrawCommandsPipeline);
+    });
+}
+
+void VStarSightRenderer::CreateInstancingPipelines()
+{
+    VComputePipelineBuilder BucketsBuilder = MakeComputePipelineBuilder();
+    BucketsBuilder.IncludeShader(ProjectAbsolutePath("shaders/instance_buckets.comp"));
+    BucketsBuilder.Build(&InstanceBucketsLayout, &InstanceBucketsPipeline, "InstanceBuckets");
+
+    VComputePipelineBuilder ScatterBuilder = MakeComputePipelineBuilder();
+    ScatterBuilder.IncludeShader(ProjectAbsolutePath("shaders/instance_scatter.comp"));
+    ScatterBuilder.Build(&InstanceScatterLayout, &InstanceScatterPipeline, "InstanceScatter");
+
+    std::lock_guard Guard{DestructionMx};
+    DestructionQueue.emplace_back([this]{
+        Device.destroyPipeline(InstanceBucketsPipeline);
+        Device.destroyPipeline(InstanceScatterPipeline);
+    });
+}
+
+void VStarSightRenderer::RecordBuildDrawCommands(vk::CommandBuffer CommandBuffer, uint32_t MeshCount, bool bOcclusionCulling, bool bLatePass)
+{
+    if(!DepthPyramid.bValid)
+    {
+        //never built, but the culling pipelines still have them bound
+        std::array<vk::ImageMemoryBarrier2, 2> PyramidBarriers{};
+        for(uint32_t Index = 0; Index < PyramidBarriers.size(); ++Index)
+        {
+            PyramidBarriers[Index] = vk::ImageMemoryBarrier2{}
+                    .setImage(DepthPyramid.Images[Index].Image)
+                    .setOldLayout(vk::ImageLayout::eUndefined)
+                    .setNewLayout(vk::ImageLayout::eGeneral)
+                    .setSrcStageMask(vk::PipelineStageFlagBits2::eNone)
+                    .setSrcAccessMask(vk::AccessFlagBits2::eNone)
+                    .setDstStageMask(vk::PipelineStageFlagBits2::eComputeShader)
+                    .setDstAccessMask(vk::AccessFlagBits2::eShaderSampledRead | vk::AccessFlagBits2::eShaderStorageWrite)
+                    .setSubresourceRange(vk::ImageSubresourceRange{vk::ImageAspectFlagBits::eColor, 0, DepthPyramid.MipLevels, 0, 1});
+        }
+
+        CommandBuffer.pipelineBarrier2(vk::DependencyInfo{}.setImageMemoryBarriers(PyramidBarriers));
+    }
+
+    if(!bLatePass)
+    {
+        bEarlyOcclusionCulling = bOcclusionCulling;
+    }
+
+    //the indirect, task and instance buffers are reused by every pass, whatever read the previous contents has to finish first
+    auto ReuseBarrier = vk::MemoryBarrier2{}
+            .setSrcStageMask(vk::PipelineStageFlagBits2::eDrawIndirect | vk::PipelineStageFlagBits2::eComputeShader | vk::PipelineStageFlagBits2::eTransfer | VertexStages(CommandBuffer))
+            .setSrcAccessMask(vk::AccessFlagBits2::eNone)
+            .setDstStageMask(vk::PipelineStageFlagBits2::eTransfer | vk::PipelineStageFlagBits2::eComputeShader)
+            .setDstAccessMask(vk::AccessFlagBits2::eTransferWrite | vk::AccessFlagBits2::eShaderStorageWrite);
+
+    CommandBuffer.pipelineBarrier2(vk::DependencyInfo{}.setMemoryBarriers(ReuseBarrier));
+
+    //the group count only grows through atomicMax, y and z stay at one
+    VShaderMeshletTasksHeader TasksHeader{};
+    TasksHeader.Dispatch = vk::DispatchIndirectCommand{0, 1, 1};
+    TasksHeader.TaskCount = 0;
+    TasksHeader.VisibleMeshes = 0;
+
+    CommandBuffer.updateBuffer(MeshletTasksBuffer.Buffer, 0, sizeof(TasksHeader), &TasksHeader);
+
+    //passes that are not run this frame count nothing
+    if(!bLatePass)
+    {
+        CommandBuffer.fillBuffer(ActiveFrame->CullStatistics.Buffer, 0, VK_WHOLE_SIZE, 0u);
+    }
+    CommandBuffer.fillBuffer(DrawIndirectCommandsBuffer.Buffer, 0, sizeof(uint32_t), 0u);
+    CommandBuffer.fillBuffer(InstanceBuckets.Buffer, 0, VK_WHOLE_SIZE, 0u);
+
+    auto ResetBarrier = vk::MemoryBarrier2{}
+            .setSrcStageMask(vk::PipelineStageFlagBits2::eTransfer)
+            .setSrcAccessMask(vk::AccessFlagBits2::eTransferWrite)
+            .setDstStageMask(vk::PipelineStageFlagBits2::eComputeShader)
+            .setDstAccessMask(vk::AccessFlagBits2::eShaderStorageRead | vk::AccessFlagBits2::eShaderStorageWrite);
+
+    //the late pass reads the visibility the early pass wrote
+    auto VisibilityBarrier = vk::BufferMemoryBarrier2{}
+            .setBuffer(SceneVisibility.Buffer)
+            .setSize(VK_WHOLE_SIZE)
+            .setOffset(0)
+            .setSrcStageMask(vk::PipelineStageFlagBits2::eComputeShader)
+            .setSrcAccessMask(vk::AccessFlagBits2::eShaderStorageWrite | vk::AccessFlagBits2::eShaderStorageRead)
+            .setDstStageMask(vk::PipelineStageFlagBits2::eComputeShader)
+            .setDstAccessMask(vk::AccessFlagBits2::eShaderStorageRead | vk::AccessFlagBits2::eShaderStorageWrite);
+
+    CommandBuffer.pipelineBarrier2(vk::DependencyInfo{}.setMemoryBarriers(ResetBarrier).setBufferMemoryBarriers(VisibilityBarrier));
+
+    const uint64_t CameraAddress = CameraBuffer.BufferAddress + (ActiveFrameIndex() * sizeof(VShaderCameraData));
+    const uint32_t MaxTaskCount = std::min(MeshletTasksCapacity, PhysicalDeviceProperties.properties.limits.maxComputeWorkGroupCount[0]);
+    const uint32_t BucketCount = std::min<uint64_t>(InstanceBucketCapacity, static_cast<uint64_t>(GetMeshIndexCount()) * MESH_MAX_LODS);
+
+    VShaderCullMeshesPC CullPushConstants{};
+    CullPushConstants.pCamera = CameraAddress;
+    CullPushConstants.pTasks = MeshletTasksBuffer.BufferAddress;
+    CullPushConstants.pMeshBounds = SceneMeshBounds.BufferAddress;
+    CullPushConstants.pMeshes = SceneMeshInfos.BufferAddress;
+    CullPushConstants.pTransforms = SceneTransforms.BufferAddress;
+    CullPushConstants.pVisibility = SceneVisibility.BufferAddress;
+    CullPushConstants.pBuckets = InstanceBuckets.BufferAddress;
+    CullPushConstants.pInstanceEntries = SceneInstanceEntries.BufferAddress;
+    CullPushConstants.pyramidSize = glm::fvec2{DepthPyramid.Width, DepthPyramid.Height};
+    CullPushConstants.meshCount = MeshCount;
+    CullPushConstants.maxTaskCount = MaxTaskCount;
+    CullPushConstants.occlusionCulling = bOcclusionCulling;
+    CullPushConstants.latePass = bLatePass;
+    CullPushConstants.lodErrorScale = static_cast<float>(ImageExtent.height) * 0.5f / MESH_LOD_PIXEL_ERROR;
+    CullPushConstants.bucketCount = BucketCount;
+    CullPushConstants.maxInstancedMeshlets = INSTANCING_MAX_MESHLETS;
+
+    CommandBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, CullMeshesPipeline);
+    CommandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, CullMeshesLayout, 0, 1, &DepthPyramid.MeshCullSets[DepthPyramid.Current], 0, nullptr);
+    CommandBuffer.pushConstants(CullMeshesLayout, vk::ShaderStageFlagBits::eCompute, 0, sizeof(CullPushConstants), &CullPushConstants);
+    CommandBuffer.dispatch(vkutil::GroupCount(MeshCount, 64u), 1u, 1u);
+
+    //tasks, bucket counts and instance entries
+    auto CullBarrier = vk::MemoryBarrier2{}
+            .setSrcStageMask(vk::PipelineStageFlagBits2::eComputeShader)
+            .setSrcAccessMask(vk::AccessFlagBits2::eShaderStorageWrite)
+            .setDstStageMask(vk::PipelineStageFlagBits2::eDrawIndirect | vk::PipelineStageFlagBits2::eComputeShader | vk::PipelineStageFlagBits2::eTransfer)
+            .setDstAccessMask(vk::AccessFlagBits2::eIndirectCommandRead | vk::AccessFlagBits2::eShaderStorageRead | vk::AccessFlagBits2::eShaderStorageWrite | vk::AccessFlagBits2::eTransferRead);
+
+    CommandBuffer.pipelineBarrier2(vk::DependencyInfo{}.setMemoryBarriers(CullBarrier));
+
+    auto StatisticsCopy = vk::BufferCopy{}
+            .setSrcOffset(offsetof(VShaderMeshletTasksHeader, VisibleMeshes))
+            .setDstOffset(bLatePass ? sizeof(uint32_t) : 0)
+            .setSize(sizeof(uint32_t));
+
+    CommandBuffer.copyBuffer(MeshletTasksBuffer.Buffer, ActiveFrame->CullStatistics.Buffer, StatisticsCopy);
+
+    VShaderBuildDrawCommandsPC PushConstants{};
+    PushConstants.pCamera = CameraAddress;
+    PushConstants.pDrawIndirectCount = DrawIndirectCommandsBuffer.BufferAddress;
+    PushConstants.pTasks = MeshletTasksBuffer.BufferAddress;
+    PushConstants.pMeshes = SceneMeshInfos.BufferAddress;
+    PushConstants.pTransforms = SceneTransforms.BufferAddress;
+    PushConstants.pVertexBuffer = GlobalVertexBuffer.BufferAddress;
+    PushConstants.pInstances = InstanceSlots.BufferAddress;
+    PushConstants.pyramidSize = glm::fvec2{DepthPyramid.Width, DepthPyramid.Height};
+    PushConstants.maxDrawCount = DrawCommandsCapacity;
+    PushConstants.occlusionCulling = bOcclusionCulling;
+    PushConstants.earlyOcclusionCulling = bEarlyOcclusionCulling;
+    PushConstants.latePass = bLatePass;
+
+    CommandBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, BuildDrawCommandsPipeline);
+    CommandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, BuildDrawCommandsLayout, 0, 1, &DepthPyramid.MeshletCullSets[DepthPyramid.Current], 0, nullptr);
+    CommandBuffer.pushConstants(BuildDrawCommandsLayout, vk::ShaderStageFlagBits::eCompute, 0, sizeof(PushConstants), &PushConstants);
+    CommandBuffer.dispatchIndirect(MeshletTasksBuffer.Buffer, 0);
+
+    //one draw per bucket, appended to the same indirect buffer as the meshlet draws
+    VShaderInstanceBucketsPC BucketsPushConstants{};
+    BucketsPushConstants.pDrawIndirectCount = DrawIndirectCommandsBuffer.BufferAddress;
+    BucketsPushConstants.pBuckets = InstanceBuckets.BufferAddress;
+    BucketsPushConstants.pMeshes = SceneMeshInfos.BufferAddress;
+    BucketsPushConstants.bucketCount = BucketCount;
+    BucketsPushConstants.instanceBase = DrawCommandsCapacity;
+    BucketsPushConstants.maxDrawCount = DrawCommandsCapacity;
+
+    CommandBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, InstanceBucketsPipeline);
+    CommandBuffer.pushConstants(InstanceBucketsLayout, vk::ShaderStageFlagBits::eCompute, 0, sizeof(BucketsPushConstants), &BucketsPushConstants);
+    CommandBuffer.dispatch(1u, 1u, 1u);
+
+    auto BucketOffsetsBarrier = vk::BufferMemoryBarrier2{}
+            .setBuffer(InstanceBuckets.Buffer)
+            .setOffset(0)
+            .setSize(VK_WHOLE_SIZE)
+            .setSrcStageMask(vk::PipelineStageFlagBits2::eComputeShader)
+            .setSrcAccessMask(vk::AccessFlagBits2::eShaderStorageWrite)
+            .setDstStageMask(vk::PipelineStageFlagBits2::eComputeShader)
+            .setDstAccessMask(vk::AccessFlagBits2::eShaderStorageRead);
+
+    CommandBuffer.pipelineBarrier2(vk::DependencyInfo{}.setBufferMemoryBarriers(BucketOffsetsBarrier));
+
+    VShaderInstanceScatterPC ScatterPushConstants{};
+    ScatterPushConstants.pBuckets = InstanceBuckets.BufferAddress;
+    ScatterPushConstants.pInstanceEntries = SceneInstanceEntries.BufferAddress;
+    ScatterPushConstants.pInstances = InstanceSlots.BufferAddress;
+    ScatterPushConstants.meshCount = MeshCount;
+    ScatterPushConstants.instanceBase = DrawCommandsCapacity;
+
+    CommandBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, InstanceScatterPipeline);
+    CommandBuffer.pushConstants(InstanceScatterLayout, vk::ShaderStageFlagBits::eCompute, 0, sizeof(ScatterPushConstants), &ScatterPushConstants);
+    CommandBuffer.dispatch(vkutil::GroupCount(MeshCount, 64u), 1u, 1u);
+
+    //draw commands and the instance slots the vertex shaders read
+    auto DrawCommandsBarrier = vk::MemoryBarrier2{}
+            .setSrcStageMask(vk::PipelineStageFlagBits2::eComputeShader)
+            .setSrcAccessMask(vk::AccessFlagBits2::eShaderStorageWrite)
+            .setDstStageMask(vk::PipelineStageFlagBits2::eDrawIndirect | VertexStages(CommandBuffer))
+            .setDstAccessMask(vk::AccessFlagBits2::eIndirectCommandRead | vk::AccessFlagBits2::eShaderStorageRead);
+
+    CommandBuffer.pipelineBarrier2(vk::DependencyInfo{}.setMemoryBarriers(DrawCommandsBarrier));
+}
+
+void VStarSightRenderer::CreateForwardPipeline()
+{
+    VGraphicsPipelineBuilder Builder = MakeGraphicsPipelineBuilder();
+
+    Builder.IncludeShader(ProjectAbsolutePath("shaders/forward.vert"));
+    Builder.IncludeShader(ProjectAbsolutePath("shaders/forward.frag"));
+
+    Builder.dynamic_state = pipeline_helpers::dynamic_viewport_scissor();
+    Builder.viewport = pipeline_helpers::single_viewport_scissor();
+    Builder.rendering.setColorAttachmentFormats(SurfaceFormat.format);
+    Builder.rendering.setDepthAttachmentFormat(GBuffer.DepthFormat);
+    //Builder.vertex_input;
+    Builder.input_assembly = pipeline_helpers::topology(vk::PrimitiveTopology::eTriangleList);
+    Builder.rasterization = pipeline_helpers::rasterization(vk::CullModeFlagBits::eBack);
+    Builder.multisample = pipeline_helpers::no_multisample();
+    Builder.color_blend = pipeline_helpers::no_colorblend<1>();
+    Builder.depth_stencil = pipeline_helpers::reversed_depth();
+
+    Builder.Build(&ForwardPipelineLayout, &ForwardPipeline, fmt::format("forward pipeline {}", GetWindowName()));
+
+    std::lock_guard Guard{DestructionMx};
+    DestructionQueue.emplace_back([this](){
+        Device.destroyPipeline(ForwardPipeline);
+    });
+}
+
+void VStarSightRenderer::CreateGBuffer()
+{
+    LOG_INFO("creating GBuffer");
+
+    std::array PositionFormats{vk::Format::eR32G32B32Sfloat, vk::Format::eR32G32B32A32Sfloat};
+    std::array NormalFormats{vk::Format::eR16G16Snorm, vk::Format::eR32G32Sfloat};
+    std::array ColorFormats{vk::Format::eR8G8B8A8Srgb};
+    std::array VisibilityFormats{vk::Format::eR32G32Uint};
+    std::array DepthFormats{vk::Format::eD32Sfloat, vk::Format::eD32SfloatS8Uint, vk::Format::eD24UnormS8Uint};
+
+    //the visibility buffer mode rasterizes only the ids, normal and color are written once per pixel by material.comp
+    vk::FormatFeatureFlags ShadedFeatures = bVisibilityBuffer ? vk::FormatFeatureFlagBits::eStorageImage : vk::FormatFeatureFlagBits::eColorAttachment;
+    vk::ImageUsageFlags ShadedUsage = bVisibilityBuffer ? vk::ImageUsageFlagBits::eStorage : vk::ImageUsageFlagBits::eColorAttachment;
+
+    GBuffer.PositionFormat = PickImageFormat(vk::FormatFeatureFlagBits::eColorAttachment | vk::FormatFeatureFlagBits::eSampledImage, PositionFormats);
+    GBuffer.NormalFormat = PickImageFormat(ShadedFeatures | vk::FormatFeatureFlagBits::eSampledImage, NormalFormats);
+    GBuffer.ColorFormat = PickImageFormat(vk::FormatFeatureFlagBits::eColorAttachment | vk::FormatFeatureFlagBits::eSampledImage, ColorFormats);
+    GBuffer.VisibilityFormat = PickImageFormat(vk::FormatFeatureFlagBits::eColorAttachment | vk::FormatFeatureFlagBits::eSampledImage, VisibilityFormats);
+    GBuffer.DepthFormat = PickImageFormat(vk::FormatFeatureFlagBits::eDepthStencilAttachment | vk::FormatFeatureFlagBits::eSampledImage, DepthFormats);
+
+    auto[Width, Height] = GetWindowExtent();
+
+    auto PositionCreateInfo = vk::ImageCreateInfo{}
+            .setUsage(vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eSampled)
+            .setExtent(vk::Extent3D{Width, Height, 1})
+            .setArrayLayers(1)
+            .setMipLevels(1)
+            .setFormat(GBuffer.PositionFormat)
+            .setImageType(vk::ImageType::e2D)
+            .setTiling(vk::ImageTiling::eOptimal)
+            .setSamples(vk::SampleCountFlagBits::e1)
+            .setInitialLayout(vk::ImageLayout::eUndefined);
+
+    auto NormalCreateInfo = vk::ImageCreateInfo{}
+            .setUsage(ShadedUsage | vk::ImageUsageFlagBits::eSampled)
+            .setExtent(vk::Extent3D{Width, Height, 1})
+            .setArrayLayers(1)
+            .setMipLevels(1)
+            .setFormat(GBuffer.NormalFormat)
+            .setImageType(vk::ImageType::e2D)
+            .setTiling(vk::ImageTiling::eOptimal)
+            .setSamples(vk::SampleCountFlagBits::e1)
+            .setInitialLayout(vk::ImageLayout::eUndefined);
+
+    auto ColorCreateInfo = vk::ImageCreateInfo{}
+            .setUsage(ShadedUsage | vk::ImageUsageFlagBits::eSampled)
+            .setExtent(vk::Extent3D{Width, Height, 1})
+            .setArrayLayers(1)
+            .setMipLevels(1)
+            .setFormat(GBuffer.ColorFormat)
+            .setImageType(vk::ImageType::e2D)
+            .setTiling(vk::ImageTiling::eOptimal)
+            .setSamples(vk::SampleCountFlagBits::e1)
+            .setInitialLayout(vk::ImageLayout::eUndefined);
+
+    if(bVisibilityBuffer)
+    {
+        //the storage usage only has to be supported by the unorm view
+        ColorCreateInfo.setFlags(vk::ImageCreateFlagBits::eMutableFormat | vk::ImageCreateFlagBits::eExtendedUsage);
+    }
+
+    auto VisibilityCreateInfo = vk::ImageCreateInfo{}
+            .setUsage(vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eSampled)
+            .setExtent(vk::Extent3D{Width, Height, 1})
+            .setArrayLayers(1)
+            .setMipLevels(1)
+            .setFormat(GBuffer.VisibilityFormat)
+            .setImageType(vk::ImageType::e2D)
+            .setTiling(vk::ImageTiling::eOptimal)
+            .setSamples(vk::SampleCountFlagBits::e1)
+            .setInitialLayout(vk::ImageLayout::eUndefined);
+
+    auto DepthCreateInfo = vk::ImageCreateInfo{}
+            .setUsage(vk::ImageUsageFlagBits::eDepthStencilAttachment | vk::ImageUsageFlagBits::eSampled)
+            .setExtent(vk::Extent3D{Width, Height, 1})
+            .setArrayLayers(1)
+            .setMipLevels(1)
+            .setFormat(GBuffer.DepthFormat)
+            .setImageType(vk::ImageType::e2D)
+            .setTiling(vk::ImageTiling::eOptimal)
+            .setSamples(vk::SampleCountFlagBits::e1)
+            .setInitialLayout(vk::ImageLayout::eUndefined);
+
+    auto DepthAllocateInfo = vma::AllocationCreateInfo{}
+            .setFlags(vma::AllocationCreateFlagBits::eStrategyBestFit)
+            .setUsage(vma::MemoryUsage::eAutoPreferDevice);
+
+    vkResultCheck = Allocator.createImage(&DepthCreateInfo, &DepthAllocateInfo, &GBuffer.Depth.Image, &GBuffer.Depth.Allocation, &GBuffer.Depth.Info);
+    NameObject(GBuffer.Depth.Image, "GBuffer Depth image");
+
+    auto DepthViewCreateInfo = vk::ImageViewCreateInfo{}
+            .setImage(GBuffer.Depth.Image)
+            .setFormat(GBuffer.DepthFormat)
+            .setViewType(vk::ImageViewType::e2D)
+            .setComponents(vk::ComponentMapping{})
+            .setSubresourceRange(vkutil::flat_subresource_range(vk::ImageAspectFlagBits::eDepth));
+
+    vkResultCheck = Device.createImageView(&DepthViewCreateInfo, nullptr, &GBuffer.Depth.ImageView);
+    NameObject(GBuffer.Depth.ImageView, "GBuffer Depth image view");
+
+    //depth outlives the frame for the depth pyramid, the rest only lives between the passes writing and reading it
+    FrameImages.Depth = FrameGraph.ImportImage("GBuffer Depth", vk::ImageAspectFlagBits::eDepth);
+
+    if(bVisibilityBuffer)
+    {
+        FrameImages.Visibility = FrameGraph.CreateImage("GBuffer Visibility", VisibilityCreateInfo, vk::ImageAspectFlagBits::eColor);
+    }
+    else
+    {
+        FrameImages.Position = FrameGraph.CreateImage("GBuffer Position", PositionCreateInfo, vk::ImageAspectFlagBits::eColor);
+    }
+
+    FrameImages.Normal = FrameGraph.CreateImage("GBuffer Normal", NormalCreateInfo, vk::ImageAspectFlagBits::eColor);
+    FrameImages.Color = FrameGraph.CreateImage("GBuffer Color", ColorCreateInfo, vk::ImageAspectFlagBits::eColor, bVisibilityBuffer ? vk::ImageUsageFlagBits::eSampled : vk::ImageUsageFlags{});
+
+    BuildFrameGraph();
+
+    auto GraphImage = [this](VRenderGraphImage Image)
+    {
+        VAllocatedImage Result{};
+        if(Image)
+        {
+            Result.Image = FrameGraph.GetImage(Image);
+            Result.ImageView = FrameGraph.GetImageView(Image);
+        }
+
+        return Result;
+    };
+
+    GBuffer.Position = GraphImage(FrameImages.Position);
+    GBuffer.Normal = GraphImage(FrameImages.Normal);
+    GBuffer.Color = GraphImage(FrameImages.Color);
+    GBuffer.Visibility = GraphImage(FrameImages.Visibility);
+
+    if(bVisibilityBuffer)
+    {
+        auto ColorStorageViewCreateInfo = vk::ImageViewCreateInfo{}
+                .setImage(GBuffer.Color.Image)
+                .setFormat(vk::Format::eR8G8B8A8Unorm)
+                .setViewType(vk::ImageViewType::e2D)
+                .setComponents(vk::ComponentMapping{})
+                .setSubresourceRange(vkutil::flat_subresource_range(vk::ImageAspectFlagBits::eColor));
+
+        vkResultCheck = Device.createImageView(&ColorStorageViewCreateInfo, nullptr, &GBuffer.ColorStorageView);
+        NameObject(GBuffer.ColorStorageView, "GBuffer Color storage view");
+    }
+}
+
+void VStarSightRenderer::Draw(uint32_t MeshCount)
+{
+    uint32_t SwapChainImage = AcquireSwapChainImage();
+    if(SwapChainImage == UINT32_MAX)
+    {
+        RecreateSwapChain();
+        return;
+    }
+
+    ActiveFrame->CommandBuffer.begin({vk::CommandBufferUsageFlagBits::eOneTimeSubmit});
+
+    RecordSceneUpdates(ActiveFrame->CommandBuffer);
+
+    RecordBuildDrawCommands(ActiveFrame->CommandBuffer, MeshCount, false, false);
+
+    BeginSwapChainRender(SwapChainImage);
+    DrawShader(MeshCount);
+    EndSwapChainRender(SwapChainImage);
+
+    ActiveFrame->CommandBuffer.end();
+
+    SubmitCommands();
 
     if(!PresentImage(SwapChainImage))
     {
@@ -676,15 +1322,39 @@ uint32_t VStarSightRenderer::AcquireSwapChainImage()
 {
     vkResultCheck = Device.waitForFences(ActiveFrame->InFlight, true, vkutil::default_timeout);
 
-    auto AcquireInfo = vk::AcquireNextImageInfoKHR{}
-            .setSwapchain(SwapChain)
-            .setSemaphore(ActiveFrame->ImageAvailable)
-            .setFence(nullptr)
-            .setTimeout(vkutil::default_timeout)
-            .setDeviceMask(1);
+    //frames finish in submission order, so everything recorded up to this frame's epoch is done
+    global::Epochs.SetDeviceEpoch(ActiveFrame->Epoch + 1);
+    ActiveFrame->Epoch = global::Epochs.GetEpoch();
+
+    //after the upload manager flush, so every texture whose upload is in flight has its descriptor written
+    BeginBindlessFrame();
+
+    GpuProfiler.Collect({&ActiveFrame->Queries, &ActiveFrame->ComputeQueries});
+
+    std::array<uint32_t, 2> CullStatistics{};
+    Allocator.invalidateAllocation(ActiveFrame->CullStatistics.Allocation, 0, VK_WHOLE_SIZE);
+    memcpy(CullStatistics.data(), ActiveFrame->CullStatistics.MappedData, sizeof(CullStatistics));
+    VisibleMeshCount = CullStatistics[0] + CullStatistics[1];
 
     uint32_t ImageIndex = UINT32_MAX;
-    vk::Result Result = Device.acquireNextImage2KHR(&AcquireInfo, &ImageIndex);
+    vk::Result Result = vk::Result::eSuccess;
+
+    if(bHeadless)
+    {
+        //the offscreen image of this frame is free once its fence has passed
+        ImageIndex = static_cast<uint32_t>(ActiveFrameIndex());
+    }
+    else
+    {
+        auto AcquireInfo = vk::AcquireNextImageInfoKHR{}
+                .setSwapchain(SwapChain)
+                .setSemaphore(ActiveFrame->ImageAvailable)
+                .setFence(nullptr)
+                .setTimeout(vkutil::default_timeout)
+                .setDeviceMask(1);
+
+        Result = Device.acquireNextImage2KHR(&AcquireInfo, &ImageIndex);
+    }
 
     for(auto& OnBegin : ActiveFrame->OnFrameBegin)
     {
@@ -790,126 +1460,533 @@ void VStarSightRenderer::DrawShader(uint32_t MeshCount)
 {
     VShaderForwardDrawPC PushConstants{};
     PushConstants.pCamera = CameraBuffer.BufferAddress + (ActiveFrameIndex() * sizeof(VShaderCameraData));
-    PushConstants.pMesh = ActiveFrame->MeshInfos.BufferAddress;
-    PushConstants.pTransform = ActiveFrame->MeshTransforms.BufferAddress;
+    PushConstants.pMesh = SceneMeshInfos.BufferAddress;
+    PushConstants.pTransform = SceneTransforms.BufferAddress;
     PushConstants.pVertexBuffer = GlobalVertexBuffer.BufferAddress;
+    PushConstants.pInstances = InstanceSlots.BufferAddress;
 
     ActiveFrame->CommandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, ForwardPipeline);
     ActiveFrame->CommandBuffer.pushConstants(ForwardPipelineLayout, vk::ShaderStageFlagBits::eVertex, 0, sizeof(PushConstants), &PushConstants);
     ActiveFrame->CommandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, ForwardPipelineLayout, 0, 1, &ShaderResourceSet, 0, nullptr);
     ActiveFrame->CommandBuffer.bindIndexBuffer(GlobalIndexBuffer.Buffer, 0, vk::IndexType::eUint32);
-    ActiveFrame->CommandBuffer.drawIndexedIndirectCount(DrawIndirectCommandsBuffer.Buffer, sizeof(VShaderDrawIndirectCount), DrawIndirectCommandsBuffer.Buffer, 0, MeshCount, sizeof(vk::DrawIndexedIndirectCommand));
+    ActiveFrame->CommandBuffer.drawIndexedIndirectCount(DrawIndirectCommandsBuffer.Buffer, sizeof(VShaderDrawIndirectCount), DrawIndirectCommandsBuffer.Buffer, 0, DrawCommandsCapacity, sizeof(vk::DrawIndexedIndirectCommand));
+}
+
+void VStarSightRenderer::EndSwapChainRender(uint32_t SwapChainImage)
+{
+    auto SwapChainImage2PresentSrc = vk::ImageMemoryBarrier2{}
+            .setImage(Images[SwapChainImage])
+            .setOldLayout(vk::ImageLayout::eColorAttachmentOptimal)
+            .setNewLayout(PresentLayout)
+            .setSrcStageMask(PipelineStage::eColorAttachmentOutput)
+            .setSrcAccessMask(AccessFlag::eColorAttachmentWrite)
+            .setDstStageMask(PipelineStage::eColorAttachmentOutput)
+            .setDstAccessMask(AccessFlag::eNone)
+            .setSubresourceRange(vkutil::flat_subresource_range(vk::ImageAspectFlagBits::eColor));
+
+    auto Dependency = vk::DependencyInfo{}
+            .setImageMemoryBarriers(SwapChainImage2PresentSrc);
+
+    ActiveFrame->CommandBuffer.endRendering();
+    ActiveFrame->CommandBuffer.pipelineBarrier2(Dependency);
+}
+
+std::vector<vk::SemaphoreSubmitInfo> VStarSightRenderer::MakeWaitSemaphoreInfos(vk::PipelineStageFlags2 ImageAvailableStage)
+{
+    std::vector<vk::SemaphoreSubmitInfo> WaitInfos{};
+
+    //headless nothing is acquired
+    if(!bHeadless)
+    {
+        WaitInfos.emplace_back(vk::SemaphoreSubmitInfo{}
+                .setSemaphore(ActiveFrame->ImageAvailable)
+                .setStageMask(ImageAvailableStage));
+    }
+
+    //the global geometry buffers were replaced by a transfer batch, their old contents have to be copied before anything reads them
+    if(uint64_t TransferValue = Uploader->TakeDeviceWaitValue(); TransferValue != 0)
+    {
+        WaitInfos.emplace_back(vk::SemaphoreSubmitInfo{}
+                .setSemaphore(Uploader->GetTimeline())
+                .setValue(TransferValue)
+                .setStageMask(PipelineStage::eAllCommands));
+    }
+
+    return WaitInfos;
+}
+
+void VStarSightRenderer::SubmitCommands()
+{
+    auto CommandInfo = vk::CommandBufferSubmitInfo{}
+            .setCommandBuffer(ActiveFrame->CommandBuffer);
+
+    std::vector<vk::SemaphoreSubmitInfo> WaitInfos = MakeWaitSemaphoreInfos(PipelineStage::eColorAttachmentOutput);
+
+    auto SignalInfo = vk::SemaphoreSubmitInfo{}
+            .setSemaphore(ActiveFrame->DrawFinished)
+            .setStageMask(PipelineStage::eColorAttachmentOutput);
+
+    //headless nothing presents, so nothing would wait for it
+    auto SubmitInfo = vk::SubmitInfo2{}
+            .setCommandBufferInfos(CommandInfo)
+            .setWaitSemaphoreInfos(WaitInfos)
+            .setSignalSemaphoreInfoCount(bHeadless ? 0 : 1)
+            .setPSignalSemaphoreInfos(&SignalInfo);
+
+    QueueHandles.Graphics.submit2(SubmitInfo, ActiveFrame->InFlight);
+}
+
+bool VStarSightRenderer::PresentImage(uint32_t SwapChainImage)
+{
+    if(bHeadless)
+    {
+        uint64_t Frame = PresentedFrames++;
+        if(std::find(Headless.DumpFrames.begin(), Headless.DumpFrames.end(), Frame) != Headless.DumpFrames.end())
+        {
+            DumpImage(SwapChainImage, Headless.DumpDirectory / fmt::format("frame_{}.png", Frame));
+        }
+
+        return true;
+    }
+
+    vk::Result Result{};
+    auto PresentInfo = vk::PresentInfoKHR{}
+            .setImageIndices(SwapChainImage)
+            .setWaitSemaphores(ActiveFrame->DrawFinished)
+            .setSwapchains(SwapChain)
+            .setResults(Result);
+
+    (void)QueueHandles.Present.presentKHR(PresentInfo);
+
+    if(Result == vk::Result::eErrorOutOfDateKHR || Result == vk::Result::eSuboptimalKHR)
+    {
+        return false;
+    }
+    else if(Result != vk::Result::eSuccess)
+    {
+        VERIFY(false, vk::to_string(Result));
+    }
+
+    return true;
+}
+
+void VStarSightRenderer::DumpImage(uint32_t Image, const std::fpath& Path)
+{
+    //only for the frames asked for, so simply waiting for the frame is fine
+    vkResultCheck = Device.waitForFences(ActiveFrame->InFlight, true, vkutil::default_timeout);
+
+    uint64_t Size = static_cast<uint64_t>(ImageExtent.width) * ImageExtent.height * 4;
+    VAllocatedBuffer Readback = AllocateBuffer(Size, vk::BufferUsageFlagBits::eTransferDst,
+            vma::AllocationCreateFlagBits::eMapped | vma::AllocationCreateFlagBits::eHostAccessRandom,
+            vma::MemoryUsage::eAutoPreferHost, "headless readback");
+
+    auto CommandBufferInfo = vk::CommandBufferAllocateInfo{}
+            .setCommandBufferCount(1)
+            .setCommandPool(GraphicsCommandPool)
+            .setLevel(vk::CommandBufferLevel::ePrimary);
+
+    vk::CommandBuffer CommandBuffer = nullptr;
+    vkResultCheck = Device.allocateCommandBuffers(&CommandBufferInfo, &CommandBuffer);
+
+    CommandBuffer.begin({vk::CommandBufferUsageFlagBits::eOneTimeSubmit});
+
+    auto CopyRegion = vk::BufferImageCopy{}
+            .setImageSubresource(vk::ImageSubresourceLayers{vk::ImageAspectFlagBits::eColor, 0, 0, 1})
+            .setImageExtent(vk::Extent3D{ImageExtent.width, ImageExtent.height, 1});
+
+    CommandBuffer.copyImageToBuffer(Images[Image], PresentLayout, Readback.Buffer, CopyRegion);
+
+    auto HostBarrier = vk::MemoryBarrier2{}
+            .setSrcStageMask(PipelineStage::eCopy)
+            .setSrcAccessMask(AccessFlag::eTransferWrite)
+            .setDstStageMask(PipelineStage::eHost)
+            .setDstAccessMask(AccessFlag::eHostRead);
+
+    CommandBuffer.pipelineBarrier2(vk::DependencyInfo{}.setMemoryBarriers(HostBarrier));
+    CommandBuffer.end();
+
+    auto CommandInfo = vk::CommandBufferSubmitInfo{}
+            .setCommandBuffer(CommandBuffer);
+
+    vk::Fence CopyFence = Device.createFence({});
+    QueueHandles.Graphics.submit2(vk::SubmitInfo2{}.setCommandBufferInfos(CommandInfo), CopyFence);
+    vkResultCheck = Device.waitForFences(CopyFence, true, vkutil::default_timeout);
+
+    Device.destroyFence(CopyFence);
+    Device.freeCommandBuffers(GraphicsCommandPool, CommandBuffer);
+
+    Allocator.invalidateAllocation(Readback.Allocation, 0, Size);
+
+    //the images are bgra
+    std::vector<uint8_t> Pixels(Size);
+    const uint8_t* Source = static_cast<const uint8_t*>(Readback.MappedData);
+    for(uint64_t Pixel = 0; Pixel < Size; Pixel += 4)
+    {
+        Pixels[Pixel + 0] = Source[Pixel + 2];
+        Pixels[Pixel + 1] = Source[Pixel + 1];
+        Pixels[Pixel + 2] = Source[Pixel + 0];
+        Pixels[Pixel + 3] = 255;
+    }
+
+    FreeBuffer(&Readback);
+
+    std::error_code Error{};
+    std::filesystem::create_directories(Path.parent_path(), Error);
+
+    if(stbi_write_png(Path.c_str(), ImageExtent.width, ImageExtent.height, 4, Pixels.data(), ImageExtent.width * 4) == 0)
+    {
+        LOG_WARNING("could not write {}", Path);
+        return;
+    }
+
+    LOG_INFO("wrote {}", Path);
+}
+
+void VStarSightRenderer::AdvanceActiveFrame()
+{
+    if(ActiveFrame == Frames.end() - 1)
+    {
+        ActiveFrame = Frames.begin();
+    }
+    else
+    {
+        ++ActiveFrame;
+    }
+
+    //nothing from the last time this frame was active is read anymore, the gpu never sees the arena
+    ActiveFrame->Arena.Reset();
+}
+
+std::string_view VStarSightRenderer::GetWindowName() const
+{
+    if(bHeadless)
+    {
+        return "headless";
+    }
+
+    return GlfwGetWindowUserData(Window)->WindowName;
+}
+
+std::pair<uint32_t, uint32_t> VStarSightRenderer::GetWindowExtent()
+{
+    if(bHeadless)
+    {
+        return {Headless.Width, Headless.Height};
+    }
+
+    int width; int height;
+    glfwGetFramebufferSize(Window, &width, &height);
+    return {width, height};
+}
+
+void VStarSightRenderer::WaitForFrames()
+{
+    std::array<vk::Fence, FRAMES_IN_FLIGHT> FrameFences{};
+    for(uint64_t index = 0; index < FRAMES_IN_FLIGHT; ++index)
+    {
+        FrameFences[index] = Frames[index].InFlight;
+    }
+
+    constexpr uint64_t TimeOut = std::nano::den * 10;
+    vkResultCheck = Device.waitForFences(FrameFences, true, TimeOut);
+}
+
+void VStarSightRenderer::DestroyGBuffer()
+{
+    //the graph owns every GBuffer image but depth
+    FrameGraph.Reset();
+    FrameImages = {};
+
+    Device.destroyImageView(GBuffer.ColorStorageView);
+    GBuffer.ColorStorageView = nullptr;
+    Allocator.destroyImage(GBuffer.Depth.Image, GBuffer.Depth.Allocation);
+    Device.destroyImageView(GBuffer.Depth.ImageView);
 }
+void VStarSightRenderer::CreateDepthReducePipeline()
+{
+    VComputePipelineBuilder Builder = MakeComputePipelineBuilder();
+    Builder.IncludeShader(ProjectAbsolutePath("shaders/depth_reduce.comp"));
+    Builder.Build(&DepthReduceLayout, &DepthReducePipeline, "DepthReduce");
+
+    //reversed depth, the farthest sample is the smallest
+    auto ReductionInfo = vk::SamplerReductionModeCreateInfo{}
+            .setReductionMode(vk::SamplerReductionMode::eMin);
+
+    auto SamplerInfo = vk::SamplerCreateInfo{}
+            .setPNext(&ReductionInfo)
+            .setAddressModeU(vk::SamplerAddressMode::eClampToEdge)
+            .setAddressModeV(vk::SamplerAddressMode::eClampToEdge)
+            .setAddressModeW(vk::SamplerAddressMode::eClampToEdge)
+            .setAnisotropyEnable(false)
+            .setUnnormalizedCoordinates(false)
+            .setCompareEnable(false)
+            .setMipmapMode(vk::SamplerMipmapMode::eNearest)
+            .setMinFilter(vk::Filter::eLinear)
+            .setMagFilter(vk::Filter::eLinear)
+            .setMinLod(0.f)
+            .setMaxLod(VK_LOD_CLAMP_NONE);
+
+    DepthPyramid.Sampler = Device.createSampler(SamplerInfo);
+    NameObject(DepthPyramid.Sampler, "DepthPyramid sampler");
+
+    std::lock_guard Guard{DestructionMx};
+    DestructionQueue.emplace_back([this]{
+        Device.destroySampler(DepthPyramid.Sampler);
+        Device.destroyPipeline(DepthReducePipeline);
+    });
+}
+
+void VStarSightRenderer::CreateDepthPyramid()
+{
+    LOG_INFO("creating depth pyramid");
+
+    auto[Width, Height] = GetWindowExtent();
+
+    //power of 2 so every level halves exactly and the min sampler covers the 2x2 footprint
+    DepthPyramid.Width = std::bit_floor(std::max(Width, 1u));
+    DepthPyramid.Height = std::bit_floor(std::max(Height, 1u));
+    DepthPyramid.MipLevels = std::bit_width(std::max(DepthPyramid.Width, DepthPyramid.Height));
+    DepthPyramid.Current = 0;
+    DepthPyramid.bValid = false;
+
+    auto PyramidCreateInfo = vk::ImageCreateInfo{}
+            .setUsage(vk::ImageUsageFlagBits::eStorage | vk::ImageUsageFlagBits::eSampled)
+            .setExtent(vk::Extent3D{DepthPyramid.Width, DepthPyramid.Height, 1})
+            .setArrayLayers(1)
+            .setMipLevels(DepthPyramid.MipLevels)
+            .setFormat(vk::Format::eR32Sfloat)
+            .setImageType(vk::ImageType::e2D)
+            .setTiling(vk::ImageTiling::eOptimal)
+            .setSamples(vk::SampleCountFlagBits::e1)
+            .setInitialLayout(vk::ImageLayout::eUndefined);
+
+    auto PyramidAllocateInfo = vma::AllocationCreateInfo{}
+            .setFlags(vma::AllocationCreateFlagBits::eStrategyBestFit)
+            .setUsage(vma::MemoryUsage::eAutoPreferDevice);
+
+    for(uint32_t Index = 0; Index < DepthPyramid.Images.size(); ++Index)
+    {
+        VAllocatedImage& Image = DepthPyramid.Images[Index];
+
+        vkResultCheck = Allocator.createImage(&PyramidCreateInfo, &PyramidAllocateInfo, &Image.Image, &Image.Allocation, &Image.Info);
+        NameObject(Image.Image, "DepthPyramid [{}] image", Index);
+
+        auto PyramidViewCreateInfo = vk::ImageViewCreateInfo{}
+                .setImage(Image.Image)
+                .setFormat(vk::Format::eR32Sfloat)
+                .setViewType(vk::ImageViewType::e2D)
+                .setComponents(vk::ComponentMapping{})
+                .setSubresourceRange(vk::ImageSubresourceRange{vk::ImageAspectFlagBits::eColor, 0, DepthPyramid.MipLevels, 0, 1});
+
+        vkResultCheck = Device.createImageView(&PyramidViewCreateInfo, nullptr, &Image.ImageView);
+        NameObject(Image.ImageView, "DepthPyramid [{}] image view", Index);
+
+        DepthPyramid.MipViews[Index].resize(DepthPyramid.MipLevels);
+        for(uint32_t Mip = 0; Mip < DepthPyramid.MipLevels; ++Mip)
+        {
+            PyramidViewCreateInfo.setSubresourceRange(vk::ImageSubresourceRange{vk::ImageAspectFlagBits::eColor, Mip, 1, 0, 1});
+
+            vkResultCheck = Device.createImageView(&PyramidViewCreateInfo, nullptr, &DepthPyramid.MipViews[Index][Mip]);
+            NameObject(DepthPyramid.MipViews[Index][Mip], "DepthPyramid [{}] mip {} image view", Index, Mip);
+        }
+    }
 
-void VStarSightRenderer::EndSwapChainRender(uint32_t SwapChainImage)
-{
-    auto SwapChainImage2PresentSrc = vk::ImageMemoryBarrier2{}
-            .setImage(Images[SwapChainImage])
-            .setOldLayout(vk::ImageLayout::eColorAttachmentOptimal)
-            .setNewLayout(vk::ImageLayout::ePresentSrcKHR)
-            .setSrcStageMask(PipelineStage::eColorAttachmentOutput)
-            .setSrcAccessMask(AccessFlag::eColorAttachmentWrite)
-            .setDstStageMask(PipelineStage::eColorAttachmentOutput)
-            .setDstAccessMask(AccessFlag::eNone)
-            .setSubresourceRange(vkutil::flat_subresource_range(vk::ImageAspectFlagBits::eColor));
+    VDescriptorLayoutCache::layout_info_t ReduceLayoutInfo{};
 
-    auto Dependency = vk::DependencyInfo{}
-            .setImageMemoryBarriers(SwapChainImage2PresentSrc);
+    ReduceLayoutInfo.flags.emplace_back();
+    ReduceLayoutInfo.bindings.emplace_back()
+            .setBinding(0)
+            .setDescriptorCount(1)
+            .setDescriptorType(vk::DescriptorType::eStorageImage)
+            .setStageFlags(vk::ShaderStageFlagBits::eCompute);
 
-    ActiveFrame->CommandBuffer.endRendering();
-    ActiveFrame->CommandBuffer.pipelineBarrier2(Dependency);
-}
+    ReduceLayoutInfo.flags.emplace_back();
+    ReduceLayoutInfo.bindings.emplace_back()
+            .setBinding(1)
+            .setDescriptorCount(1)
+            .setDescriptorType(vk::DescriptorType::eCombinedImageSampler)
+            .setStageFlags(vk::ShaderStageFlagBits::eCompute);
 
-void VStarSightRenderer::SubmitCommands()
-{
-    auto CommandInfo = vk::CommandBufferSubmitInfo{}
-            .setCommandBuffer(ActiveFrame->CommandBuffer);
+    VDescriptorLayoutCache::layout_info_t MeshCullLayoutInfo{};
 
-    auto WaitInfo = vk::SemaphoreSubmitInfo{}
-            .setSemaphore(ActiveFrame->ImageAvailable)
-            .setStageMask(PipelineStage::eColorAttachmentOutput);
+    MeshCullLayoutInfo.flags.emplace_back();
+    MeshCullLayoutInfo.bindings.emplace_back()
+            .setBinding(0)
+            .setDescriptorCount(1)
+            .setDescriptorType(vk::DescriptorType::eCombinedImageSampler)
+            .setStageFlags(vk::ShaderStageFlagBits::eCompute);
 
-    auto SignalInfo = vk::SemaphoreSubmitInfo{}
-            .setSemaphore(ActiveFrame->DrawFinished)
-            .setStageMask(PipelineStage::eColorAttachmentOutput);
+    VDescriptorLayoutCache::layout_info_t MeshletCullLayoutInfo = MeshCullLayoutInfo;
 
-    auto SubmitInfo = vk::SubmitInfo2{}
-            .setCommandBufferInfos(CommandInfo)
-            .setWaitSemaphoreInfos(WaitInfo)
-            .setSignalSemaphoreInfos(SignalInfo);
+    MeshletCullLayoutInfo.flags.emplace_back();
+    MeshletCullLayoutInfo.bindings.emplace_back()
+            .setBinding(1)
+            .setDescriptorCount(1)
+            .setDescriptorType(vk::DescriptorType::eCombinedImageSampler)
+            .setStageFlags(vk::ShaderStageFlagBits::eCompute);
 
-    QueueHandles.Graphics.submit2(SubmitInfo, ActiveFrame->InFlight);
-}
+    for(uint32_t Index = 0; Index < DepthPyramid.Images.size(); ++Index)
+    {
+        std::vector<vk::DescriptorSetLayout> SetLayouts(DepthPyramid.MipLevels, DescriptorLayoutCache->create_layout(ReduceLayoutInfo));
+        SetLayouts.emplace_back(DescriptorLayoutCache->create_layout(MeshCullLayoutInfo));
+        SetLayouts.emplace_back(DescriptorLayoutCache->create_layout(MeshletCullLayoutInfo));
+
+        auto SetAllocateInfo = vk::DescriptorSetAllocateInfo{}
+                .setDescriptorPool(TransientDescriptorPool)
+                .setSetLayouts(SetLayouts);
+
+        std::vector<vk::DescriptorSet> Sets = Device.allocateDescriptorSets(SetAllocateInfo);
+        DepthPyramid.MeshletCullSets[Index] = Sets.back();
+        Sets.pop_back();
+        DepthPyramid.MeshCullSets[Index] = Sets.back();
+        Sets.pop_back();
+        DepthPyramid.ReduceSets[Index] = std::move(Sets);
+
+        NameObject(DepthPyramid.MeshCullSets[Index], "DepthPyramid [{}] mesh cull descriptor set", Index);
+        NameObject(DepthPyramid.MeshletCullSets[Index], "DepthPyramid [{}] meshlet cull descriptor set", Index);
+    }
 
-bool VStarSightRenderer::PresentImage(uint32_t SwapChainImage)
-{
-    vk::Result Result{};
-    auto PresentInfo = vk::PresentInfoKHR{}
-            .setImageIndices(SwapChainImage)
-            .setWaitSemaphores(ActiveFrame->DrawFinished)
-            .setSwapchains(SwapChain)
-            .setResults(Result);
+    //every level reads the one above it, the first reads the depth attachment itself
+    std::vector<vk::DescriptorImageInfo> ImageInfos(DepthPyramid.Images.size() * (DepthPyramid.MipLevels * 2 + 1));
+    std::vector<vk::WriteDescriptorSet> Writes{};
 
-    (void)QueueHandles.Present.presentKHR(PresentInfo);
+    uint64_t InfoIndex = 0;
 
-    if(Result == vk::Result::eErrorOutOfDateKHR || Result == vk::Result::eSuboptimalKHR)
+    for(uint32_t Index = 0; Index < DepthPyramid.Images.size(); ++Index)
     {
-        return false;
+        for(uint32_t Mip = 0; Mip < DepthPyramid.MipLevels; ++Mip)
+        {
+            vk::DescriptorImageInfo& OutInfo = ImageInfos[InfoIndex++]
+                    .setImageView(DepthPyramid.MipViews[Index][Mip])
+                    .setImageLayout(vk::ImageLayout::eGeneral)
+                    .setSampler(nullptr);
+
+            vk::DescriptorImageInfo& InInfo = ImageInfos[InfoIndex++]
+                    .setImageView(Mip == 0 ? GBuffer.Depth.ImageView : DepthPyramid.MipViews[Index][Mip - 1])
+                    .setImageLayout(Mip == 0 ? vk::ImageLayout::eDepthReadOnlyOptimal : vk::ImageLayout::eGeneral)
+                    .setSampler(DepthPyramid.Sampler);
+
+            Writes.emplace_back()
+                    .setDstSet(DepthPyramid.ReduceSets[Index][Mip])
+                    .setDstArrayElement(0)
+                    .setDstBinding(0)
+                    .setDescriptorType(vk::DescriptorType::eStorageImage)
+                    .setImageInfo(OutInfo);
+
+            Writes.emplace_back()
+                    .setDstSet(DepthPyramid.ReduceSets[Index][Mip])
+                    .setDstArrayElement(0)
+                    .setDstBinding(1)
+                    .setDescriptorType(vk::DescriptorType::eCombinedImageSampler)
+                    .setImageInfo(InInfo);
+        }
+
+        vk::DescriptorImageInfo& CullInfo = ImageInfos[InfoIndex++]
+                .setImageView(DepthPyramid.Images[Index].ImageView)
+                .setImageLayout(vk::ImageLayout::eGeneral)
+                .setSampler(DepthPyramid.Sampler);
+
+        Writes.emplace_back()
+                .setDstSet(DepthPyramid.MeshCullSets[Index])
+                .setDstArrayElement(0)
+                .setDstBinding(0)
+                .setDescriptorType(vk::DescriptorType::eCombinedImageSampler)
+                .setImageInfo(CullInfo);
+
+        Writes.emplace_back()
+                .setDstSet(DepthPyramid.MeshletCullSets[Index])
+                .setDstArrayElement(0)
+                .setDstBinding(0)
+                .setDescriptorType(vk::DescriptorType::eCombinedImageSampler)
+                .setImageInfo(CullInfo);
     }
-    else if(Result != vk::Result::eSuccess)
+
+    //the other pyramid is the one the early pass of the same frame tested against
+    for(uint32_t Index = 0; Index < DepthPyramid.Images.size(); ++Index)
     {
-        VERIFY(false, vk::to_string(Result));
+        uint64_t OtherCullInfo = (1 - Index) * (DepthPyramid.MipLevels * 2 + 1) + DepthPyramid.MipLevels * 2;
+
+        Writes.emplace_back()
+                .setDstSet(DepthPyramid.MeshletCullSets[Index])
+                .setDstArrayElement(0)
+                .setDstBinding(1)
+                .setDescriptorType(vk::DescriptorType::eCombinedImageSampler)
+                .setImageInfo(ImageInfos[OtherCullInfo]);
     }
 
-    return true;
+    Device.updateDescriptorSets(Writes, {});
 }
 
-void VStarSightRenderer::AdvanceActiveFrame()
+void VStarSightRenderer::DestroyDepthPyramid()
 {
-    if(ActiveFrame == Frames.end() - 1)
-    {
-        ActiveFrame = Frames.begin();
-    }
-    else
+    for(uint32_t Index = 0; Index < DepthPyramid.Images.size(); ++Index)
     {
-        ++ActiveFrame;
+        Device.freeDescriptorSets(TransientDescriptorPool, DepthPyramid.ReduceSets[Index]);
+        Device.freeDescriptorSets(TransientDescriptorPool, DepthPyramid.MeshCullSets[Index]);
+        Device.freeDescriptorSets(TransientDescriptorPool, DepthPyramid.MeshletCullSets[Index]);
+        DepthPyramid.ReduceSets[Index].clear();
+
+        for(vk::ImageView MipView : DepthPyramid.MipViews[Index])
+        {
+            Device.destroyImageView(MipView);
+        }
+        DepthPyramid.MipViews[Index].clear();
+
+        Device.destroyImageView(DepthPyramid.Images[Index].ImageView);
+        Allocator.destroyImage(DepthPyramid.Images[Index].Image, DepthPyramid.Images[Index].Allocation);
     }
-}
 
-std::string_view VStarSightRenderer::GetWindowName() const
-{
-    return GlfwGetWindowUserData(Window)->WindowName;
+    DepthPyramid.bValid = false;
 }
 
-std::pair<uint32_t, uint32_t> VStarSightRenderer::GetWindowExtent()
+void VStarSightRenderer::RecordDepthPyramid(vk::CommandBuffer CommandBuffer)
 {
-    int width; int height;
-    glfwGetFramebufferSize(Window, &width, &height);
-    return {width, height};
-}
+    //the early pass pyramid stays intact so the late pass can repeat its decisions
+    const uint32_t Target = 1 - DepthPyramid.Current;
 
-void VStarSightRenderer::WaitForFrames()
-{
-    std::array<vk::Fence, FRAMES_IN_FLIGHT> FrameFences{};
-    for(uint64_t index = 0; index < FRAMES_IN_FLIGHT; ++index)
+    //the culling pass of the previous frame may still be sampling the previous contents
+    auto Pyramid2Write = vk::ImageMemoryBarrier2{}
+            .setImage(DepthPyramid.Images[Target].Image)
+            .setOldLayout(vk::ImageLayout::eGeneral)
+            .setNewLayout(vk::ImageLayout::eGeneral)
+            .setSrcStageMask(vk::PipelineStageFlagBits2::eComputeShader)
+            .setSrcAccessMask(vk::AccessFlagBits2::eShaderSampledRead)
+            .setDstStageMask(vk::PipelineStageFlagBits2::eComputeShader)
+            .setDstAccessMask(vk::AccessFlagBits2::eShaderStorageWrite)
+            .setSubresourceRange(vk::ImageSubresourceRange{vk::ImageAspectFlagBits::eColor, 0, DepthPyramid.MipLevels, 0, 1});
+
+    //the graph moves depth to a read only layout before this
+    CommandBuffer.pipelineBarrier2(vk::DependencyInfo{}.setImageMemoryBarriers(Pyramid2Write));
+
+    CommandBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, DepthReducePipeline);
+
+    for(uint32_t Mip = 0; Mip < DepthPyramid.MipLevels; ++Mip)
     {
-        FrameFences[index] = Frames[index].InFlight;
+        uint32_t MipWidth = std::max(DepthPyramid.Width >> Mip, 1u);
+        uint32_t MipHeight = std::max(DepthPyramid.Height >> Mip, 1u);
+
+        VShaderDepthReducePC PushConstants{};
+        PushConstants.outImageSize = glm::fvec2{MipWidth, MipHeight};
+
+        CommandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, DepthReduceLayout, 0, 1, &DepthPyramid.ReduceSets[Target][Mip], 0, nullptr);
+        CommandBuffer.pushConstants(DepthReduceLayout, vk::ShaderStageFlagBits::eCompute, 0, sizeof(PushConstants), &PushConstants);
+        CommandBuffer.dispatch(vkutil::GroupCount(MipWidth, 8), vkutil::GroupCount(MipHeight, 8), 1);
+
+        auto MipBarrier = vk::ImageMemoryBarrier2{}
+                .setImage(DepthPyramid.Images[Target].Image)
+                .setOldLayout(vk::ImageLayout::eGeneral)
+                .setNewLayout(vk::ImageLayout::eGeneral)
+                .setSrcStageMask(vk::PipelineStageFlagBits2::eComputeShader)
+                .setSrcAccessMask(vk::AccessFlagBits2::eShaderStorageWrite)
+                .setDstStageMask(vk::PipelineStageFlagBits2::eComputeShader)
+                .setDstAccessMask(vk::AccessFlagBits2::eShaderSampledRead)
+                .setSubresourceRange(vk::ImageSubresourceRange{vk::ImageAspectFlagBits::eColor, Mip, 1, 0, 1});
+
+        CommandBuffer.pipelineBarrier2(vk::DependencyInfo{}.setImageMemoryBarriers(MipBarrier));
     }
 
-    constexpr uint64_t TimeOut = std::nano::den * 10;
-    vkResultCheck = Device.waitForFences(FrameFences, true, TimeOut);
-}
-
-void VStarSightRenderer::DestroyGBuffer()
-{
-    Allocator.destroyImage(GBuffer.Position.Image, GBuffer.Position.Allocation);
-    Device.destroyImageView(GBuffer.Position.ImageView);
-    Allocator.destroyImage(GBuffer.Normal.Image, GBuffer.Normal.Allocation);
-    Device.destroyImageView(GBuffer.Normal.ImageView);
-    Allocator.destroyImage(GBuffer.Color.Image, GBuffer.Color.Allocation);
-    Device.destroyImageView(GBuffer.Color.ImageView);
-    Allocator.destroyImage(GBuffer.Depth.Image, GBuffer.Depth.Allocation);
-    Device.destroyImageView(GBuffer.Depth.ImageView);
+    DepthPyramid.Current = Target;
+    DepthPyramid.bValid = true;
 }
 /*
 void VRenderTarget::DrawDeferred(std::span<ecs::RenderSystem::RenderInfo> RenderInfos)
@@ -1081,7 +2158,7 @@ void VStarSightRenderer::EndGeometryPass(uint32_t SwapChainImag)
     auto SwapChainImage2PresentSrc = vk::ImageMemoryBarrier2{}
             .setImage(Images[SwapChainImag])
             .setOldLayout(vk::ImageLayout::eUndefined)
-            .setNewLayout(vk::ImageLayout::ePresentSrcKHR)
+            .setNewLayout(PresentLayout)
             .setSrcStageMask(PipelineStage::eColorAttachmentOutput)
             .setSrcAccessMask(AccessFlag::eColorAttachmentWrite)
             .setDstStageMask(PipelineStage::eColorAttachmentOutput)
@@ -1100,18 +2177,18 @@ void VStarSightRenderer::SubmitGBufferCommands()
     auto CommandInfo = vk::CommandBufferSubmitInfo{}
             .setCommandBuffer(ActiveFrame->CommandBuffer);
 
-    auto WaitInfo = vk::SemaphoreSubmitInfo{}
-            .setSemaphore(ActiveFrame->ImageAvailable)
-            .setStageMask(PipelineStage::eColorAttachmentOutput);
+    std::vector<vk::SemaphoreSubmitInfo> WaitInfos = MakeWaitSemaphoreInfos(PipelineStage::eColorAttachmentOutput);
 
     auto SignalInfo = vk::SemaphoreSubmitInfo{}
             .setSemaphore(ActiveFrame->DrawFinished)
             .setStageMask(PipelineStage::eColorAttachmentOutput);
 
+    //headless nothing presents, so nothing would wait for it
     auto SubmitInfo = vk::SubmitInfo2{}
             .setCommandBufferInfos(CommandInfo)
-            .setWaitSemaphoreInfos(WaitInfo)
-            .setSignalSemaphoreInfos(SignalInfo);
+            .setWaitSemaphoreInfos(WaitInfos)
+            .setSignalSemaphoreInfoCount(bHeadless ? 0 : 1)
+            .setPSignalSemaphoreInfos(&SignalInfo);
 
     QueueHandles.Graphics.submit2(SubmitInfo, ActiveFrame->InFlight);
 }
@@ -1121,6 +2198,11 @@ uint64_t VStarSightRenderer::ActiveFrameIndex() const
     return std::distance(Frames.data(), static_cast<const VFrame*>(ActiveFrame));
 }
 
+LinearArena& VStarSightRenderer::GetFrameArena()
+{
+    return ActiveFrame->Arena;
+}
+
 void VStarSightRenderer::CreateCameraBuffer()
 {
     LOG_INFO("creating camera buffer");
@@ -1141,8 +2223,9 @@ void VStarSightRenderer::CreateIndirectCommandsBuffer()
 {
     LOG_INFO("creating indirect draw buffer");
 
+    DrawCommandsCapacity = DEVICE_MESH_ALLOCATION_STEP;
     DrawIndirectCommandsBuffer = AllocateBuffer(
-            sizeof(VShaderDrawIndirectCount) + (sizeof(vk::DrawIndexedIndirectCommand) * DEVICE_MESH_ALLOCATION_STEP),
+            sizeof(VShaderDrawIndirectCount) + (sizeof(vk::DrawIndexedIndirectCommand) * DrawCommandsCapacity),
             vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eIndirectBuffer | vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eShaderDeviceAddress,
             vma::AllocationCreateFlagBits::eStrategyBestFit,
             vma::MemoryUsage::eAutoPreferDevice,
@@ -1153,6 +2236,190 @@ void VStarSightRenderer::CreateIndirectCommandsBuffer()
     });
 }
 
+void VStarSightRenderer::CreateClusterBuffers()
+{
+    LOG_INFO("creating light cluster buffer");
+
+    const uint64_t ClusterCount = CLUSTER_GRID_X * CLUSTER_GRID_Y * CLUSTER_GRID_Z;
+
+    ClusterLights = AllocateBuffer(
+            sizeof(uint32_t) * ClusterCount * (1 + CLUSTER_MAX_LIGHTS),
+            vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eShaderDeviceAddress,
+            vma::AllocationCreateFlagBits::eStrategyBestFit,
+            vma::MemoryUsage::eAutoPreferDevice,
+            "light clusters");
+
+    DestructionQueue.emplace_back([this](){
+        Allocator.destroyBuffer(ClusterLights.Buffer, ClusterLights.Allocation);
+    });
+}
+
+void VStarSightRenderer::CreateInstanceBuffers()
+{
+    LOG_INFO("creating instance buffers");
+
+    vk::BufferUsageFlags BufferFlags = vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eShaderDeviceAddress;
+
+    InstanceBucketCapacity = DEVICE_MESH_ALLOCATION_STEP;
+    InstanceBuckets = AllocateBuffer(sizeof(VShaderInstanceBucket) * InstanceBucketCapacity, BufferFlags, vma::AllocationCreateFlagBits::eStrategyBestFit, vma::MemoryUsage::eAutoPreferDevice, "instance buckets");
+
+    InstanceSlotCapacity = DrawCommandsCapacity + SceneCapacity;
+    InstanceSlots = AllocateBuffer(sizeof(uint32_t) * InstanceSlotCapacity, BufferFlags, vma::AllocationCreateFlagBits::eStrategyBestFit, vma::MemoryUsage::eAutoPreferDevice, "instance slots");
+
+    DestructionQueue.emplace_back([this](){
+        Allocator.destroyBuffer(InstanceBuckets.Buffer, InstanceBuckets.Allocation);
+        Allocator.destroyBuffer(InstanceSlots.Buffer, InstanceSlots.Allocation);
+    });
+}
+
+void VStarSightRenderer::CreateMeshletTasksBuffer()
+{
+    LOG_INFO("creating meshlet tasks buffer");
+
+    MeshletTasksCapacity = DEVICE_MESH_ALLOCATION_STEP;
+    MeshletTasksBuffer = AllocateBuffer(
+            sizeof(VShaderMeshletTasksHeader) + (sizeof(VShaderMeshletTask) * MeshletTasksCapacity),
+            vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eIndirectBuffer | vk::BufferUsageFlagBits::eTransferSrc | vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eShaderDeviceAddress,
+            vma::AllocationCreateFlagBits::eStrategyBestFit,
+            vma::MemoryUsage::eAutoPreferDevice,
+            "meshlet tasks buffer");
+
+    DestructionQueue.emplace_back([this](){
+        Allocator.destroyBuffer(MeshletTasksBuffer.Buffer, MeshletTasksBuffer.Allocation);
+    });
+}
+
+void VStarSightRenderer::BuildFrameGraph()
+{
+    FrameImages.SwapChain = FrameGraph.ImportImage("SwapChain", vk::ImageAspectFlagBits::eColor, VImageUse{
+            .Stages = vk::PipelineStageFlagBits2::eComputeShader, //the stage the acquire semaphore is waited on
+            .Access = vk::AccessFlagBits2::eNone,
+            .Layout = vk::ImageLayout::eUndefined
+    });
+
+    FrameGraph.ExportImage(FrameImages.SwapChain, VImageUse{
+            .Stages = vk::PipelineStageFlagBits2::eAllCommands,
+            .Access = vk::AccessFlagBits2::eNone,
+            .Layout = PresentLayout
+    });
+
+    const VImageUse DepthAttachment{
+            .Stages = vk::PipelineStageFlagBits2::eEarlyFragmentTests | vk::PipelineStageFlagBits2::eLateFragmentTests,
+            .Access = vk::AccessFlagBits2::eDepthStencilAttachmentRead | vk::AccessFlagBits2::eDepthStencilAttachmentWrite,
+            .Layout = vk::ImageLayout::eDepthAttachmentOptimal
+    };
+
+    const VImageUse ColorClear{
+            .Stages = vk::PipelineStageFlagBits2::eColorAttachmentOutput,
+            .Access = vk::AccessFlagBits2::eColorAttachmentWrite,
+            .Layout = vk::ImageLayout::eColorAttachmentOptimal
+    };
+
+    const VImageUse ColorLoad{
+            .Stages = vk::PipelineStageFlagBits2::eColorAttachmentOutput,
+            .Access = vk::AccessFlagBits2::eColorAttachmentRead | vk::AccessFlagBits2::eColorAttachmentWrite,
+            .Layout = vk::ImageLayout::eColorAttachmentOptimal
+    };
+
+    const VImageUse ComputeSampled{
+            .Stages = vk::PipelineStageFlagBits2::eComputeShader,
+            .Access = vk::AccessFlagBits2::eShaderSampledRead,
+            .Layout = vk::ImageLayout::eShaderReadOnlyOptimal
+    };
+
+    const VImageUse ComputeDepthSampled{
+            .Stages = vk::PipelineStageFlagBits2::eComputeShader,
+            .Access = vk::AccessFlagBits2::eShaderSampledRead,
+            .Layout = vk::ImageLayout::eDepthReadOnlyOptimal
+    };
+
+    const VImageUse ComputeStorageWrite{
+            .Stages = vk::PipelineStageFlagBits2::eComputeShader,
+            .Access = vk::AccessFlagBits2::eShaderStorageWrite,
+            .Layout = vk::ImageLayout::eGeneral
+    };
+
+    auto UseGeometryAttachments = [&](VRenderGraphPass& Pass, const VImageUse& Color)
+    {
+        Pass.Use(FrameImages.Depth, DepthAttachment);
+
+        if(bVisibilityBuffer)
+        {
+            Pass.Use(FrameImages.Visibility, Color);
+        }
+        else
+        {
+            Pass.Use(FrameImages.Position, Color);
+            Pass.Use(FrameImages.Normal, Color);
+            Pass.Use(FrameImages.Color, Color);
+        }
+    };
+
+    //with async compute the scene updates and the early culling pass run on the compute queue before this
+    if(!bAsyncCompute)
+    {
+        FrameGraph.AddPass("SceneUpdate", 0, [this](vk::CommandBuffer CommandBuffer)
+        {
+            RecordSceneUpdates(CommandBuffer);
+        }).SetSideEffects();
+
+        //early pass, whatever was visible against the last frame's depth
+        FrameGraph.AddPass("Cull", 0, [this](vk::CommandBuffer CommandBuffer)
+        {
+            RecordBuildDrawCommands(CommandBuffer, FrameMeshCount, DepthPyramid.bValid, false);
+        }).SetSideEffects();
+    }
+
+    UseGeometryAttachments(FrameGraph.AddPass("Geometry", 0, [this](vk::CommandBuffer CommandBuffer)
+    {
+        RecordGeometryPass(CommandBuffer, false);
+    }), ColorClear);
+
+    //late pass, re-test what the early pass rejected against the depth it just produced and draw it on top
+    FrameGraph.AddPass("DepthPyramid", 0, [this](vk::CommandBuffer CommandBuffer)
+    {
+        RecordDepthPyramid(CommandBuffer);
+    }).Use(FrameImages.Depth, ComputeDepthSampled).SetSideEffects();
+
+    FrameGraph.AddPass("Cull", 0, [this](vk::CommandBuffer CommandBuffer)
+    {
+        RecordBuildDrawCommands(CommandBuffer, FrameMeshCount, true, true);
+    }).SetSideEffects();
+
+    UseGeometryAttachments(FrameGraph.AddPass("Geometry", 0, [this](vk::CommandBuffer CommandBuffer)
+    {
+        RecordGeometryPass(CommandBuffer, true);
+    }), ColorLoad);
+
+    if(bVisibilityBuffer)
+    {
+        FrameGraph.AddPass("Material", 0, [this](vk::CommandBuffer CommandBuffer)
+        {
+            RecordMaterialPass(CommandBuffer);
+        })
+        .Use(FrameImages.Visibility, ComputeSampled)
+        .Use(FrameImages.Normal, ComputeStorageWrite)
+        .Use(FrameImages.Color, ComputeStorageWrite);
+    }
+
+    FrameGraph.AddPass("ClusterLights", 1, [this](vk::CommandBuffer CommandBuffer)
+    {
+        RecordClusterLights(CommandBuffer);
+    }).SetSideEffects();
+
+    //the lights are placed in view space from the depth
+    FrameGraph.AddPass("Lighting", 1, [this](vk::CommandBuffer CommandBuffer)
+    {
+        RecordLightingPass(CommandBuffer);
+    })
+    .Use(FrameImages.Normal, ComputeSampled)
+    .Use(FrameImages.Color, ComputeSampled)
+    .Use(FrameImages.Depth, ComputeDepthSampled)
+    .Use(FrameImages.SwapChain, ComputeStorageWrite);
+
+    FrameGraph.Compile();
+}
+
 void VStarSightRenderer::DrawDeferred(uint32_t MeshCount)
 {
     uint32_t SwapChainImage = AcquireSwapChainImage();
@@ -1162,114 +2429,153 @@ void VStarSightRenderer::DrawDeferred(uint32_t MeshCount)
         return;
     }
 
-    ActiveFrame->CommandBuffer.begin({vk::CommandBufferUsageFlagBits::eOneTimeSubmit});
+    FrameMeshCount = MeshCount;
+    FrameSwapChainImage = SwapChainImage;
+    FrameGraph.SetImage(FrameImages.SwapChain, Images[SwapChainImage]);
 
-    ActiveFrame->CommandBuffer.fillBuffer(DrawIndirectCommandsBuffer.Buffer, 0, sizeof(uint32_t), 0u);
+    if(bAsyncCompute)
+    {
+        SubmitAsyncCulling(MeshCount);
+    }
 
-    auto ZeroDrawCountBarrier = vk::BufferMemoryBarrier2{}
-            .setBuffer(DrawIndirectCommandsBuffer.Buffer)
-            .setSize(sizeof(uint32_t))
-            .setOffset(0)
-            .setSrcStageMask(vk::PipelineStageFlagBits2::eTransfer)
-            .setSrcAccessMask(vk::AccessFlagBits2::eTransferWrite)
-            .setDstStageMask(vk::PipelineStageFlagBits2::eComputeShader)
-            .setDstAccessMask(vk::AccessFlagBits2::eShaderStorageRead | vk::AccessFlagBits2::eShaderStorageWrite);
+    ActiveFrame->CommandBuffer.begin({vk::CommandBufferUsageFlagBits::eOneTimeSubmit});
+    GpuProfiler.Reset(ActiveFrame->CommandBuffer, ActiveFrame->Queries);
 
-    auto ZeroDrawCount_Dependency = vk::DependencyInfo{}.setBufferMemoryBarriers(ZeroDrawCountBarrier);
-    ActiveFrame->CommandBuffer.pipelineBarrier2(ZeroDrawCount_Dependency);
+    if(bAsyncCompute)
+    {
+        RecordPyramidOwnership(ActiveFrame->CommandBuffer, QueueIndices.Compute, QueueIndices.Graphics, true);
+    }
 
-    VShaderBuildDrawCommandsPC DrawCommandsPushConstants{};
-    DrawCommandsPushConstants.pCamera = CameraBuffer.BufferAddress + (ActiveFrameIndex() * sizeof(VShaderCameraData));
-    DrawCommandsPushConstants.pDrawIndirectCount = DrawIndirectCommandsBuffer.BufferAddress;
-    DrawCommandsPushConstants.pMeshBounds = ActiveFrame->MeshBounds.BufferAddress;
-    DrawCommandsPushConstants.pMeshes = ActiveFrame->MeshInfos.BufferAddress;
-    DrawCommandsPushConstants.pTransforms = ActiveFrame->MeshTransforms.BufferAddress;
-    DrawCommandsPushConstants.meshCount = MeshCount;
+    FrameGraph.Execute(0, ActiveFrame->CommandBuffer, &ActiveFrame->Queries);
 
-    ActiveFrame->CommandBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, BuildDrawCommandsPipeline);
-    ActiveFrame->CommandBuffer.pushConstants(BuildDrawCommandsLayout, vk::ShaderStageFlagBits::eCompute, 0, sizeof(DrawCommandsPushConstants), &DrawCommandsPushConstants);
-    ActiveFrame->CommandBuffer.dispatch(vkutil::GroupCount(MeshCount, 64u), 1u, 1u);
+    //nothing after this reads the scene or culling buffers, so the next frame's culling can start while this one is lit
+    vk::CommandBuffer LightingCommands = ActiveFrame->CommandBuffer;
+    if(bAsyncCompute)
+    {
+        RecordPyramidOwnership(ActiveFrame->CommandBuffer, QueueIndices.Graphics, QueueIndices.Compute, false);
+        ActiveFrame->CommandBuffer.end();
 
-    auto DrawIndirectCommandsBarrier = vk::BufferMemoryBarrier2{}
-            .setBuffer(DrawIndirectCommandsBuffer.Buffer)
-            .setOffset(0)
-            .setSize(VK_WHOLE_SIZE)
-            .setDstStageMask(vk::PipelineStageFlagBits2::eDrawIndirect)
-            .setDstAccessMask(vk::AccessFlagBits2::eIndirectCommandRead)
-            .setSrcStageMask(vk::PipelineStageFlagBits2::eComputeShader)
-            .setSrcAccessMask(vk::AccessFlagBits2::eShaderStorageWrite);
+        LightingCommands = ActiveFrame->LightingCommandBuffer;
+        LightingCommands.begin({vk::CommandBufferUsageFlagBits::eOneTimeSubmit});
+    }
 
-    auto DrawIndirectCommandsBarrier_Dependency = vk::DependencyInfo{}.setBufferMemoryBarriers(DrawIndirectCommandsBarrier);
-    ActiveFrame->CommandBuffer.pipelineBarrier2(DrawIndirectCommandsBarrier_Dependency);
+    //lighting writes the swapchain image directly, so presenting only costs the layout transition at the end
+    FrameGraph.Execute(1, LightingCommands, &ActiveFrame->Queries);
 
-    auto Undefined2ColorAttachmentOptimal = [](vk::Image Image)
+    LightingCommands.end();
+
+    if(bAsyncCompute)
     {
-        return vk::ImageMemoryBarrier2{}
-                .setImage(Image)
-                .setOldLayout(vk::ImageLayout::eUndefined)
-                .setNewLayout(vk::ImageLayout::eColorAttachmentOptimal)
-                .setSrcStageMask(vk::PipelineStageFlagBits2::eColorAttachmentOutput)
-                .setSrcAccessMask(vk::AccessFlagBits2::eColorAttachmentWrite | vk::AccessFlagBits2::eColorAttachmentRead)
-                .setDstStageMask(vk::PipelineStageFlagBits2::eClear | vk::PipelineStageFlagBits2::eColorAttachmentOutput)
-                .setDstAccessMask(vk::AccessFlagBits2::eColorAttachmentWrite)
-                .setSubresourceRange(vk::ImageSubresourceRange{
-                        vk::ImageAspectFlagBits::eColor,
-                        0,
-                        1,
-                        0,
-                        1
-                });
-    };
+        //the geometry batch waits for this frame's culling and signals the point the next frame's culling waits for
+        auto GeometryCommandInfo = vk::CommandBufferSubmitInfo{}
+                .setCommandBuffer(ActiveFrame->CommandBuffer);
+
+        auto CullWaitInfo = vk::SemaphoreSubmitInfo{}
+                .setSemaphore(CullTimeline)
+                .setValue(CullTimelineValue)
+                .setStageMask(PipelineStage::eAllCommands);
+
+        GeometryTimelineValue += 1;
+
+        auto GeometrySignalInfo = vk::SemaphoreSubmitInfo{}
+                .setSemaphore(GeometryTimeline)
+                .setValue(GeometryTimelineValue)
+                .setStageMask(PipelineStage::eAllCommands);
+
+        auto LightingCommandInfo = vk::CommandBufferSubmitInfo{}
+                .setCommandBuffer(LightingCommands);
+
+        auto ImageAvailableInfo = vk::SemaphoreSubmitInfo{}
+                .setSemaphore(ActiveFrame->ImageAvailable)
+                .setStageMask(PipelineStage::eComputeShader);
+
+        auto DrawFinishedInfo = vk::SemaphoreSubmitInfo{}
+                .setSemaphore(ActiveFrame->DrawFinished)
+                .setStageMask(PipelineStage::eComputeShader);
+
+        std::array<vk::SubmitInfo2, 2> SubmitInfos{};
+        SubmitInfos[0]
+                .setCommandBufferInfos(GeometryCommandInfo)
+                .setWaitSemaphoreInfos(CullWaitInfo)
+                .setSignalSemaphoreInfos(GeometrySignalInfo);
+
+        SubmitInfos[1]
+                .setCommandBufferInfos(LightingCommandInfo)
+                .setWaitSemaphoreInfoCount(bHeadless ? 0 : 1)
+                .setPWaitSemaphoreInfos(&ImageAvailableInfo)
+                .setSignalSemaphoreInfoCount(bHeadless ? 0 : 1)
+                .setPSignalSemaphoreInfos(&DrawFinishedInfo);
+
+        QueueHandles.Graphics.submit2(SubmitInfos, ActiveFrame->InFlight);
+    }
+    else
+    {
+        auto CommandInfo = vk::CommandBufferSubmitInfo{}
+                .setCommandBuffer(ActiveFrame->CommandBuffer);
 
-    std::array<vk::ImageMemoryBarrier2, 4> GBufferBarriers{};
-    GBufferBarriers[0] = Undefined2ColorAttachmentOptimal(GBuffer.Position.Image);
-    GBufferBarriers[1] = Undefined2ColorAttachmentOptimal(GBuffer.Normal.Image);
-    GBufferBarriers[2] = Undefined2ColorAttachmentOptimal(GBuffer.Color.Image);
-    GBufferBarriers[3]
-            .setImage(GBuffer.Depth.Image)
-            .setOldLayout(vk::ImageLayout::eUndefined)
-            .setNewLayout(vk::ImageLayout::eDepthAttachmentOptimal)
-            .setSrcStageMask(vk::PipelineStageFlagBits2::eEarlyFragmentTests | vk::PipelineStageFlagBits2::eLateFragmentTests)
-            .setSrcAccessMask(vk::AccessFlagBits2::eDepthStencilAttachmentRead | vk::AccessFlagBits2::eDepthStencilAttachmentWrite)
-            .setDstStageMask(vk::PipelineStageFlagBits2::eClear | vk::PipelineStageFlagBits2::eEarlyFragmentTests | vk::PipelineStageFlagBits2::eLateFragmentTests)
-            .setDstAccessMask(vk::AccessFlagBits2::eDepthStencilAttachmentRead | vk::AccessFlagBits2::eDepthStencilAttachmentWrite)
-            .setSubresourceRange(vk::ImageSubresourceRange{
-                    vk::ImageAspectFlagBits::eDepth,
-                    0,
-                    1,
-                    0,
-                    1
-            });
+        std::vector<vk::SemaphoreSubmitInfo> WaitInfos = MakeWaitSemaphoreInfos(PipelineStage::eComputeShader);
+
+        auto SignalInfo = vk::SemaphoreSubmitInfo{}
+                .setSemaphore(ActiveFrame->DrawFinished)
+                .setStageMask(PipelineStage::eComputeShader);
+
+        auto SubmitInfo = vk::SubmitInfo2{}
+                .setCommandBufferInfos(CommandInfo)
+                .setWaitSemaphoreInfos(WaitInfos)
+                .setSignalSemaphoreInfoCount(bHeadless ? 0 : 1)
+                .setPSignalSemaphoreInfos(&SignalInfo);
+
+        QueueHandles.Graphics.submit2(SubmitInfo, ActiveFrame->InFlight);
+    }
+
+    if(!PresentImage(SwapChainImage))
+    {
+        RecreateSwapChain();
+    }
+    else
+    {
+        AdvanceActiveFrame();
+    }
+}
+
+void VStarSightRenderer::RecordGeometryPass(vk::CommandBuffer CommandBuffer, bool bLatePass)
+{
+    //the early pass clears, the late pass draws on top of it
+    vk::AttachmentLoadOp LoadOp = bLatePass ? vk::AttachmentLoadOp::eLoad : vk::AttachmentLoadOp::eClear;
+
+    //the visibility buffer rasterizes into a single attachment
+    uint32_t ColorAttachmentCount = bVisibilityBuffer ? 1 : 3;
 
     vk::ClearValue ColorClearValue{vk::ClearColorValue{0, 0, 0, 0}};
+    vk::ClearValue VisibilityClearValue{vk::ClearColorValue{UINT32_MAX, UINT32_MAX, 0u, 0u}};
     vk::ClearValue DepthClearVale{vk::ClearDepthStencilValue{0.0, 0}};
 
     std::array<vk::RenderingAttachmentInfo, 3> ColorAttachments{};
     ColorAttachments[0]
-            .setImageView(GBuffer.Position.ImageView)
+            .setImageView(bVisibilityBuffer ? GBuffer.Visibility.ImageView : GBuffer.Position.ImageView)
             .setImageLayout(vk::ImageLayout::eColorAttachmentOptimal)
-            .setLoadOp(vk::AttachmentLoadOp::eClear)
+            .setLoadOp(LoadOp)
             .setStoreOp(vk::AttachmentStoreOp::eStore)
-            .setClearValue(ColorClearValue);
+            .setClearValue(bVisibilityBuffer ? VisibilityClearValue : ColorClearValue);
 
     ColorAttachments[1]
             .setImageView(GBuffer.Normal.ImageView)
             .setImageLayout(vk::ImageLayout::eColorAttachmentOptimal)
-            .setLoadOp(vk::AttachmentLoadOp::eClear)
+            .setLoadOp(LoadOp)
             .setStoreOp(vk::AttachmentStoreOp::eStore)
             .setClearValue(ColorClearValue);
 
     ColorAttachments[2]
             .setImageView(GBuffer.Color.ImageView)
             .setImageLayout(vk::ImageLayout::eColorAttachmentOptimal)
-            .setLoadOp(vk::AttachmentLoadOp::eClear)
+            .setLoadOp(LoadOp)
             .setStoreOp(vk::AttachmentStoreOp::eStore)
             .setClearValue(ColorClearValue);
 
     auto DepthAttachment = vk::RenderingAttachmentInfo{}
             .setImageView(GBuffer.Depth.ImageView)
             .setImageLayout(vk::ImageLayout::eDepthAttachmentOptimal)
-            .setLoadOp(vk::AttachmentLoadOp::eClear)
+            .setLoadOp(LoadOp)
             .setStoreOp(vk::AttachmentStoreOp::eStore)
             .setClearValue(DepthClearVale);
 
@@ -1279,7 +2585,8 @@ void VStarSightRenderer::DrawDeferred(uint32_t MeshCount)
     };
 
     auto RenderingInfo = vk::RenderingInfo{}
-            .setColorAttachments(ColorAttachments)
+            .setColorAttachmentCount(ColorAttachmentCount)
+            .setPColorAttachments(ColorAttachments.data())
             .setPDepthAttachment(&DepthAttachment)
             .setRenderArea(RenderArea)
             .setLayerCount(1)
@@ -1294,25 +2601,46 @@ void VStarSightRenderer::DrawDeferred(uint32_t MeshCount)
             1.0
     };
 
-    ActiveFrame->CommandBuffer.pipelineBarrier2(vk::DependencyInfo{}.setImageMemoryBarriers(GBufferBarriers));
-    ActiveFrame->CommandBuffer.beginRendering(RenderingInfo);
-    ActiveFrame->CommandBuffer.setViewport(0, Viewport);
-    ActiveFrame->CommandBuffer.setScissor(0, RenderArea);
+    CommandBuffer.beginRendering(RenderingInfo);
+    CommandBuffer.setViewport(0, Viewport);
+    CommandBuffer.setScissor(0, RenderArea);
 
     VShaderForwardDrawPC GeometryPushConstants{};
     GeometryPushConstants.pCamera = CameraBuffer.BufferAddress + (ActiveFrameIndex() * sizeof(VShaderCameraData));
-    GeometryPushConstants.pMesh = ActiveFrame->MeshInfos.BufferAddress;
-    GeometryPushConstants.pTransform = ActiveFrame->MeshTransforms.BufferAddress;
+    GeometryPushConstants.pMesh = SceneMeshInfos.BufferAddress;
+    GeometryPushConstants.pTransform = SceneTransforms.BufferAddress;
     GeometryPushConstants.pVertexBuffer = GlobalVertexBuffer.BufferAddress;
+    GeometryPushConstants.pInstances = InstanceSlots.BufferAddress;
 
-    ActiveFrame->CommandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, GeometryPipeline);
-    ActiveFrame->CommandBuffer.pushConstants(GeometryPipelineLayout, vk::ShaderStageFlagBits::eVertex, 0, sizeof(GeometryPushConstants), &GeometryPushConstants);
-    ActiveFrame->CommandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, GeometryPipelineLayout, 0, 1, &ShaderResourceSet, 0, nullptr);
-    ActiveFrame->CommandBuffer.bindIndexBuffer(GlobalIndexBuffer.Buffer, 0, vk::IndexType::eUint32);
-    ActiveFrame->CommandBuffer.drawIndexedIndirectCount(DrawIndirectCommandsBuffer.Buffer, sizeof(VShaderDrawIndirectCount), DrawIndirectCommandsBuffer.Buffer, 0, MeshCount, sizeof(vk::DrawIndexedIndirectCommand));
+    if(bVisibilityBuffer)
+    {
+        VShaderVisibilityDrawPC VisibilityPushConstants{};
+        VisibilityPushConstants.pCamera = GeometryPushConstants.pCamera;
+        VisibilityPushConstants.pMesh = GeometryPushConstants.pMesh;
+        VisibilityPushConstants.pTransform = GeometryPushConstants.pTransform;
+        VisibilityPushConstants.pVertexBuffer = GeometryPushConstants.pVertexBuffer;
+        VisibilityPushConstants.pInstances = GeometryPushConstants.pInstances;
+        VisibilityPushConstants.pDrawCommands = DrawIndirectCommandsBuffer.BufferAddress + sizeof(VShaderDrawIndirectCount);
+
+        CommandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, VisibilityPipeline);
+        CommandBuffer.pushConstants(VisibilityPipelineLayout, vk::ShaderStageFlagBits::eVertex, 0, sizeof(VisibilityPushConstants), &VisibilityPushConstants);
+        CommandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, VisibilityPipelineLayout, 0, 1, &ShaderResourceSet, 0, nullptr);
+    }
+    else
+    {
+        CommandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, GeometryPipeline);
+        CommandBuffer.pushConstants(GeometryPipelineLayout, vk::ShaderStageFlagBits::eVertex, 0, sizeof(GeometryPushConstants), &GeometryPushConstants);
+        CommandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, GeometryPipelineLayout, 0, 1, &ShaderResourceSet, 0, nullptr);
+    }
 
-    ActiveFrame->CommandBuffer.endRendering();
+    CommandBuffer.bindIndexBuffer(GlobalIndexBuffer.Buffer, 0, vk::IndexType::eUint32);
+    CommandBuffer.drawIndexedIndirectCount(DrawIndirectCommandsBuffer.Buffer, sizeof(VShaderDrawIndirectCount), DrawIndirectCommandsBuffer.Buffer, 0, DrawCommandsCapacity, sizeof(vk::DrawIndexedIndirectCommand));
+
+    CommandBuffer.endRendering();
+}
 
+void VStarSightRenderer::RecordLightingPass(vk::CommandBuffer CommandBuffer)
+{
     VDescriptorLayoutCache::layout_info_t GlobalLightDescriptorLayoutInfo{};
 
     GlobalLightDescriptorLayoutInfo.flags.emplace_back();
@@ -1336,6 +2664,13 @@ void VStarSightRenderer::DrawDeferred(uint32_t MeshCount)
             .setDescriptorType(vk::DescriptorType::eStorageImage)
             .setStageFlags(vk::ShaderStageFlagBits::eCompute);
 
+    GlobalLightDescriptorLayoutInfo.flags.emplace_back();
+    GlobalLightDescriptorLayoutInfo.bindings.emplace_back()
+            .setBinding(3)
+            .setDescriptorCount(1)
+            .setDescriptorType(vk::DescriptorType::eCombinedImageSampler)
+            .setStageFlags(vk::ShaderStageFlagBits::eCompute);
+
     vk::DescriptorSetLayout GlobalLightDescriptorLayout = DescriptorLayoutCache->create_layout(GlobalLightDescriptorLayoutInfo);
 
     auto GlobalLightDescriptorAllocateInfo = vk::DescriptorSetAllocateInfo{}
@@ -1362,7 +2697,7 @@ void VStarSightRenderer::DrawDeferred(uint32_t MeshCount)
 
     vk::Sampler GBufferSampler = Device.createSampler(GBufferSamplerInfo);
 
-    std::array<vk::DescriptorImageInfo, 3> DescriptorImageInfos{};
+    std::array<vk::DescriptorImageInfo, 4> DescriptorImageInfos{};
     DescriptorImageInfos[0]
             .setImageView(GBuffer.Normal.ImageView)
             .setImageLayout(vk::ImageLayout::eShaderReadOnlyOptimal)
@@ -1374,11 +2709,16 @@ void VStarSightRenderer::DrawDeferred(uint32_t MeshCount)
             .setSampler(GBufferSampler);
 
     DescriptorImageInfos[2]
-            .setImageView(ImageViews[SwapChainImage])
+            .setImageView(ImageViews[FrameSwapChainImage])
             .setImageLayout(vk::ImageLayout::eGeneral)
             .setSampler(nullptr);
 
-    std::array<vk::WriteDescriptorSet, 3> DescriptorSetWrites{};
+    DescriptorImageInfos[3]
+            .setImageView(GBuffer.Depth.ImageView)
+            .setImageLayout(vk::ImageLayout::eDepthReadOnlyOptimal)
+            .setSampler(GBufferSampler);
+
+    std::array<vk::WriteDescriptorSet, 4> DescriptorSetWrites{};
     DescriptorSetWrites[0]
             .setDstSet(GlobalLightDescriptorSet)
             .setDstArrayElement(0)
@@ -1400,6 +2740,13 @@ void VStarSightRenderer::DrawDeferred(uint32_t MeshCount)
             .setDescriptorType(vk::DescriptorType::eStorageImage)
             .setImageInfo(DescriptorImageInfos[2]);
 
+    DescriptorSetWrites[3]
+            .setDstSet(GlobalLightDescriptorSet)
+            .setDstArrayElement(0)
+            .setDstBinding(3)
+            .setDescriptorType(vk::DescriptorType::eCombinedImageSampler)
+            .setImageInfo(DescriptorImageInfos[3]);
+
     Device.updateDescriptorSets(DescriptorSetWrites, {});
 
     DeferredDestructionQueue.enqueue([this, GlobalLightDescriptorSet, GBufferSampler](){
@@ -1407,95 +2754,284 @@ void VStarSightRenderer::DrawDeferred(uint32_t MeshCount)
         Device.destroySampler(GBufferSampler);
     });
 
-    std::array<vk::ImageMemoryBarrier2, 3> GlobalLightImageBarriers{};
-    GlobalLightImageBarriers[0]
-            .setSrcStageMask(vk::PipelineStageFlagBits2::eColorAttachmentOutput)
-            .setSrcAccessMask(vk::AccessFlagBits2::eColorAttachmentWrite)
-            .setDstStageMask(vk::PipelineStageFlagBits2::eComputeShader)
-            .setDstAccessMask(vk::AccessFlagBits2::eShaderSampledRead)
-            .setOldLayout(vk::ImageLayout::eColorAttachmentOptimal)
-            .setNewLayout(vk::ImageLayout::eReadOnlyOptimalKHR)
-            .setSubresourceRange(vkutil::flat_subresource_range(vk::ImageAspectFlagBits::eColor))
-            .setImage(GBuffer.Normal.Image);
+    VGlobalLightPC GlobalLightPushConstants{};
+    GlobalLightPushConstants.pCamera = CameraBuffer.BufferAddress + (ActiveFrameIndex() * sizeof(VShaderCameraData));
+    GlobalLightPushConstants.pLights = ActiveFrame->Lights.BufferAddress;
+    GlobalLightPushConstants.pClusters = ClusterLights.BufferAddress;
+    GlobalLightPushConstants.lightCount = ActiveFrame->LightCount;
+    GlobalLightPushConstants.clusterGrid = glm::uvec3{CLUSTER_GRID_X, CLUSTER_GRID_Y, CLUSTER_GRID_Z};
+    GlobalLightPushConstants.maxClusterLights = CLUSTER_MAX_LIGHTS;
+    GlobalLightPushConstants.lightDirection = axis::down;
+    GlobalLightPushConstants.lightColor = glm::fvec3{1.0, 1.0, 1.0};
+    GlobalLightPushConstants.lightStrength = 8.f;
 
-    GlobalLightImageBarriers[1]
-            .setSrcStageMask(vk::PipelineStageFlagBits2::eColorAttachmentOutput)
-            .setSrcAccessMask(vk::AccessFlagBits2::eColorAttachmentWrite)
-            .setDstStageMask(vk::PipelineStageFlagBits2::eComputeShader)
-            .setDstAccessMask(vk::AccessFlagBits2::eShaderSampledRead)
-            .setOldLayout(vk::ImageLayout::eColorAttachmentOptimal)
-            .setNewLayout(vk::ImageLayout::eReadOnlyOptimalKHR)
-            .setSubresourceRange(vkutil::flat_subresource_range(vk::ImageAspectFlagBits::eColor))
-            .setImage(GBuffer.Color.Image);
+    CommandBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, GlobalLightPipeline);
+    CommandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, GlobalLightPipelineLayout, 0, 1, &GlobalLightDescriptorSet, 0, nullptr);
+    CommandBuffer.pushConstants(GlobalLightPipelineLayout, vk::ShaderStageFlagBits::eCompute, 0, sizeof(GlobalLightPushConstants), &GlobalLightPushConstants);
+    CommandBuffer.dispatch(vkutil::GroupCount(ImageExtent.width, 8), vkutil::GroupCount(ImageExtent.height, 8), 1);
+}
 
-    GlobalLightImageBarriers[2]
-            .setSrcStageMask(vk::PipelineStageFlagBits2::eNone)
-            .setSrcAccessMask(vk::AccessFlagBits2::eNone)
-            .setDstStageMask(vk::PipelineStageFlagBits2::eComputeShader)
-            .setDstAccessMask(vk::AccessFlagBits2::eShaderStorageWrite)
-            .setOldLayout(vk::ImageLayout::eUndefined)
-            .setNewLayout(vk::ImageLayout::eGeneral)
-            .setSubresourceRange(vkutil::flat_subresource_range(vk::ImageAspectFlagBits::eColor))
-            .setImage(Images[SwapChainImage]);
+void VStarSightRenderer::SubmitAsyncCulling(uint32_t MeshCount)
+{
+    vk::CommandBuffer CommandBuffer = ActiveFrame->ComputeCommandBuffer;
 
-    auto GlobalLightDependencyInfo = vk::DependencyInfo{}
-    .setImageMemoryBarriers(GlobalLightImageBarriers);
+    CommandBuffer.begin({vk::CommandBufferUsageFlagBits::eOneTimeSubmit});
+    GpuProfiler.Reset(CommandBuffer, ActiveFrame->ComputeQueries);
 
-    ActiveFrame->CommandBuffer.pipelineBarrier2(GlobalLightDependencyInfo);
+    //a pyramid that is not valid yet is created from undefined by the culling pass, there is nothing to acquire
+    if(DepthPyramid.bValid)
+    {
+        RecordPyramidOwnership(CommandBuffer, QueueIndices.Graphics, QueueIndices.Compute, true);
+    }
 
-    VGlobalLightPC GlobalLightPushConstants{};
-    GlobalLightPushConstants.lightDirection = axis::down;
-    GlobalLightPushConstants.lightColor = glm::fvec3{1.0, 1.0, 1.0};
-    GlobalLightPushConstants.lightStrength = 8.f;
+    GpuProfiler.BeginScope(CommandBuffer, ActiveFrame->ComputeQueries, "SceneUpdate");
+    RecordSceneUpdates(CommandBuffer);
+    GpuProfiler.EndScope(CommandBuffer, ActiveFrame->ComputeQueries);
 
-    ActiveFrame->CommandBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, GlobalLightPipeline);
-    ActiveFrame->CommandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, GlobalLightPipelineLayout, 0, 1, &GlobalLightDescriptorSet, 0, nullptr);
-    ActiveFrame->CommandBuffer.pushConstants(GlobalLightPipelineLayout, vk::ShaderStageFlagBits::eCompute, 0, sizeof(GlobalLightPushConstants), &GlobalLightPushConstants);
-    ActiveFrame->CommandBuffer.dispatch(vkutil::GroupCount(ImageExtent.width, 8), vkutil::GroupCount(ImageExtent.height, 8), 1);
+    //early pass, whatever was visible against the last frame's depth
+    GpuProfiler.BeginScope(CommandBuffer, ActiveFrame->ComputeQueries, "Cull");
+    RecordBuildDrawCommands(CommandBuffer, MeshCount, DepthPyramid.bValid, false);
+    GpuProfiler.EndScope(CommandBuffer, ActiveFrame->ComputeQueries);
 
-    auto SwapChainImage2PresentSrc = vk::ImageMemoryBarrier2{}
-            .setSrcStageMask(vk::PipelineStageFlagBits2::eComputeShader)
-            .setSrcAccessMask(vk::AccessFlagBits2::eShaderStorageWrite)
-            .setDstStageMask(vk::PipelineStageFlagBits2::eAllCommands)
-            .setDstAccessMask(vk::AccessFlagBits2::eNone)
-            .setOldLayout(vk::ImageLayout::eGeneral)
-            .setNewLayout(vk::ImageLayout::ePresentSrcKHR)
-            .setSubresourceRange(vkutil::flat_subresource_range(vk::ImageAspectFlagBits::eColor))
-            .setImage(Images[SwapChainImage]);
+    RecordPyramidOwnership(CommandBuffer, QueueIndices.Compute, QueueIndices.Graphics, false);
 
-    auto SwapChainImage2PresentSrc_Dependency = vk::DependencyInfo{}
-            .setImageMemoryBarriers(SwapChainImage2PresentSrc);
+    CommandBuffer.end();
 
-    ActiveFrame->CommandBuffer.pipelineBarrier2(SwapChainImage2PresentSrc_Dependency);
+    std::vector<vk::SemaphoreSubmitInfo> WaitInfos{};
 
-    ActiveFrame->CommandBuffer.end();
+    //the previous frame's geometry and material passes read the buffers this overwrites
+    WaitInfos.emplace_back(vk::SemaphoreSubmitInfo{}
+            .setSemaphore(GeometryTimeline)
+            .setValue(GeometryTimelineValue)
+            .setStageMask(PipelineStage::eAllCommands));
 
-    auto CommandInfo = vk::CommandBufferSubmitInfo{}
-            .setCommandBuffer(ActiveFrame->CommandBuffer);
+    //the geometry copies and the culling read the global geometry buffers first in the frame
+    if(uint64_t TransferValue = Uploader->TakeDeviceWaitValue(); TransferValue != 0)
+    {
+        WaitInfos.emplace_back(vk::SemaphoreSubmitInfo{}
+                .setSemaphore(Uploader->GetTimeline())
+                .setValue(TransferValue)
+                .setStageMask(PipelineStage::eAllCommands));
+    }
 
-    auto WaitInfo = vk::SemaphoreSubmitInfo{}
-            .setSemaphore(ActiveFrame->ImageAvailable)
-            .setStageMask(PipelineStage::eComputeShader);
+    CullTimelineValue += 1;
 
     auto SignalInfo = vk::SemaphoreSubmitInfo{}
-            .setSemaphore(ActiveFrame->DrawFinished)
-            .setStageMask(PipelineStage::eComputeShader);
+            .setSemaphore(CullTimeline)
+            .setValue(CullTimelineValue)
+            .setStageMask(PipelineStage::eAllCommands);
+
+    auto CommandInfo = vk::CommandBufferSubmitInfo{}
+            .setCommandBuffer(CommandBuffer);
 
     auto SubmitInfo = vk::SubmitInfo2{}
             .setCommandBufferInfos(CommandInfo)
-            .setWaitSemaphoreInfos(WaitInfo)
+            .setWaitSemaphoreInfos(WaitInfos)
             .setSignalSemaphoreInfos(SignalInfo);
 
-    QueueHandles.Graphics.submit2(SubmitInfo, ActiveFrame->InFlight);
+    //the frame fence covers this too, the graphics batches it signals wait for it
+    QueueHandles.Compute.submit2(SubmitInfo);
+}
 
-    if(!PresentImage(SwapChainImage))
+void VStarSightRenderer::RecordPyramidOwnership(vk::CommandBuffer CommandBuffer, uint32_t SrcFamily, uint32_t DstFamily, bool bAcquire)
+{
+    //the pyramids are exclusive images, the release recorded on the source queue has to be matched by an identical acquire on the destination queue
+    std::array<vk::ImageMemoryBarrier2, 2> OwnershipBarriers{};
+    for(uint32_t Index = 0; Index < OwnershipBarriers.size(); ++Index)
     {
-        RecreateSwapChain();
+        OwnershipBarriers[Index] = vk::ImageMemoryBarrier2{}
+                .setImage(DepthPyramid.Images[Index].Image)
+                .setOldLayout(vk::ImageLayout::eGeneral)
+                .setNewLayout(vk::ImageLayout::eGeneral)
+                .setSrcQueueFamilyIndex(SrcFamily)
+                .setDstQueueFamilyIndex(DstFamily)
+                .setSrcStageMask(bAcquire ? vk::PipelineStageFlagBits2::eNone : vk::PipelineStageFlagBits2::eComputeShader)
+                .setSrcAccessMask(bAcquire ? vk::AccessFlagBits2::eNone : vk::AccessFlagBits2::eShaderStorageWrite)
+                .setDstStageMask(bAcquire ? vk::PipelineStageFlagBits2::eComputeShader : vk::PipelineStageFlagBits2::eNone)
+                .setDstAccessMask(bAcquire ? vk::AccessFlagBits2::eShaderSampledRead | vk::AccessFlagBits2::eShaderStorageWrite : vk::AccessFlagBits2::eNone)
+                .setSubresourceRange(vk::ImageSubresourceRange{vk::ImageAspectFlagBits::eColor, 0, DepthPyramid.MipLevels, 0, 1});
     }
-    else
+
+    CommandBuffer.pipelineBarrier2(vk::DependencyInfo{}.setImageMemoryBarriers(OwnershipBarriers));
+}
+
+vk::PipelineStageFlags2 VStarSightRenderer::VertexStages(vk::CommandBuffer CommandBuffer) const
+{
+    //the compute queue has no vertex stage, the timeline semaphores order it against the graphics queue instead
+    if(CommandBuffer == ActiveFrame->ComputeCommandBuffer)
     {
-        AdvanceActiveFrame();
+        return vk::PipelineStageFlags2{};
+    }
+
+    return vk::PipelineStageFlagBits2::eVertexShader;
+}
+
+void VStarSightRenderer::UpdateLights(std::vector<VShaderLight>&& Lights)
+{
+    std::lock_guard Guard{LightMx};
+    SceneLights = std::move(Lights);
+}
+
+void VStarSightRenderer::RecordClusterLights(vk::CommandBuffer CommandBuffer)
+{
+    {
+        std::lock_guard Guard{LightMx};
+
+        ActiveFrame->LightCount = SceneLights.size();
+
+        uint64_t LightsSize = sizeof(VShaderLight) * SceneLights.size();
+        if(LightsSize > ActiveFrame->Lights.Size) [[unlikely]]
+        {
+            ReallocateBuffer(&ActiveFrame->Lights, sizeof(VShaderLight) * math::PadSize2Alignment(SceneLights.size(), DEVICE_MESH_ALLOCATION_STEP));
+        }
+
+        if(LightsSize != 0)
+        {
+            memcpy(ActiveFrame->Lights.MappedData, SceneLights.data(), LightsSize);
+            Allocator.flushAllocation(ActiveFrame->Lights.Allocation, 0, LightsSize);
+        }
     }
+
+    //the previous frame's lighting pass may still be reading the lists
+    auto ReuseBarrier = vk::MemoryBarrier2{}
+            .setSrcStageMask(vk::PipelineStageFlagBits2::eComputeShader)
+            .setSrcAccessMask(vk::AccessFlagBits2::eNone)
+            .setDstStageMask(vk::PipelineStageFlagBits2::eComputeShader)
+            .setDstAccessMask(vk::AccessFlagBits2::eShaderStorageWrite);
+
+    CommandBuffer.pipelineBarrier2(vk::DependencyInfo{}.setMemoryBarriers(ReuseBarrier));
+
+    VShaderClusterLightsPC PushConstants{};
+    PushConstants.pCamera = CameraBuffer.BufferAddress + (ActiveFrameIndex() * sizeof(VShaderCameraData));
+    PushConstants.pLights = ActiveFrame->Lights.BufferAddress;
+    PushConstants.pClusters = ClusterLights.BufferAddress;
+    PushConstants.lightCount = ActiveFrame->LightCount;
+    PushConstants.clusterGrid = glm::uvec3{CLUSTER_GRID_X, CLUSTER_GRID_Y, CLUSTER_GRID_Z};
+    PushConstants.maxClusterLights = CLUSTER_MAX_LIGHTS;
+
+    CommandBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, ClusterLightsPipeline);
+    CommandBuffer.pushConstants(ClusterLightsLayout, vk::ShaderStageFlagBits::eCompute, 0, sizeof(PushConstants), &PushConstants);
+    CommandBuffer.dispatch(vkutil::GroupCount(CLUSTER_GRID_X * CLUSTER_GRID_Y * CLUSTER_GRID_Z, 64), 1, 1);
+
+    auto ClusterBarrier = vk::MemoryBarrier2{}
+            .setSrcStageMask(vk::PipelineStageFlagBits2::eComputeShader)
+            .setSrcAccessMask(vk::AccessFlagBits2::eShaderStorageWrite)
+            .setDstStageMask(vk::PipelineStageFlagBits2::eComputeShader)
+            .setDstAccessMask(vk::AccessFlagBits2::eShaderStorageRead);
+
+    CommandBuffer.pipelineBarrier2(vk::DependencyInfo{}.setMemoryBarriers(ClusterBarrier));
+}
+
+void VStarSightRenderer::RecordMaterialPass(vk::CommandBuffer CommandBuffer)
+{
+    VDescriptorLayoutCache::layout_info_t MaterialDescriptorLayoutInfo{};
+
+    MaterialDescriptorLayoutInfo.flags.emplace_back();
+    MaterialDescriptorLayoutInfo.bindings.emplace_back()
+            .setBinding(0)
+            .setDescriptorCount(1)
+            .setDescriptorType(vk::DescriptorType::eCombinedImageSampler)
+            .setStageFlags(vk::ShaderStageFlagBits::eCompute);
+
+    MaterialDescriptorLayoutInfo.flags.emplace_back();
+    MaterialDescriptorLayoutInfo.bindings.emplace_back()
+            .setBinding(1)
+            .setDescriptorCount(1)
+            .setDescriptorType(vk::DescriptorType::eStorageImage)
+            .setStageFlags(vk::ShaderStageFlagBits::eCompute);
+
+    MaterialDescriptorLayoutInfo.flags.emplace_back();
+    MaterialDescriptorLayoutInfo.bindings.emplace_back()
+            .setBinding(2)
+            .setDescriptorCount(1)
+            .setDescriptorType(vk::DescriptorType::eStorageImage)
+            .setStageFlags(vk::ShaderStageFlagBits::eCompute);
+
+    vk::DescriptorSetLayout MaterialDescriptorLayout = DescriptorLayoutCache->create_layout(MaterialDescriptorLayoutInfo);
+
+    auto MaterialDescriptorAllocateInfo = vk::DescriptorSetAllocateInfo{}
+            .setDescriptorPool(TransientDescriptorPool)
+            .setDescriptorSetCount(1)
+            .setSetLayouts(MaterialDescriptorLayout);
+
+    vk::DescriptorSet MaterialDescriptorSet = nullptr;
+    vkResultCheck = Device.allocateDescriptorSets(&MaterialDescriptorAllocateInfo, &MaterialDescriptorSet);
+
+    //integer ids are only ever fetched
+    auto VisibilitySamplerInfo = vk::SamplerCreateInfo{}
+            .setAddressModeU(vk::SamplerAddressMode::eClampToEdge)
+            .setAddressModeV(vk::SamplerAddressMode::eClampToEdge)
+            .setAddressModeW(vk::SamplerAddressMode::eClampToEdge)
+            .setAnisotropyEnable(false)
+            .setMaxAnisotropy(0)
+            .setUnnormalizedCoordinates(true)
+            .setCompareEnable(false)
+            .setMipmapMode(vk::SamplerMipmapMode::eNearest)
+            .setMinFilter(vk::Filter::eNearest)
+            .setMagFilter(vk::Filter::eNearest)
+            .setMinLod(0.f)
+            .setMaxLod(0.f);
+
+    vk::Sampler VisibilitySampler = Device.createSampler(VisibilitySamplerInfo);
+
+    std::array<vk::DescriptorImageInfo, 3> DescriptorImageInfos{};
+    DescriptorImageInfos[0]
+            .setImageView(GBuffer.Visibility.ImageView)
+            .setImageLayout(vk::ImageLayout::eShaderReadOnlyOptimal)
+            .setSampler(VisibilitySampler);
+
+    DescriptorImageInfos[1]
+            .setImageView(GBuffer.Normal.ImageView)
+            .setImageLayout(vk::ImageLayout::eGeneral)
+            .setSampler(nullptr);
+
+    DescriptorImageInfos[2]
+            .setImageView(GBuffer.ColorStorageView)
+            .setImageLayout(vk::ImageLayout::eGeneral)
+            .setSampler(nullptr);
+
+    std::array<vk::WriteDescriptorSet, 3> DescriptorSetWrites{};
+    DescriptorSetWrites[0]
+            .setDstSet(MaterialDescriptorSet)
+            .setDstArrayElement(0)
+            .setDstBinding(0)
+            .setDescriptorType(vk::DescriptorType::eCombinedImageSampler)
+            .setImageInfo(DescriptorImageInfos[0]);
+
+    DescriptorSetWrites[1]
+            .setDstSet(MaterialDescriptorSet)
+            .setDstArrayElement(0)
+            .setDstBinding(1)
+            .setDescriptorType(vk::DescriptorType::eStorageImage)
+            .setImageInfo(DescriptorImageInfos[1]);
+
+    DescriptorSetWrites[2]
+            .setDstSet(MaterialDescriptorSet)
+            .setDstArrayElement(0)
+            .setDstBinding(2)
+            .setDescriptorType(vk::DescriptorType::eStorageImage)
+            .setImageInfo(DescriptorImageInfos[2]);
+
+    Device.updateDescriptorSets(DescriptorSetWrites, {});
+
+    DeferredDestructionQueue.enqueue([this, MaterialDescriptorSet, VisibilitySampler](){
+        Device.freeDescriptorSets(TransientDescriptorPool, MaterialDescriptorSet);
+        Device.destroySampler(VisibilitySampler);
+    });
+
+    VShaderMaterialPC MaterialPushConstants{};
+    MaterialPushConstants.pCamera = CameraBuffer.BufferAddress + (ActiveFrameIndex() * sizeof(VShaderCameraData));
+    MaterialPushConstants.pMesh = SceneMeshInfos.BufferAddress;
+    MaterialPushConstants.pTransform = SceneTransforms.BufferAddress;
+    MaterialPushConstants.pVertexBuffer = GlobalVertexBuffer.BufferAddress;
+    MaterialPushConstants.pIndexBuffer = GlobalIndexBuffer.BufferAddress;
+
+    std::array MaterialDescriptorSets{ShaderResourceSet, MaterialDescriptorSet};
+
+    CommandBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, MaterialPipeline);
+    CommandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, MaterialPipelineLayout, 0, MaterialDescriptorSets, {});
+    CommandBuffer.pushConstants(MaterialPipelineLayout, vk::ShaderStageFlagBits::eCompute, 0, sizeof(MaterialPushConstants), &MaterialPushConstants);
+    CommandBuffer.dispatch(vkutil::GroupCount(ImageExtent.width, 8), vkutil::GroupCount(ImageExtent.height, 8), 1);
 }
 
 void VStarSightRenderer::CreateGeometryPipeline()
@@ -1564,22 +3100,112 @@ void VStarSightRenderer::CreateGeometryPipeline()
 
     Builder.Build(&GeometryPipelineLayout, &GeometryPipeline, "Geometry Pipeline");
 
+    std::lock_guard Guard{DestructionMx};
     DestructionQueue.emplace_back([this](){
         Device.destroyPipeline(GeometryPipeline);
     });
 }
 
+void VStarSightRenderer::CreateVisibilityPipeline()
+{
+    VGraphicsPipelineBuilder Builder = MakeGraphicsPipelineBuilder();
+
+    Builder.IncludeShader(ProjectAbsolutePath("shaders/visibility.vert"));
+    Builder.IncludeShader(ProjectAbsolutePath("shaders/visibility.frag"));
+
+    std::array DynamicStates{vk::DynamicState::eViewport, vk::DynamicState::eScissor};
+
+    Builder.dynamic_state
+            .setDynamicStates(DynamicStates);
+
+    Builder.viewport
+         .setViewportCount(1)
+         .setScissorCount(1);
+
+    Builder.rendering
+            .setColorAttachmentFormats(GBuffer.VisibilityFormat)
+            .setDepthAttachmentFormat(GBuffer.DepthFormat);
+
+    Builder.input_assembly
+            .setPrimitiveRestartEnable(false)
+            .setTopology(vk::PrimitiveTopology::eTriangleList);
+
+    Builder.rasterization
+            .setFrontFace(vk::FrontFace::eCounterClockwise)
+            .setCullMode(vk::CullModeFlagBits::eBack)
+            .setPolygonMode(vk::PolygonMode::eFill)
+            .setRasterizerDiscardEnable(false)
+            .setDepthClampEnable(false)
+            .setDepthBiasEnable(false)
+            .setLineWidth(1.0);
+
+    Builder.multisample
+    .setSampleShadingEnable(false);
+
+    constexpr vk::ColorComponentFlags IdComponents = vk::ColorComponentFlagBits::eR | vk::ColorComponentFlagBits::eG;
+    std::array ColorBlendAttachments{
+        vk::PipelineColorBlendAttachmentState{}
+                .setBlendEnable(false)
+                .setColorWriteMask(IdComponents),
+    };
+
+    Builder.color_blend
+    .setLogicOpEnable(false)
+    .setAttachments(ColorBlendAttachments);
+
+    Builder.depth_stencil
+            .setDepthTestEnable(true)
+            .setDepthWriteEnable(true)
+            .setDepthCompareOp(vk::CompareOp::eGreater)
+            .setDepthBoundsTestEnable(true)
+            .setMinDepthBounds(0.0)
+            .setMaxDepthBounds(1.0)
+            .setStencilTestEnable(false);
+
+    Builder.Build(&VisibilityPipelineLayout, &VisibilityPipeline, "Visibility Pipeline");
+
+    std::lock_guard Guard{DestructionMx};
+    DestructionQueue.emplace_back([this](){
+        Device.destroyPipeline(VisibilityPipeline);
+    });
+}
+
+void VStarSightRenderer::CreateMaterialPipeline()
+{
+    VComputePipelineBuilder Builder = MakeComputePipelineBuilder();
+    Builder.IncludeShader(ProjectAbsolutePath("shaders/material.comp"));
+    Builder.Build(&MaterialPipelineLayout, &MaterialPipeline, "Material Pipeline");
+
+    std::lock_guard Guard{DestructionMx};
+    DestructionQueue.emplace_back([this]{
+        Device.destroyPipeline(MaterialPipeline);
+    });
+}
+
 void VStarSightRenderer::CreateGlobalLightPipeline()
 {
     VComputePipelineBuilder Builder = MakeComputePipelineBuilder();
     Builder.IncludeShader(ProjectAbsolutePath("shaders/global_light.comp"));
     Builder.Build(&GlobalLightPipelineLayout, &GlobalLightPipeline, "Global Light Pipeline");
 
+    std::lock_guard Guard{DestructionMx};
     DestructionQueue.emplace_back([this]{
         Device.destroyPipeline(GlobalLightPipeline);
     });
 }
 
+void VStarSightRenderer::CreateClusterLightsPipeline()
+{
+    VComputePipelineBuilder Builder = MakeComputePipelineBuilder();
+    Builder.IncludeShader(ProjectAbsolutePath("shaders/cluster_lights.comp"));
+    Builder.Build(&ClusterLightsLayout, &ClusterLightsPipeline, "Cluster Lights Pipeline");
+
+    std::lock_guard Guard{DestructionMx};
+    DestructionQueue.emplace_back([this]{
+        Device.destroyPipeline(ClusterLightsPipeline);
+    });
+}
+
 
 /*
 void VRenderTarget::EndGeometryPass(uint32_t SwapChainImage)
@@ -3,10 +3,14 @@
 #include "core/assertion.hpp"
 #include "core/log.hpp"
 #include "core/filesystem.hpp"
+#include "core/derived_data_cache.hpp"
 #include "libshaderc_util/file_finder.h"
 #include "shaderc/glslc/src/file_includer.h"
 #include "vk_context.hpp"
 
+#include <algorithm>
+#include <cstring>
+
 namespace
 {
     vk::ShaderStageFlagBits ShaderName2ShaderStage(const std::fpath& ShaderName)
@@ -84,6 +88,121 @@ namespace
     }
 }
 
+//cached payload, the header is followed by the push constants, the bindings and the spirv
+struct CachedShaderHeader
+{
+    uint32_t Stage;
+    uint32_t PushConstantCount;
+    uint32_t BindingCount;
+    uint32_t CodeSize;
+};
+
+static_assert(sizeof(CachedShaderHeader) % alignof(uint32_t) == 0 && sizeof(VShaderBinding) % alignof(uint32_t) == 0);
+
+static void ReflectShader(VShader* Shader, const uint32_t* Code, uint64_t CodeSize)
+{
+    SpvReflectShaderModule ReflectionModule{};
+    spvResultCheck = spvReflectCreateShaderModule2(SPV_REFLECT_MODULE_FLAG_NO_COPY, CodeSize, Code, &ReflectionModule);
+
+    Shader->Stage = static_cast<vk::ShaderStageFlagBits>(ReflectionModule.shader_stage);
+
+    uint32_t PushConstantBlocksCount = 0;
+    spvResultCheck = spvReflectEnumeratePushConstantBlocks(&ReflectionModule, &PushConstantBlocksCount, nullptr);
+
+    std::vector<SpvReflectBlockVariable*> PushConstantBlocks(PushConstantBlocksCount);
+    spvResultCheck = spvReflectEnumeratePushConstantBlocks(&ReflectionModule, &PushConstantBlocksCount, PushConstantBlocks.data());
+
+    for(SpvReflectBlockVariable* ReflectedPC : PushConstantBlocks)
+    {
+        Shader->PushConstants.emplace_back(ReflectedPC->offset, ReflectedPC->size);
+    }
+
+    uint32_t DescriptorSetCount = 0;
+    spvResultCheck = spvReflectEnumerateDescriptorSets(&ReflectionModule, &DescriptorSetCount, nullptr);
+
+    std::vector<SpvReflectDescriptorSet*> DescriptorSets(DescriptorSetCount);
+    spvResultCheck = spvReflectEnumerateDescriptorSets(&ReflectionModule, &DescriptorSetCount, DescriptorSets.data());
+
+    for(SpvReflectDescriptorSet* ReflectedDS : DescriptorSets)
+    {
+        for(uint32_t binding_idx = 0; binding_idx < ReflectedDS->binding_count; ++binding_idx)
+        {
+            const SpvReflectDescriptorBinding* ReflectedBinding = ReflectedDS->bindings[binding_idx];
+
+            Shader->Bindings.emplace_back(VShaderBinding{
+                .Set = ReflectedDS->set,
+                .Binding = ReflectedBinding->binding,
+                .DescriptorType = static_cast<uint32_t>(ReflectedBinding->descriptor_type),
+                .Count = ReflectedBinding->count,
+                .ArrayDimsCount = ReflectedBinding->array.dims_count,
+                .ArrayDim = ReflectedBinding->array.dims_count != 0 ? ReflectedBinding->array.dims[0] : 0
+            });
+        }
+    }
+
+    spvReflectDestroyShaderModule(&ReflectionModule);
+}
+
+static std::vector<uint8_t> SerializeShader(const VShader& Shader, const uint32_t* Code, uint64_t CodeSize)
+{
+    CachedShaderHeader Header{};
+    Header.Stage = static_cast<uint32_t>(Shader.Stage);
+    Header.PushConstantCount = Shader.PushConstants.size();
+    Header.BindingCount = Shader.Bindings.size();
+    Header.CodeSize = CodeSize;
+
+    uint64_t PushConstantsSize = Shader.PushConstants.size() * sizeof(VShaderPushConstant);
+    uint64_t BindingsSize = Shader.Bindings.size() * sizeof(VShaderBinding);
+
+    std::vector<uint8_t> Payload(sizeof(Header) + PushConstantsSize + BindingsSize + CodeSize);
+    uint8_t* Cursor = Payload.data();
+
+    memcpy(Cursor, &Header, sizeof(Header));
+    Cursor += sizeof(Header);
+    memcpy(Cursor, Shader.PushConstants.data(), PushConstantsSize);
+    Cursor += PushConstantsSize;
+    memcpy(Cursor, Shader.Bindings.data(), BindingsSize);
+    Cursor += BindingsSize;
+    memcpy(Cursor, Code, CodeSize);
+
+    return Payload;
+}
+
+//fills the reflection from a cached payload and points at its spirv, false when the payload does not add up
+static bool ParseShader(VShader* Shader, std::span<const uint8_t> Payload, const uint32_t** Code, uint64_t* CodeSize)
+{
+    if(Payload.size() < sizeof(CachedShaderHeader))
+    {
+        return false;
+    }
+
+    CachedShaderHeader Header;
+    memcpy(&Header, Payload.data(), sizeof(Header));
+
+    uint64_t PushConstantsSize = uint64_t{Header.PushConstantCount} * sizeof(VShaderPushConstant);
+    uint64_t BindingsSize = uint64_t{Header.BindingCount} * sizeof(VShaderBinding);
+
+    if(Payload.size() != sizeof(Header) + PushConstantsSize + BindingsSize + Header.CodeSize || Header.CodeSize % sizeof(uint32_t) != 0)
+    {
+        return false;
+    }
+
+    const uint8_t* Cursor = Payload.data() + sizeof(Header);
+
+    Shader->Stage = static_cast<vk::ShaderStageFlagBits>(Header.Stage);
+    Shader->PushConstants.resize(Header.PushConstantCount);
+    memcpy(Shader->PushConstants.data(), Cursor, PushConstantsSize);
+    Cursor += PushConstantsSize;
+    Shader->Bindings.resize(Header.BindingCount);
+    memcpy(Shader->Bindings.data(), Cursor, BindingsSize);
+    Cursor += BindingsSize;
+
+    *Code = reinterpret_cast<const uint32_t*>(Cursor);
+    *CodeSize = Header.CodeSize;
+
+    return true;
+}
+
 SpvResultCheck& SpvResultCheck::operator=(SpvReflectResult Result_)
 {
     VERIFY(Result_ == SPV_REFLECT_RESULT_SUCCESS, SpvReflectResult2String(Result_));
@@ -91,19 +210,20 @@ SpvResultCheck& SpvResultCheck::operator=(SpvReflectResult Result_)
     return *this;
 }
 
-std::future<VShader*> VShaderCache::CreateShader(const std::fpath& Path)
+std::shared_future<VShader*> VShaderCache::CreateShader(const std::fpath& Path)
 {
-    auto[it, inserted] = Shaders.emplace(Path, VShader{});
-    if(!inserted)
+    auto Promise = std::make_shared<std::promise<VShader*>>();
+
+    //the future is in place before the entry is visible, so a builder racing for the same shader waits on the same compile
+    auto[it, inserted] = Shaders.emplace(Path, VShader{.Compiled = Promise->get_future().share()});
+    if(inserted)
     {
-        std::promise<VShader*> Promise{};
-        Promise.set_value(&it->second);
-        return Promise.get_future();
+        global::Scheduler.Submit(JobPriority::Background, [=, this](){
+            Promise->set_value(CreateShader_Impl(&it->second, Path, false));
+        }, &CompileJobs);
     }
 
-    return TaskExecutor.async([=, this](){
-        return CreateShader_Impl(&it->second, Path, false);
-    });
+    return it->second.Compiled;
 }
 
 bool VShaderCache::DestroyShader(const std::fpath& Path)
@@ -114,7 +234,6 @@ bool VShaderCache::DestroyShader(const std::fpath& Path)
         LOG_INFO("destroying shader {}", Found->first);
 
         Context->Device.destroyShaderModule(Found->second.ShaderModule);
-        spvReflectDestroyShaderModule(&Found->second.ReflectionModule);
 
         Shaders.unsafe_erase(Found);
         return true;
@@ -132,6 +251,7 @@ VShader* VShaderCache::CreateShader_Impl(VShader* Shader, std::fpath Path, bool
     std::vector<uint8_t> SourceData = ReadFileBinary(Path.c_str());
 
     shaderc::CompilationResult<uint32_t> CompileResult{};
+    std::shared_ptr<const DerivedData> Cached{};
     uint64_t CompiledSize;
     const uint32_t* CompiledData;
 
@@ -139,11 +259,11 @@ VShader* VShaderCache::CreateShader_Impl(VShader* Shader, std::fpath Path, bool
     {
         CompiledSize = SourceData.size();
         CompiledData = reinterpret_cast<const uint32_t*>(SourceData.data());
+
+        ReflectShader(Shader, CompiledData, CompiledSize);
     }
     else
     {
-        LOG_INFO("compiling {}", Path);
-
         shaderc_shader_kind ShaderKind = ShaderName2ShaderKind(Path);
 
         shaderc::CompileOptions CompileOptions{};
@@ -154,27 +274,72 @@ VShader* VShaderCache::CreateShader_Impl(VShader* Shader, std::fpath Path, bool
         CompileOptions.SetPreserveBindings(true);
 
         shaderc_util::FileFinder FileFinder{};
-        CompileOptions.SetIncluder(std::make_unique<glslc::FileIncluder>(&FileFinder));
+        auto Includer = std::make_unique<glslc::FileIncluder>(&FileFinder);
+        const glslc::FileIncluder* IncludeTrace = Includer.get();
+        CompileOptions.SetIncluder(std::move(Includer));
 
 #ifndef NDEBUG
         CompileOptions.SetGenerateDebugInfo();
 #endif
 
-        CompileResult = shaderc::Compiler().CompileGlslToSpv((char*)SourceData.data(), SourceData.size(), ShaderKind, Path.c_str(), "main", CompileOptions);
-        VERIFY(CompileResult.GetCompilationStatus() == shaderc_compilation_status_success, CompileResult.GetErrorMessage());
+        //the preprocessed source has every include expanded and every disabled branch dropped, so it is all the compiler sees
+        //a fraction of the cost of a compile, which is what a hit saves
+        shaderc::PreprocessedSourceCompilationResult PreprocessResult = shaderc::Compiler().PreprocessGlsl((char*)SourceData.data(), SourceData.size(), ShaderKind, Path.c_str(), CompileOptions);
+        VERIFY(PreprocessResult.GetCompilationStatus() == shaderc_compilation_status_success, PreprocessResult.GetErrorMessage());
+
+        //every option set above is part of the key, the path too since the #line directives carry it
+        DerivedDataKey Key{"spirv", SHADER_DDC_VERSION};
+        Key.Append(PreprocessResult.begin(), std::distance(PreprocessResult.begin(), PreprocessResult.end()));
+        Key.Append(Path.string());
+        Key.Append(ShaderKind);
+        Key.Append(uint32_t{VK_API_VERSION_1_3});
+        Key.Append(shaderc_spirv_version_1_6);
+        Key.Append(shaderc_optimization_level_performance);
+#ifndef NDEBUG
+        //debug info embeds the original text of the shader and of everything it includes, comments included
+        Key.Append(true);
+        Key.Append(SourceData);
+
+        std::vector<std::string> IncludedFiles(IncludeTrace->file_path_trace().begin(), IncludeTrace->file_path_trace().end());
+        std::ranges::sort(IncludedFiles);
 
-        if(CompileResult.GetNumWarnings() > 0)
+        for(const std::string& IncludedFile : IncludedFiles)
         {
-            LOG_WARNING("{}", CompileResult.GetErrorMessage());
+            Key.Append(IncludedFile);
+            Key.Append(ReadFileBinary(IncludedFile.c_str()));
         }
+#endif
 
-        CompiledSize = std::distance(CompileResult.begin(), CompileResult.end()) * sizeof(uint32_t);
-        CompiledData = CompileResult.begin();
-    }
+        Cached = GetDerivedDataCache()->Find(Key);
+
+        if(Cached && ParseShader(Shader, Cached->Payload(), &CompiledData, &CompiledSize))
+        {
+            LOG_INFO("using cached spirv and reflection data for {}", Path);
+        }
+        else
+        {
+            LOG_INFO("compiling {}", Path);
+
+            CompileResult = shaderc::Compiler().CompileGlslToSpv((char*)SourceData.data(), SourceData.size(), ShaderKind, Path.c_str(), "main", CompileOptions);
+            VERIFY(CompileResult.GetCompilationStatus() == shaderc_compilation_status_success, CompileResult.GetErrorMessage());
+
+            if(CompileResult.GetNumWarnings() > 0)
+            {
+                LOG_WARNING("{}", CompileResult.GetErrorMessage());
+            }
+
+            CompiledSize = std::distance(CompileResult.begin(), CompileResult.end()) * sizeof(uint32_t);
+            CompiledData = CompileResult.begin();
 
-    LOG_INFO("building reflection data for {}", Path);
+            LOG_INFO("building reflection data for {}", Path);
 
-    spvResultCheck = spvReflectCreateShaderModule2(0, CompiledSize, CompiledData, &Shader->ReflectionModule);
+            Shader->PushConstants.clear();
+            Shader->Bindings.clear();
+            ReflectShader(Shader, CompiledData, CompiledSize);
+
+            GetDerivedDataCache()->Store(Key, SerializeShader(*Shader, CompiledData, CompiledSize));
+        }
+    }
 
     auto ModuleInfo = vk::ShaderModuleCreateInfo{}
             .setPCode(CompiledData)
@@ -192,7 +357,7 @@ VShaderCache::VShaderCache(VContext* Context_)
 
 VShaderCache::~VShaderCache()
 {
-    TaskExecutor.wait_for_all();
+    global::Scheduler.Wait(CompileJobs, JobPriority::FrameCritical); //the compiles are left to the workers
 
     LOG_INFO("destroying shader cache");
 
@@ -201,7 +366,6 @@ VShaderCache::~VShaderCache()
         LOG_INFO("destroying shader {}", Pair.first);
 
         Context->Device.destroyShaderModule(Pair.second.ShaderModule);
-        spvReflectDestroyShaderModule(&Pair.second.ReflectionModule);
     }
 }
 
@@ -0,0 +1,423 @@
+#include "vk_upload.hpp"
+#include "vk_context.hpp"
+#include "core/assertion.hpp"
+#include "core/log.hpp"
+#include "core/math.hpp"
+#include <thread>
+
+void VStagingBlock::CopyToBuffer(const VAllocatedBuffer* DstBuffer, uint64_t SrcOffset, uint64_t DstOffset, uint64_t CopySize)
+{
+    ASSERT(SrcOffset + CopySize <= Size);
+
+    BufferUploads.emplace_back(VBufferUpload{
+        .SrcBuffer = Buffer,
+        .DstBuffer = DstBuffer,
+        .Region = vk::BufferCopy2{}
+                .setSrcOffset(BufferOffset + SrcOffset)
+                .setDstOffset(DstOffset)
+                .setSize(CopySize)
+    });
+}
+
+void VStagingBlock::CopyToImage(vk::Image DstImage, const vk::ImageSubresourceRange& SubresourceRange, VImageRegions Regions)
+{
+    for(vk::BufferImageCopy2& Region : Regions)
+    {
+        Region.bufferOffset += BufferOffset;
+    }
+
+    ImageUploads.emplace_back(VImageUpload{
+        .SrcBuffer = Buffer,
+        .DstImage = DstImage,
+        .SubresourceRange = SubresourceRange,
+        .Regions = std::move(Regions)
+    });
+}
+
+VUploadManager::VUploadManager(VContext* Context_)
+{
+    LOG_INFO("creating upload manager");
+    Context = Context_;
+
+    RingBuffer = Context->AllocateBuffer(
+            STAGING_RING_SIZE,
+            vk::BufferUsageFlagBits::eTransferSrc,
+            vma::AllocationCreateFlagBits::eMapped | vma::AllocationCreateFlagBits::eHostAccessSequentialWrite | vma::AllocationCreateFlagBits::eStrategyBestFit,
+            vma::MemoryUsage::eAutoPreferHost,
+            "staging ring buffer");
+
+    auto TimelineInfo = vk::SemaphoreTypeCreateInfo{}
+            .setSemaphoreType(vk::SemaphoreType::eTimeline)
+            .setInitialValue(0);
+
+    auto SemaphoreInfo = vk::SemaphoreCreateInfo{}
+            .setPNext(&TimelineInfo);
+
+    vkResultCheck = Context->Device.createSemaphore(&SemaphoreInfo, nullptr, &TransferTimeline);
+    Context->NameObject(TransferTimeline, "transfer timeline");
+
+    auto CommandPoolInfo = vk::CommandPoolCreateInfo{}
+            .setQueueFamilyIndex(Context->QueueIndices.Transfer)
+            .setFlags(vk::CommandPoolCreateFlagBits::eTransient | vk::CommandPoolCreateFlagBits::eResetCommandBuffer);
+
+    CommandPool = Context->Device.createCommandPool(CommandPoolInfo);
+    Context->NameObject(CommandPool, "upload command pool");
+}
+
+VUploadManager::~VUploadManager()
+{
+    LOG_INFO("destroying upload manager");
+
+    WaitIdle();
+
+    {
+        std::lock_guard Guard{RingMx};
+        Reclaim_Locked();
+        VERIFY(Ranges.empty(), ASSERTION::NONFATAL, "staging ranges were never committed", Ranges.size());
+    }
+
+    Context->Device.destroyCommandPool(CommandPool);
+    Context->Device.destroySemaphore(TransferTimeline);
+    Context->Allocator.destroyBuffer(RingBuffer.Buffer, RingBuffer.Allocation);
+}
+
+VUploadManager::VThreadRecording* VUploadManager::GetThreadRecording()
+{
+    static thread_local VUploadManager* Owner = nullptr;
+    static thread_local VThreadRecording* Recording = nullptr;
+
+    if(Owner != this) [[unlikely]]
+    {
+        std::lock_guard Guard{ThreadRecordingsMx};
+
+        Owner = this;
+        Recording = ThreadRecordings.emplace_back(std::make_unique<VThreadRecording>()).get();
+    }
+
+    return Recording;
+}
+
+void VUploadManager::Reclaim_Locked()
+{
+    uint64_t CompletedValue;
+    vkResultCheck = Context->Device.getSemaphoreCounterValue(TransferTimeline, &CompletedValue);
+
+    while(!Ranges.empty())
+    {
+        VStagingRange& Front = Ranges.front();
+        uint64_t Value = Front.Value.load(std::memory_order_acquire);
+
+        if(Value == VStagingRange::Open || Value == VStagingRange::Committed || Value > CompletedValue)
+        {
+            break;
+        }
+
+        if(Front.Dedicated.Buffer)
+        {
+            Context->Allocator.destroyBuffer(Front.Dedicated.Buffer, Front.Dedicated.Allocation);
+        }
+
+        Ranges.pop_front();
+    }
+}
+
+VStagingRange* VUploadManager::TryReserve_Locked(uint64_t Size)
+{
+    uint64_t Tail = Ranges.empty() ? RingHead : Ranges.front().Begin;
+
+    uint64_t Begin = math::PadSize2Alignment(RingHead, STAGING_RING_ALIGNMENT);
+    uint64_t PhysicalBegin = Begin % STAGING_RING_SIZE;
+
+    if(PhysicalBegin + Size > STAGING_RING_SIZE) //blocks never wrap around, skip to the start of the ring
+    {
+        Begin += STAGING_RING_SIZE - PhysicalBegin;
+    }
+
+    if(Begin + Size - Tail > STAGING_RING_SIZE)
+    {
+        return nullptr;
+    }
+
+    RingHead = Begin + Size;
+
+    VStagingRange& Range = Ranges.emplace_back();
+    Range.Begin = Begin;
+    Range.End = Begin + Size;
+    return &Range;
+}
+
+VStagingBlock VUploadManager::Reserve(uint64_t Size, const std::string& Name)
+{
+    VStagingBlock Block{};
+    Block.Size = Size;
+
+    if(Size > STAGING_RING_SIZE / 2) [[unlikely]]
+    {
+        LOG_WARNING("upload {} of {} bytes does not fit the staging ring", Name, Size);
+
+        VAllocatedBuffer Dedicated = Context->AllocateBuffer(
+                Size,
+                vk::BufferUsageFlagBits::eTransferSrc,
+                vma::AllocationCreateFlagBits::eMapped | vma::AllocationCreateFlagBits::eHostAccessSequentialWrite | vma::AllocationCreateFlagBits::eStrategyFirstFit,
+                vma::MemoryUsage::eAutoPreferHost,
+                fmt::format("{} staging buffer", Name));
+
+        std::lock_guard Guard{RingMx};
+
+        VStagingRange& Range = Ranges.emplace_back();
+        Range.Begin = RingHead;
+        Range.End = RingHead;
+        Range.Dedicated = Dedicated;
+
+        Block.Range = &Range;
+        Block.Buffer = Dedicated.Buffer;
+        Block.BufferOffset = 0;
+        Block.MappedData = Dedicated.MappedData;
+        return Block;
+    }
+
+    while(true)
+    {
+        uint64_t WaitValue = 0;
+
+        {
+            std::lock_guard Guard{RingMx};
+            Reclaim_Locked();
+
+            if(VStagingRange* Range = TryReserve_Locked(Size))
+            {
+                Block.Range = Range;
+                Block.Buffer = RingBuffer.Buffer;
+                Block.BufferOffset = Range->Begin % STAGING_RING_SIZE;
+                Block.MappedData = static_cast<uint8_t*>(RingBuffer.MappedData) + Block.BufferOffset;
+                return Block;
+            }
+
+            WaitValue = Ranges.front().Value.load(std::memory_order_acquire);
+        }
+
+        //the oldest range is still being written by another loader
+        if(WaitValue == VStagingRange::Open)
+        {
+            std::this_thread::yield();
+        }
+        //the per tick flush may only come once the loaders are done, so submit the committed ranges from here
+        else if(WaitValue == VStagingRange::Committed)
+        {
+            Flush();
+        }
+        else
+        {
+            Wait(WaitValue);
+        }
+    }
+}
+
+uint64_t VUploadManager::Commit(VStagingBlock&& Block)
+{
+    ASSERT(Block.Range != nullptr);
+
+    vma::Allocation Allocation = Block.Range->Dedicated.Buffer ? Block.Range->Dedicated.Allocation : RingBuffer.Allocation;
+    Context->Allocator.flushAllocation(Allocation, Block.BufferOffset, Block.Size);
+
+    VThreadRecording* Recording = GetThreadRecording();
+    uint64_t Ticket;
+
+    {
+        std::lock_guard Guard{Recording->RecordingMx};
+
+        Recording->BufferUploads.insert(Recording->BufferUploads.end(), Block.BufferUploads.begin(), Block.BufferUploads.end());
+        std::move(Block.ImageUploads.begin(), Block.ImageUploads.end(), std::back_inserter(Recording->ImageUploads));
+        Recording->Ranges.emplace_back(Block.Range);
+
+        Block.Range->Value.store(VStagingRange::Committed, std::memory_order_release);
+
+        //read while the recording is locked, a concurrent flush has already advanced the value before collecting this thread
+        Ticket = NextValue.load(std::memory_order_acquire);
+    }
+
+    PendingCommits.fetch_add(1, std::memory_order_release);
+
+    Block = VStagingBlock{};
+    return Ticket;
+}
+
+vk::CommandBuffer VUploadManager::GrabCommandBuffer()
+{
+    if(!InFlightCommands.empty() && IsComplete(InFlightCommands.front().Value))
+    {
+        vk::CommandBuffer CommandBuffer = InFlightCommands.front().CommandBuffer;
+        InFlightCommands.pop_front();
+
+        CommandBuffer.reset();
+        return CommandBuffer;
+    }
+
+    auto CommandBufferAllocateInfo = vk::CommandBufferAllocateInfo{}
+            .setCommandPool(CommandPool)
+            .setLevel(vk::CommandBufferLevel::ePrimary)
+            .setCommandBufferCount(1);
+
+    vk::CommandBuffer CommandBuffer = nullptr;
+    vkResultCheck = Context->Device.allocateCommandBuffers(&CommandBufferAllocateInfo, &CommandBuffer);
+    Context->NameObject(CommandBuffer, "upload command buffer");
+
+    return CommandBuffer;
+}
+
+void VUploadManager::Flush()
+{
+    std::lock_guard FlushGuard{FlushMx};
+
+    if(PendingCommits.exchange(0, std::memory_order_acq_rel) == 0)
+    {
+        return;
+    }
+
+    //advanced before collecting so every ticket handed out from now on belongs to a later batch
+    const uint64_t Value = NextValue.fetch_add(1, std::memory_order_acq_rel);
+
+    std::vector<VBufferUpload> BufferUploads{};
+    std::vector<VImageUpload> ImageUploads{};
+    std::vector<VStagingRange*> SubmittedRanges{};
+
+    {
+        std::lock_guard Guard{ThreadRecordingsMx};
+
+        for(std::unique_ptr<VThreadRecording>& Recording : ThreadRecordings)
+        {
+            std::lock_guard RecordingGuard{Recording->RecordingMx};
+
+            BufferUploads.insert(BufferUploads.end(), Recording->BufferUploads.begin(), Recording->BufferUploads.end());
+            std::move(Recording->ImageUploads.begin(), Recording->ImageUploads.end(), std::back_inserter(ImageUploads));
+            SubmittedRanges.insert(SubmittedRanges.end(), Recording->Ranges.begin(), Recording->Ranges.end());
+
+            Recording->BufferUploads.clear();
+            Recording->ImageUploads.clear();
+            Recording->Ranges.clear();
+        }
+    }
+
+    vk::CommandBuffer CommandBuffer = GrabCommandBuffer();
+    CommandBuffer.begin(vk::CommandBufferBeginInfo{}.setFlags(vk::CommandBufferUsageFlagBits::eOneTimeSubmit));
+
+    vkutil::push_label(CommandBuffer, fmt::format("upload batch {}", Value));
+
+    //every collected upload already owns its slot, so growing now covers all of them
+    if(Context->GrowGeometryBuffers(CommandBuffer))
+    {
+        DeviceWaitValue.store(Value, std::memory_order_release);
+    }
+
+    std::vector<vk::ImageMemoryBarrier2> ImageBarriers(ImageUploads.size());
+    for(uint64_t index = 0; index < ImageUploads.size(); ++index)
+    {
+        ImageBarriers[index]
+                .setImage(ImageUploads[index].DstImage)
+                .setOldLayout(vk::ImageLayout::eUndefined)
+                .setNewLayout(vk::ImageLayout::eTransferDstOptimal)
+                .setSrcStageMask(vk::PipelineStageFlagBits2::eNone)
+                .setSrcAccessMask(vk::AccessFlagBits2::eNone)
+                .setDstStageMask(vk::PipelineStageFlagBits2::eTransfer)
+                .setDstAccessMask(vk::AccessFlagBits2::eTransferWrite)
+                .setSubresourceRange(ImageUploads[index].SubresourceRange);
+    }
+
+    if(!ImageBarriers.empty())
+    {
+        CommandBuffer.pipelineBarrier2(vk::DependencyInfo{}.setImageMemoryBarriers(ImageBarriers));
+    }
+
+    for(const VBufferUpload& Upload : BufferUploads)
+    {
+        auto CopyBufferInfo = vk::CopyBufferInfo2{}
+                .setSrcBuffer(Upload.SrcBuffer)
+                .setDstBuffer(Upload.DstBuffer->Buffer)
+                .setRegions(Upload.Region);
+
+        CommandBuffer.copyBuffer2(CopyBufferInfo);
+    }
+
+    for(const VImageUpload& Upload : ImageUploads)
+    {
+        auto CopyBuffer2ImageInfo = vk::CopyBufferToImageInfo2{}
+                .setSrcBuffer(Upload.SrcBuffer)
+                .setDstImage(Upload.DstImage)
+                .setDstImageLayout(vk::ImageLayout::eTransferDstOptimal)
+                .setRegions(Upload.Regions);
+
+        CommandBuffer.copyBufferToImage2(CopyBuffer2ImageInfo);
+    }
+
+    for(vk::ImageMemoryBarrier2& Barrier : ImageBarriers)
+    {
+        Barrier
+                .setOldLayout(vk::ImageLayout::eTransferDstOptimal)
+                .setNewLayout(vk::ImageLayout::eReadOnlyOptimal)
+                .setSrcStageMask(vk::PipelineStageFlagBits2::eTransfer)
+                .setSrcAccessMask(vk::AccessFlagBits2::eTransferWrite)
+                .setDstStageMask(vk::PipelineStageFlagBits2::eNone)
+                .setDstAccessMask(vk::AccessFlagBits2::eNone);
+    }
+
+    if(!ImageBarriers.empty())
+    {
+        CommandBuffer.pipelineBarrier2(vk::DependencyInfo{}.setImageMemoryBarriers(ImageBarriers));
+    }
+
+    vkutil::pop_label(CommandBuffer);
+    CommandBuffer.end();
+
+    auto CommandBufferSubmitInfo = vk::CommandBufferSubmitInfo{}
+            .setCommandBuffer(CommandBuffer)
+            .setDeviceMask(1);
+
+    auto SignalInfo = vk::SemaphoreSubmitInfo{}
+            .setSemaphore(TransferTimeline)
+            .setValue(Value)
+            .setStageMask(vk::PipelineStageFlagBits2::eAllTransfer);
+
+    auto SubmitInfo = vk::SubmitInfo2{}
+            .setCommandBufferInfos(CommandBufferSubmitInfo)
+            .setSignalSemaphoreInfos(SignalInfo);
+
+    Context->QueueHandles.Transfer.submit2(SubmitInfo);
+
+    InFlightCommands.emplace_back(VInFlightCommands{
+        .CommandBuffer = CommandBuffer,
+        .Value = Value
+    });
+
+    for(VStagingRange* Range : SubmittedRanges)
+    {
+        Range->Value.store(Value, std::memory_order_release);
+    }
+}
+
+bool VUploadManager::IsComplete(uint64_t Value) const
+{
+    uint64_t CompletedValue;
+    vkResultCheck = Context->Device.getSemaphoreCounterValue(TransferTimeline, &CompletedValue);
+
+    return CompletedValue >= Value;
+}
+
+void VUploadManager::Wait(uint64_t Value) const
+{
+    auto WaitInfo = vk::SemaphoreWaitInfo{}
+            .setSemaphores(TransferTimeline)
+            .setValues(Value);
+
+    vkResultCheck = Context->Device.waitSemaphores(WaitInfo, vkutil::default_timeout);
+}
+
+void VUploadManager::WaitIdle()
+{
+    Flush();
+    Wait(NextValue.load(std::memory_order_acquire) - 1);
+}
+
+uint64_t VUploadManager::TakeDeviceWaitValue()
+{
+    return DeviceWaitValue.exchange(0, std::memory_order_acq_rel);
+}
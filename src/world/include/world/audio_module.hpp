@@ -9,7 +9,7 @@ class AudioModule
 private:
     static inline constinit AudioModule* Self = nullptr;
 
-    static void GarbageCollect(flecs::iter&);
+    static void ReclaimAssets(flecs::iter&);
     static void PlaySoundCues(SoundCueComponent& SoundCue);
 
 public:
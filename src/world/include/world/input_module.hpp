@@ -16,6 +16,7 @@ public:
     glm::ivec2 FramebufferSize{};
     glm::dvec2 CursorPos{};
     glm::dvec2 PrevCursorPos{};
+    bool bTraceKeyDown = false;
 
 public:
     explicit InputModule(flecs::world& world);
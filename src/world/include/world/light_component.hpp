@@ -0,0 +1,25 @@
+#ifndef STARSIGHT_LIGHT_COMPONENT_HPP
+#define STARSIGHT_LIGHT_COMPONENT_HPP
+
+#include "core/math.hpp"
+
+//point or spot light placed by the entity's WorldTransformComponent, spot lights shine along its forward axis
+class LightComponent
+{
+public:
+
+    enum LightType : uint8_t
+    {
+        point,
+        spot,
+    };
+
+    glm::fvec3 Color{1.f, 1.f, 1.f};
+    float Intensity = 1.f;
+    float Range = 10.f; //the light fades out to nothing at this distance
+    float InnerConeAngle = 0.5f; //half angles in radians, only used by spot lights
+    float OuterConeAngle = 0.6f;
+    LightType Type = point;
+};
+
+#endif //STARSIGHT_LIGHT_COMPONENT_HPP
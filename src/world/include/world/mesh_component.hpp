@@ -15,9 +15,21 @@ public:
     uint32_t positionBufferOffset = -1;
     uint32_t normalUVBufferOffset = -1;
     uint32_t baseColorIndex = -1;
+    uint32_t meshletBufferOffset = -1;
+    uint32_t meshletCount = 0;
+    uint32_t meshIndex = -1;
+    uint32_t lodCount = 0;
+    std::array<VShaderMeshLod, MESH_MAX_LODS> lods{};
 
     MeshComponent() = default;
     MeshComponent(const scene::MeshData& MeshData);
 };
 
+//stable index of the mesh in the renderers persistent scene buffers
+class SceneSlotComponent
+{
+public:
+    uint32_t Slot = UINT32_MAX;
+};
+
 #endif //STARSIGHT_MESH_COMPONENT_HPP
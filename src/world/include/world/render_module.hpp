@@ -5,42 +5,60 @@
 #include "mesh_component.hpp"
 #include "model_component.hpp"
 #include "camera_component.hpp"
+#include "light_component.hpp"
 #include "flecs.h"
 
 class VStarSightRenderer;
 
-struct DirtyTag{};
+struct DirtyTag{}; //add after modifying a TransformComponent so its subtree gets propagated
 
 class RenderModule
 {
 private:
     static inline constinit RenderModule* Self = nullptr;
 
-    static void GarbageCollect(flecs::iter&);
+    static void ReclaimAssets(flecs::iter&);
     static void BuildNodeEntities(flecs::iter& it, flecs::entity Parent, scene::SceneNode* Node, bool RootNode);
-    static void UpdateGraphTransforms(flecs::iter& it, size_t index, const TransformComponent&, DirtyTag);
+    static void DefragmentGeometry(flecs::iter& it);
+    static void PropagateTransforms(flecs::iter& it);
     static void LoadModels(flecs::iter& it, size_t index, ModelComponent& Model);
-    static void PrepareDeviceBuffers(flecs::iter& it);
-    static void UploadMeshData(const TransformComponent& Transform, const MeshComponent& Mesh);
+    static void FreeSceneSlot(flecs::entity Entity, SceneSlotComponent& SceneSlot);
+    static void UploadMeshData(flecs::iter& it);
     static void UploadCameraData(const CameraComponent& Camera);
+    static void UploadLightData(flecs::iter& it);
     static void FlushDeviceData(flecs::iter&);
     static void Draw(flecs::iter&);
 
+    //cascade ordered so parents are always iterated before their children
+    flecs::query<const TransformComponent, const WorldTransformComponent, WorldTransformComponent> TransformQuery{};
+    uint64_t TransformTick = 0;
+
+    flecs::query<const WorldTransformComponent, const MeshComponent, const SceneSlotComponent> SceneQuery{};
+    flecs::query<MeshComponent> MeshQuery{};
+    flecs::query<const WorldTransformComponent, const LightComponent> LightQuery{};
+
 public:
-    std::atomic_uint32_t MeshCount = 0;
     static inline constinit VStarSightRenderer* Renderer = nullptr;
 
 public:
     explicit RenderModule(flecs::world& world);
 
     RenderModule(RenderModule&& Other)
-        : MeshCount(Other.MeshCount.load(std::memory_order_relaxed))
+        : TransformQuery(std::move(Other.TransformQuery))
+        , TransformTick(Other.TransformTick)
+        , SceneQuery(std::move(Other.SceneQuery))
+        , MeshQuery(std::move(Other.MeshQuery))
+        , LightQuery(std::move(Other.LightQuery))
     {
     }
 
     RenderModule& operator=(RenderModule&& Other)
     {
-        MeshCount = Other.MeshCount.load(std::memory_order_relaxed);
+        TransformQuery = std::move(Other.TransformQuery);
+        TransformTick = Other.TransformTick;
+        SceneQuery = std::move(Other.SceneQuery);
+        MeshQuery = std::move(Other.MeshQuery);
+        LightQuery = std::move(Other.LightQuery);
         return *this;
     }
 
@@ -11,4 +11,14 @@ public:
     glm::fvec3 scale{1,1,1};
 };
 
+//accumulated transform of the entity and all its parents, written by the render module
+class WorldTransformComponent
+{
+public:
+    glm::dvec3 location{0,0,0};
+    glm::fquat rotation = glm::identity<glm::dquat>();
+    glm::fvec3 scale{1,1,1};
+    uint64_t UpdateTick = 0; //tick of the propagation pass that last wrote this transform
+};
+
 #endif //STARSIGHT_TRANSFORM_COMPONENT_HPP
@@ -11,10 +11,9 @@ AudioModule::AudioModule(flecs::world& world)
             .kind(flecs::OnUpdate)
             .each(PlaySoundCues);
 
-    world.system("Audio Context GC")
+    world.system("Reclaim Audio Buffers")
             .kind(flecs::PostUpdate)
-            .interval(10)
-            .iter(GarbageCollect);
+            .iter(ReclaimAssets);
 }
 
 AudioModule::~AudioModule()
@@ -22,9 +21,9 @@ AudioModule::~AudioModule()
     Self = nullptr;
 }
 
-void AudioModule::GarbageCollect(flecs::iter&)
+void AudioModule::ReclaimAssets(flecs::iter&)
 {
-    alContext->GarbageCollect();
+    alContext->Reclaim();
 }
 
 void AudioModule::PlaySoundCues(SoundCueComponent& SoundCue)
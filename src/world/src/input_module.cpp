@@ -1,5 +1,8 @@
 #include "input_module.hpp"
 #include "window/window.hpp"
+#include "core/cpu_profiler.hpp"
+#include "core/time.hpp"
+#include "fmt/format.h"
 
 InputModule::InputModule(flecs::world& world)
 {
@@ -25,16 +28,36 @@ InputModule::~InputModule()
 
 void InputModule::PollWindowEvents(flecs::iter& it)
 {
+    //headless there is no window and cameras are only moved from code
+    if(global::Window == nullptr)
+    {
+        return;
+    }
+
     glfwPollEvents();
 
     Self->PrevCursorPos = Self->CursorPos;
     glfwGetCursorPos(global::Window, &Self->CursorPos.x, &Self->CursorPos.y);
 
     glfwGetFramebufferSize(global::Window, &Self->FramebufferSize.x, &Self->FramebufferSize.y);
+
+    //F9 writes the zones the cpu profiler still holds of every thread
+    bool bTraceKey = glfwGetKey(global::Window, GLFW_KEY_F9) == GLFW_PRESS;
+    if(bTraceKey && !Self->bTraceKeyDown)
+    {
+        global::Profiler.ExportChromeTrace(ProjectAbsolutePath(fmt::format("saved/traces/frame_{}.json", global::ProgramTime.FrameCount)));
+    }
+
+    Self->bTraceKeyDown = bTraceKey;
 }
 
 void InputModule::UpdateCameras(flecs::iter& it, size_t, CameraComponent& Camera)
 {
+    if(global::Window == nullptr)
+    {
+        return;
+    }
+
     if(glfwGetInputMode(global::Window, GLFW_CURSOR) == GLFW_CURSOR_DISABLED)
     {
         if(Camera.Mode == CameraComponent::fly)
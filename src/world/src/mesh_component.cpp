@@ -3,7 +3,7 @@
 
 MeshComponent::MeshComponent(const scene::MeshData& MeshData)
 {
-    const VMesh& Mesh = vkContext->ModelManager->Meshes.at(MeshData.MeshName);
+    const VMesh& Mesh = vkContext->ModelManager->Meshes.At(MeshData.Mesh);
 
     SphereBounds = Mesh.SphereBounds;
 
@@ -12,14 +12,19 @@ MeshComponent::MeshComponent(const scene::MeshData& MeshData)
     indexBufferOffset = Mesh.IndexSlot.Offset;
     positionBufferOffset = Mesh.PositionSlot.Offset;
     normalUVBufferOffset = Mesh.NormalUVSlot.Offset;
+    meshletBufferOffset = Mesh.MeshletSlot.Offset;
+    meshletCount = Mesh.MeshletCount;
+    meshIndex = Mesh.MeshIndex;
+    lodCount = Mesh.LodCount;
+    lods = Mesh.Lods;
 
     baseColorIndex = 0;
     for(const auto& TextureRef : MeshData.Textures)
     {
         if(TextureRef.Type == aiTextureType_BASE_COLOR || TextureRef.Type == aiTextureType_DIFFUSE)
         {
-            const VTexture& Texture = vkContext->ModelManager->Textures.at(TextureRef.Name);
-            baseColorIndex = Texture.DescriptorSlot;
+            const VTexture& Texture = vkContext->ModelManager->Textures.At(TextureRef.Texture);
+            baseColorIndex = Texture.DescriptorHandle.Index();
             break;
         }
     }
@@ -4,7 +4,48 @@
 #include "render/vk_render_target.hpp"
 #include "window/window.hpp"
 #include "input_module.hpp"
-#include "core/ssovector.hpp"
+#include "core/utility_functions.hpp"
+#include "core/linear_arena.hpp"
+#include <algorithm>
+#include <cmath>
+#include <unordered_map>
+#include <vector>
+
+namespace
+{
+    //a contiguous range of entities in one table, all sharing the same parent
+    struct TransformBatch
+    {
+        const TransformComponent* Local = nullptr;
+        const WorldTransformComponent* Parent = nullptr;
+        WorldTransformComponent* World = nullptr;
+        size_t Count = 0;
+    };
+
+    void PropagateTransformBatch(const TransformBatch& Batch)
+    {
+        for(size_t index = 0; index < Batch.Count; ++index)
+        {
+            const TransformComponent& Local = Batch.Local[index];
+            WorldTransformComponent& World = Batch.World[index];
+
+            if(Batch.Parent != nullptr)
+            {
+                const WorldTransformComponent& Parent = *Batch.Parent;
+
+                World.location = Parent.location + glm::dquat(Parent.rotation) * (glm::dvec3(Parent.scale) * Local.location);
+                World.rotation = Parent.rotation * Local.rotation;
+                World.scale = Parent.scale * Local.scale;
+            }
+            else
+            {
+                World.location = Local.location;
+                World.rotation = Local.rotation;
+                World.scale = Local.scale;
+            }
+        }
+    }
+}
 
 RenderModule::RenderModule(flecs::world& world)
 {
@@ -17,6 +58,22 @@ RenderModule::RenderModule(flecs::world& world)
     world.component<ModelComponent>("Model");
     world.component<MeshComponent>("Mesh");
     world.component<TransformComponent>("Transform");
+    world.component<WorldTransformComponent>("World Transform");
+    world.component<SceneSlotComponent>("Scene Slot");
+    world.component<LightComponent>("Light");
+
+    TransformQuery = world.query_builder<const TransformComponent, const WorldTransformComponent, WorldTransformComponent>()
+            .term_at(2).parent().cascade().optional()
+            .term<DirtyTag>().optional()
+            .build();
+
+    SceneQuery = world.query<const WorldTransformComponent, const MeshComponent, const SceneSlotComponent>();
+    MeshQuery = world.query<MeshComponent>();
+    LightQuery = world.query<const WorldTransformComponent, const LightComponent>();
+
+    world.observer<SceneSlotComponent>("Free Scene Slot")
+            .event(flecs::OnRemove)
+            .each(FreeSceneSlot);
 
     world.system<ModelComponent>("Load Models")
             .kind(flecs::OnLoad)
@@ -25,34 +82,39 @@ RenderModule::RenderModule(flecs::world& world)
             .write<DirtyTag>()
             .each(LoadModels);
 
-    world.system<TransformComponent, DirtyTag>("Update Dirty Graph Transforms")
+    world.system("Defragment Geometry")
             .kind(flecs::PreUpdate)
-            .read<TransformComponent>()
-            .write<TransformComponent>()
-            .read<DirtyTag>()
+            .write<MeshComponent>()
             .write<DirtyTag>()
-            .each(UpdateGraphTransforms);
+            .iter(DefragmentGeometry);
 
-    world.system("Prepare Device Buffers")
+    world.system("Propagate Transforms")
             .kind(flecs::PreUpdate)
-            .read<ModelComponent>()
-            .iter(PrepareDeviceBuffers);
+            .read<TransformComponent>()
+            .write<WorldTransformComponent>()
+            .write<DirtyTag>()
+            .iter(PropagateTransforms);
 
-    world.system<TransformComponent, MeshComponent>("Upload Mesh Data")
+    world.system("Upload Mesh Data")
             .kind(flecs::OnUpdate)
-            .read<TransformComponent>()
-            .read<ModelComponent>()
-            .multi_threaded(true)
-            .each(UploadMeshData);
+            .read<WorldTransformComponent>()
+            .read<MeshComponent>()
+            .read<SceneSlotComponent>()
+            .iter(UploadMeshData);
 
     world.system<CameraComponent>("Upload Camera Data")
             .kind(flecs::OnUpdate)
             .each(UploadCameraData);
 
-    world.system("ModelManager GC")
+    world.system("Upload Light Data")
+            .kind(flecs::OnUpdate)
+            .read<WorldTransformComponent>()
+            .read<LightComponent>()
+            .iter(UploadLightData);
+
+    world.system("Reclaim Model Assets")
             .kind(flecs::PostUpdate)
-            .interval(10)
-            .iter(GarbageCollect);
+            .iter(ReclaimAssets);
 
     world.system("Flush Device Data")
             .kind(flecs::PreStore)
@@ -68,9 +130,9 @@ RenderModule::~RenderModule()
     Self = nullptr;
 }
 
-void RenderModule::GarbageCollect(flecs::iter&)
+void RenderModule::ReclaimAssets(flecs::iter&)
 {
-    vkContext->ModelManager->GarbageCollect();
+    vkContext->ModelManager->Reclaim();
 }
 
 void RenderModule::BuildNodeEntities(flecs::iter& it, flecs::entity Parent, scene::SceneNode* Node, bool RootNode)
@@ -91,6 +153,7 @@ void RenderModule::BuildNodeEntities(flecs::iter& it, flecs::entity Parent, scen
         RootTransform.scale *= Node->Transform.Scale;
 
         Parent.set<TransformComponent>(RootTransform);
+        Parent.add<WorldTransformComponent>();
         Parent.add<DirtyTag>();
     }
     else
@@ -101,7 +164,9 @@ void RenderModule::BuildNodeEntities(flecs::iter& it, flecs::entity Parent, scen
                     .location = Node->Transform.Translation,
                     .rotation = Node->Transform.Rotation,
                     .scale = Node->Transform.Scale
-                });
+                })
+                .add<WorldTransformComponent>()
+                .add<DirtyTag>();
     }
 
     if(auto* MeshNode = dynamic_cast<scene::MeshNode*>(Node))
@@ -111,7 +176,10 @@ void RenderModule::BuildNodeEntities(flecs::iter& it, flecs::entity Parent, scen
             it.world().entity()
                     .add(flecs::ChildOf, NodeEntity)
                     .set<TransformComponent>({})
-                    .set<MeshComponent>(Mesh);
+                    .add<WorldTransformComponent>()
+                    .add<DirtyTag>()
+                    .set<MeshComponent>(Mesh)
+                    .set<SceneSlotComponent>({Renderer->GrabSceneSlot()});
         }
     }
 
@@ -138,122 +206,186 @@ void RenderModule::LoadModels(flecs::iter& it, size_t index, ModelComponent& Mod
     }
 }
 
-void RenderModule::UpdateGraphTransforms(flecs::iter& it, size_t index, const TransformComponent&, DirtyTag)
+void RenderModule::DefragmentGeometry(flecs::iter&)
 {
-    flecs::entity Entity = it.entity(index);
-    Entity.remove<DirtyTag>();
+    std::vector<VGeometryRelocation> Relocations = vkContext->ModelManager->DefragmentGeometry(GEOMETRY_DEFRAG_BYTES_PER_TICK);
+    if(Relocations.empty())
+    {
+        return;
+    }
 
-    ssovector<flecs::entity, 32> FinalChildren{};
-    std::function<void(flecs::entity)> AddChildren = [&FinalChildren, &AddChildren](flecs::entity Child) -> void
+    std::unordered_map<uint32_t, uint32_t> IndexOffsets{};
+    std::unordered_map<uint32_t, uint32_t> VertexOffsets{};
+
+    for(const VGeometryRelocation& Relocation : Relocations)
     {
-        bool HasChildren = false;
-        Child.children([&HasChildren, &AddChildren](flecs::entity Child)
-        {
-            HasChildren = true;
-            AddChildren(Child);
-        });
+        auto& Offsets = Relocation.Buffer == &vkContext->GlobalIndexBuffer ? IndexOffsets : VertexOffsets;
+        Offsets.emplace(Relocation.Src.Offset, Relocation.Dst.Offset);
+    }
 
-        if(!HasChildren)
+    auto Remap = [](const std::unordered_map<uint32_t, uint32_t>& Offsets, uint32_t& Offset)
+    {
+        auto it = Offsets.find(Offset);
+        if(it == Offsets.end())
         {
-            FinalChildren.emplace_back(Child);
+            return false;
         }
-    };
 
-    Entity.children([&AddChildren](flecs::entity Child){
-        AddChildren(Child);
-    });
+        Offset = it->second;
+        return true;
+    };
 
-    for(flecs::entity Child : FinalChildren)
+    Self->MeshQuery.iter([&](flecs::iter& qit, MeshComponent* Meshes)
     {
-        auto* ChildTransform = Child.get_mut<TransformComponent>();
-        *ChildTransform = TransformComponent{}; //reset the transform
-
-        flecs::entity Parent = Child.parent();
-        while(Parent.is_valid())
+        for(size_t index : qit)
         {
-            if(const auto* ParentTransform = Parent.get<TransformComponent>())
+            MeshComponent& Mesh = Meshes[index];
+
+            bool bRelocated = Remap(IndexOffsets, Mesh.indexBufferOffset);
+            bRelocated |= Remap(VertexOffsets, Mesh.positionBufferOffset);
+            bRelocated |= Remap(VertexOffsets, Mesh.normalUVBufferOffset);
+            bRelocated |= Remap(VertexOffsets, Mesh.meshletBufferOffset);
+
+            if(bRelocated)
             {
-                ChildTransform->location += ParentTransform->location;
-                ChildTransform->rotation = ParentTransform->rotation * ChildTransform->rotation;
-                ChildTransform->scale *= ParentTransform->scale;
+                qit.entity(index).add<DirtyTag>(); //gets the new offsets uploaded along with the transform
             }
-
-            Parent = Parent.parent();
         }
-    }
+    });
 }
 
-void RenderModule::PrepareDeviceBuffers(flecs::iter& it)
+void RenderModule::PropagateTransforms(flecs::iter& it)
 {
-    Self->MeshCount.store(0, std::memory_order_relaxed);
+    const uint64_t Tick = ++Self->TransformTick;
 
-    uint64_t TotalMeshCount = it.world().count<MeshComponent>();
+    //batches are grouped by hierarchy depth, every depth has to be finished before the next one can start
+    //they only live for this system, so they come from the frame arena instead of the heap
+    TArenaAllocator<TransformBatch> FrameAllocator{Renderer->GetFrameArena()};
+    TArenaVector<TArenaVector<TransformBatch>> DepthBatches(FrameAllocator);
 
-    uint64_t DrawCommandsCount = (Renderer->DrawIndirectCommandsBuffer.Size - sizeof(VShaderDrawIndirectCount)) / sizeof(vk::DrawIndexedIndirectCommand);
-    uint64_t MeshTransformCount = Renderer->ActiveFrame->MeshTransforms.Size / sizeof(VShaderTransform);
-    uint64_t MeshInfoCount = Renderer->ActiveFrame->MeshInfos.Size / sizeof(VShaderMeshInfo);
-    uint64_t MeshBoundsCount = Renderer->ActiveFrame->MeshBounds.Size / sizeof(glm::fvec4);
+    Self->TransformQuery.iter([&DepthBatches, &FrameAllocator, Tick](flecs::iter& qit, const TransformComponent* Local, const WorldTransformComponent* Parent, WorldTransformComponent* World)
+    {
+        bool bDirty = qit.is_set(4);
+        bool bParentChanged = qit.is_set(2) && Parent->UpdateTick == Tick;
 
-    auto BufferSize = [TotalMeshCount](uint64_t ElementSize){
-        return math::PadSize2Alignment(DEVICE_MESH_ALLOCATION_STEP + (TotalMeshCount * ElementSize), uint64_t(DEVICE_MESH_ALLOCATION_STEP));
-    };
+        //only touch subtrees where either the node itself or one of its ancestors has changed
+        if(!bDirty && !bParentChanged)
+        {
+            qit.skip(); //keeps the table out of change detection
+            return;
+        }
 
-    if(TotalMeshCount > DrawCommandsCount || TotalMeshCount + DEVICE_MESH_ALLOCATION_STEP * 2 < DrawCommandsCount) [[unlikely]]
-    {
-        vkContext->ReallocateBuffer(&Renderer->DrawIndirectCommandsBuffer, sizeof(VShaderDrawIndirectCount) + BufferSize(sizeof(vk::DrawIndexedIndirectCommand)));
-    }
+        //stamped here so children collected later in cascade order see it before the values are written
+        for(size_t index : qit)
+        {
+            World[index].UpdateTick = Tick;
+        }
 
-    if(TotalMeshCount > MeshTransformCount || TotalMeshCount + DEVICE_MESH_ALLOCATION_STEP * 2 < MeshTransformCount) [[unlikely]]
-    {
-        vkContext->ReallocateBuffer(&Renderer->ActiveFrame->MeshTransforms, BufferSize(sizeof(VShaderTransform)));
-    }
+        uint64_t Depth = qit.group_id();
+        if(Depth >= DepthBatches.size())
+        {
+            DepthBatches.resize(Depth + 1, TArenaVector<TransformBatch>(FrameAllocator));
+        }
 
-    if(TotalMeshCount > MeshInfoCount || TotalMeshCount + DEVICE_MESH_ALLOCATION_STEP * 2 < MeshInfoCount) [[unlikely]]
+        DepthBatches[Depth].emplace_back(TransformBatch{
+            .Local = Local,
+            .Parent = qit.is_set(2) ? Parent : nullptr,
+            .World = World,
+            .Count = qit.count()
+        });
+
+        if(bDirty)
+        {
+            for(size_t index : qit)
+            {
+                qit.entity(index).remove<DirtyTag>(); //deferred until the end of the system
+            }
+        }
+    });
+
+    for(TArenaVector<TransformBatch>& Batches : DepthBatches)
     {
-        vkContext->ReallocateBuffer(&Renderer->ActiveFrame->MeshInfos, BufferSize(sizeof(VShaderMeshInfo)));
+        if(Batches.size() <= 1)
+        {
+            for(const TransformBatch& Batch : Batches)
+            {
+                PropagateTransformBatch(Batch);
+            }
+        }
+        else
+        {
+            global::Scheduler.ParallelFor(JobPriority::FrameCritical, 0, Batches.size(), [&](uint64_t Batch)
+            {
+                PropagateTransformBatch(Batches[Batch]);
+            });
+        }
     }
+}
 
-    if(TotalMeshCount > MeshBoundsCount || TotalMeshCount + DEVICE_MESH_ALLOCATION_STEP * 2 < MeshBoundsCount) [[unlikely]]
+void RenderModule::FreeSceneSlot(flecs::entity, SceneSlotComponent& SceneSlot)
+{
+    if(SceneSlot.Slot != UINT32_MAX)
     {
-        vkContext->ReallocateBuffer(&Renderer->ActiveFrame->MeshBounds, BufferSize(sizeof(glm::fvec4)));
+        Renderer->FreeSceneSlot(SceneSlot.Slot);
+        SceneSlot.Slot = UINT32_MAX;
     }
 }
 
-void RenderModule::UploadMeshData(const TransformComponent& Transform, const MeshComponent& Mesh)
+void RenderModule::UploadMeshData(flecs::iter&)
 {
-    const uint32_t thisIndex = Self->MeshCount.fetch_add(1, std::memory_order_relaxed);
-
-    void* pMeshTransform = static_cast<VShaderTransform*>(Renderer->ActiveFrame->MeshTransforms.MappedData) + thisIndex;
-    void* pMeshInfo = static_cast<VShaderMeshInfo*>(Renderer->ActiveFrame->MeshInfos.MappedData) + thisIndex;
-    void* pMeshBounds = static_cast<glm::fvec4*>(Renderer->ActiveFrame->MeshBounds.MappedData) + thisIndex;
-
-    //https://godotengine.org/article/emulating-double-precision-gpu-render-large-worlds/
-    VShaderTransform ShaderTransform{};
-    ShaderTransform.Translation = glm::fvec3(Transform.location);
-    ShaderTransform.Translation_Err = glm::fvec3(Transform.location - glm::dvec3(ShaderTransform.Translation));
-    ShaderTransform.Rotation = glm::fquat(Transform.rotation);
-    ShaderTransform.Scale = glm::fvec3(Transform.scale);
-
-    VShaderMeshInfo ShaderMeshInfo{};
-    ShaderMeshInfo.indexCount = Mesh.indexCount;
-    ShaderMeshInfo.vertexCount = Mesh.vertexCount;
-    ShaderMeshInfo.indexBufferOffset = Mesh.indexBufferOffset;
-    ShaderMeshInfo.positionBufferOffset = Mesh.positionBufferOffset;
-    ShaderMeshInfo.normalUVBufferOffset = Mesh.normalUVBufferOffset;
-    ShaderMeshInfo.baseColorIndex = Mesh.baseColorIndex;
-
-    glm::fvec4 ShaderMeshBounds = Mesh.SphereBounds;
-
-    memcpy(pMeshTransform, &ShaderTransform, sizeof(ShaderTransform));
-    memcpy(pMeshInfo, &ShaderMeshInfo, sizeof(ShaderMeshInfo));
-    memcpy(pMeshBounds, &ShaderMeshBounds, sizeof(ShaderMeshBounds));
+    const uint64_t Tick = Self->TransformTick;
+
+    Self->SceneQuery.iter([Tick](flecs::iter& qit, const WorldTransformComponent* Transforms, const MeshComponent* Meshes, const SceneSlotComponent* SceneSlots)
+    {
+        //tables nobody wrote to since the last upload are skipped without touching their entities
+        if(!qit.changed())
+        {
+            return;
+        }
+
+        for(size_t index : qit)
+        {
+            const WorldTransformComponent& Transform = Transforms[index];
+            const MeshComponent& Mesh = Meshes[index];
+
+            if(Transform.UpdateTick != Tick)
+            {
+                continue;
+            }
+
+            VShaderSceneUpdate Update{};
+            Update.Slot = SceneSlots[index].Slot;
+
+            //https://godotengine.org/article/emulating-double-precision-gpu-render-large-worlds/
+            Update.Transform.Translation = glm::fvec3(Transform.location);
+            Update.Transform.Translation_Err = glm::fvec3(Transform.location - glm::dvec3(Update.Transform.Translation));
+            Update.Transform.Rotation = glm::fquat(Transform.rotation);
+            Update.Transform.Scale = glm::fvec3(Transform.scale);
+
+            Update.MeshInfo.indexCount = Mesh.indexCount;
+            Update.MeshInfo.vertexCount = Mesh.vertexCount;
+            Update.MeshInfo.indexBufferOffset = Mesh.indexBufferOffset;
+            Update.MeshInfo.positionBufferOffset = Mesh.positionBufferOffset;
+            Update.MeshInfo.normalUVBufferOffset = Mesh.normalUVBufferOffset;
+            Update.MeshInfo.baseColorIndex = Mesh.baseColorIndex;
+            Update.MeshInfo.meshletBufferOffset = Mesh.meshletBufferOffset;
+            Update.MeshInfo.meshletCount = Mesh.meshletCount;
+            Update.MeshInfo.meshIndex = Mesh.meshIndex;
+            Update.MeshInfo.lodCount = Mesh.lodCount;
+            Update.MeshInfo.lods = Mesh.lods;
+
+            Update.Bounds = Mesh.SphereBounds;
+
+            Renderer->UpdateSceneSlot(Update);
+        }
+    });
 }
 
 void RenderModule::UploadCameraData(const CameraComponent& Camera)
 {
     VShaderCameraData Data{};
     Data.View = Camera.MakeView();
-    Data.Projection = Camera.MakeProjection(InputModule::Self->FramebufferSize.x, InputModule::Self->FramebufferSize.y);
+    Data.Projection = Camera.MakeProjection(Renderer->ImageExtent.width, Renderer->ImageExtent.height); //there is no framebuffer size headless
     Data.ViewProjection = Data.Projection * Data.View;
     Data.Location = glm::fvec3{Camera.Location};
     Data.LocationErr = glm::fvec3{glm::dvec3{Data.Location} - Camera.Location};
@@ -276,36 +408,50 @@ void RenderModule::UploadCameraData(const CameraComponent& Camera)
     memcpy(ShaderCamera, &Data, sizeof(VShaderCameraData));
 }
 
-void RenderModule::FlushDeviceData(flecs::iter&)
+void RenderModule::UploadLightData(flecs::iter&)
 {
-    uint32_t UploadedMeshesCount = Self->MeshCount.load(std::memory_order_relaxed);
+    std::vector<VShaderLight> Lights{};
 
-    std::array Allocations{
-            Renderer->CameraBuffer.Allocation,
-            Renderer->ActiveFrame->MeshTransforms.Allocation,
-            Renderer->ActiveFrame->MeshInfos.Allocation,
-            Renderer->ActiveFrame->MeshBounds.Allocation,
-    };
+    //the light set is small next to the scene and moves every frame, so it is rebuilt whole instead of tracked per slot
+    Self->LightQuery.iter([&Lights](flecs::iter& qit, const WorldTransformComponent* Transforms, const LightComponent* LightComponents)
+    {
+        for(size_t index : qit)
+        {
+            const WorldTransformComponent& Transform = Transforms[index];
+            const LightComponent& Light = LightComponents[index];
 
-    std::array Offsets{
-            vk::DeviceSize{Renderer->ActiveFrameIndex() * sizeof(VShaderCameraData)},
-            vk::DeviceSize{0},
-            vk::DeviceSize{0},
-            vk::DeviceSize{0}
-    };
+            VShaderLight& ShaderLight = Lights.emplace_back();
+            ShaderLight.Translation = glm::fvec3(Transform.location);
+            ShaderLight.Translation_Err = glm::fvec3(Transform.location - glm::dvec3(ShaderLight.Translation));
+            ShaderLight.Direction = glm::fvec3(glm::dquat(Transform.rotation) * axis::forward);
+            ShaderLight.Range = Light.Range;
+            ShaderLight.Color = Light.Color * Light.Intensity;
 
-    std::array Sizes{
-            vk::DeviceSize{sizeof(VShaderCameraData)},
-            vk::DeviceSize{sizeof(VShaderTransform) * UploadedMeshesCount},
-            vk::DeviceSize{sizeof(VShaderMeshInfo) * UploadedMeshesCount},
-            vk::DeviceSize{sizeof(glm::fvec4) * UploadedMeshesCount}
-    };
+            if(Light.Type == LightComponent::spot)
+            {
+                ShaderLight.CosInnerCone = std::cos(Light.InnerConeAngle);
+                ShaderLight.CosOuterCone = std::cos(std::max(Light.OuterConeAngle, Light.InnerConeAngle + 0.001f));
+            }
+            else
+            {
+                ShaderLight.CosInnerCone = -1.f;
+                ShaderLight.CosOuterCone = -2.f;
+            }
+        }
+    });
 
-    vkContext->Allocator.flushAllocations(Allocations, Offsets, Sizes);
+    Renderer->UpdateLights(std::move(Lights));
 }
 
-void RenderModule::Draw(flecs::iter&)
+void RenderModule::FlushDeviceData(flecs::iter&)
 {
-    Renderer->DrawDeferred(Self->MeshCount.load(std::memory_order_relaxed));
+    vkContext->Uploader->Flush();
+
+    vk::DeviceSize Offset = Renderer->ActiveFrameIndex() * sizeof(VShaderCameraData);
+    vkContext->Allocator.flushAllocation(Renderer->CameraBuffer.Allocation, Offset, sizeof(VShaderCameraData));
 }
 
+void RenderModule::Draw(flecs::iter&)
+{
+    Renderer->DrawDeferred(Renderer->GetSceneSlotCount());
+}
@@ -4,7 +4,9 @@
 #include "input_module.hpp"
 #include "audio_module.hpp"
 #include "render_module.hpp"
+#include "core/cpu_profiler.hpp"
 #include <string>
+#include <vector>
 
 /* Logging function. The level should be interpreted as: */
 /* >0: Debug tracing. Only enabled in debug builds. */
@@ -36,6 +38,47 @@ void FlecsLog(int32_t level, const char *file, int32_t line, const char *msg)
     }
 }
 
+#if CPU_PROFILER
+//takes the place of the default runner of a system to put it in a zone named after the system
+void ProfiledSystemRun(ecs_iter_t* it)
+{
+    CpuProfileScope Scope{static_cast<const char*>(it->ctx)};
+
+    //systems without terms run their callback once, like the default runner does
+    if(it->field_count == 0)
+    {
+        it->callback(it);
+        ecs_iter_fini(it);
+        return;
+    }
+
+    while(ecs_iter_next(it))
+    {
+        it->callback(it);
+    }
+}
+
+//every system the modules have registered, the names are interned since the trace can be exported after the world is gone
+void ProfileSystems(flecs::world& World)
+{
+    std::vector<flecs::entity> Systems{};
+    World.filter_builder<>()
+            .term(flecs::System)
+            .build()
+            .each([&Systems](flecs::entity System){ Systems.emplace_back(System); });
+
+    for(flecs::entity System : Systems)
+    {
+        ecs_system_desc_t SystemDesc{};
+        SystemDesc.entity = System;
+        SystemDesc.run = &ProfiledSystemRun;
+        SystemDesc.ctx = const_cast<char*>(global::Profiler.InternName(System.name().c_str()));
+
+        ecs_system_init(World, &SystemDesc);
+    }
+}
+#endif
+
 std::optional<flecs::world> CreateWorld()
 {
     ecs_os_set_api_defaults();
@@ -49,11 +92,16 @@ std::optional<flecs::world> CreateWorld()
 #endif
     ecs_os_set_api(&ecsOsApi);
 
+    //single staged, flecs stage tasks wait on each other at every sync point and would hold scheduler workers for the whole progress
+    //systems that are worth splitting up do so with global::Scheduler.ParallelFor at frame critical priority, the calling thread helping
     flecs::world World{};
-    World.set_threads(std::max(1u, std::thread::hardware_concurrency()));
     World.import<InputModule>();
     World.import<RenderModule>();
     World.import<AudioModule>();
 
+#if CPU_PROFILER
+    ProfileSystems(World);
+#endif
+
     return World;
 }
\ No newline at end of file